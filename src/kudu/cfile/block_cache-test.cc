@@ -25,12 +25,32 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/casts.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
 
+DECLARE_double(block_cache_decoded_ratio);
+DECLARE_double(block_cache_high_priority_ratio);
 DECLARE_double(cache_memtracker_approximation_ratio);
 
+METRIC_DECLARE_counter(block_cache_decoded_hits_caching);
+METRIC_DECLARE_counter(block_cache_decoded_inserts);
+METRIC_DECLARE_counter(block_cache_decoded_misses_caching);
+METRIC_DECLARE_counter(block_cache_high_priority_evictions);
+METRIC_DECLARE_counter(block_cache_high_priority_hits_caching);
+METRIC_DECLARE_counter(block_cache_high_priority_inserts);
+METRIC_DECLARE_counter(block_cache_normal_priority_evictions);
+METRIC_DECLARE_counter(block_cache_normal_priority_inserts);
+METRIC_DECLARE_counter(block_cache_hits_caching);
+METRIC_DECLARE_counter(block_cache_misses_caching);
+METRIC_DECLARE_counter(block_cache_normal_priority_misses_caching);
+METRIC_DECLARE_entity(server);
+METRIC_DECLARE_gauge_uint64(block_cache_high_priority_usage);
+
 namespace kudu {
 namespace cfile {
 
@@ -54,11 +74,11 @@ TEST(TestBlockCache, TestBasics) {
   // Lookup something missing from cache
   {
     BlockCacheHandle handle;
-    ASSERT_FALSE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+    ASSERT_FALSE(cache.Lookup(key, BlockCache::Priority::NORMAL, Cache::EXPECT_IN_CACHE, &handle));
     ASSERT_FALSE(handle.valid());
   }
 
-  BlockCache::PendingEntry data = cache.Allocate(key, data_size);
+  BlockCache::PendingEntry data = cache.Allocate(key, BlockCache::Priority::NORMAL, data_size);
   memcpy(data.val_ptr(), DATA_TO_CACHE, data_size);
 
   // Insert and re-lookup
@@ -74,7 +94,8 @@ TEST(TestBlockCache, TestBasics) {
   }
 
   BlockCacheHandle retrieved_handle;
-  ASSERT_TRUE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &retrieved_handle));
+  ASSERT_TRUE(cache.Lookup(key, BlockCache::Priority::NORMAL, Cache::EXPECT_IN_CACHE,
+                           &retrieved_handle));
   ASSERT_TRUE(retrieved_handle.valid());
 
   ASSERT_EQ(0, memcmp(retrieved_handle.data().data(), DATA_TO_CACHE, data_size));
@@ -82,7 +103,93 @@ TEST(TestBlockCache, TestBasics) {
   // Ensure that a lookup for a different offset doesn't
   // return this data.
   BlockCache::CacheKey key1(id, 3);
-  ASSERT_FALSE(cache.Lookup(key1, Cache::EXPECT_IN_CACHE, &retrieved_handle));
+  ASSERT_FALSE(cache.Lookup(key1, BlockCache::Priority::NORMAL, Cache::EXPECT_IN_CACHE,
+                            &retrieved_handle));
+}
+
+// Test that high-priority blocks aren't evicted by normal-priority blocks,
+// and that each priority has its own metrics.
+TEST(TestBlockCache, TestHighPriorityBlocksArePooled) {
+  const int kCapacity = 16 * 1024 * 1024;
+  const int kBlockSize = 4 * 1024;
+  FLAGS_block_cache_high_priority_ratio = 0.25;
+  BlockCache cache(kCapacity);
+
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity(METRIC_ENTITY_server.Instantiate(&registry, "test"));
+  cache.StartInstrumentation(entity);
+
+  auto insert = [&](const BlockCache::CacheKey& key, BlockCache::Priority priority) {
+    BlockCache::PendingEntry entry = cache.Allocate(key, priority, kBlockSize);
+    ASSERT_TRUE(entry.valid());
+    memset(entry.val_ptr(), 0, kBlockSize);
+    BlockCacheHandle handle;
+    cache.Insert(&entry, &handle);
+  };
+  BlockCache::FileId index_file(1);
+  BlockCache::CacheKey index_key(index_file, 1);
+  NO_FATALS(insert(index_key, BlockCache::Priority::HIGH));
+
+  // Read twice the cache's capacity worth of data blocks, as a large scan
+  // would.
+  BlockCache::FileId data_file(2);
+  const int kNumDataBlocks = 2 * kCapacity / kBlockSize;
+  for (int i = 0; i < kNumDataBlocks; i++) {
+    BlockCache::CacheKey key(data_file, i);
+    BlockCacheHandle handle;
+    ASSERT_FALSE(cache.Lookup(key, BlockCache::Priority::NORMAL, Cache::EXPECT_IN_CACHE,
+                              &handle));
+    NO_FATALS(insert(key, BlockCache::Priority::NORMAL));
+  }
+
+  BlockCacheHandle handle;
+  ASSERT_TRUE(cache.Lookup(index_key, BlockCache::Priority::HIGH, Cache::EXPECT_IN_CACHE,
+                           &handle));
+
+  auto counter_value = [&](const CounterPrototype& proto) {
+    return down_cast<Counter*>(entity->FindOrNull(proto).get())->value();
+  };
+  ASSERT_EQ(1, counter_value(METRIC_block_cache_high_priority_inserts));
+  ASSERT_EQ(1, counter_value(METRIC_block_cache_high_priority_hits_caching));
+  ASSERT_EQ(0, counter_value(METRIC_block_cache_high_priority_evictions));
+  ASSERT_EQ(kNumDataBlocks, counter_value(METRIC_block_cache_normal_priority_inserts));
+  ASSERT_EQ(kNumDataBlocks, counter_value(METRIC_block_cache_normal_priority_misses_caching));
+  ASSERT_GT(counter_value(METRIC_block_cache_normal_priority_evictions), 0);
+  ASSERT_EQ(kBlockSize, down_cast<AtomicGauge<uint64_t>*>(
+      entity->FindOrNull(METRIC_block_cache_high_priority_usage).get())->value());
+}
+
+// Test that lookups of decoded blocks are counted by metrics of their own,
+// rather than by those of the encoded blocks.
+TEST(TestBlockCache, TestDecodedBlocksHaveOwnMetrics) {
+  const int kBlockSize = 4 * 1024;
+  FLAGS_block_cache_decoded_ratio = 0.25;
+  BlockCache cache(16 * 1024 * 1024);
+  ASSERT_TRUE(cache.has_decoded_pool());
+
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity(METRIC_ENTITY_server.Instantiate(&registry, "test"));
+  cache.StartInstrumentation(entity);
+
+  BlockCache::FileId id(1);
+  BlockCache::CacheKey key(id, 1);
+  BlockCacheHandle handle;
+  ASSERT_FALSE(cache.LookupDecoded(key, &handle));
+  BlockCache::PendingEntry entry = cache.AllocateDecoded(key, kBlockSize);
+  ASSERT_TRUE(entry.valid());
+  memset(entry.val_ptr(), 0, kBlockSize);
+  cache.Insert(&entry, &handle);
+  ASSERT_TRUE(cache.LookupDecoded(key, &handle));
+
+  auto counter_value = [&](const CounterPrototype& proto) {
+    scoped_refptr<Metric> m = entity->FindOrNull(proto);
+    return m ? down_cast<Counter*>(m.get())->value() : 0;
+  };
+  ASSERT_EQ(1, counter_value(METRIC_block_cache_decoded_inserts));
+  ASSERT_EQ(1, counter_value(METRIC_block_cache_decoded_hits_caching));
+  ASSERT_EQ(1, counter_value(METRIC_block_cache_decoded_misses_caching));
+  ASSERT_EQ(0, counter_value(METRIC_block_cache_hits_caching));
+  ASSERT_EQ(0, counter_value(METRIC_block_cache_misses_caching));
 }
 
 
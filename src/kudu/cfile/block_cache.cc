@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <initializer_list>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -28,15 +29,21 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/block_cache_metrics.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/cache_metrics.h"
+#include "kudu/util/env.h"
+#include "kudu/util/file_backed_cache.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/flag_validators.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/process_memory.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/status.h"
 #include "kudu/util/string_case.h"
+#include "kudu/util/test_util_prod.h"
 
 DEFINE_int64(block_cache_capacity_mb, 512, "block cache capacity in MB");
 TAG_FLAG(block_cache_capacity_mb, stable);
@@ -58,6 +65,75 @@ DEFINE_string(block_cache_type, "DRAM",
               "libmemkind 1.8.0 or newer must be available on the system; "
               "otherwise Kudu will crash.");
 
+DEFINE_string(block_cache_eviction_policy, "LRU",
+              "Eviction policy of the block cache. Valid choices are 'LRU' or "
+              "'TINYLFU'. 'TINYLFU' admits blocks to the bulk of the cache based "
+              "on how often they are looked up, so that large scans which cache "
+              "their blocks do not flush out frequently used index and bloom "
+              "filter blocks. 'TINYLFU' is only supported with the DRAM block "
+              "cache type.");
+TAG_FLAG(block_cache_eviction_policy, advanced);
+TAG_FLAG(block_cache_eviction_policy, experimental);
+
+DEFINE_double(block_cache_high_priority_ratio, 0.1,
+              "Fraction of the block cache capacity reserved for high-priority "
+              "blocks: the B-tree index, bloom filter and dictionary blocks of "
+              "CFiles. These blocks are cached separately from all other blocks, "
+              "so that large scans can't evict them. If 0, all blocks share the "
+              "whole capacity.");
+TAG_FLAG(block_cache_high_priority_ratio, advanced);
+TAG_FLAG(block_cache_high_priority_ratio, experimental);
+
+static bool ValidateHighPriorityRatio(const char* flagname, double value) {
+  if (value < 0 || value >= 1) {
+    LOG(ERROR) << flagname << " must be at least 0 and less than 1, value "
+               << value << " is invalid";
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(block_cache_high_priority_ratio, &ValidateHighPriorityRatio);
+
+DEFINE_double(block_cache_decoded_ratio, 0,
+              "Fraction of the block cache capacity used to cache CFile data "
+              "blocks in decoded form, so that repeated scans of them don't have "
+              "to decode them again. Only blocks of fixed-size columns with the "
+              "bitshuffle or group varint encodings are cached in decoded form. "
+              "If 0, decoded blocks are not cached.");
+TAG_FLAG(block_cache_decoded_ratio, advanced);
+TAG_FLAG(block_cache_decoded_ratio, experimental);
+
+static bool ValidateBlockCachePoolRatios() {
+  if (FLAGS_block_cache_decoded_ratio < 0 ||
+      FLAGS_block_cache_high_priority_ratio + FLAGS_block_cache_decoded_ratio >= 1) {
+    LOG(ERROR) << strings::Substitute(
+        "--block_cache_decoded_ratio must be at least 0, and its sum with "
+        "--block_cache_high_priority_ratio must be less than 1 ($0 + $1 is invalid)",
+        FLAGS_block_cache_decoded_ratio, FLAGS_block_cache_high_priority_ratio);
+    return false;
+  }
+  return true;
+}
+GROUP_FLAG_VALIDATOR(block_cache_decoded_ratio, ValidateBlockCachePoolRatios);
+
+DEFINE_string(block_cache_ssd_path, "",
+              "Path of a file, preferably on a local SSD, used as a second tier "
+              "of the block cache. Blocks evicted from memory are written to it, "
+              "and read back from it when they are needed again. The blocks in "
+              "it survive restarts, unless the file was last used by a server "
+              "with a different file system. If empty, the block cache has no "
+              "second tier.");
+TAG_FLAG(block_cache_ssd_path, advanced);
+TAG_FLAG(block_cache_ssd_path, experimental);
+
+DEFINE_int64(block_cache_ssd_capacity_mb, 10240,
+             "Capacity in MB of the second tier of the block cache. Only used "
+             "if --block_cache_ssd_path is set.");
+TAG_FLAG(block_cache_ssd_capacity_mb, advanced);
+TAG_FLAG(block_cache_ssd_capacity_mb, experimental);
+
+using std::string;
+using std::unique_ptr;
 using strings::Substitute;
 
 template <class T> class scoped_refptr;
@@ -70,15 +146,25 @@ namespace cfile {
 
 namespace {
 
-Cache* CreateCache(int64_t capacity) {
+// The second tier of the cache is reclaimed in regions of this size.
+constexpr uint64_t kSsdCacheRegionSize = 16 * 1024 * 1024;
+
+Cache* CreateCache(int64_t capacity, const string& id) {
   const auto mem_type = BlockCache::GetConfiguredCacheMemoryTypeOrDie();
+  const auto eviction_policy = BlockCache::GetConfiguredEvictionPolicyOrDie();
+  if (eviction_policy == Cache::EvictionPolicy::TINYLFU) {
+    CHECK(mem_type == Cache::MemoryType::DRAM)
+        << "TINYLFU block cache eviction policy requires the DRAM block cache type";
+    return NewCache<Cache::EvictionPolicy::TINYLFU, Cache::MemoryType::DRAM>(
+        capacity, id);
+  }
   switch (mem_type) {
     case Cache::MemoryType::DRAM:
       return NewCache<Cache::EvictionPolicy::LRU, Cache::MemoryType::DRAM>(
-          capacity, "block_cache");
+          capacity, id);
     case Cache::MemoryType::NVM:
       return NewCache<Cache::EvictionPolicy::LRU, Cache::MemoryType::NVM>(
-          capacity, "block_cache");
+          capacity, id);
     default:
       LOG(FATAL) << "unsupported LRU cache memory type: " << mem_type;
       return nullptr;
@@ -133,39 +219,209 @@ Cache::MemoryType BlockCache::GetConfiguredCacheMemoryTypeOrDie() {
   __builtin_unreachable();
 }
 
+Cache::EvictionPolicy BlockCache::GetConfiguredEvictionPolicyOrDie() {
+  ToUpperCase(FLAGS_block_cache_eviction_policy, &FLAGS_block_cache_eviction_policy);
+  if (FLAGS_block_cache_eviction_policy == "LRU") {
+    return Cache::EvictionPolicy::LRU;
+  }
+  if (FLAGS_block_cache_eviction_policy == "TINYLFU") {
+    return Cache::EvictionPolicy::TINYLFU;
+  }
+
+  LOG(FATAL) << "Unknown block cache eviction policy: '"
+             << FLAGS_block_cache_eviction_policy << "' (expected 'LRU' or 'TINYLFU')";
+  __builtin_unreachable();
+}
+
 BlockCache::BlockCache()
     : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024) {
 }
 
-BlockCache::BlockCache(size_t capacity)
-    : cache_(CreateCache(capacity)) {
+// Counts the evictions of the entries of one priority, once metrics are set,
+// and writes the evicted entries to the second tier of the cache, if any.
+class BlockCache::EvictionHandler : public Cache::EvictionCallback {
+ public:
+  EvictionHandler(const unique_ptr<BlockCacheTierMetrics>* metrics,
+                  const unique_ptr<FileBackedCache>* ssd_cache)
+      : metrics_(metrics),
+        ssd_cache_(ssd_cache) {
+  }
+
+  void EvictedEntry(Slice key, Slice value) override {
+    const BlockCacheTierMetrics* metrics = metrics_->get();
+    if (PREDICT_TRUE(metrics)) {
+      metrics->evictions->Increment();
+      metrics->usage->DecrementBy(value.size());
+    }
+    // Blocks never change, so a block which was read back from the second
+    // tier needn't be written to it again.
+    FileBackedCache* ssd_cache = ssd_cache_->get();
+    if (ssd_cache && !ssd_cache->Contains(key)) {
+      ssd_cache->Insert(key, value);
+    }
+  }
+
+ private:
+  const unique_ptr<BlockCacheTierMetrics>* metrics_;
+  const unique_ptr<FileBackedCache>* ssd_cache_;
+};
+
+BlockCache::BlockCache(size_t capacity) {
+  const size_t high_priority_capacity = capacity * FLAGS_block_cache_high_priority_ratio;
+  if (high_priority_capacity > 0) {
+    high_priority_cache_.reset(CreateCache(high_priority_capacity,
+                                           "block_cache_high_priority"));
+  }
+  const size_t decoded_capacity = capacity * FLAGS_block_cache_decoded_ratio;
+  if (decoded_capacity > 0) {
+    decoded_cache_.reset(CreateCache(decoded_capacity, "block_cache_decoded"));
+  }
+  cache_.reset(CreateCache(capacity - high_priority_capacity - decoded_capacity,
+                           "block_cache"));
+  for (int i = 0; i < kNumPriorities; i++) {
+    eviction_handlers_[i].reset(new EvictionHandler(&tier_metrics_[i], &ssd_cache_));
+  }
+}
+
+BlockCache::~BlockCache() {
+  // Don't write the blocks freed below to the second tier.
+  ssd_cache_.reset();
+  // Free the cached blocks while their eviction callbacks are still alive.
+  decoded_cache_.reset();
+  high_priority_cache_.reset();
+  cache_.reset();
 }
 
-BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t block_size) {
+BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, Priority priority,
+                                              size_t block_size) {
   Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
-  return PendingEntry(cache_->Allocate(key_slice, block_size));
+  return PendingEntry(PriorityCache(priority)->Allocate(key_slice, block_size), priority);
 }
 
-bool BlockCache::Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
-                        BlockCacheHandle* handle) {
-  auto h(cache_->Lookup(
+bool BlockCache::Lookup(const CacheKey& key, Priority priority,
+                        Cache::CacheBehavior behavior, BlockCacheHandle* handle) {
+  auto h(PriorityCache(priority)->Lookup(
       Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)), behavior));
+  const BlockCacheTierMetrics* metrics = tier_metrics_[PriorityIndex(priority)].get();
+  if (PREDICT_TRUE(metrics) && behavior == Cache::EXPECT_IN_CACHE) {
+    if (h) {
+      metrics->hits_caching->Increment();
+    } else {
+      metrics->misses_caching->Increment();
+    }
+  }
   if (h) {
     handle->SetHandle(std::move(h));
     return true;
   }
+  if (ssd_cache_ && behavior == Cache::EXPECT_IN_CACHE) {
+    // Read the block back from the second tier, caching it in memory again.
+    PendingEntry entry;
+    auto allocate = [&](size_t size) -> uint8_t* {
+      entry = Allocate(key, priority, size);
+      return entry.valid() ? entry.val_ptr() : nullptr;
+    };
+    if (ssd_cache_->Lookup(Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)),
+                           allocate)) {
+      Insert(&entry, handle);
+      return true;
+    }
+  }
   return false;
 }
 
 void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted) {
-  auto h(cache_->Insert(std::move(entry->handle_),
-                        /* eviction_callback= */ nullptr));
+  Cache* cache = entry->handle_.get_deleter().cache();
+  if (cache == decoded_cache_.get()) {
+    // Decoded blocks are only counted by the metrics of the caches themselves.
+    inserted->SetHandle(cache->Insert(std::move(entry->handle_),
+                                      /* eviction_callback= */ nullptr));
+    return;
+  }
+  const int idx = PriorityIndex(entry->priority_);
+  auto h(cache->Insert(std::move(entry->handle_), eviction_handlers_[idx].get()));
   inserted->SetHandle(std::move(h));
+  const BlockCacheTierMetrics* metrics = tier_metrics_[idx].get();
+  if (PREDICT_TRUE(metrics)) {
+    metrics->inserts->Increment();
+    metrics->usage->IncrementBy(inserted->data().size());
+  }
+}
+
+bool BlockCache::LookupDecoded(const CacheKey& key, BlockCacheHandle* handle) {
+  DCHECK(decoded_cache_);
+  auto h(decoded_cache_->Lookup(
+      Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)), Cache::EXPECT_IN_CACHE));
+  if (h) {
+    handle->SetHandle(std::move(h));
+    return true;
+  }
+  return false;
+}
+
+BlockCache::PendingEntry BlockCache::AllocateDecoded(const CacheKey& key, size_t block_size) {
+  DCHECK(decoded_cache_);
+  Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+  return PendingEntry(decoded_cache_->Allocate(key_slice, block_size), Priority::NORMAL);
 }
 
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
-  std::unique_ptr<BlockCacheMetrics> metrics(new BlockCacheMetrics(metric_entity));
-  cache_->SetMetrics(std::move(metrics));
+  // As with the metrics of the caches themselves (see KUDU-2165), only the
+  // first server sharing the singleton gets to instrument it.
+  if (tier_metrics_[0]) {
+    CHECK(IsGTest()) << "Metrics should only be set once per BlockCache singleton";
+    return;
+  }
+  // The caches of encoded blocks of both priorities update the same
+  // server-wide metrics. Decoded blocks have metrics of their own, so that
+  // lookups of them, which fall back to the encoded blocks on a miss, don't
+  // skew the hit ratio of the block cache.
+  for (Cache* cache : { cache_.get(), high_priority_cache_.get() }) {
+    if (cache) {
+      unique_ptr<BlockCacheMetrics> metrics(new BlockCacheMetrics(metric_entity));
+      cache->SetMetrics(std::move(metrics));
+    }
+  }
+  if (decoded_cache_) {
+    decoded_cache_->SetMetrics(unique_ptr<CacheMetrics>(
+        new BlockCacheDecodedMetrics(metric_entity)));
+  }
+  for (Priority priority : { Priority::HIGH, Priority::NORMAL }) {
+    tier_metrics_[PriorityIndex(priority)].reset(
+        new BlockCacheTierMetrics(metric_entity, priority == Priority::HIGH));
+  }
+  metric_entity_ = metric_entity;
+  if (ssd_cache_) {
+    ssd_cache_->SetMetrics(unique_ptr<FileBackedCacheMetrics>(
+        new BlockCacheSsdMetrics(metric_entity)));
+  }
+}
+
+void BlockCache::OpenSsdTier(const string& fs_uuid) {
+  if (FLAGS_block_cache_ssd_path.empty()) {
+    return;
+  }
+  // As with StartInstrumentation(), only the first server sharing the
+  // singleton gets to open the second tier.
+  if (ssd_cache_) {
+    CHECK(IsGTest()) << "The second tier should only be opened once per BlockCache singleton";
+    return;
+  }
+  // Blocks are keyed by block ID and offset, which only identify the same
+  // data within a single file system, so the file is stamped with its UUID.
+  Status s = FileBackedCache::Open(Env::Default(), FLAGS_block_cache_ssd_path,
+                                   FLAGS_block_cache_ssd_capacity_mb * 1024 * 1024,
+                                   kSsdCacheRegionSize, fs_uuid, &ssd_cache_);
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to open the second tier of the block cache, "
+                 << "continuing without it: " << s.ToString();
+    ssd_cache_.reset();
+    return;
+  }
+  if (metric_entity_) {
+    ssd_cache_->SetMetrics(unique_ptr<FileBackedCacheMetrics>(
+        new BlockCacheSsdMetrics(metric_entity_)));
+  }
 }
 
 } // namespace cfile
@@ -19,21 +19,24 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <utility>
 
 #include "kudu/fs/block_id.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/slice.h"
 
-template <class T> class scoped_refptr;
-
 namespace kudu {
 
+class FileBackedCache;
 class MetricEntity;
+struct BlockCacheTierMetrics;
 
 namespace cfile {
 
@@ -41,12 +44,35 @@ class BlockCacheHandle;
 
 // Wrapper around kudu::Cache specifically for caching blocks of CFiles.
 // Provides a singleton and LRU cache for CFile blocks.
+//
+// Blocks are cached with a priority. Unless disabled with
+// --block_cache_high_priority_ratio, high-priority blocks are kept in a
+// separate pool taking up that fraction of the capacity, so that they can't
+// be evicted by normal-priority blocks, however many of those are read.
+//
+// If --block_cache_ssd_path is set, blocks evicted from memory are written to
+// a file-backed second tier of the cache, meant to be on a local SSD, once it
+// is opened with OpenSsdTier(). Lookups which miss in memory and expect the
+// block to be cached read it back from there, and cache it in memory again.
 class BlockCache {
  public:
+  // The priority of a cached block.
+  enum class Priority {
+    // Blocks which are needed to locate rows: B-tree index blocks, bloom
+    // filter blocks and dictionary blocks.
+    HIGH,
+    // All other blocks.
+    NORMAL,
+  };
+
   // Parse the gflag which configures the block cache. FATALs if the flag is
   // invalid.
   static Cache::MemoryType GetConfiguredCacheMemoryTypeOrDie();
 
+  // Parse the gflag which configures the block cache's eviction policy.
+  // FATALs if the flag is invalid.
+  static Cache::EvictionPolicy GetConfiguredEvictionPolicyOrDie();
+
   // BlockId refers to the unique identifier for a Kudu block, that is, for an
   // entire CFile. This is different than the block cache's notion of a block,
   // which is just a portion of a CFile.
@@ -111,7 +137,13 @@ class BlockCache {
    private:
     friend class BlockCache;
 
+    PendingEntry(Cache::UniquePendingHandle handle, Priority priority)
+        : handle_(std::move(handle)),
+          priority_(priority) {
+    }
+
     Cache::UniquePendingHandle handle_;
+    Priority priority_ = Priority::NORMAL;
   };
 
   static BlockCache* GetSingleton() {
@@ -120,14 +152,20 @@ class BlockCache {
 
   explicit BlockCache(size_t capacity);
 
+  ~BlockCache();
+
   // Lookup the given block in the cache.
   //
   // If the entry is found, then sets *handle to refer to the entry.
   // This object's destructor will release the cache entry so it may be freed again.
   // Alternatively,  handle->Release() may be used to explicitly release it.
   //
+  // If the entry isn't in memory and 'behavior' is EXPECT_IN_CACHE, it is
+  // looked up in the second tier of the cache, if any, and if found there it
+  // is read back into memory.
+  //
   // Returns true to indicate that the entry was found, false otherwise.
-  bool Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
+  bool Lookup(const CacheKey& key, Priority priority, Cache::CacheBehavior behavior,
               BlockCacheHandle* handle);
 
   // Pass a metric entity to the cache to start recording metrics.
@@ -136,6 +174,14 @@ class BlockCache {
   // Calling StartInstrumentation multiple times will reset the metrics each time.
   void StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity);
 
+  // Open the second tier of the cache, if --block_cache_ssd_path is set, on
+  // behalf of the file system instance with UUID 'fs_uuid'. The blocks already
+  // in it are kept if it was last used for the same file system, in which
+  // block IDs are never reused, and discarded otherwise. Like
+  // StartInstrumentation(), this should be called before the cache starts
+  // serving blocks, and only the first call has any effect.
+  void OpenSsdTier(const std::string& fs_uuid);
+
   // Insertion path
   // --------------------
   // Block cache entries are written in two phases. First, a pending entry must be
@@ -143,7 +189,7 @@ class BlockCache {
   // this pending entry before being inserted. For example:
   //
   //   // Allocate space in the cache for a block of 'data_size' bytes.
-  //   PendingEntry entry = cache->Allocate(my_cache_key, data_size);
+  //   PendingEntry entry = cache->Allocate(my_cache_key, priority, data_size);
   //   // Check for allocation failure.
   //   if (!entry.valid()) {
   //     // if there is no space left in the cache, handle the error.
@@ -154,20 +200,79 @@ class BlockCache {
   //   BlockCacheHandle bch;
   //   cache->Insert(&entry, &bch);
 
-  // Allocate a new entry to be inserted into the cache.
-  PendingEntry Allocate(const CacheKey& key, size_t block_size);
+  // Allocate a new entry to be inserted into the cache with the given
+  // priority. Lookups of the entry must use the same priority.
+  PendingEntry Allocate(const CacheKey& key, Priority priority, size_t block_size);
 
   // Insert the given block into the cache. 'inserted' is set to refer to the
   // entry in the cache.
   void Insert(PendingEntry* entry, BlockCacheHandle* inserted);
 
+  // Decoded blocks
+  // --------------------
+  // Blocks whose values are costly to decode may also be cached in decoded
+  // form, in a separate pool sized by --block_cache_decoded_ratio. Decoded
+  // blocks are allocated with AllocateDecoded() and then inserted with
+  // Insert(), like any other block.
+
+  // Whether the cache has a pool for decoded blocks.
+  bool has_decoded_pool() const {
+    return decoded_cache_ != nullptr;
+  }
+
+  // Like Lookup(), for the decoded form of the given block. Must only be
+  // called if has_decoded_pool().
+  bool LookupDecoded(const CacheKey& key, BlockCacheHandle* handle);
+
+  // Like Allocate(), for the decoded form of the given block. Must only be
+  // called if has_decoded_pool().
+  PendingEntry AllocateDecoded(const CacheKey& key, size_t block_size);
+
  private:
   friend class Singleton<BlockCache>;
   BlockCache();
 
   DISALLOW_COPY_AND_ASSIGN(BlockCache);
 
+  class EvictionHandler;
+
+  static constexpr int kNumPriorities = 2;
+
+  static int PriorityIndex(Priority priority) {
+    return priority == Priority::HIGH ? 0 : 1;
+  }
+
+  // The cache holding blocks of the given priority.
+  Cache* PriorityCache(Priority priority) const {
+    return priority == Priority::HIGH && high_priority_cache_ ?
+        high_priority_cache_.get() : cache_.get();
+  }
+
+  // Normal-priority blocks, and high-priority blocks too if they have no
+  // separate pool.
   gscoped_ptr<Cache> cache_;
+
+  // High-priority blocks, or null if they have no separate pool.
+  gscoped_ptr<Cache> high_priority_cache_;
+
+  // Decoded blocks, or null if they aren't cached.
+  gscoped_ptr<Cache> decoded_cache_;
+
+  // Per-priority metrics, indexed by PriorityIndex(). Null until
+  // StartInstrumentation() is called.
+  std::unique_ptr<BlockCacheTierMetrics> tier_metrics_[kNumPriorities];
+
+  // The entity passed to StartInstrumentation(), for the metrics of the second
+  // tier if it's opened later.
+  scoped_refptr<MetricEntity> metric_entity_;
+
+  // The file-backed second tier of the cache, or null if there is none or it
+  // hasn't been opened yet.
+  std::unique_ptr<FileBackedCache> ssd_cache_;
+
+  // Eviction callbacks of the entries of each priority, which count their
+  // evictions in 'tier_metrics_' and write them to 'ssd_cache_'.
+  std::unique_ptr<EvictionHandler> eviction_handlers_[kNumPriorities];
 };
 
 // Scoped reference to a block from the block cache.
@@ -214,6 +319,7 @@ inline BlockCache::PendingEntry& BlockCache::PendingEntry::operator=(
     BlockCache::PendingEntry&& other) noexcept {
   reset();
   handle_ = std::move(other.handle_);
+  priority_ = other.priority_;
   return *this;
 }
 
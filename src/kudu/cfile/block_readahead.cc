@@ -0,0 +1,186 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/block_readahead.h"
+
+#include <limits>
+#include <ostream>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_handle.h"
+#include "kudu/cfile/index_btree.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/fs/io_scheduler.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/threadpool.h"
+#include "kudu/util/trace.h"
+
+using std::shared_ptr;
+
+namespace kudu {
+namespace cfile {
+
+using fs::IOContext;
+
+struct BlockReadahead::Request {
+  explicit Request(const BlockPointer& p)
+      : ptr(p),
+        done(1) {
+  }
+
+  const BlockPointer ptr;
+
+  // Counted down once 'status' and 'handle' are set.
+  CountDownLatch done;
+  Status status;
+  BlockHandle handle;
+};
+
+BlockReadahead::BlockReadahead(const CFileReader* reader,
+                               ThreadPool* pool,
+                               CFileReader::CacheControl cache_control,
+                               const IOContext* io_context,
+                               int window)
+    : reader_(reader),
+      pool_(DCHECK_NOTNULL(pool)),
+      cache_control_(cache_control),
+      io_context_(io_context),
+      window_(window),
+      limit_(std::numeric_limits<rowid_t>::max()) {
+  DCHECK_GT(window_, 0);
+}
+
+BlockReadahead::~BlockReadahead() {
+  // Queued reads are dropped; running ones are waited for, since they refer
+  // to the reader and the I/O context.
+  if (token_) {
+    token_->Shutdown();
+  }
+}
+
+Status BlockReadahead::ReadBlock(const IndexTreeIterator& idx_iter, BlockHandle* ret) {
+  const BlockPointer& ptr = idx_iter.GetCurrentBlockPointer();
+
+  // Data blocks are laid out in positional order, so any requests ahead of
+  // the wanted block in the window are for blocks which were skipped over.
+  const bool had_window = !window_reqs_.empty();
+  shared_ptr<Request> req;
+  while (!window_reqs_.empty()) {
+    shared_ptr<Request> front = std::move(window_reqs_.front());
+    window_reqs_.pop_front();
+    if (front->ptr.offset() == ptr.offset()) {
+      req = std::move(front);
+      break;
+    }
+  }
+
+  bool sequential = false;
+  if (req) {
+    sequential = true;
+    req->done.Wait();
+    if (req->status.ok()) {
+      TRACE_COUNTER_INCREMENT("cfile_readahead_hit", 1);
+      *ret = std::move(req->handle);
+      FillWindow();
+      return Status::OK();
+    }
+    // Let the synchronous read below report the error, if it recurs.
+  } else if (!had_window && lookahead_ && lookahead_->HasNext()) {
+    // Nothing was read ahead; check whether the wanted block directly follows
+    // the previously read one.
+    sequential = lookahead_->Next().ok() &&
+        lookahead_->GetCurrentBlockPointer().offset() == ptr.offset();
+  }
+
+  RETURN_NOT_OK(reader_->ReadBlock(io_context_, ptr, cache_control_,
+                                   BlockCache::Priority::NORMAL, ret));
+  if (sequential) {
+    FillWindow();
+  } else {
+    window_reqs_.clear();
+    Reposition(idx_iter);
+  }
+  return Status::OK();
+}
+
+void BlockReadahead::Reposition(const IndexTreeIterator& idx_iter) {
+  if (!lookahead_) {
+    lookahead_.reset(IndexTreeIterator::Create(io_context_, reader_, reader_->posidx_root()));
+  }
+  Status s = lookahead_->SeekAtOrBefore(idx_iter.GetCurrentKey());
+  if (PREDICT_FALSE(!s.ok())) {
+    VLOG(1) << "Unable to position readahead in CFile " << reader_->ToString()
+            << ": " << s.ToString();
+    lookahead_.reset();
+  }
+}
+
+void BlockReadahead::FillWindow() {
+  while (lookahead_ && window_reqs_.size() < window_ && lookahead_->HasNext()) {
+    Status s = lookahead_->Next();
+    if (PREDICT_FALSE(!s.ok())) {
+      VLOG(1) << "Unable to advance readahead in CFile " << reader_->ToString()
+              << ": " << s.ToString();
+      lookahead_.reset();
+      return;
+    }
+    Slice key = lookahead_->GetCurrentKey();
+    rowid_t first_row;
+    s = KeyEncoderTraits<UINT32, faststring>::DecodeKeyPortion(
+        &key, /*is_last=*/true, nullptr, reinterpret_cast<uint8_t*>(&first_row));
+    if (!s.ok() || first_row >= limit_) {
+      // 'lookahead_' has moved past the last block of the window.
+      lookahead_.reset();
+      return;
+    }
+
+    shared_ptr<Request> req(new Request(lookahead_->GetCurrentBlockPointer()));
+    window_reqs_.push_back(req);
+    if (reader_->ReadBlockFromCache(req->ptr, cache_control_, BlockCache::Priority::NORMAL,
+                                    &req->handle)) {
+      req->done.CountDown();
+      continue;
+    }
+    if (!token_) {
+      token_ = pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+    }
+    const CFileReader* reader = reader_;
+    CFileReader::CacheControl cache_control = cache_control_;
+    const IOContext* io_context = io_context_;
+    // Account the read to the I/O class of the scan, not the pool thread's.
+    fs::IOClass io_class = fs::CurrentIOClass();
+    s = token_->SubmitFunc([reader, cache_control, io_context, io_class, req]() {
+      fs::ScopedIOClass scoped_io_class(io_class);
+      req->status = reader->ReadBlockFromDisk(io_context, req->ptr, cache_control,
+                                              BlockCache::Priority::NORMAL, &req->handle);
+      req->done.CountDown();
+    });
+    if (PREDICT_FALSE(!s.ok())) {
+      req->status = s;
+      req->done.CountDown();
+    }
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
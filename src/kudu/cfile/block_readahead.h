@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+
+#include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ThreadPool;
+class ThreadPoolToken;
+
+namespace fs {
+struct IOContext;
+}  // namespace fs
+
+namespace cfile {
+
+class BlockHandle;
+class IndexTreeIterator;
+
+// Reads the data blocks of a CFile ahead of a CFileIterator which is scanning
+// it by position.
+//
+// Once the iterator has read two consecutive data blocks, the next few blocks
+// in positional index order are looked up in the block cache, and those which
+// are not cached are read from disk on a shared background thread pool. The
+// blocks are held (pinned in the cache, or owned outright for DONT_CACHE_BLOCK
+// scans) until the iterator asks for them or moves elsewhere in the file.
+//
+// Readahead is best-effort: any failure of a background read is hidden from
+// the caller, which simply re-reads the block synchronously.
+//
+// This class is not thread-safe.
+class BlockReadahead {
+ public:
+  // 'reader', 'pool', and 'io_context' if not null, must outlive this object.
+  // 'window' is the maximum number of blocks to read ahead.
+  BlockReadahead(const CFileReader* reader,
+                 ThreadPool* pool,
+                 CFileReader::CacheControl cache_control,
+                 const fs::IOContext* io_context,
+                 int window);
+
+  // Waits for any in-flight background reads to finish.
+  ~BlockReadahead();
+
+  // Read the data block pointed to by 'idx_iter', which must be an iterator
+  // over the positional index of the reader's CFile, and then issue readahead
+  // for the blocks which follow it.
+  Status ReadBlock(const IndexTreeIterator& idx_iter, BlockHandle* ret);
+
+  // Don't read ahead blocks whose first row is at or after 'limit'.
+  void set_limit(rowid_t limit) {
+    limit_ = limit;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BlockReadahead);
+
+  struct Request;
+
+  // Position 'lookahead_' at the block pointed to by 'idx_iter'.
+  void Reposition(const IndexTreeIterator& idx_iter);
+
+  // Advance 'lookahead_', starting reads of the blocks it passes, until the
+  // window is full or the limit or the end of the file is reached.
+  void FillWindow();
+
+  const CFileReader* reader_;
+  ThreadPool* const pool_;
+  const CFileReader::CacheControl cache_control_;
+  const fs::IOContext* io_context_;
+  const size_t window_;
+  rowid_t limit_;
+
+  // Iterator over the positional index, pointing at the block most recently
+  // returned by ReadBlock() or, if 'window_reqs_' is not empty, at the last
+  // block which readahead was issued for. Null if it isn't positioned.
+  std::unique_ptr<IndexTreeIterator> lookahead_;
+
+  // Blocks for which readahead has been issued, in file order.
+  std::deque<std::shared_ptr<Request>> window_reqs_;
+
+  // Token for submitting reads to 'pool_'. Created lazily.
+  std::unique_ptr<ThreadPoolToken> token_;
+};
+
+} // namespace cfile
+} // namespace kudu
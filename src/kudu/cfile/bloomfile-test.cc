@@ -27,11 +27,16 @@
 #include "kudu/cfile/bloomfile-test-base.h"
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/endian.h"
 #include "kudu/util/bloom_filter.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
@@ -149,5 +154,57 @@ TEST_F(BloomFileTest, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+TEST_F(BloomFileTest, TestColumnBloomFile) {
+  // Values arrive unsorted and with duplicates, and span several bloom
+  // blocks, each of which is indexed by its first key.
+  const int kNumRows = 20000;
+  const int kNumDistinct = 5000;
+  const TypeInfo* type_info = GetTypeInfo(INT32);
+  ScopedColumnBlock<INT32> cb(kNumRows);
+  for (int i = 0; i < kNumRows; i++) {
+    cb.SetCellIsNull(i, i % 11 == 0);
+    cb[i] = ((i * 7919) % kNumDistinct) * 2 - kNumDistinct;
+  }
+  ColumnBloomFileWriter writer(type_info, BloomFilterSizing::BySizeAndFPRate(512, 0.01));
+  writer.AppendValues(cb, 0);
+  ASSERT_FALSE(writer.empty());
+
+  unique_ptr<fs::WritableBlock> sink;
+  ASSERT_OK(fs_manager_->CreateNewBlock({}, &sink));
+  BlockId block_id = sink->id();
+  unique_ptr<fs::BlockCreationTransaction> transaction =
+      fs_manager_->block_manager()->NewCreationTransaction();
+  ASSERT_OK(writer.FinishAndReleaseBlock(std::move(sink), transaction.get()));
+  ASSERT_OK(transaction->CommitCreatedBlocks());
+  ASSERT_TRUE(writer.empty());
+
+  unique_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  unique_ptr<BloomFileReader> reader;
+  ASSERT_OK(BloomFileReader::Open(std::move(source), ReaderOptions(), &reader));
+
+  faststring key;
+  auto may_be_present = [&](int32_t value) {
+    ColumnBloomFileWriter::EncodeKey(type_info, &value, &key);
+    bool present = false;
+    CHECK_OK(reader->CheckKeyPresent(BloomKeyProbe(Slice(key)), nullptr, &present));
+    return present;
+  };
+  for (int i = 0; i < kNumRows; i++) {
+    if (!cb.is_null(i)) {
+      ASSERT_TRUE(may_be_present(cb[i])) << cb[i];
+    }
+  }
+  // Odd values were never written; only a small fraction may be false
+  // positives.
+  int false_positives = 0;
+  for (int v = 0; v < kNumDistinct; v++) {
+    if (may_be_present(v * 2 - kNumDistinct + 1)) {
+      false_positives++;
+    }
+  }
+  ASSERT_LT(false_positives, kNumDistinct / 20);
+}
+
 } // namespace cfile
 } // namespace kudu
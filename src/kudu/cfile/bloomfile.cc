@@ -25,13 +25,16 @@
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
+#include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
 #include "kudu/fs/block_manager.h"
@@ -192,6 +195,46 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// Column writer
+////////////////////////////////////////////////////////////
+
+ColumnBloomFileWriter::ColumnBloomFileWriter(const TypeInfo* type_info,
+                                             BloomFilterSizing sizing)
+    : key_encoder_(GetKeyEncoder<faststring>(type_info)),
+      sizing_(sizing) {
+}
+
+void ColumnBloomFileWriter::EncodeKey(const TypeInfo* type_info,
+                                      const void* value,
+                                      faststring* dst) {
+  dst->clear();
+  GetKeyEncoder<faststring>(type_info).Encode(value, /*is_last=*/true, dst);
+}
+
+void ColumnBloomFileWriter::AppendValues(const ColumnBlock& block, rowid_t /*first_rowid*/) {
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (block.is_nullable() && block.is_null(i)) {
+      continue;
+    }
+    key_encoder_.Encode(block.cell_ptr(i), /*is_last=*/true, StartEntry());
+  }
+}
+
+Status ColumnBloomFileWriter::FinishAndReleaseBlock(unique_ptr<WritableBlock> block,
+                                                    BlockCreationTransaction* transaction) {
+  DCHECK(!empty());
+
+  vector<Slice> keys = SortedEntries(/*dedup=*/true);
+  BloomFileWriter writer(std::move(block), sizing_);
+  RETURN_NOT_OK(writer.Start());
+  RETURN_NOT_OK(writer.AppendKeys(keys.data(), keys.size()));
+  RETURN_NOT_OK(writer.FinishAndReleaseBlock(transaction));
+
+  Clear();
+  return Status::OK();
+}
+
 ////////////////////////////////////////////////////////////
 // Reader
 ////////////////////////////////////////////////////////////
@@ -322,8 +365,8 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   // BloomFilter instance.
   if (!bci->cur_block_pointer.Equals(bblk_ptr)) {
     BlockHandle dblk_data;
-    RETURN_NOT_OK(reader_->ReadBlock(io_context, bblk_ptr,
-                                     CFileReader::CACHE_BLOCK, &dblk_data));
+    RETURN_NOT_OK(reader_->ReadBlock(io_context, bblk_ptr, CFileReader::CACHE_BLOCK,
+                                     BlockCache::Priority::HIGH, &dblk_data));
 
     // Parse the header in the block.
     BloomBlockHeaderPB hdr;
@@ -20,9 +20,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/column_aux_file_writer.h"
+#include "kudu/common/rowid.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
@@ -33,6 +36,12 @@
 
 namespace kudu {
 
+class ColumnBlock;
+class TypeInfo;
+
+template <typename Buffer>
+class KeyEncoder;
+
 namespace fs {
 class BlockCreationTransaction;
 struct IOContext;
@@ -79,6 +88,40 @@ class BloomFileWriter {
   faststring last_key_;
 };
 
+// Builds a bloom file over the values of a single column of a DiskRowSet.
+//
+// BloomFileWriter requires its keys in sorted order, since each bloom block
+// is indexed by the first key it contains. Column values arrive in row
+// order, so they are buffered, key-encoded (making byte order match value
+// order), and sorted and deduplicated when the file is written. NULL cells
+// are not added.
+//
+// Readers probe the file with keys produced by EncodeKey().
+class ColumnBloomFileWriter : public ColumnAuxFileWriter {
+ public:
+  // Bloom filters are sized according to 'sizing'.
+  ColumnBloomFileWriter(const TypeInfo* type_info, BloomFilterSizing sizing);
+
+  // Encode the cell 'value' of a column of type 'type_info' into 'dst', in
+  // the form in which it is added to the bloom file.
+  static void EncodeKey(const TypeInfo* type_info, const void* value, faststring* dst);
+
+  // Buffer the value of every non-NULL cell of 'block'. Row ordinals are not
+  // recorded.
+  void AppendValues(const ColumnBlock& block, rowid_t first_rowid) override;
+
+  // Write a bloom file containing the distinct buffered values.
+  Status FinishAndReleaseBlock(std::unique_ptr<fs::WritableBlock> block,
+                               fs::BlockCreationTransaction* transaction) override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ColumnBloomFileWriter);
+
+  const KeyEncoder<faststring>& key_encoder_;
+
+  const BloomFilterSizing sizing_;
+};
+
 // Reader for a bloom file.
 // NB: this is not currently thread-safe.
 // When making it thread-safe, should make sure that the threads
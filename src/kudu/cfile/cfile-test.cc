@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -54,6 +55,7 @@
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/fs/io_context.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
@@ -76,9 +78,13 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/trace.h"
+#include "kudu/util/trace_metrics.h"
 
 DECLARE_bool(cfile_write_checksums);
 DECLARE_bool(cfile_verify_checksums);
+DECLARE_int32(cfile_readahead_blocks);
+DECLARE_double(block_cache_decoded_ratio);
 DECLARE_string(block_cache_type);
 DECLARE_bool(force_block_cache_capacity);
 DECLARE_int64(block_cache_capacity_mb);
@@ -303,7 +309,8 @@ class TestCFile : public CFileTestBase {
     do {
       BlockHandle dblk_data;
       BlockPointer blk_ptr = iter->GetCurrentBlockPointer();
-      ASSERT_OK(reader->ReadBlock(nullptr, blk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+      ASSERT_OK(reader->ReadBlock(nullptr, blk_ptr, CFileReader::CACHE_BLOCK,
+                                  BlockCache::Priority::NORMAL, &dblk_data));
 
       memcpy(data + 12, &count, 4);
       ASSERT_EQ(expected_data, dblk_data.data());
@@ -387,7 +394,7 @@ class TestCFile : public CFileTestBase {
       BlockHandle dblk_data;
       BlockPointer blk_ptr = iter->GetCurrentBlockPointer();
       RETURN_NOT_OK(reader->ReadBlock(&io_context, blk_ptr,
-          CFileReader::DONT_CACHE_BLOCK, &dblk_data));
+          CFileReader::DONT_CACHE_BLOCK, BlockCache::Priority::NORMAL, &dblk_data));
     } while (iter->Next().ok());
 
     return Status::OK();
@@ -1027,6 +1034,136 @@ TEST_P(TestCFileBothCacheMemoryTypes, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Tests that scans return the right data with readahead enabled, whether they
+// read the file sequentially, skip around in it, or go past the readahead limit.
+TEST_P(TestCFileBothCacheMemoryTypes, TestReadahead) {
+  RETURN_IF_NO_NVM_CACHE(GetParam());
+  FLAGS_cfile_readahead_blocks = 3;
+
+  const int kNumRows = 10000;
+  BlockId block_id;
+  UInt32DataGenerator<false> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows, SMALL_BLOCKSIZE,
+                &block_id);
+
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  ReaderOptions opts;
+  opts.readahead_pool = fs_manager_->readahead_pool();
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), std::move(opts), &reader));
+
+  // Reads 'count' rows starting at 'start' in small batches, and checks them.
+  auto read_and_verify = [&](CFileIterator* iter, rowid_t start, size_t count) {
+    ScopedColumnBlock<UINT32> out(count);
+    SelectionVector sel(count);
+    ASSERT_OK(iter->SeekToOrdinal(start));
+    size_t fetched = 0;
+    while (fetched < count) {
+      ColumnBlock advancing_block(out.type_info(), nullptr,
+                                  out.data() + (fetched * out.stride()),
+                                  count - fetched, out.arena());
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&advancing_block, &sel);
+      ASSERT_TRUE(iter->HasNext());
+      size_t n = std::min<size_t>(37, count - fetched);
+      ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+      fetched += n;
+    }
+    for (size_t i = 0; i < count; i++) {
+      ASSERT_EQ(generator.BuildTestValue(0, start + i), out[i]) << "at row " << start + i;
+    }
+  };
+
+  for (auto cache_control : { CFileReader::CACHE_BLOCK, CFileReader::DONT_CACHE_BLOCK }) {
+    SCOPED_TRACE(cache_control);
+    unique_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, cache_control, nullptr));
+
+    // A full sequential scan.
+    NO_FATALS(read_and_verify(iter.get(), 0, kNumRows));
+    ASSERT_FALSE(iter->HasNext());
+
+    // Jumps backwards and forwards, abandoning any blocks read ahead.
+    for (rowid_t start : { 9000, 100, 5000, 5600 }) {
+      NO_FATALS(read_and_verify(iter.get(), start, 500));
+    }
+
+    // Readahead stops at the limit, but reads past it still work.
+    iter->SetReadaheadLimit(2000);
+    NO_FATALS(read_and_verify(iter.get(), 0, 3000));
+  }
+
+  // Only foreground scans read ahead.
+  for (auto io_class : { fs::IOClass::FOREGROUND, fs::IOClass::COMPACTION }) {
+    SCOPED_TRACE(fs::IOClassToString(io_class));
+    fs::ScopedIOClass scoped_io_class(io_class);
+    scoped_refptr<Trace> trace(new Trace);
+    ADOPT_TRACE(trace.get());
+    unique_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK, nullptr));
+    NO_FATALS(read_and_verify(iter.get(), 0, kNumRows));
+    int64_t hits = trace->metrics().GetMetric("cfile_readahead_hit");
+    if (io_class == fs::IOClass::FOREGROUND) {
+      ASSERT_GT(hits, 0);
+    } else {
+      ASSERT_EQ(0, hits);
+    }
+  }
+}
+
+// Tests that blocks cached in decoded form are read back correctly, nulls
+// included.
+TEST_P(TestCFileBothCacheMemoryTypes, TestDecodedBlockCache) {
+  RETURN_IF_NO_NVM_CACHE(GetParam());
+  FLAGS_block_cache_decoded_ratio = 0.25;
+
+  const int kNumRows = 10000;
+  BlockId block_id;
+  UInt32DataGenerator<true> generator;
+  WriteTestFile(&generator, BIT_SHUFFLE, NO_COMPRESSION, kNumRows, SMALL_BLOCKSIZE,
+                &block_id);
+
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+  // The first scan caches the decoded blocks, and the second one reads them.
+  for (int scan = 0; scan < 2; scan++) {
+    SCOPED_TRACE(scan);
+    scoped_refptr<Trace> trace(new Trace);
+    ADOPT_TRACE(trace.get());
+
+    unique_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK, nullptr));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+    ScopedColumnBlock<UINT32> out(kNumRows);
+    SelectionVector sel(kNumRows);
+    ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&out, &sel);
+    size_t n = kNumRows;
+    ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+    ASSERT_EQ(kNumRows, n);
+    for (int i = 0; i < kNumRows; i++) {
+      bool is_null = generator.TestValueShouldBeNull(i);
+      ASSERT_EQ(is_null, out.is_null(i)) << "at row " << i;
+      if (!is_null) {
+        ASSERT_EQ(generator.BuildTestValue(0, i), out[i]) << "at row " << i;
+      }
+    }
+
+    // Seeking within a decoded block works too.
+    ASSERT_OK(iter->SeekToOrdinal(kNumRows / 2 + 1));
+    ASSERT_EQ(kNumRows / 2 + 1, iter->GetCurrentOrdinal());
+
+    int64_t hits = trace->metrics().GetMetric("cfile_decoded_cache_hit");
+    if (scan == 0) {
+      ASSERT_EQ(0, hits);
+    } else {
+      ASSERT_GT(hits, 0);
+    }
+  }
+}
+
 // Tests that the block cache keys used by CFileReaders are stable. That is,
 // different reader instances operating on the same block should use the same
 // block cache keys.
@@ -1062,6 +1199,7 @@ TEST_P(TestCFileBothCacheMemoryTypes, TestCacheKeysAreStable) {
     BlockHandle bh;
     ASSERT_OK(reader->ReadBlock(nullptr, iter->GetCurrentBlockPointer(),
                                 CFileReader::CACHE_BLOCK,
+                                BlockCache::Priority::NORMAL,
                                 &bh));
 
     // The first time through, we miss in the seek and in the ReadBlock().
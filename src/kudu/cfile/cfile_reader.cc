@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <ostream>
 #include <utility>
@@ -31,10 +32,12 @@
 #include "kudu/cfile/block_compression.h"
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/block_readahead.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h" // for kMagicString
 #include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/type_encodings.h"
 #include "kudu/common/column_materialization_context.h"
 #include "kudu/common/column_predicate.h"
@@ -46,6 +49,7 @@
 #include "kudu/common/types.h"
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/io_context.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
@@ -53,6 +57,7 @@
 #include "kudu/util/array_view.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/coding-inl.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/crc.h"
@@ -83,6 +88,14 @@ DEFINE_double(cfile_inject_corruption, 0,
               "with a corruption status");
 TAG_FLAG(cfile_inject_corruption, hidden);
 
+DEFINE_int32(cfile_readahead_blocks, 0,
+             "Number of data blocks of each column to read ahead of sequential "
+             "foreground scans, on a background thread pool. Blocks already in "
+             "the block cache are pinned rather than read. Flushes, compactions "
+             "and tablet copies never read ahead. 0 disables readahead.");
+TAG_FLAG(cfile_readahead_blocks, advanced);
+TAG_FLAG(cfile_readahead_blocks, runtime);
+
 using kudu::fault_injection::MaybeTrue;
 using kudu::fs::ErrorHandlerType;
 using kudu::fs::IOContext;
@@ -136,7 +149,9 @@ CFileReader::CFileReader(ReaderOptions options,
                          unique_ptr<ReadableBlock> block) :
   block_(std::move(block)),
   file_size_(file_size),
+  readahead_pool_(options.readahead_pool),
   codec_(nullptr),
+  decoded_encoding_info_(nullptr),
   mem_consumption_(std::move(options.parent_mem_tracker),
                    memory_footprint()) {
 }
@@ -193,6 +208,16 @@ Status CFileReader::InitOnce(const IOContext* io_context) {
                                       footer_->encoding(),
                                       &type_encoding_info_));
 
+  // Values of fixed-size types are costly to decode from these encodings,
+  // whose decoders also don't evaluate predicates: decoder evaluation must
+  // be supported by all the blocks of a column or by none.
+  if ((footer_->encoding() == BIT_SHUFFLE || footer_->encoding() == GROUP_VARINT) &&
+      type_info_->physical_type() != BINARY &&
+      BlockCache::GetSingleton()->has_decoded_pool()) {
+    RETURN_NOT_OK(TypeEncodingInfo::Get(type_info_, PLAIN_ENCODING,
+                                        &decoded_encoding_info_));
+  }
+
   VLOG(2) << "Initialized CFile reader. "
           << "Header: " << SecureDebugString(*header_)
           << " Footer: " << SecureDebugString(*footer_)
@@ -372,9 +397,10 @@ class ScratchMemory {
   // no capacity and cannot evict to make room, this will fall back
   // to allocating from the heap. In that case, IsFromCache() will
   // return false.
-  void TryAllocateFromCache(BlockCache* cache, const BlockCache::CacheKey& key, int size) {
+  void TryAllocateFromCache(BlockCache* cache, const BlockCache::CacheKey& key,
+                            BlockCache::Priority priority, int size) {
     DCHECK(!ptr_);
-    from_cache_ = cache->Allocate(key, size);
+    from_cache_ = cache->Allocate(key, priority, size);
     if (!from_cache_.valid()) {
       AllocateFromHeap(size);
       return;
@@ -431,24 +457,43 @@ class ScratchMemory {
 } // anonymous namespace
 
 Status CFileReader::ReadBlock(const IOContext* io_context, const BlockPointer &ptr,
-                              CacheControl cache_control, BlockHandle *ret) const {
+                              CacheControl cache_control, BlockCache::Priority priority,
+                              BlockHandle *ret) const {
   DCHECK(init_once_.init_succeeded());
   CHECK(ptr.offset() > 0 &&
         ptr.offset() + ptr.size() < file_size_) <<
     "bad offset " << ptr.ToString() << " in file of size "
                   << file_size_;
+  if (ReadBlockFromCache(ptr, cache_control, priority, ret)) {
+    return Status::OK();
+  }
+  return ReadBlockFromDisk(io_context, ptr, cache_control, priority, ret);
+}
+
+bool CFileReader::ReadBlockFromCache(const BlockPointer& ptr,
+                                     CacheControl cache_control,
+                                     BlockCache::Priority priority,
+                                     BlockHandle* ret) const {
   BlockCacheHandle bc_handle;
   Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
       Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
-  BlockCache* cache = BlockCache::GetSingleton();
   BlockCache::CacheKey key(block_->id(), ptr.offset());
-  if (cache->Lookup(key, cache_behavior, &bc_handle)) {
-    TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
-    TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
-    *ret = BlockHandle::WithDataFromCache(&bc_handle);
-    // Cache hit
-    return Status::OK();
+  if (!BlockCache::GetSingleton()->Lookup(key, priority, cache_behavior, &bc_handle)) {
+    return false;
   }
+  TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
+  TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
+  *ret = BlockHandle::WithDataFromCache(&bc_handle);
+  return true;
+}
+
+Status CFileReader::ReadBlockFromDisk(const IOContext* io_context, const BlockPointer& ptr,
+                                      CacheControl cache_control,
+                                      BlockCache::Priority priority,
+                                      BlockHandle* ret) const {
+  BlockCacheHandle bc_handle;
+  BlockCache* cache = BlockCache::GetSingleton();
+  BlockCache::CacheKey key(block_->id(), ptr.offset());
 
   // Cache miss: need to read ourselves.
   // We issue trace events only in the cache miss case since we expect the
@@ -473,7 +518,7 @@ Status CFileReader::ReadBlock(const IOContext* io_context, const BlockPointer &p
   // then we should allocate our scratch memory directly from the cache.
   // This avoids an extra memory copy in the case of an NVM cache.
   if (codec_ == nullptr && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, key, data_size);
+    scratch.TryAllocateFromCache(cache, key, priority, data_size);
   } else {
     scratch.AllocateFromHeap(data_size);
   }
@@ -517,7 +562,7 @@ Status CFileReader::ReadBlock(const IOContext* io_context, const BlockPointer &p
     // decompress directly into the cache's memory (to avoid a memcpy for NVM).
     ScratchMemory decompressed_scratch;
     if (cache_control == CACHE_BLOCK) {
-      decompressed_scratch.TryAllocateFromCache(cache, key, uncompressed_size);
+      decompressed_scratch.TryAllocateFromCache(cache, key, priority, uncompressed_size);
     } else {
       decompressed_scratch.AllocateFromHeap(uncompressed_size);
     }
@@ -562,6 +607,58 @@ Status CFileReader::ReadBlock(const IOContext* io_context, const BlockPointer &p
   return Status::OK();
 }
 
+bool CFileReader::ReadDecodedBlockFromCache(const BlockPointer& ptr, BlockHandle* ret) const {
+  DCHECK(decoded_encoding_info_);
+  BlockCacheHandle bc_handle;
+  BlockCache::CacheKey key(block_->id(), ptr.offset());
+  if (!BlockCache::GetSingleton()->LookupDecoded(key, &bc_handle)) {
+    return false;
+  }
+  TRACE_COUNTER_INCREMENT("cfile_decoded_cache_hit", 1);
+  *ret = BlockHandle::WithDataFromCache(&bc_handle);
+  return true;
+}
+
+void CFileReader::CacheDecodedBlock(const BlockPointer& ptr, const Slice& null_info,
+                                    BlockDecoder* decoder) const {
+  DCHECK(decoded_encoding_info_);
+  const size_t num_values = decoder->Count();
+  BlockCache* cache = BlockCache::GetSingleton();
+  BlockCache::PendingEntry entry = cache->AllocateDecoded(
+      BlockCache::CacheKey(block_->id(), ptr.offset()),
+      null_info.size() + kPlainBlockHeaderSize + num_values * type_info_->size());
+  if (!entry.valid()) {
+    return;
+  }
+
+  // Write the same header as PlainBlockBuilder::Finish(), then the values.
+  uint8_t* dst = entry.val_ptr();
+  memcpy(dst, null_info.data(), null_info.size());
+  dst += null_info.size();
+  InlineEncodeFixed32(dst, num_values);
+  InlineEncodeFixed32(dst + sizeof(uint32_t), decoder->GetFirstRowId());
+  dst += kPlainBlockHeaderSize;
+  ColumnBlock cb(type_info_, nullptr, dst, num_values, nullptr);
+  ColumnDataView view(&cb);
+  size_t remaining = num_values;
+  while (remaining > 0) {
+    size_t n = remaining;
+    Status s = decoder->CopyNextValues(&n, &view);
+    if (PREDICT_FALSE(!s.ok() || n == 0)) {
+      VLOG(1) << "Unable to decode block " << block_id().ToString() << " at "
+              << ptr.ToString() << " for caching: " << s.ToString();
+      decoder->SeekToPositionInBlock(0);
+      return;
+    }
+    view.Advance(n);
+    remaining -= n;
+  }
+  decoder->SeekToPositionInBlock(0);
+
+  BlockCacheHandle bc_handle;
+  cache->Insert(&entry, &bc_handle);
+}
+
 Status CFileReader::CountRows(rowid_t *count) const {
   *count = footer().num_values();
   return Status::OK();
@@ -684,12 +781,20 @@ CFileIterator::CFileIterator(CFileReader* reader,
     cache_control_(cache_control),
     last_prepare_idx_(-1),
     last_prepare_count_(-1),
-    io_context_(io_context) {
+    io_context_(io_context),
+    readahead_limit_(std::numeric_limits<rowid_t>::max()) {
 }
 
 CFileIterator::~CFileIterator() {
 }
 
+void CFileIterator::SetReadaheadLimit(rowid_t limit) {
+  readahead_limit_ = limit;
+  if (readahead_) {
+    readahead_->set_limit(limit);
+  }
+}
+
 Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
   // Check to see if we already have the required block prepared. Typically
   // (when seeking forward during a scan), only the final block might be
@@ -804,6 +909,21 @@ Status CFileIterator::SeekToFirst() {
 
 Status CFileIterator::SeekAtOrAfter(const EncodedKey &key,
                                     bool *exact_match) {
+  if (key.num_key_columns() > 1) {
+    Slice slice = key.encoded_key();
+    return SeekValueIndexAtOrAfter(key.encoded_key(), &slice, exact_match);
+  }
+  return SeekValueIndexAtOrAfter(key.encoded_key(), key.raw_keys()[0], exact_match);
+}
+
+Status CFileIterator::SeekAtOrAfterEncodedValue(const Slice& value,
+                                                bool* exact_match) {
+  return SeekValueIndexAtOrAfter(value, &value, exact_match);
+}
+
+Status CFileIterator::SeekValueIndexAtOrAfter(const Slice& index_key,
+                                              const void* value,
+                                              bool* exact_match) {
   RETURN_NOT_OK(PrepareForNewSeek());
   DCHECK_EQ(reader_->is_nullable(), false);
 
@@ -811,7 +931,7 @@ Status CFileIterator::SeekAtOrAfter(const EncodedKey &key,
     return Status::NotSupported("no value index present");
   }
 
-  Status s = validx_iter_->SeekAtOrBefore(key.encoded_key());
+  Status s = validx_iter_->SeekAtOrBefore(index_key);
   if (PREDICT_FALSE(s.IsNotFound())) {
     // Seeking to a value before the first value in the file
     // will return NotFound, due to the way the index seek
@@ -826,14 +946,7 @@ Status CFileIterator::SeekAtOrAfter(const EncodedKey &key,
     prepared_block_pool_.Construct());
   RETURN_NOT_OK(ReadCurrentDataBlock(*validx_iter_, b.get()));
 
-  Status dblk_seek_status;
-  if (key.num_key_columns() > 1) {
-    Slice slice = key.encoded_key();
-    dblk_seek_status = b->dblk_->SeekAtOrAfterValue(&slice, exact_match);
-  } else {
-    dblk_seek_status = b->dblk_->SeekAtOrAfterValue(key.raw_keys()[0],
-                                                    exact_match);
-  }
+  Status dblk_seek_status = b->dblk_->SeekAtOrAfterValue(value, exact_match);
 
   // If seeking within the data block results in NotFound, then that indicates that the
   // value we're looking for fell after all the data in that block.
@@ -845,7 +958,7 @@ Status CFileIterator::SeekAtOrAfter(const EncodedKey &key,
     *exact_match = false;
     if (PREDICT_FALSE(!validx_iter_->HasNext())) {
       return Status::NotFound("key after last block in file",
-                              KUDU_REDACT(key.encoded_key().ToDebugString()));
+                              KUDU_REDACT(index_key.ToDebugString()));
     }
     RETURN_NOT_OK(validx_iter_->Next());
     RETURN_NOT_OK(ReadCurrentDataBlock(*validx_iter_, b.get()));
@@ -888,7 +1001,8 @@ Status CFileIterator::PrepareForNewSeek() {
 
     // Cache the dictionary for performance
     RETURN_NOT_OK_PREPEND(
-        reader_->ReadBlock(io_context_, bp, CFileReader::CACHE_BLOCK, &dict_block_handle_),
+        reader_->ReadBlock(io_context_, bp, CFileReader::CACHE_BLOCK,
+                           BlockCache::Priority::HIGH, &dict_block_handle_),
         "couldn't read dictionary block");
 
     dict_decoder_.reset(new BinaryPlainBlockDecoder(dict_block_handle_.data()));
@@ -938,8 +1052,38 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
 Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                                            PreparedBlock *prep_block) {
   prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
-  RETURN_NOT_OK(reader_->ReadBlock(io_context_, prep_block->dblk_ptr_,
-                                   cache_control_, &prep_block->dblk_data_));
+
+  // Blocks which are cached are also cached in decoded form, if enabled.
+  const TypeEncodingInfo* encoding_info = reader_->type_encoding_info();
+  bool decoded = false;
+  bool cache_decoded = false;
+  if (cache_control_ == CFileReader::CACHE_BLOCK && reader_->decoded_encoding_info()) {
+    decoded = reader_->ReadDecodedBlockFromCache(prep_block->dblk_ptr_,
+                                                 &prep_block->dblk_data_);
+    if (decoded) {
+      encoding_info = reader_->decoded_encoding_info();
+    } else {
+      cache_decoded = true;
+    }
+  }
+
+  if (decoded) {
+    // The decoded block was read from the cache above.
+  } else if (&idx_iter == posidx_iter_.get() &&
+             (readahead_ || (FLAGS_cfile_readahead_blocks > 0 &&
+                             reader_->readahead_pool() &&
+                             fs::CurrentIOClass() == fs::IOClass::FOREGROUND))) {
+    if (!readahead_) {
+      readahead_.reset(new BlockReadahead(reader_, reader_->readahead_pool(), cache_control_,
+                                          io_context_, FLAGS_cfile_readahead_blocks));
+      readahead_->set_limit(readahead_limit_);
+    }
+    RETURN_NOT_OK(readahead_->ReadBlock(idx_iter, &prep_block->dblk_data_));
+  } else {
+    RETURN_NOT_OK(reader_->ReadBlock(io_context_, prep_block->dblk_ptr_,
+                                     cache_control_, BlockCache::Priority::NORMAL,
+                                     &prep_block->dblk_data_));
+  }
 
   uint32_t num_rows_in_block = 0;
   Slice data_block = prep_block->dblk_data_.data();
@@ -950,12 +1094,18 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   }
 
   BlockDecoder *bd;
-  RETURN_NOT_OK(reader_->type_encoding_info()->CreateBlockDecoder(&bd, data_block, this));
+  RETURN_NOT_OK(encoding_info->CreateBlockDecoder(&bd, data_block, this));
   prep_block->dblk_.reset(bd);
   RETURN_NOT_OK_PREPEND(prep_block->dblk_->ParseHeader(),
                         Substitute("unable to decode data block header in block $0 ($1)",
                                    reader_->block_id().ToString(),
                                    prep_block->dblk_ptr_.ToString()));
+  if (cache_decoded) {
+    Slice block = prep_block->dblk_data_.data();
+    reader_->CacheDecodedBlock(prep_block->dblk_ptr_,
+                               Slice(block.data(), data_block.data() - block.data()),
+                               bd);
+  }
 
   // For nullable blocks, we filled in the row count from the null information above,
   // since the data block decoder only knows about the non-null values.
@@ -27,6 +27,7 @@
 
 #include <glog/logging.h>
 
+#include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
@@ -53,6 +54,7 @@ class ColumnMaterializationContext;
 class CompressionCodec;
 class EncodedKey;
 class SelectionVector;
+class ThreadPool;
 class TypeInfo;
 
 namespace fs {
@@ -64,6 +66,7 @@ template <typename T> class ArrayView;
 namespace cfile {
 
 class BinaryPlainBlockDecoder;
+class BlockReadahead;
 class CFileIterator;
 class IndexTreeIterator;
 class TypeEncodingInfo;
@@ -106,9 +109,10 @@ class CFileReader {
 
   // Reads the data block pointed to by `ptr`. Will pull the data block from
   // the block cache if it exists, and reads from the filesystem block
-  // otherwise.
+  // otherwise. 'priority' is the priority of the block in the block cache.
   Status ReadBlock(const fs::IOContext* io_context, const BlockPointer& ptr,
-                   CacheControl cache_control, BlockHandle* ret) const;
+                   CacheControl cache_control, BlockCache::Priority priority,
+                   BlockHandle* ret) const;
 
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
@@ -122,6 +126,11 @@ class CFileReader {
   // in a hot path.
   bool GetMetadataEntry(const std::string &key, std::string *val) const;
 
+  // Can be called before Init().
+  ThreadPool* readahead_pool() const {
+    return readahead_pool_;
+  }
+
   // Can be called before Init().
   uint64_t file_size() const {
     return file_size_;
@@ -189,6 +198,9 @@ class CFileReader {
   void HandleCorruption(const fs::IOContext* io_context) const;
 
  private:
+  friend class BlockReadahead;
+  friend class CFileIterator;
+
   DISALLOW_COPY_AND_ASSIGN(CFileReader);
 
   CFileReader(ReaderOptions options,
@@ -202,6 +214,39 @@ class CFileReader {
   Status ReadAndParseFooter();
   Status VerifyChecksum(ArrayView<const Slice> data, const Slice& checksum) const;
 
+  // The two halves of ReadBlock(). ReadBlockFromCache() returns true and sets
+  // 'ret' if the block is in the block cache. ReadBlockFromDisk() reads the
+  // block from the filesystem, inserting it into the cache if requested.
+  bool ReadBlockFromCache(const BlockPointer& ptr, CacheControl cache_control,
+                          BlockCache::Priority priority, BlockHandle* ret) const;
+  Status ReadBlockFromDisk(const fs::IOContext* io_context, const BlockPointer& ptr,
+                           CacheControl cache_control, BlockCache::Priority priority,
+                           BlockHandle* ret) const;
+
+  // Look up the decoded form of the data block pointed to by 'ptr' in the
+  // block cache, returning true and setting 'ret' if it is found. The decoded
+  // form is the block's null bitmap, if any, followed by its values in
+  // PLAIN_ENCODING.
+  //
+  // Must only be called if decoded_encoding_info() is not null.
+  bool ReadDecodedBlockFromCache(const BlockPointer& ptr, BlockHandle* ret) const;
+
+  // Insert the decoded form of the data block pointed to by 'ptr' into the
+  // block cache. 'null_info' is the block's null bitmap, and 'decoder' is
+  // the parsed decoder of its values, which is left at the start of the block.
+  //
+  // Must only be called if decoded_encoding_info() is not null. Failures are
+  // ignored: the block is simply not cached.
+  void CacheDecodedBlock(const BlockPointer& ptr, const Slice& null_info,
+                         BlockDecoder* decoder) const;
+
+  // The encoding of the decoded form of this file's data blocks, or null if
+  // they aren't cached in decoded form.
+  const TypeEncodingInfo* decoded_encoding_info() const {
+    DCHECK(init_once_.init_succeeded());
+    return decoded_encoding_info_;
+  }
+
   // Returns the memory usage of the object including the object itself.
   size_t memory_footprint() const;
 
@@ -210,6 +255,7 @@ class CFileReader {
 #endif
   const std::unique_ptr<fs::ReadableBlock> block_;
   const uint64_t file_size_;
+  ThreadPool* const readahead_pool_;
 
   uint8_t cfile_version_;
 
@@ -218,6 +264,7 @@ class CFileReader {
   const CompressionCodec* codec_;
   const TypeInfo *type_info_;
   const TypeEncodingInfo *type_encoding_info_;
+  const TypeEncodingInfo* decoded_encoding_info_;
 
   KuduOnceLambda init_once_;
 
@@ -277,6 +324,10 @@ class ColumnIterator {
   // batch left off.
   virtual Status FinishBatch() = 0;
 
+  // Hint that rows at or after ordinal 'limit' will not be read, so that
+  // any readahead may stop there.
+  virtual void SetReadaheadLimit(rowid_t /*limit*/) {}
+
   virtual const IteratorStats& io_statistics() const = 0;
 };
 
@@ -345,6 +396,11 @@ class CFileIterator : public ColumnIterator {
   Status SeekAtOrAfter(const EncodedKey &encoded_key,
                        bool *exact_match);
 
+  // Like SeekAtOrAfter(), but seeks a BINARY file whose values are themselves
+  // the keys of its value index to the first value at or after 'value'.
+  Status SeekAtOrAfterEncodedValue(const Slice& value,
+                                   bool* exact_match);
+
   // Return true if this reader is currently seeked.
   // If the iterator is not seeked, it is an error to call any functions except
   // for seek (including GetCurrentOrdinal).
@@ -381,6 +437,8 @@ class CFileIterator : public ColumnIterator {
   // batch left off.
   Status FinishBatch() OVERRIDE;
 
+  void SetReadaheadLimit(rowid_t limit) override;
+
   // Return true if the next call to PrepareBatch will return at least one row.
   bool HasNext() const;
 
@@ -464,6 +522,12 @@ class CFileIterator : public ColumnIterator {
   // seek-related state.
   Status PrepareForNewSeek();
 
+  // Seek the value index to the entry at or before 'index_key', then seek the
+  // data block it points to to the first value at or after 'value'.
+  Status SeekValueIndexAtOrAfter(const Slice& index_key,
+                                 const void* value,
+                                 bool* exact_match);
+
   CFileReader* reader_;
 
   gscoped_ptr<IndexTreeIterator> posidx_iter_;
@@ -508,6 +572,12 @@ class CFileIterator : public ColumnIterator {
 
   // a temporary buffer for encoding
   faststring tmp_buf_;
+
+  // Reads data blocks ahead of sequential positional scans. Created on the
+  // first positional read of a foreground scan if --cfile_readahead_blocks is
+  // positive and the reader has a readahead pool.
+  std::unique_ptr<BlockReadahead> readahead_;
+  rowid_t readahead_limit_;
 };
 
 } // namespace cfile
@@ -31,6 +31,7 @@
 namespace kudu {
 
 class MemTracker;
+class ThreadPool;
 class faststring;
 
 namespace fs {
@@ -104,6 +105,12 @@ struct ReaderOptions {
   //
   // Default: the root tracker.
   std::shared_ptr<MemTracker> parent_mem_tracker;
+
+  // The pool on which iterators of this reader read data blocks ahead of
+  // sequential scans. Must outlive the reader.
+  //
+  // Default: nullptr (no readahead)
+  ThreadPool* readahead_pool = nullptr;
 };
 
 // Dumps the contents of a cfile to 'out'; 'reader' and 'iterator'
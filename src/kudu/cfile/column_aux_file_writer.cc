@@ -0,0 +1,49 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/column_aux_file_writer.h"
+
+#include <algorithm>
+
+using std::vector;
+
+namespace kudu {
+namespace cfile {
+
+vector<Slice> ColumnAuxFileWriter::SortedEntries(bool dedup) const {
+  vector<Slice> entries;
+  entries.reserve(entry_offsets_.size());
+  for (size_t i = 0; i < entry_offsets_.size(); i++) {
+    uint64_t end = i + 1 < entry_offsets_.size() ? entry_offsets_[i + 1] : buffer_.size();
+    entries.emplace_back(buffer_.data() + entry_offsets_[i], end - entry_offsets_[i]);
+  }
+  std::sort(entries.begin(), entries.end(), [](const Slice& a, const Slice& b) {
+    return a.compare(b) < 0;
+  });
+  if (dedup) {
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+  }
+  return entries;
+}
+
+void ColumnAuxFileWriter::Clear() {
+  buffer_.clear();
+  entry_offsets_.clear();
+}
+
+} // namespace cfile
+} // namespace kudu
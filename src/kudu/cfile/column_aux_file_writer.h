@@ -0,0 +1,102 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnBlock;
+
+namespace fs {
+class BlockCreationTransaction;
+class WritableBlock;
+}
+
+namespace cfile {
+
+// Base class for writers of an auxiliary file over the base data of a single
+// column of a DiskRowSet, such as a secondary index or a column bloom filter.
+//
+// Such files are keyed by the column's values, which arrive in row order, so
+// subclasses buffer an encoded entry per cell and sort the entries by their
+// bytes when the file is written.
+class ColumnAuxFileWriter {
+ public:
+  virtual ~ColumnAuxFileWriter() = default;
+
+  // Buffer an entry for every non-NULL cell of 'block'. The first cell of
+  // 'block' belongs to the row with ordinal 'first_rowid'.
+  virtual void AppendValues(const ColumnBlock& block, rowid_t first_rowid) = 0;
+
+  // Write the buffered entries out to 'block', finalizing the block and
+  // releasing it to 'transaction'.
+  //
+  // Must not be called if the writer is empty().
+  virtual Status FinishAndReleaseBlock(std::unique_ptr<fs::WritableBlock> block,
+                                       fs::BlockCreationTransaction* transaction) = 0;
+
+  // Whether any entries have been buffered.
+  bool empty() const {
+    return entry_offsets_.empty();
+  }
+
+  // The amount of memory used by the buffered entries.
+  size_t buffered_size() const {
+    return buffer_.size() + entry_offsets_.size() * sizeof(uint64_t);
+  }
+
+ protected:
+  ColumnAuxFileWriter() = default;
+
+  // Start a new entry, returning the buffer to which the caller should append
+  // its bytes.
+  faststring* StartEntry() {
+    entry_offsets_.push_back(buffer_.size());
+    return &buffer_;
+  }
+
+  // Returns the buffered entries, sorted by their bytes. If 'dedup' is true,
+  // duplicate entries are dropped. The slices point into the buffer, and are
+  // only valid until the next call to Clear().
+  std::vector<Slice> SortedEntries(bool dedup) const;
+
+  // Discard the buffered entries.
+  void Clear();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ColumnAuxFileWriter);
+
+  // Concatenated entries, in insertion order.
+  faststring buffer_;
+
+  // Offset of the start of each entry within 'buffer_'. 64-bit since the
+  // entries of a large rowset can exceed 4GiB.
+  std::vector<uint64_t> entry_offsets_;
+};
+
+} // namespace cfile
+} // namespace kudu
@@ -23,6 +23,7 @@
 
 #include <glog/logging.h>
 
+#include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/cfile.pb.h"
@@ -285,8 +286,8 @@ Status IndexTreeIterator::LoadBlock(const BlockPointer &block,
     seeked = seeked_indexes_.back().get();
   }
 
-  RETURN_NOT_OK(reader_->ReadBlock(io_context_, block,
-                                   CFileReader::CACHE_BLOCK, &seeked->data));
+  RETURN_NOT_OK(reader_->ReadBlock(io_context_, block, CFileReader::CACHE_BLOCK,
+                                   BlockCache::Priority::HIGH, &seeked->data));
   seeked->block_ptr = block;
 
   // Parse the new block.
@@ -0,0 +1,165 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/secondary_index.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/rowid.h"
+#include "kudu/common/types.h"
+#include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace cfile {
+
+class SecondaryIndexTest : public KuduTest {
+ public:
+  void SetUp() override {
+    KuduTest::SetUp();
+
+    fs_manager_.reset(new FsManager(env_, GetTestPath("fs_root")));
+    ASSERT_OK(fs_manager_->CreateInitialFileSystemLayout());
+    ASSERT_OK(fs_manager_->Open());
+  }
+
+ protected:
+  // Write the non-null cells of 'batches' to a new index, numbering rows
+  // consecutively across batches, then open a reader over it.
+  template<DataType type>
+  void WriteAndOpenIndex(const vector<unique_ptr<ScopedColumnBlock<type>>>& batches) {
+    const TypeInfo* type_info = GetTypeInfo(type);
+    SecondaryIndexWriter writer(type_info);
+    rowid_t first_rowid = 0;
+    for (const auto& batch : batches) {
+      writer.AppendValues(*batch, first_rowid);
+      first_rowid += batch->nrows();
+    }
+    ASSERT_FALSE(writer.empty());
+
+    unique_ptr<fs::WritableBlock> sink;
+    ASSERT_OK(fs_manager_->CreateNewBlock({}, &sink));
+    BlockId block_id = sink->id();
+    unique_ptr<fs::BlockCreationTransaction> transaction =
+        fs_manager_->block_manager()->NewCreationTransaction();
+    ASSERT_OK(writer.FinishAndReleaseBlock(std::move(sink), transaction.get()));
+    ASSERT_OK(transaction->CommitCreatedBlocks());
+    ASSERT_TRUE(writer.empty());
+
+    unique_ptr<fs::ReadableBlock> source;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+    ASSERT_OK(SecondaryIndexReader::OpenNoInit(std::move(source), type_info,
+                                               ReaderOptions(), &reader_));
+    ASSERT_OK(reader_->Init(nullptr));
+  }
+
+  vector<rowid_t> Lookup(const void* value) {
+    vector<rowid_t> rowids;
+    CHECK_OK(reader_->FindRowIds(value, nullptr, &rowids));
+    return rowids;
+  }
+
+  unique_ptr<FsManager> fs_manager_;
+  unique_ptr<SecondaryIndexReader> reader_;
+};
+
+TEST_F(SecondaryIndexTest, TestInt32WithNulls) {
+  const int kNumBatches = 10;
+  const int kBatchSize = 1000;
+  const int kNumDistinct = 37;
+  vector<unique_ptr<ScopedColumnBlock<INT32>>> batches;
+  vector<vector<rowid_t>> expected(kNumDistinct);
+  for (int b = 0; b < kNumBatches; b++) {
+    batches.emplace_back(new ScopedColumnBlock<INT32>(kBatchSize));
+    auto& cb = *batches.back();
+    for (int j = 0; j < kBatchSize; j++) {
+      // Every seventh row is NULL; the remaining values are spread out so
+      // that lookups in the gaps between them can be tested too.
+      int i = b * kBatchSize + j;
+      bool is_null = i % 7 == 0;
+      cb.SetCellIsNull(j, is_null);
+      if (!is_null) {
+        int v = i % kNumDistinct;
+        cb[j] = v * 2 - kNumDistinct;
+        expected[v].push_back(i);
+      }
+    }
+  }
+  NO_FATALS(WriteAndOpenIndex(batches));
+
+  for (int v = 0; v < kNumDistinct; v++) {
+    int32_t value = v * 2 - kNumDistinct;
+    SCOPED_TRACE(value);
+    ASSERT_EQ(expected[v], Lookup(&value));
+
+    // Odd offsets fall between indexed values.
+    int32_t missing = value + 1;
+    ASSERT_TRUE(Lookup(&missing).empty());
+  }
+  int32_t below_min = -kNumDistinct - 1;
+  ASSERT_TRUE(Lookup(&below_min).empty());
+  int32_t above_max = kNumDistinct * 2;
+  ASSERT_TRUE(Lookup(&above_max).empty());
+}
+
+TEST_F(SecondaryIndexTest, TestBinaryPrefixesAreDistinct) {
+  // Values which are prefixes of one another, or which contain embedded NUL
+  // bytes, must not match each other's lookups.
+  const vector<string> kValues = { "", "a", string("a\0", 2), "aa", "ab", "b" };
+  const int kNumRows = 600;
+  vector<unique_ptr<ScopedColumnBlock<BINARY>>> batches;
+  batches.emplace_back(new ScopedColumnBlock<BINARY>(kNumRows, /*allow_nulls=*/false));
+  auto& cb = *batches.back();
+  vector<vector<rowid_t>> expected(kValues.size());
+  for (int i = 0; i < kNumRows; i++) {
+    int v = (i * 7) % kValues.size();
+    cb[i] = Slice(kValues[v]);
+    expected[v].push_back(i);
+  }
+  NO_FATALS(WriteAndOpenIndex(batches));
+
+  for (int v = 0; v < kValues.size(); v++) {
+    Slice value(kValues[v]);
+    SCOPED_TRACE(value.ToDebugString());
+    ASSERT_EQ(expected[v], Lookup(&value));
+  }
+  Slice missing("a\0\0", 3);
+  ASSERT_TRUE(Lookup(&missing).empty());
+  missing = Slice("ac");
+  ASSERT_TRUE(Lookup(&missing).empty());
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,177 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/secondary_index.h"
+
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/gutil/endian.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace cfile {
+
+using fs::BlockCreationTransaction;
+using fs::IOContext;
+using fs::ReadableBlock;
+using fs::WritableBlock;
+
+namespace {
+
+// Number of index entries read per batch while scanning for a value.
+constexpr size_t kScanBatchSize = 128;
+
+// Size of the row ordinal suffix of each entry.
+constexpr size_t kRowIdSize = sizeof(uint32_t);
+
+} // anonymous namespace
+
+////////////////////////////////////////////////////////////
+// Writer
+////////////////////////////////////////////////////////////
+
+SecondaryIndexWriter::SecondaryIndexWriter(const TypeInfo* type_info)
+    : key_encoder_(GetKeyEncoder<faststring>(type_info)) {
+}
+
+void SecondaryIndexWriter::AppendValues(const ColumnBlock& block, rowid_t first_rowid) {
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (block.is_nullable() && block.is_null(i)) {
+      continue;
+    }
+    faststring* entry = StartEntry();
+    key_encoder_.Encode(block.cell_ptr(i), /*is_last=*/false, entry);
+    uint8_t rowid_buf[kRowIdSize];
+    BigEndian::Store32(rowid_buf, first_rowid + i);
+    entry->append(rowid_buf, kRowIdSize);
+  }
+}
+
+Status SecondaryIndexWriter::FinishAndReleaseBlock(unique_ptr<WritableBlock> block,
+                                                   BlockCreationTransaction* transaction) {
+  DCHECK(!empty());
+
+  // Entries are unique, since each ends with its row's ordinal.
+  vector<Slice> entries = SortedEntries(/*dedup=*/false);
+
+  WriterOptions opts;
+  // Index the entries by value so that lookups can seek to a value's prefix.
+  opts.write_validx = true;
+  opts.write_posidx = false;
+  // Adjacent entries commonly share long prefixes.
+  opts.storage_attributes.encoding = PREFIX_ENCODING;
+  opts.storage_attributes.compression = LZ4;
+
+  CFileWriter writer(std::move(opts), GetTypeInfo(BINARY), false, std::move(block));
+  RETURN_NOT_OK(writer.Start());
+  RETURN_NOT_OK(writer.AppendEntries(entries.data(), entries.size()));
+  RETURN_NOT_OK(writer.FinishAndReleaseBlock(transaction));
+
+  Clear();
+  return Status::OK();
+}
+
+////////////////////////////////////////////////////////////
+// Reader
+////////////////////////////////////////////////////////////
+
+Status SecondaryIndexReader::OpenNoInit(unique_ptr<ReadableBlock> block,
+                                        const TypeInfo* type_info,
+                                        ReaderOptions options,
+                                        unique_ptr<SecondaryIndexReader>* reader) {
+  unique_ptr<CFileReader> cf_reader;
+  RETURN_NOT_OK(CFileReader::OpenNoInit(std::move(block), std::move(options), &cf_reader));
+  reader->reset(new SecondaryIndexReader(std::move(cf_reader), type_info));
+  return Status::OK();
+}
+
+SecondaryIndexReader::SecondaryIndexReader(unique_ptr<CFileReader> reader,
+                                           const TypeInfo* type_info)
+    : reader_(std::move(reader)),
+      key_encoder_(GetKeyEncoder<faststring>(type_info)) {
+}
+
+Status SecondaryIndexReader::Init(const IOContext* io_context) {
+  return reader_->Init(io_context);
+}
+
+uint64_t SecondaryIndexReader::FileSize() const {
+  return reader_->file_size();
+}
+
+Status SecondaryIndexReader::FindRowIds(const void* value,
+                                        const IOContext* io_context,
+                                        vector<rowid_t>* rowids) const {
+  faststring prefix_buf;
+  key_encoder_.Encode(value, /*is_last=*/false, &prefix_buf);
+  const Slice prefix(prefix_buf);
+
+  unique_ptr<CFileIterator> iter;
+  RETURN_NOT_OK(reader_->NewIterator(&iter, CFileReader::CACHE_BLOCK, io_context));
+
+  bool exact;
+  Status s = iter->SeekAtOrAfterEncodedValue(prefix, &exact);
+  if (s.IsNotFound()) {
+    // Every entry sorts before 'value'.
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+
+  Arena arena(1024);
+  Slice entries[kScanBatchSize];
+  ColumnBlock cb(GetTypeInfo(BINARY), nullptr, entries, kScanBatchSize, &arena);
+  SelectionVector sel(kScanBatchSize);
+  ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+  while (iter->HasNext()) {
+    size_t n = kScanBatchSize;
+    RETURN_NOT_OK(iter->CopyNextValues(&n, &ctx));
+    for (size_t i = 0; i < n; i++) {
+      const Slice& entry = entries[i];
+      if (!entry.starts_with(prefix)) {
+        return Status::OK();
+      }
+      if (PREDICT_FALSE(entry.size() != prefix.size() + kRowIdSize)) {
+        return Status::Corruption("bad secondary index entry",
+                                  KUDU_REDACT(entry.ToDebugString()));
+      }
+      rowids->push_back(BigEndian::Load32(entry.data() + prefix.size()));
+    }
+    arena.Reset();
+  }
+  return Status::OK();
+}
+
+} // namespace cfile
+} // namespace kudu
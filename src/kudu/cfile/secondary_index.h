@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "kudu/cfile/column_aux_file_writer.h"
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnBlock;
+class TypeInfo;
+
+template <typename Buffer>
+class KeyEncoder;
+
+namespace fs {
+class BlockCreationTransaction;
+struct IOContext;
+class ReadableBlock;
+class WritableBlock;
+}
+
+namespace cfile {
+
+class CFileReader;
+struct ReaderOptions;
+
+// A secondary index maps the values of a single non-key column of a
+// DiskRowSet to the ordinals of the rows holding them.
+//
+// It is stored as a BINARY CFile with a value index. Each entry is the
+// key-encoded column value (as a non-final composite key component, so that
+// entries for a given value share a unique prefix) followed by the big-endian
+// row ordinal. Entries are sorted, so all the rows for a value are contiguous
+// and in ascending ordinal order. NULL cells are not indexed.
+class SecondaryIndexWriter : public ColumnAuxFileWriter {
+ public:
+  explicit SecondaryIndexWriter(const TypeInfo* type_info);
+
+  void AppendValues(const ColumnBlock& block, rowid_t first_rowid) override;
+
+  // Sort the buffered entries and write them out as a CFile.
+  Status FinishAndReleaseBlock(std::unique_ptr<fs::WritableBlock> block,
+                               fs::BlockCreationTransaction* transaction) override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SecondaryIndexWriter);
+
+  const KeyEncoder<faststring>& key_encoder_;
+};
+
+// Reader for a secondary index.
+class SecondaryIndexReader {
+ public:
+  // Lazily opens a secondary index using a previously opened block. A lazy
+  // open does not incur additional I/O.
+  //
+  // Init() must be called before using FindRowIds().
+  static Status OpenNoInit(std::unique_ptr<fs::ReadableBlock> block,
+                           const TypeInfo* type_info,
+                           ReaderOptions options,
+                           std::unique_ptr<SecondaryIndexReader>* reader);
+
+  // Fully opens a previously lazily opened index.
+  //
+  // May be called multiple times; subsequent calls will no-op.
+  Status Init(const fs::IOContext* io_context);
+
+  // Append to 'rowids' the ordinals of all rows whose indexed cell equals
+  // 'value', in ascending order. 'value' points to a cell of the indexed
+  // column's type (e.g. a Slice for BINARY columns).
+  Status FindRowIds(const void* value,
+                    const fs::IOContext* io_context,
+                    std::vector<rowid_t>* rowids) const;
+
+  // Can be called before Init().
+  uint64_t FileSize() const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SecondaryIndexReader);
+
+  SecondaryIndexReader(std::unique_ptr<CFileReader> reader,
+                       const TypeInfo* type_info);
+
+  std::unique_ptr<CFileReader> reader_;
+
+  const KeyEncoder<faststring>& key_encoder_;
+};
+
+} // namespace cfile
+} // namespace kudu
@@ -962,6 +962,45 @@ TEST_F(ClientTest, TestScan) {
   DoTestScanWithKeyPredicate();
 }
 
+// Test that a scan which prefetches its batches returns all of the rows, in
+// order, and that it can be closed with a prefetch still in flight.
+TEST_F(ClientTest, TestScanWithPrefetching) {
+  NO_FATALS(InsertTestRows(client_table_.get(), FLAGS_test_scan_num_rows));
+
+  for (bool close_early : { false, true }) {
+    SCOPED_TRACE(close_early);
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetProjectedColumnNames({ "key" }));
+    ASSERT_OK(scanner.SetFaultTolerant());
+    ASSERT_OK(scanner.SetPrefetching(true));
+    // Use small batches so the scan takes many of them.
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+    ASSERT_TRUE(scanner.SetPrefetching(false).IsIllegalState());
+
+    KuduScanBatch batch;
+    int32_t expected_key = 0;
+    int num_batches = 0;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      num_batches++;
+      for (const KuduScanBatch::RowPtr& row : batch) {
+        int32_t key;
+        ASSERT_OK(row.GetInt32(0, &key));
+        ASSERT_EQ(expected_key++, key);
+      }
+      if (close_early && num_batches == 2) {
+        break;
+      }
+    }
+    scanner.Close();
+    if (!close_early) {
+      ASSERT_EQ(FLAGS_test_scan_num_rows, expected_key);
+      ASSERT_GT(num_batches, 2);
+    }
+  }
+}
+
 TEST_F(ClientTest, TestScanAtSnapshot) {
   int half_the_rows = FLAGS_test_scan_num_rows / 2;
 
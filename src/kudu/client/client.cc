@@ -1502,6 +1502,14 @@ Status KuduScanner::SetLimit(int64_t limit) {
   return data_->mutable_configuration()->SetLimit(limit);
 }
 
+Status KuduScanner::SetPrefetching(bool prefetching) {
+  if (data_->open_) {
+    return Status::IllegalState("Prefetching must be set before Open()");
+  }
+  data_->mutable_configuration()->SetPrefetching(prefetching);
+  return Status::OK();
+}
+
 const ResourceMetrics& KuduScanner::GetResourceMetrics() const {
   return data_->resource_metrics_;
 }
@@ -1590,6 +1598,10 @@ void KuduScanner::Close() {
   // If the scan did not match any rows, the tserver will not assign a scanner ID.
   // This is reflected in the Open() response. In this case, there is no server-side state
   // to clean up.
+  // The prefetched continuation of the scan, if any, refers to the scanner's
+  // state and its reply must be waited out before closing the scanner.
+  data_->WaitForPrefetch();
+
   if (!data_->next_req_.scanner_id().empty()) {
     CHECK(data_->proxy_);
     gscoped_ptr<CloseCallback> closer(new CloseCallback);
@@ -1626,10 +1638,6 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
-  // TODO: do some double-buffering here -- when we return this batch
-  // we should already have fired off the RPC for the next batch, but
-  // need to do some swapping of the response objects around to avoid
-  // stomping on the memory the user is looking at.
   CHECK(data_->open_);
   CHECK(data_->proxy_);
 
@@ -1643,12 +1651,14 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     // We have data from a previous scan.
     VLOG(2) << "Extracting data from " << data_->DebugString();
     data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                               data_->configuration().row_format_flags(),
-                               unique_ptr<RowwiseRowBlockPB>(
-                                   data_->last_response_.release_data()));
+    RETURN_NOT_OK(batch->data_->Reset(&data_->controller_,
+                                      data_->configuration().projection(),
+                                      data_->configuration().client_projection(),
+                                      data_->configuration().row_format_flags(),
+                                      unique_ptr<RowwiseRowBlockPB>(
+                                          data_->last_response_.release_data())));
+    data_->MaybeStartPrefetch();
+    return Status::OK();
   }
 
   if (data_->last_response_.has_more_results()) {
@@ -1656,11 +1666,22 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     VLOG(2) << "Continuing " << data_->DebugString();
 
     MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
-    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+    // If the batch was prefetched, the request for it was already prepared
+    // and sent, with deadlines of its own.
+    bool prefetched = data_->prefetch_in_flight_;
+    if (!prefetched) {
+      data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+    }
 
     while (true) {
-      bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
-      ScanRpcStatus result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
+      ScanRpcStatus result;
+      if (prefetched) {
+        result = data_->FinishPrefetch();
+        prefetched = false;
+      } else {
+        bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
+        result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
+      }
 
       // Success case.
       if (result.result == ScanRpcStatus::OK) {
@@ -1668,12 +1689,14 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
           data_->last_primary_key_ = data_->last_response_.last_primary_key();
         }
         data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   data_->configuration().row_format_flags(),
-                                   unique_ptr<RowwiseRowBlockPB>(
-                                       data_->last_response_.release_data()));
+        RETURN_NOT_OK(batch->data_->Reset(&data_->controller_,
+                                          data_->configuration().projection(),
+                                          data_->configuration().client_projection(),
+                                          data_->configuration().row_format_flags(),
+                                          unique_ptr<RowwiseRowBlockPB>(
+                                              data_->last_response_.release_data())));
+        data_->MaybeStartPrefetch();
+        return Status::OK();
       }
 
       data_->scan_attempts_++;
@@ -2348,6 +2348,22 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
 
+  /// Prefetch the next batch of rows while the current one is processed.
+  ///
+  /// By default, the scanner asks the tablet server for each batch only when
+  /// NextBatch() is called, so the tablet server is idle while the
+  /// application processes a batch, and each batch takes at least one round
+  /// trip to the server. If prefetching is enabled, the scanner asks for the
+  /// next batch as soon as it returns a batch from NextBatch(), so that the
+  /// next batch is likely to have arrived by the time it's needed. At most
+  /// one batch is prefetched, so the scanner holds on to the memory of up to
+  /// two batches at a time.
+  ///
+  /// @param [in] prefetching
+  ///   Whether to prefetch batches. Prefetching is disabled by default.
+  /// @return Operation result status.
+  Status SetPrefetching(bool prefetching) WARN_UNUSED_RESULT;
+
   /// @return String representation of this scan.
   ///
   /// @internal
@@ -54,6 +54,7 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       selection_(KuduClient::CLOSEST_REPLICA),
       read_mode_(KuduScanner::READ_LATEST),
       is_fault_tolerant_(false),
+      prefetching_(false),
       start_timestamp_(kNoTimestamp),
       snapshot_timestamp_(kNoTimestamp),
       lower_bound_propagation_timestamp_(kNoTimestamp),
@@ -216,6 +217,10 @@ Status ScanConfiguration::SetLimit(int64_t limit) {
   return Status::OK();
 }
 
+void ScanConfiguration::SetPrefetching(bool prefetching) {
+  prefetching_ = prefetching;
+}
+
 Status ScanConfiguration::AddIsDeletedColumn() {
   CHECK(has_start_timestamp());
   CHECK(has_snapshot_timestamp());
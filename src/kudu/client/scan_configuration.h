@@ -99,6 +99,8 @@ class ScanConfiguration {
 
   Status SetLimit(int64_t limit);
 
+  void SetPrefetching(bool prefetching);
+
   // Adds an IS_DELETED virtual column to the projection.
   //
   // Can only be used with diff scans.
@@ -149,6 +151,10 @@ class ScanConfiguration {
     return is_fault_tolerant_;
   }
 
+  bool prefetching() const {
+    return prefetching_;
+  }
+
   bool has_start_timestamp() const {
     return start_timestamp_ != kNoTimestamp;
   }
@@ -218,6 +224,8 @@ class ScanConfiguration {
 
   bool is_fault_tolerant_;
 
+  bool prefetching_;
+
   // Start and end timestamps in a diff scan.
   //
   // If just a regular snapshot scan, start_timestamp_ is ignored.
@@ -25,6 +25,7 @@
 #include <utility>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
 
@@ -78,6 +79,8 @@ KuduScanner::Data::Data(KuduTable* table)
     data_in_open_(false),
     short_circuit_(false),
     table_(DCHECK_NOTNULL(table)->shared_from_this()),
+    prefetch_in_flight_(false),
+    prefetch_latch_(0),
     scan_attempts_(0),
     num_rows_returned_(0) {
 }
@@ -329,8 +332,9 @@ Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                     blacklist);
 }
 
-ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
-                                             bool allow_time_for_failover) {
+MonoTime KuduScanner::Data::PrepareScanRpc(const MonoTime& overall_deadline,
+                                          bool allow_time_for_failover,
+                                          RpcController* controller) {
   // The user has specified a timeout which should apply to the total time for each call
   // to NextBatch(). However, for fault-tolerant scans, or for when we are first opening
   // a scanner, it's preferable to set a shorter timeout (the "default RPC timeout") for
@@ -344,14 +348,33 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
     rpc_deadline = overall_deadline;
   }
 
-  controller_.Reset();
-  controller_.set_deadline(rpc_deadline);
+  controller->Reset();
+  controller->set_deadline(rpc_deadline);
   if (!configuration_.spec().predicates().empty()) {
-    controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+    controller->RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
   }
   if (configuration().row_format_flags() & KuduScanner::PAD_UNIXTIME_MICROS_TO_16_BYTES) {
-    controller_.RequireServerFeature(TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES);
+    controller->RequireServerFeature(TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES);
   }
+  return rpc_deadline;
+}
+
+ScanRpcStatus KuduScanner::Data::FinishScanRpc(const Status& rpc_status,
+                                               const MonoTime& overall_deadline,
+                                               const MonoTime& rpc_deadline) {
+  ScanRpcStatus scan_status = AnalyzeResponse(rpc_status, rpc_deadline, overall_deadline);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+    num_rows_returned_ += last_response_.data().num_rows();
+  }
+  return scan_status;
+}
+
+ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
+                                             bool allow_time_for_failover) {
+  DCHECK(!prefetch_in_flight_);
+  MonoTime rpc_deadline = PrepareScanRpc(overall_deadline, allow_time_for_failover,
+                                         &controller_);
   if (next_req_.has_new_scan_request()) {
     // Only new scan requests require authz tokens. Scan continuations rely on
     // Kudu's prevention of scanner hijacking by different users.
@@ -364,16 +387,42 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
       VLOG(1) << "no authz token for table " << table_->id();
     }
   }
-  ScanRpcStatus scan_status = AnalyzeResponse(
-      proxy_->Scan(next_req_,
-                   &last_response_,
-                   &controller_),
-      rpc_deadline, overall_deadline);
-  if (scan_status.result == ScanRpcStatus::OK) {
-    UpdateResourceMetrics();
-    num_rows_returned_ += last_response_.data().num_rows();
+  return FinishScanRpc(proxy_->Scan(next_req_, &last_response_, &controller_),
+                       overall_deadline, rpc_deadline);
+}
+
+void KuduScanner::Data::MaybeStartPrefetch() {
+  DCHECK(!prefetch_in_flight_);
+  if (!configuration_.prefetching() || !last_response_.has_more_results()) {
+    return;
+  }
+  VLOG(2) << "Prefetching " << DebugString();
+  PrepareRequest(KuduScanner::Data::CONTINUE);
+  prefetch_overall_deadline_ = MonoTime::Now() + configuration_.timeout();
+  prefetch_rpc_deadline_ = PrepareScanRpc(prefetch_overall_deadline_,
+                                          configuration_.is_fault_tolerant(),
+                                          &prefetch_controller_);
+  prefetch_response_.Clear();
+  prefetch_latch_.Reset(1);
+  prefetch_in_flight_ = true;
+  proxy_->ScanAsync(next_req_, &prefetch_response_, &prefetch_controller_,
+                    boost::bind(&CountDownLatch::CountDown, &prefetch_latch_));
+}
+
+ScanRpcStatus KuduScanner::Data::FinishPrefetch() {
+  DCHECK(prefetch_in_flight_);
+  prefetch_latch_.Wait();
+  prefetch_in_flight_ = false;
+  controller_.Swap(&prefetch_controller_);
+  last_response_.Swap(&prefetch_response_);
+  return FinishScanRpc(controller_.status(), prefetch_overall_deadline_, prefetch_rpc_deadline_);
+}
+
+void KuduScanner::Data::WaitForPrefetch() {
+  if (prefetch_in_flight_) {
+    prefetch_latch_.Wait();
+    prefetch_in_flight_ = false;
   }
-  return scan_status;
 }
 
 Status KuduScanner::Data::OpenTablet(const string& partition_key,
@@ -39,12 +39,13 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
-class MonoTime;
 class Schema;
 
 namespace tserver {
@@ -192,6 +193,18 @@ class KuduScanner::Data {
   // Modifies fields in 'next_req_' in preparation for a new request.
   void PrepareRequest(RequestType state);
 
+  // If prefetching is enabled and the tablet has more rows, send the request
+  // for the next batch in the background. Must be called once the last
+  // response has been handed off to a batch.
+  void MaybeStartPrefetch();
+
+  // Wait for the prefetched batch to arrive, and make it the last response,
+  // as if it had been fetched by SendScanRpc().
+  ScanRpcStatus FinishPrefetch();
+
+  // Wait for the prefetched batch to arrive, if any, and discard it.
+  void WaitForPrefetch();
+
   // Update 'last_error_' if need be. Should be invoked whenever a
   // non-fatal (i.e. retriable) scan error is encountered.
   void UpdateLastError(const Status& error);
@@ -233,6 +246,18 @@ class KuduScanner::Data {
   // RPC controller for the last in-flight RPC.
   rpc::RpcController controller_;
 
+  // Whether the request for the next batch was sent ahead of NextBatch(). At
+  // most one such request is in flight at a time, since the tablet server
+  // expects a scanner's requests one after another. Its response and
+  // controller are kept apart from the ones above, which hold the state of
+  // the scan as of the last batch returned.
+  bool prefetch_in_flight_;
+  tserver::ScanResponsePB prefetch_response_;
+  rpc::RpcController prefetch_controller_;
+  MonoTime prefetch_overall_deadline_;
+  MonoTime prefetch_rpc_deadline_;
+  CountDownLatch prefetch_latch_;
+
   // The table we're scanning.
   sp::shared_ptr<KuduTable> table_;
 
@@ -285,6 +310,18 @@ class KuduScanner::Data {
                                 const MonoTime& overall_deadline,
                                 const MonoTime& rpc_deadline);
 
+  // Set up 'controller' for a scan RPC with the given overall deadline,
+  // returning the deadline of the RPC itself.
+  MonoTime PrepareScanRpc(const MonoTime& overall_deadline,
+                          bool allow_time_for_failover,
+                          rpc::RpcController* controller);
+
+  // Analyze the response of the last scan RPC, as left in 'last_response_'
+  // and 'controller_', and account for its rows if it succeeded.
+  ScanRpcStatus FinishScanRpc(const Status& rpc_status,
+                              const MonoTime& overall_deadline,
+                              const MonoTime& rpc_deadline);
+
   // Add additional details to the status message, such as number of retries,
   // original cause of the error, etc. Returns a cloned object.
   Status EnrichStatusMessage(Status s) const;
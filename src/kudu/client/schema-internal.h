@@ -17,6 +17,7 @@
 #ifndef KUDU_CLIENT_SCHEMA_INTERNAL_H
 #define KUDU_CLIENT_SCHEMA_INTERNAL_H
 
+#include <map>
 #include <string>
 
 #include <boost/optional/optional.hpp>
@@ -81,6 +82,7 @@ class KuduColumnSpec::Data {
   boost::optional<KuduColumnStorageAttributes::EncodingType> encoding;
   boost::optional<KuduColumnStorageAttributes::CompressionType> compression;
   boost::optional<int32_t> block_size;
+  std::map<ColumnAuxFileType, bool> aux_files;
   boost::optional<bool> nullable;
   bool primary_key;
   boost::optional<KuduValue*> default_val;  // Owned.
@@ -315,6 +315,16 @@ KuduColumnSpec* KuduColumnSpec::BlockSize(int32_t block_size) {
   return this;
 }
 
+KuduColumnSpec* KuduColumnSpec::SecondaryIndex(bool secondary_index) {
+  data_->aux_files[SECONDARY_INDEX_FILE] = secondary_index;
+  return this;
+}
+
+KuduColumnSpec* KuduColumnSpec::BloomFilter(bool bloom_filter) {
+  data_->aux_files[BLOOM_FILTER_FILE] = bloom_filter;
+  return this;
+}
+
 KuduColumnSpec* KuduColumnSpec::Precision(int8_t precision) {
   data_->precision = precision;
   return this;
@@ -480,6 +490,12 @@ Status KuduColumnSpec::ToColumnSchema(KuduColumnSchema* col) const {
                           data_->comment ? data_->comment.value() : "");
 #pragma GCC diagnostic pop
 
+  if (!data_->aux_files.empty()) {
+    ColumnSchemaDelta delta(data_->name);
+    delta.aux_files = data_->aux_files;
+    RETURN_NOT_OK(col->col_->ApplyDelta(delta));
+  }
+
   return Status::OK();
 }
 
@@ -516,6 +532,7 @@ Status KuduColumnSpec::ToColumnSchemaDelta(ColumnSchemaDelta* col_delta) const {
 
   col_delta->new_name = std::move(data_->rename_to);
   col_delta->cfile_block_size = std::move(data_->block_size);
+  col_delta->aux_files = std::move(data_->aux_files);
   col_delta->new_comment = std::move(data_->comment);
   return Status::OK();
 }
@@ -387,6 +387,38 @@ class KUDU_EXPORT KuduColumnSpec {
   /// @return Pointer to the modified object.
   KuduColumnSpec* BlockSize(int32_t block_size);
 
+  /// Set whether a secondary index is maintained for the column.
+  ///
+  /// When enabled, every flush and compaction writes an index mapping each
+  /// value of the column to the rows holding it, so that scans with equality
+  /// or IN-list predicates on the column can skip non-matching rows without
+  /// reading the column itself.
+  ///
+  /// @note Secondary indexes are only supported on non-primary-key columns
+  ///   of types that are allowed in a primary key. Rows written before the
+  ///   index is enabled via ALTER TABLE are indexed once they are compacted.
+  ///
+  /// @param [in] secondary_index
+  ///   Whether to maintain a secondary index for the column.
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* SecondaryIndex(bool secondary_index);
+
+  /// Set whether a bloom filter is maintained for the column.
+  ///
+  /// When enabled, every flush and compaction writes a bloom filter over the
+  /// values of the column, so that scans with equality or IN-list predicates
+  /// on the column can skip the data of rowsets which contain none of the
+  /// requested values. This is most useful for high-cardinality columns
+  /// which are not part of the primary key.
+  ///
+  /// @note Bloom filters are only supported on columns of types that are
+  ///   allowed in a primary key.
+  ///
+  /// @param [in] bloom_filter
+  ///   Whether to maintain a bloom filter for the column.
+  /// @return Pointer to the modified object.
+  KuduColumnSpec* BloomFilter(bool bloom_filter);
+
   /// @name Operations only relevant for decimal columns.
   ///
   ///@{
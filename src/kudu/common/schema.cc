@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <unordered_set>
 
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h" // IWYU pragma: keep
 #include "kudu/gutil/map-util.h"
@@ -110,10 +111,44 @@ string ColumnTypeAttributes::ToStringForType(DataType type) const {
 string ColumnStorageAttributes::ToString() const {
   const string cfile_block_size_str =
       cfile_block_size == 0 ? "" : Substitute(" $0", cfile_block_size);
-  return Substitute("$0 $1$2",
+  string aux_files_str;
+  for (ColumnAuxFileType type : aux_files) {
+    StrAppend(&aux_files_str, " ", ColumnAuxFileType_Name(type));
+  }
+  return Substitute("$0 $1$2$3",
                     EncodingType_Name(encoding),
                     CompressionType_Name(compression),
-                    cfile_block_size_str);
+                    cfile_block_size_str,
+                    aux_files_str);
+}
+
+Status ValidateColumnAuxFile(ColumnAuxFileType aux_type,
+                             const string& col_name,
+                             const TypeInfo* type_info,
+                             bool is_key) {
+  const char* desc;
+  switch (aux_type) {
+    case SECONDARY_INDEX_FILE:
+      // Key columns are already indexed by the rowset's key index.
+      if (is_key) {
+        return Status::InvalidArgument(Substitute(
+            "secondary index may not be specified on key column '$0'", col_name));
+      }
+      desc = "secondary index";
+      break;
+    case BLOOM_FILTER_FILE:
+      desc = "bloom filter";
+      break;
+    default:
+      return Status::InvalidArgument(Substitute(
+          "unknown auxiliary file type $0 on column '$1'", aux_type, col_name));
+  }
+  // Both kinds of file hold key-encoded values.
+  if (!IsTypeAllowableInKey(type_info)) {
+    return Status::InvalidArgument(Substitute(
+        "$0 is not supported on column '$1' of type $2", desc, col_name, type_info->name()));
+  }
+  return Status::OK();
 }
 
 Status ColumnSchema::ApplyDelta(const ColumnSchemaDelta& col_delta) {
@@ -150,6 +185,13 @@ Status ColumnSchema::ApplyDelta(const ColumnSchemaDelta& col_delta) {
   if (col_delta.cfile_block_size) {
     attributes_.cfile_block_size = *col_delta.cfile_block_size;
   }
+  for (const auto& e : col_delta.aux_files) {
+    if (e.second) {
+      attributes_.aux_files.insert(e.first);
+    } else {
+      attributes_.aux_files.erase(e.first);
+    }
+  }
   if (col_delta.new_comment) {
     comment_ = col_delta.new_comment.value();
   }
@@ -692,8 +734,15 @@ Status SchemaBuilder::ApplyColumnSchemaDelta(const ColumnSchemaDelta& col_delta)
     return Status::NotFound("The specified column does not exist", col_delta.name);
   }
 
-  for (ColumnSchema& col_schema : cols_) {
+  for (size_t i = 0; i < cols_.size(); i++) {
+    ColumnSchema& col_schema = cols_[i];
     if (col_delta.name == col_schema.name()) {
+      for (const auto& e : col_delta.aux_files) {
+        if (e.second) {
+          RETURN_NOT_OK(ValidateColumnAuxFile(e.first, col_schema.name(),
+                                              col_schema.type_info(), i < num_key_columns_));
+        }
+      }
       RETURN_NOT_OK(col_schema.ApplyDelta(col_delta));
       if (col_delta.new_name) {
         // TODO(wdb): Should the old one stay, marked as an alias?
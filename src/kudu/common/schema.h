@@ -20,8 +20,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <ostream>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -151,14 +153,33 @@ struct ColumnStorageAttributes {
 
   std::string ToString() const;
 
+  bool has_aux_file(ColumnAuxFileType type) const {
+    return aux_files.count(type) > 0;
+  }
+
   EncodingType encoding;
   CompressionType compression;
 
   // The preferred block size for cfile blocks. If 0, uses the
   // server-wide default.
   int32_t cfile_block_size;
+
+  // The auxiliary files which flushes and compactions write over the base
+  // data of this column, e.g. a secondary index allowing equality and
+  // IN-list predicates to skip non-matching rows, or a bloom filter allowing
+  // them to skip whole rowsets. See ValidateColumnAuxFile() for the columns
+  // which may carry each type.
+  std::set<ColumnAuxFileType> aux_files;
 };
 
+// Returns an error if the column 'col_name' of type 'type_info' may not carry
+// an auxiliary file of type 'aux_type'. 'is_key' is whether the column is part
+// of the primary key.
+Status ValidateColumnAuxFile(ColumnAuxFileType aux_type,
+                             const std::string& col_name,
+                             const TypeInfo* type_info,
+                             bool is_key);
+
 // A struct representing changes to a ColumnSchema.
 //
 // In the future, as more complex alter operations need to be supported,
@@ -189,6 +210,9 @@ public:
   boost::optional<CompressionType> compression;
   boost::optional<int32_t> cfile_block_size;
 
+  // Auxiliary files to add to (true) or drop from (false) the column.
+  std::map<ColumnAuxFileType, bool> aux_files;
+
   boost::optional<std::string> new_comment;
 };
 
@@ -235,6 +235,9 @@ void ColumnSchemaToPB(const ColumnSchema& col_schema, ColumnSchemaPB *pb, int fl
     pb->set_encoding(col_schema.attributes().encoding);
     pb->set_compression(col_schema.attributes().compression);
     pb->set_cfile_block_size(col_schema.attributes().cfile_block_size);
+    for (ColumnAuxFileType aux_type : col_schema.attributes().aux_files) {
+      pb->add_aux_files(aux_type);
+    }
   }
   if (col_schema.has_read_default()) {
     if (col_schema.type_info()->physical_type() == BINARY) {
@@ -316,6 +319,9 @@ Status ColumnSchemaFromPB(const ColumnSchemaPB& pb, boost::optional<ColumnSchema
   if (pb.has_cfile_block_size()) {
     attributes.cfile_block_size = pb.cfile_block_size();
   }
+  for (int i = 0; i < pb.aux_files_size(); i++) {
+    attributes.aux_files.insert(pb.aux_files(i));
+  }
 
   // According to the URL below, the default value for strings that are optional
   // in protobuf is the empty string. So, it's safe to use pb.comment() directly
@@ -349,6 +355,13 @@ void ColumnSchemaDeltaToPB(const ColumnSchemaDelta& col_delta, ColumnSchemaDelta
   if (col_delta.cfile_block_size) {
     pb->set_block_size(*col_delta.cfile_block_size);
   }
+  for (const auto& e : col_delta.aux_files) {
+    if (e.second) {
+      pb->add_add_aux_files(e.first);
+    } else {
+      pb->add_drop_aux_files(e.first);
+    }
+  }
   if (col_delta.new_comment) {
     pb->set_new_comment(*col_delta.new_comment);
   }
@@ -374,6 +387,12 @@ ColumnSchemaDelta ColumnSchemaDeltaFromPB(const ColumnSchemaDeltaPB& pb) {
   if (pb.has_block_size()) {
     col_delta.cfile_block_size = boost::optional<int32_t>(pb.block_size());
   }
+  for (int i = 0; i < pb.add_aux_files_size(); i++) {
+    col_delta.aux_files[pb.add_aux_files(i)] = true;
+  }
+  for (int i = 0; i < pb.drop_aux_files_size(); i++) {
+    col_delta.aux_files[pb.drop_aux_files(i)] = false;
+  }
   if (pb.has_new_comment()) {
     col_delta.new_comment = boost::optional<string>(pb.new_comment());
   }
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/fs/dir_manager.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
@@ -170,11 +171,14 @@ class ReadableBlock : public Block {
 };
 
 // Provides options and hints for block placement. This is used for identifying
-// the correct DataDirGroups to place blocks. In the future this may also be
-// used to specify directories based on block type (e.g. to prefer bloom block
-// placement into SSD-backed directories).
+// the correct DataDirGroups to place blocks, and the tier of storage media to
+// prefer within them.
 struct CreateBlockOptions {
   const std::string tablet_id;
+
+  // The tier of data directory to place the block in, if the tablet's data
+  // dir group has room in a directory of that tier. Defaults to ANY.
+  StorageTier tier;
 };
 
 // Block manager creation options.
@@ -67,6 +67,7 @@ DECLARE_int64(disk_reserved_bytes_free_for_testing);
 DECLARE_int64(fs_data_dirs_reserved_bytes);
 DECLARE_string(env_inject_eio_globs);
 DECLARE_string(env_inject_full_globs);
+DECLARE_string(fs_data_dirs_fast_tier);
 
 METRIC_DECLARE_gauge_uint64(data_dirs_failed);
 
@@ -351,6 +352,69 @@ TEST_F(DataDirsTest, TestFailedDirNotAddedToGroup) {
   ASSERT_TRUE(s.IsIOError());
 }
 
+TEST_F(DataDirsTest, TestTieredPlacement) {
+  // Put the first two dirs in the fast tier.
+  vector<string> dir_names = GetDirNames(kNumDirs);
+  FLAGS_fs_data_dirs_fast_tier = JoinStrings({ dir_names[0], dir_names[1] }, ",");
+  FLAGS_fs_target_data_dirs_per_tablet = 3;
+  dd_manager_.reset();
+  DataDirManagerOptions opts;
+  opts.metric_entity = entity_;
+  ASSERT_OK(DataDirManager::OpenExistingForTests(env_, dir_names, opts, &dd_manager_));
+  vector<int> slow_indices;
+  for (const auto& e : dd_manager_->dir_by_uuid_idx_) {
+    if (e.second->tier() == StorageTier::SLOW) {
+      slow_indices.push_back(e.first);
+    }
+  }
+  ASSERT_EQ(kNumDirs - 2, slow_indices.size());
+
+  // Every new group gets a fast dir, which blocks asking for the fast tier
+  // are placed in.
+  for (int i = 0; i < 10; i++) {
+    const string tablet_id = Substitute("$0-$1", test_tablet_name_, i);
+    ASSERT_OK(dd_manager_->CreateDataDirGroup(tablet_id));
+    for (StorageTier tier : { StorageTier::FAST, StorageTier::SLOW }) {
+      Dir* dd;
+      ASSERT_OK(dd_manager_->GetDirAddIfNecessary(CreateBlockOptions({ tablet_id, tier }), &dd));
+      ASSERT_EQ(tier, dd->tier());
+    }
+  }
+
+  // A group with only slow dirs, e.g. one created before the fast tier was
+  // configured, gains a fast dir once a block asks for one.
+  DataDirGroupPB pb;
+  for (int i = 0; i < 3; i++) {
+    pb.add_uuids(FindOrDie(dd_manager_->uuid_by_idx_, slow_indices[i]));
+  }
+  ASSERT_OK(dd_manager_->LoadDataDirGroupFromPB(test_tablet_name_, pb));
+  Dir* dd;
+  ASSERT_OK(dd_manager_->GetDirAddIfNecessary(CreateBlockOptions({ test_tablet_name_ }), &dd));
+  ASSERT_EQ(StorageTier::SLOW, dd->tier());
+  ASSERT_OK(dd_manager_->GetDirAddIfNecessary(
+      CreateBlockOptions({ test_tablet_name_, StorageTier::FAST }), &dd));
+  ASSERT_EQ(StorageTier::FAST, dd->tier());
+  ASSERT_OK(dd_manager_->GetDataDirGroupPB(test_tablet_name_, &pb));
+  ASSERT_EQ(4, pb.uuids_size());
+}
+
+// Without any dirs in the fast tier, blocks asking for it are placed in the
+// group's slow dirs, which isn't grown for them.
+TEST_F(DataDirsTest, TestNoDirsInRequestedTier) {
+  FLAGS_fs_target_data_dirs_per_tablet = 3;
+  ASSERT_FALSE(dd_manager_->HasDirsInTier(StorageTier::FAST));
+  ASSERT_OK(dd_manager_->CreateDataDirGroup(test_tablet_name_));
+  for (int i = 0; i < 10; i++) {
+    Dir* dd;
+    ASSERT_OK(dd_manager_->GetDirAddIfNecessary(
+        CreateBlockOptions({ test_tablet_name_, StorageTier::FAST }), &dd));
+    ASSERT_EQ(StorageTier::SLOW, dd->tier());
+  }
+  DataDirGroupPB pb;
+  ASSERT_OK(dd_manager_->GetDataDirGroupPB(test_tablet_name_, &pb));
+  ASSERT_EQ(3, pb.uuids_size());
+}
+
 TEST_F(DataDirsTest, TestLoadBalancingDistribution) {
   FLAGS_fs_target_data_dirs_per_tablet = 3;
   const double kNumTablets = 20;
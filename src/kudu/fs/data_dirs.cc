@@ -38,14 +38,18 @@
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/dir_util.h"
 #include "kudu/fs/fs.pb.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/integral_types.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/status.h"
@@ -92,6 +96,17 @@ DEFINE_bool(fs_data_dirs_consider_available_space, true,
 TAG_FLAG(fs_data_dirs_consider_available_space, runtime);
 TAG_FLAG(fs_data_dirs_consider_available_space, evolving);
 
+DEFINE_string(fs_data_dirs_fast_tier, "",
+              "Comma-separated list of the data directories, as given in "
+              "--fs_data_dirs or --fs_wal_dir, which are on fast storage media "
+              "such as SSDs. All other data directories are considered to be "
+              "on slow media. Every tablet's data dir group includes a fast "
+              "data directory if one is available, and newly flushed data is "
+              "placed on the fast tier, while rowsets which haven't been read "
+              "in a while are moved to the slow tier when compacted.");
+TAG_FLAG(fs_data_dirs_fast_tier, advanced);
+TAG_FLAG(fs_data_dirs_fast_tier, experimental);
+
 DEFINE_uint64(fs_max_thread_count_per_data_dir, 8,
               "Maximum work thread per data directory.");
 TAG_FLAG(fs_max_thread_count_per_data_dir, advanced);
@@ -107,6 +122,34 @@ METRIC_DEFINE_gauge_uint64(server, data_dirs_full,
                            kudu::MetricUnit::kDataDirectories,
                            "Number of data directories whose disks are currently full",
                            kudu::MetricLevel::kWarn);
+METRIC_DEFINE_histogram(server, data_dirs_io_queue_time_foreground,
+                        "Foreground I/O Queue Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time that block I/O issued by scans and other reads on behalf of "
+                        "clients spent queued behind other I/O to its data directory",
+                        kudu::MetricLevel::kDebug,
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, data_dirs_io_queue_time_flush,
+                        "Flush I/O Queue Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time that block I/O issued by flushes of in-memory stores spent queued "
+                        "behind other I/O to its data directory",
+                        kudu::MetricLevel::kDebug,
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, data_dirs_io_queue_time_compaction,
+                        "Compaction I/O Queue Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time that block I/O issued by compactions and other background "
+                        "maintenance spent queued behind other I/O to its data directory",
+                        kudu::MetricLevel::kDebug,
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, data_dirs_io_queue_time_copy,
+                        "Tablet Copy I/O Queue Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time that block I/O issued by tablet copies spent queued "
+                        "behind other I/O to its data directory",
+                        kudu::MetricLevel::kDebug,
+                        60000000LU, 2);
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_string(block_manager);
@@ -134,10 +177,17 @@ using strings::SubstituteAndAppend;
 ////////////////////////////////////////////////////////////
 
 #define GINIT(member, x) member = METRIC_##x.Instantiate(metric_entity, 0)
+#define HINIT(c, x) io_scheduler.queue_time_us[static_cast<int>(IOClass::c)] = \
+    METRIC_data_dirs_io_queue_time_##x.Instantiate(metric_entity)
 DataDirMetrics::DataDirMetrics(const scoped_refptr<MetricEntity>& metric_entity) {
   GINIT(dirs_failed, data_dirs_failed);
   GINIT(dirs_full, data_dirs_full);
+  HINIT(FOREGROUND, foreground);
+  HINIT(FLUSH, flush);
+  HINIT(COMPACTION, compaction);
+  HINIT(COPY, copy);
 }
+#undef HINIT
 #undef GINIT
 
 ////////////////////////////////////////////////////////////
@@ -186,16 +236,46 @@ Status DataDirGroup::CopyToPB(const UuidByUuidIndexMap& uuid_by_uuid_idx,
 // DataDir
 ////////////////////////////////////////////////////////////
 
-DataDir::DataDir(Env* env, DirMetrics* metrics, FsType fs_type, std::string dir,
+namespace {
+
+// Returns the tier of the data directory 'dir', as configured by
+// --fs_data_dirs_fast_tier.
+StorageTier GetDataDirTier(Env* env, const string& dir) {
+  vector<string> fast_roots = strings::Split(FLAGS_fs_data_dirs_fast_tier, ",",
+                                             strings::SkipEmpty());
+  for (const auto& root : fast_roots) {
+    // The data directory is a subdirectory of its canonicalized root.
+    string canonicalized_root;
+    if (!env->Canonicalize(root, &canonicalized_root).ok()) {
+      canonicalized_root = root;
+    }
+    if (dir == JoinPathSegments(canonicalized_root, kDataDirName)) {
+      return StorageTier::FAST;
+    }
+  }
+  return StorageTier::SLOW;
+}
+
+} // anonymous namespace
+
+DataDir::DataDir(Env* env, DirMetrics* metrics, FsType fs_type, StorageTier tier,
+                 std::string dir,
                  std::unique_ptr<DirInstanceMetadataFile> metadata_file,
                  std::unique_ptr<ThreadPool> pool)
-    : Dir(env, metrics, fs_type, std::move(dir), std::move(metadata_file), std::move(pool)) {}
+    : Dir(env, metrics, fs_type, std::move(dir), std::move(metadata_file), std::move(pool)),
+      tier_(tier) {
+  DCHECK(tier_ != StorageTier::ANY);
+}
 
 std::unique_ptr<Dir> DataDirManager::CreateNewDir(
     Env* env, DirMetrics* metrics, FsType fs_type,
     std::string dir, std::unique_ptr<DirInstanceMetadataFile> metadata_file,
     std::unique_ptr<ThreadPool> pool) {
-  return unique_ptr<Dir>(new DataDir(env, metrics, fs_type, std::move(dir),
+  StorageTier tier = GetDataDirTier(env, dir);
+  if (tier == StorageTier::FAST) {
+    LOG(INFO) << Substitute("Data directory $0 is on the fast storage tier", dir);
+  }
+  return unique_ptr<Dir>(new DataDir(env, metrics, fs_type, tier, std::move(dir),
                                      std::move(metadata_file), std::move(pool)));
 }
 
@@ -220,7 +300,9 @@ DataDirManager::DataDirManager(Env* env,
     : DirManager(env, opts.metric_entity ?
                           unique_ptr<DirMetrics>(new DataDirMetrics(opts.metric_entity)) : nullptr,
                  FLAGS_fs_max_thread_count_per_data_dir,
-                 opts, std::move(canonicalized_data_roots)) {}
+                 opts, std::move(canonicalized_data_roots)),
+      num_fast_dirs_(0),
+      num_slow_dirs_(0) {}
 
 Status DataDirManager::OpenExistingForTests(Env* env,
                                             vector<string> data_fs_roots,
@@ -277,6 +359,15 @@ int DataDirManager::max_dirs() const {
 }
 
 Status DataDirManager::PopulateDirectoryMaps(const vector<unique_ptr<Dir>>& dirs) {
+  num_fast_dirs_ = 0;
+  num_slow_dirs_ = 0;
+  for (const auto& dd : dirs) {
+    if (dd->tier() == StorageTier::FAST) {
+      num_fast_dirs_++;
+    } else {
+      num_slow_dirs_++;
+    }
+  }
   if (opts_.dir_type == "log") {
     return DirManager::PopulateDirectoryMaps(dirs);
   }
@@ -462,6 +553,18 @@ Status DataDirManager::GetDirForBlock(const CreateBlockOptions& opts, Dir** dir,
                    opts.tablet_id, num_total, num_failed, num_full),
         "", ENOSPC);
   }
+  // Prefer the directories in the requested tier, if any.
+  if (opts.tier != StorageTier::ANY && HasDirsInTier(opts.tier)) {
+    vector<Dir*> tier_dirs;
+    for (Dir* candidate : candidate_dirs) {
+      if (candidate->tier() == opts.tier) {
+        tier_dirs.emplace_back(candidate);
+      }
+    }
+    if (!tier_dirs.empty()) {
+      candidate_dirs = std::move(tier_dirs);
+    }
+  }
   if (candidate_dirs.size() == 1) {
     *dir = candidate_dirs[0];
     return Status::OK();
@@ -475,6 +578,30 @@ Status DataDirManager::GetDirForBlock(const CreateBlockOptions& opts, Dir** dir,
   return Status::OK();
 }
 
+bool DataDirManager::HasAvailableDirOutsideGroup(const string& tablet_id,
+                                                 StorageTier tier) const {
+  shared_lock<rw_spinlock> lock(dir_group_lock_.get_lock());
+  const DataDirGroup* group = FindOrNull(group_by_tablet_map_, tablet_id);
+  if (group == nullptr) {
+    return false;
+  }
+  unordered_set<int> group_indices(group->uuid_indices().begin(), group->uuid_indices().end());
+  for (const auto& e : dir_by_uuid_idx_) {
+    if (e.second->tier() == tier &&
+        !ContainsKey(group_indices, e.first) &&
+        !ContainsKey(failed_dirs_, e.first) &&
+        !e.second->is_full()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DataDirManager::HasDirsInTier(StorageTier tier) const {
+  DCHECK(tier != StorageTier::ANY);
+  return (tier == StorageTier::FAST ? num_fast_dirs_ : num_slow_dirs_) > 0;
+}
+
 void DataDirManager::DeleteDataDirGroup(const std::string& tablet_id) {
   std::lock_guard<percpu_rwlock> lock(dir_group_lock_);
   DataDirGroup* group = FindOrNull(group_by_tablet_map_, tablet_id);
@@ -503,10 +630,41 @@ Status DataDirManager::GetDataDirGroupPB(const string& tablet_id,
 Status DataDirManager::GetDirAddIfNecessary(const CreateBlockOptions& opts, Dir** dir) {
   int new_target_group_size = 0;
   Status s = GetDirForBlock(opts, dir, &new_target_group_size);
+  const string& tablet_id = opts.tablet_id;
   if (PREDICT_TRUE(s.ok())) {
+    // Unless some dirs are in the requested tier, e.g. when asking for the
+    // fast tier without any configured, there is no dir of that tier to add.
+    if (opts.tier == StorageTier::ANY || (*dir)->tier() == opts.tier ||
+        !HasDirsInTier(opts.tier) || tablet_id.empty() ||
+        !HasAvailableDirOutsideGroup(tablet_id, opts.tier)) {
+      return Status::OK();
+    }
+    // The group has no room in the requested tier, but another directory in
+    // that tier does; add it to the group.
+    std::lock_guard<percpu_rwlock> l(dir_group_lock_);
+    vector<int> group_uuid_indices = FindOrDie(group_by_tablet_map_, tablet_id).uuid_indices();
+    for (int uuid_idx : group_uuid_indices) {
+      // Another thread may have added one in the meantime.
+      Dir* candidate = FindOrDie(dir_by_uuid_idx_, uuid_idx);
+      if (candidate->tier() == opts.tier && !candidate->is_full() &&
+          !ContainsKey(failed_dirs_, uuid_idx)) {
+        *dir = candidate;
+        return Status::OK();
+      }
+    }
+    size_t old_group_size = group_uuid_indices.size();
+    GetDirsForGroupUnlocked(old_group_size + 1, &group_uuid_indices, opts.tier);
+    if (group_uuid_indices.size() == old_group_size) {
+      return Status::OK();
+    }
+    int new_uuid_idx = group_uuid_indices.back();
+    InsertOrDie(&FindOrDie(tablets_by_uuid_idx_map_, new_uuid_idx), tablet_id);
+    CHECK(!EmplaceOrUpdate(&group_by_tablet_map_, tablet_id, DataDirGroup(group_uuid_indices)));
+    *dir = FindOrDie(dir_by_uuid_idx_, new_uuid_idx);
+    LOG(INFO) << Substitute("Added $0 to $1's directory group for $2 tier placement",
+                            (*dir)->dir(), tablet_id, StorageTierToString(opts.tier));
     return Status::OK();
   }
-  const string& tablet_id = opts.tablet_id;
   if (tablet_id.empty()) {
     // This should only be reached by some tests; in cases where there is no
     // natural tablet_id. Just return whatever error we got.
@@ -558,18 +716,25 @@ Status DataDirManager::GetDirAddIfNecessary(const CreateBlockOptions& opts, Dir*
 }
 
 void DataDirManager::GetDirsForGroupUnlocked(int target_size,
-                                             vector<int>* group_indices) {
+                                             vector<int>* group_indices,
+                                             StorageTier tier) {
   DCHECK(dir_group_lock_.is_locked());
   vector<int> candidate_indices;
+  vector<int> fast_candidate_indices;
+  bool group_has_fast_dir = false;
   unordered_set<int> existing_group_indices(group_indices->begin(), group_indices->end());
   for (auto& e : dir_by_uuid_idx_) {
     int uuid_idx = e.first;
     DCHECK_LT(uuid_idx, dirs_.size());
-    if (ContainsKey(existing_group_indices, uuid_idx) ||
-        ContainsKey(failed_dirs_, uuid_idx)) {
+    Dir* dd = e.second;
+    if (ContainsKey(existing_group_indices, uuid_idx)) {
+      group_has_fast_dir |= dd->tier() == StorageTier::FAST;
+      continue;
+    }
+    if (ContainsKey(failed_dirs_, uuid_idx) ||
+        (tier != StorageTier::ANY && dd->tier() != tier)) {
       continue;
     }
-    Dir* dd = e.second;
     Status s = dd->RefreshAvailableSpace(Dir::RefreshMode::ALWAYS);
     WARN_NOT_OK(s, Substitute("failed to refresh fullness of $0", dd->dir()));
     if (s.ok() && !dd->is_full()) {
@@ -577,31 +742,46 @@ void DataDirManager::GetDirsForGroupUnlocked(int target_size,
       // resulting group may be below targeted size. Add functionality to
       // resize groups. See KUDU-2040 for more details.
       candidate_indices.push_back(uuid_idx);
+      if (dd->tier() == StorageTier::FAST) {
+        fast_candidate_indices.push_back(uuid_idx);
+      }
     }
   }
+  if (!group_has_fast_dir && !fast_candidate_indices.empty() &&
+      group_indices->size() < target_size) {
+    int uuid_idx = SelectDirForGroupUnlocked(&fast_candidate_indices);
+    group_indices->push_back(uuid_idx);
+    candidate_indices.erase(std::find(candidate_indices.begin(), candidate_indices.end(),
+                                      uuid_idx));
+  }
   while (group_indices->size() < target_size && !candidate_indices.empty()) {
-    shuffle(candidate_indices.begin(), candidate_indices.end(), default_random_engine(rng_.Next()));
-    if (candidate_indices.size() == 1) {
-      group_indices->push_back(candidate_indices[0]);
-      candidate_indices.erase(candidate_indices.begin());
+    group_indices->push_back(SelectDirForGroupUnlocked(&candidate_indices));
+  }
+}
+
+int DataDirManager::SelectDirForGroupUnlocked(vector<int>* candidate_indices) {
+  DCHECK(dir_group_lock_.is_locked());
+  DCHECK(!candidate_indices->empty());
+  shuffle(candidate_indices->begin(), candidate_indices->end(),
+          default_random_engine(rng_.Next()));
+  int selected_index = 0;
+  if (candidate_indices->size() > 1) {
+    int tablets_in_first = FindOrDie(tablets_by_uuid_idx_map_, (*candidate_indices)[0]).size();
+    int tablets_in_second = FindOrDie(tablets_by_uuid_idx_map_, (*candidate_indices)[1]).size();
+    if (tablets_in_first == tablets_in_second &&
+        PREDICT_TRUE(FLAGS_fs_data_dirs_consider_available_space)) {
+      int64_t space_in_first = FindOrDie(dir_by_uuid_idx_,
+                                         (*candidate_indices)[0])->available_bytes();
+      int64_t space_in_second = FindOrDie(dir_by_uuid_idx_,
+                                          (*candidate_indices)[1])->available_bytes();
+      selected_index = space_in_first > space_in_second ? 0 : 1;
     } else {
-      int tablets_in_first = FindOrDie(tablets_by_uuid_idx_map_, candidate_indices[0]).size();
-      int tablets_in_second = FindOrDie(tablets_by_uuid_idx_map_, candidate_indices[1]).size();
-      int selected_index = 0;
-      if (tablets_in_first == tablets_in_second &&
-          PREDICT_TRUE(FLAGS_fs_data_dirs_consider_available_space)) {
-        int64_t space_in_first = FindOrDie(dir_by_uuid_idx_,
-                                           candidate_indices[0])->available_bytes();
-        int64_t space_in_second = FindOrDie(dir_by_uuid_idx_,
-                                            candidate_indices[1])->available_bytes();
-        selected_index = space_in_first > space_in_second ? 0 : 1;
-      } else {
-        selected_index = tablets_in_first < tablets_in_second ? 0 : 1;
-      }
-      group_indices->push_back(candidate_indices[selected_index]);
-      candidate_indices.erase(candidate_indices.begin() + selected_index);
+      selected_index = tablets_in_first < tablets_in_second ? 0 : 1;
     }
   }
+  int uuid_idx = (*candidate_indices)[selected_index];
+  candidate_indices->erase(candidate_indices->begin() + selected_index);
+  return uuid_idx;
 }
 
 Status DataDirManager::FindDataDirsByTabletId(const string& tablet_id,
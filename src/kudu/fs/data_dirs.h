@@ -92,12 +92,17 @@ class DataDir : public Dir {
   DataDir(Env* env,
           DirMetrics* metrics,
           FsType fs_type,
+          StorageTier tier,
           std::string dir,
           std::unique_ptr<DirInstanceMetadataFile> metadata_file,
           std::unique_ptr<ThreadPool> pool);
 
   int available_space_cache_secs() const override;
   int reserved_bytes() const override;
+  StorageTier tier() const override { return tier_; }
+
+ private:
+  const StorageTier tier_;
 };
 
 struct DataDirManagerOptions : public DirManagerOptions {
@@ -175,6 +180,10 @@ class DataDirManager : public DirManager {
   // Returns a dir for block placement in the data dir group specified in
   // 'opts'. If none exists, adds a new dir to the group and returns the dir,
   // and if none can be added, returns an error.
+  //
+  // If 'opts' asks for a tier which none of the group's available dirs are
+  // in, a dir of that tier is added to the group if there is one with room;
+  // otherwise a dir of another tier is returned.
   Status GetDirAddIfNecessary(const CreateBlockOptions& opts, Dir** dir);
 
   // Returns in 'data_dirs' a sorted list of the directory names for the data
@@ -196,6 +205,8 @@ class DataDirManager : public DirManager {
   FRIEND_TEST(DataDirsTest, TestLoadBalancingBias);
   FRIEND_TEST(DataDirsTest, TestLoadBalancingDistribution);
   FRIEND_TEST(DataDirsTest, TestFailedDirNotAddedToGroup);
+  FRIEND_TEST(DataDirsTest, TestTieredPlacement);
+  FRIEND_TEST(DataDirsTest, TestNoDirsInRequestedTier);
 
   // Populates the maps to index the given directories.
   Status PopulateDirectoryMaps(const std::vector<std::unique_ptr<Dir>>& dirs) override;
@@ -218,12 +229,20 @@ class DataDirManager : public DirManager {
                  CanonicalizedRootsList canonicalized_data_roots);
 
   // Returns a random directory in the data dir group specified in 'opts',
-  // giving preference to those with more free space. If there is no room in
-  // the group, returns an IOError with the ENOSPC posix code and returns the
-  // new target size for the data dir group.
+  // giving preference to those in the tier asked for by 'opts' and then to
+  // those with more free space. If there is no room in the group, returns an
+  // IOError with the ENOSPC posix code and returns the new target size for
+  // the data dir group.
   Status GetDirForBlock(const CreateBlockOptions& opts, Dir** dir,
                         int* new_target_group_size) const;
 
+  // Whether any healthy dir outside of the data dir group for 'tablet_id' is
+  // in 'tier' and has room for blocks.
+  bool HasAvailableDirOutsideGroup(const std::string& tablet_id, StorageTier tier) const;
+
+  // Whether any dir, failed or not, is in 'tier', which must not be ANY.
+  bool HasDirsInTier(StorageTier tier) const;
+
   // Repeatedly selects directories from those available to put into a new
   // DataDirGroup until 'group_indices' reaches 'target_size' elements.
   //
@@ -234,12 +253,23 @@ class DataDirManager : public DirManager {
   // resulting behavior fills directories that have fewer tablets stored on
   // them while not completely neglecting those with more tablets.
   //
+  // If there are dirs in the fast tier and 'group_indices' has none, the
+  // first dir selected is from the fast tier, so that every tablet can place
+  // new data on fast media.
+  //
+  // If 'tier' is not ANY, only dirs in that tier are considered.
+  //
   // 'group_indices' is an in/out parameter that stores the list of UUID
   // indices to be added; UUID indices that are already in 'group_indices' are
   // not considered. Although this function does not itself change
   // DataDirManager state, its expected usage warrants that it is called within
   // the scope of a lock_guard of dir_group_lock_.
-  void GetDirsForGroupUnlocked(int target_size, std::vector<int>* group_indices);
+  void GetDirsForGroupUnlocked(int target_size, std::vector<int>* group_indices,
+                               StorageTier tier = StorageTier::ANY);
+
+  // Removes one of 'candidate_indices', selected as described above, and
+  // returns it. 'candidate_indices' must not be empty.
+  int SelectDirForGroupUnlocked(std::vector<int>* candidate_indices);
 
   // Goes through the data dirs in 'uuid_indices' and populates
   // 'healthy_indices' with those that haven't failed.
@@ -249,6 +279,11 @@ class DataDirManager : public DirManager {
   typedef std::unordered_map<std::string, internal::DataDirGroup> TabletDataDirGroupMap;
   TabletDataDirGroupMap group_by_tablet_map_;
 
+  // Number of dirs in the fast and slow tiers. Dirs don't change tiers, so
+  // these are counted once, when the dirs are opened.
+  int num_fast_dirs_;
+  int num_slow_dirs_;
+
   DISALLOW_COPY_AND_ASSIGN(DataDirManager);
 };
 
@@ -71,6 +71,16 @@ void DeleteTmpFilesRecursively(Env* env, const string& path) {
 } // anonymous namespace
 namespace fs {
 
+const char* StorageTierToString(StorageTier tier) {
+  switch (tier) {
+    case StorageTier::ANY: return "any";
+    case StorageTier::FAST: return "fast";
+    case StorageTier::SLOW: return "slow";
+  }
+  LOG(FATAL) << "unknown storage tier: " << static_cast<int>(tier);
+  return nullptr;
+}
+
 Dir::Dir(Env* env,
          DirMetrics* metrics,
          FsType fs_type,
@@ -83,6 +93,7 @@ Dir::Dir(Env* env,
       dir_(std::move(dir)),
       metadata_file_(std::move(metadata_file)),
       pool_(std::move(pool)),
+      io_scheduler_(IOScheduler::CreateFromFlags(metrics ? &metrics->io_scheduler : nullptr)),
       is_shutdown_(false),
       is_full_(false),
       available_bytes_(0) {
@@ -26,6 +26,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -76,6 +77,7 @@ enum UpdateInstanceBehavior {
 struct DirMetrics {
   scoped_refptr<AtomicGauge<uint64_t>> dirs_failed;
   scoped_refptr<AtomicGauge<uint64_t>> dirs_full;
+  IOSchedulerMetrics io_scheduler;
 };
 
 // Detected type of filesystem.
@@ -90,6 +92,21 @@ enum class FsType {
   OTHER
 };
 
+// The tiers of storage media which directories may be on.
+enum class StorageTier {
+  // No particular tier. Used when requesting a directory to mean that any
+  // tier will do.
+  ANY,
+
+  // Fast media, e.g. SSDs.
+  FAST,
+
+  // Slow media, e.g. spinning disks.
+  SLOW,
+};
+
+const char* StorageTierToString(StorageTier tier);
+
 // Representation of a directory (e.g. a data directory).
 class Dir {
  public:
@@ -138,6 +155,10 @@ class Dir {
     return metadata_file_.get();
   }
 
+  // The scheduler of block I/O to this directory, or null if I/O scheduling
+  // is disabled.
+  IOScheduler* io_scheduler() const { return io_scheduler_.get(); }
+
   bool is_full() const {
     std::lock_guard<simple_spinlock> l(lock_);
     return is_full_;
@@ -156,6 +177,9 @@ class Dir {
   // value of -1 means 1% of the disk space in a directory will be reserved.
   virtual int reserved_bytes() const = 0;
 
+  // The tier of storage media the directory is on. Never ANY.
+  virtual StorageTier tier() const = 0;
+
  private:
   Env* env_;
   DirMetrics* metrics_;
@@ -163,6 +187,7 @@ class Dir {
   const std::string dir_;
   const std::unique_ptr<DirInstanceMetadataFile> metadata_file_;
   const std::unique_ptr<ThreadPool> pool_;
+  const std::unique_ptr<IOScheduler> io_scheduler_;
 
   bool is_shutdown_;
 
@@ -36,6 +36,7 @@
 #include "kudu/fs/dir_manager.h"
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/fs_report.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/integral_types.h"
@@ -340,16 +341,19 @@ Status FileWritableBlock::Append(const Slice& data) {
 
 Status FileWritableBlock::AppendV(ArrayView<const Slice> data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY) << "Invalid state: " << state_;
-  RETURN_NOT_OK_HANDLE_ERROR(writer_->AppendV(data));
-  RETURN_NOT_OK_HANDLE_ERROR(location_.data_dir()->RefreshAvailableSpace(
-      Dir::RefreshMode::ALWAYS));
-  state_ = DIRTY;
-
   // Calculate the amount of data written
   size_t bytes_written = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
                                     [&](int sum, const Slice& curr) {
                                       return sum + curr.size();
                                     });
+  {
+    IOScheduler::ScopedIO io(location_.data_dir()->io_scheduler(), bytes_written);
+    RETURN_NOT_OK_HANDLE_ERROR(writer_->AppendV(data));
+  }
+  RETURN_NOT_OK_HANDLE_ERROR(location_.data_dir()->RefreshAvailableSpace(
+      Dir::RefreshMode::ALWAYS));
+  state_ = DIRTY;
+
   bytes_appended_ += bytes_written;
   return Status::OK();
 }
@@ -396,6 +400,7 @@ Status FileWritableBlock::Close(SyncMode mode) {
     VLOG(3) << "Syncing block " << id();
     if (FLAGS_enable_data_block_fsync) {
       if (block_manager_->metrics_) block_manager_->metrics_->total_disk_sync->Increment();
+      IOScheduler::ScopedIO io(location_.data_dir()->io_scheduler(), 0);
       sync = writer_->Sync();
     }
     if (sync.ok()) {
@@ -464,6 +469,9 @@ class FileReadableBlock : public ReadableBlock {
   // The underlying opened file backing this block.
   shared_ptr<RandomAccessFile> reader_;
 
+  // The I/O scheduler of the block's data directory, if any.
+  IOScheduler* io_scheduler_;
+
   // Whether or not this block has been closed. Close() is thread-safe, so
   // this must be an atomic primitive.
   AtomicBool closed_;
@@ -484,7 +492,13 @@ FileReadableBlock::FileReadableBlock(FileBlockManager* block_manager,
     : block_manager_(block_manager),
       block_id_(block_id),
       reader_(std::move(reader)),
+      io_scheduler_(nullptr),
       closed_(false) {
+  const Dir* dir = block_manager_->dd_manager_->FindDirByUuidIndex(
+      internal::FileBlockLocation::GetDirIdx(block_id_));
+  if (dir) {
+    io_scheduler_ = dir->io_scheduler();
+  }
   if (block_manager_->metrics_) {
     block_manager_->metrics_->blocks_open_reading->Increment();
     block_manager_->metrics_->total_readable_blocks->Increment();
@@ -529,14 +543,17 @@ Status FileReadableBlock::Read(uint64_t offset, Slice result) const {
 Status FileReadableBlock::ReadV(uint64_t offset, ArrayView<Slice> results) const {
   DCHECK(!closed_.Load());
 
-  RETURN_NOT_OK_HANDLE_ERROR(reader_->ReadV(offset, results));
+  // Calculate the read amount of data
+  size_t bytes_read = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
+                                 [&](int sum, const Slice& curr) {
+                                   return sum + curr.size();
+                                 });
+  {
+    IOScheduler::ScopedIO io(io_scheduler_, bytes_read);
+    RETURN_NOT_OK_HANDLE_ERROR(reader_->ReadV(offset, results));
+  }
 
   if (block_manager_->metrics_) {
-    // Calculate the read amount of data
-    size_t bytes_read = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
-                                   [&](int sum, const Slice& curr) {
-                                     return sum + curr.size();
-                                   });
     block_manager_->metrics_->total_bytes_read->IncrementBy(bytes_read);
   }
 
@@ -60,12 +60,18 @@
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_bool(enable_data_block_fsync, true,
             "Whether to enable fsync() of data blocks, metadata, and their parent directories. "
             "Disabling this flag may cause data loss in the event of a system crash.");
 TAG_FLAG(enable_data_block_fsync, unsafe);
 
+DEFINE_int32(fs_readahead_threads, 8,
+             "Maximum number of threads used to read data blocks ahead of "
+             "sequential scans. See --cfile_readahead_blocks.");
+TAG_FLAG(fs_readahead_threads, advanced);
+
 #if defined(__linux__)
 DEFINE_string(block_manager, "log", "Which block manager to use for storage. "
               "Valid options are 'file' and 'log'. The file block manager is not suitable for "
@@ -166,7 +172,11 @@ DCHECK(opts_.update_instances == UpdateInstanceBehavior::DONT_UPDATE ||
        !opts_.read_only) << "FsManager can only be for updated if not in read-only mode";
 }
 
-FsManager::~FsManager() {}
+FsManager::~FsManager() {
+  if (readahead_pool_) {
+    readahead_pool_->Shutdown();
+  }
+}
 
 void FsManager::SetErrorNotificationCb(ErrorHandlerType e, ErrorNotificationCb cb) {
   error_manager_->SetErrorNotificationCb(e, std::move(cb));
@@ -435,6 +445,12 @@ Status FsManager::Open(FsReport* report) {
     RETURN_NOT_OK(block_manager_->Open(report));
   }
 
+  if (!readahead_pool_) {
+    RETURN_NOT_OK(ThreadPoolBuilder("fs-readahead")
+                  .set_max_threads(FLAGS_fs_readahead_threads)
+                  .Build(&readahead_pool_));
+  }
+
   // Report wal and metadata directories.
   if (report) {
     report->wal_dir = canonicalized_wal_fs_root_.path;
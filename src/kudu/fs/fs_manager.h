@@ -46,6 +46,7 @@ namespace kudu {
 class BlockId;
 class InstanceMetadataPB;
 class MemTracker;
+class ThreadPool;
 
 namespace fs {
 
@@ -213,6 +214,13 @@ class FsManager {
 
   bool BlockExists(const BlockId& block_id) const;
 
+  // Returns the pool on which data blocks are read ahead of sequential scans.
+  // Only valid once the FsManager has been opened; shut down when the
+  // FsManager is destroyed.
+  ThreadPool* readahead_pool() const {
+    return readahead_pool_.get();
+  }
+
   // ==========================================================================
   //  on-disk path
   // ==========================================================================
@@ -380,6 +388,7 @@ class FsManager {
   std::unique_ptr<fs::FsErrorManager> error_manager_;
   std::unique_ptr<fs::DataDirManager> dd_manager_;
   std::unique_ptr<fs::BlockManager> block_manager_;
+  std::unique_ptr<ThreadPool> readahead_pool_;
 
   ObjectIdGenerator oid_generator_;
 
@@ -0,0 +1,159 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/locks.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace fs {
+
+class IOSchedulerTest : public KuduTest {
+ protected:
+  void SetUp() override {
+    KuduTest::SetUp();
+    scheduler_.reset(new IOScheduler(1, { 8, 4, 2, 1 }, nullptr));
+  }
+
+  // Start a thread which issues a zero-length I/O in 'io_class' and records
+  // the class once the I/O is admitted.
+  void StartIO(IOClass io_class) {
+    threads_.emplace_back([this, io_class]() {
+      ScopedIOClass scoped_io_class(io_class);
+      IOScheduler::ScopedIO io(scheduler_.get(), 0);
+      std::lock_guard<simple_spinlock> l(lock_);
+      admitted_.push_back(io_class);
+    });
+  }
+
+  unique_ptr<IOScheduler> scheduler_;
+  vector<thread> threads_;
+
+  simple_spinlock lock_;
+  vector<IOClass> admitted_;
+};
+
+TEST_F(IOSchedulerTest, TestScopedIOClass) {
+  ASSERT_EQ(IOClass::FOREGROUND, CurrentIOClass());
+  {
+    ScopedIOClass compaction(IOClass::COMPACTION);
+    ASSERT_EQ(IOClass::COMPACTION, CurrentIOClass());
+    {
+      ScopedIOClass copy(IOClass::COPY);
+      ASSERT_EQ(IOClass::COPY, CurrentIOClass());
+    }
+    ASSERT_EQ(IOClass::COMPACTION, CurrentIOClass());
+  }
+  ASSERT_EQ(IOClass::FOREGROUND, CurrentIOClass());
+}
+
+TEST_F(IOSchedulerTest, TestParseWeights) {
+  vector<int64_t> weights;
+  ASSERT_OK(ParseIOClassWeights("8,4,2,1", &weights));
+  ASSERT_EQ(vector<int64_t>({ 8, 4, 2, 1 }), weights);
+  ASSERT_TRUE(ParseIOClassWeights("8,4,2", &weights).IsInvalidArgument());
+  ASSERT_TRUE(ParseIOClassWeights("8,4,2,0", &weights).IsInvalidArgument());
+  ASSERT_TRUE(ParseIOClassWeights("8,4,x,1", &weights).IsInvalidArgument());
+}
+
+TEST_F(IOSchedulerTest, TestNullSchedulerAdmitsEverything) {
+  IOScheduler::ScopedIO io1(nullptr, 1024);
+  IOScheduler::ScopedIO io2(nullptr, 1024);
+}
+
+// I/O which is queued behind a saturated disk is admitted in proportion to
+// the weights of the classes.
+TEST_F(IOSchedulerTest, TestWeightedShares) {
+  const int kNumPerClass = 9;
+  {
+    IOScheduler::ScopedIO io(scheduler_.get(), 0);
+    ASSERT_EQ(1, scheduler_->num_outstanding());
+    for (int i = 0; i < kNumPerClass; i++) {
+      StartIO(IOClass::FOREGROUND);
+      StartIO(IOClass::COPY);
+    }
+    ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(2 * kNumPerClass, scheduler_->num_queued());
+    });
+  }
+  for (auto& t : threads_) {
+    t.join();
+  }
+  ASSERT_EQ(0, scheduler_->num_outstanding());
+  ASSERT_EQ(0, scheduler_->num_queued());
+  ASSERT_EQ(2 * kNumPerClass, admitted_.size());
+
+  // With a weight of 8 to 1, almost all of the first I/Os to be admitted are
+  // foreground ones.
+  int num_foreground = 0;
+  for (int i = 0; i < kNumPerClass; i++) {
+    if (admitted_[i] == IOClass::FOREGROUND) {
+      num_foreground++;
+    }
+  }
+  ASSERT_GE(num_foreground, kNumPerClass - 2);
+}
+
+// A class which was idle doesn't get to catch up on the share it didn't use.
+TEST_F(IOSchedulerTest, TestIdleClassDoesNotAccumulateCredit) {
+  // Use up lots of the disk with copy I/O while nothing else is running.
+  for (int i = 0; i < 100; i++) {
+    ScopedIOClass scoped_io_class(IOClass::COPY);
+    IOScheduler::ScopedIO io(scheduler_.get(), 0);
+  }
+  {
+    IOScheduler::ScopedIO io(scheduler_.get(), 0);
+    for (int i = 0; i < 4; i++) {
+      StartIO(IOClass::COPY);
+      StartIO(IOClass::COMPACTION);
+    }
+    ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(8, scheduler_->num_queued());
+    });
+  }
+  for (auto& t : threads_) {
+    t.join();
+  }
+  // Had the compaction class been credited for the time it was idle, all of
+  // its I/O would have been admitted before any of the copy I/O.
+  ASSERT_EQ(8, admitted_.size());
+  int num_copy = 0;
+  for (int i = 0; i < 4; i++) {
+    if (admitted_[i] == IOClass::COPY) {
+      num_copy++;
+    }
+  }
+  ASSERT_GT(num_copy, 0);
+}
+
+} // namespace fs
+} // namespace kudu
@@ -0,0 +1,243 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+
+DEFINE_int32(fs_io_scheduler_max_outstanding_per_dir, 0,
+             "Maximum number of block I/O operations issued concurrently to "
+             "each data directory. Once this many are outstanding, further "
+             "ones are queued and issued according to the weight of their "
+             "I/O class (see --fs_io_class_weights). Every block I/O then "
+             "takes a lock of its data directory, so this is only worth "
+             "enabling when disks are contended. 0 disables I/O scheduling.");
+DEFINE_validator(fs_io_scheduler_max_outstanding_per_dir,
+    [](const char* /*n*/, int32_t v) { return v >= 0; });
+TAG_FLAG(fs_io_scheduler_max_outstanding_per_dir, advanced);
+TAG_FLAG(fs_io_scheduler_max_outstanding_per_dir, experimental);
+
+DEFINE_int64(fs_io_scheduler_op_cost_bytes, 128 * 1024,
+             "The cost of a single block I/O operation to a data directory, "
+             "in bytes, in addition to the number of bytes it transfers. "
+             "Higher values share out the IOPS of a disk more evenly between "
+             "I/O classes, lower values share out its bandwidth more evenly.");
+DEFINE_validator(fs_io_scheduler_op_cost_bytes,
+    [](const char* /*n*/, int64_t v) { return v >= 0; });
+TAG_FLAG(fs_io_scheduler_op_cost_bytes, advanced);
+TAG_FLAG(fs_io_scheduler_op_cost_bytes, experimental);
+
+DEFINE_string(fs_io_class_weights, "8,4,2,1",
+              "Comma-separated weights of the foreground, flush, compaction "
+              "and tablet copy I/O classes. When a data directory is "
+              "saturated, each class gets a share of it proportional to its "
+              "weight.");
+DEFINE_validator(fs_io_class_weights,
+    [](const char* /*n*/, const std::string& v) {
+      std::vector<int64_t> weights;
+      return kudu::fs::ParseIOClassWeights(v, &weights).ok();
+    });
+TAG_FLAG(fs_io_class_weights, advanced);
+TAG_FLAG(fs_io_class_weights, experimental);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace fs {
+
+namespace {
+
+__thread IOClass g_current_io_class = IOClass::FOREGROUND;
+
+} // anonymous namespace
+
+const char* IOClassToString(IOClass io_class) {
+  switch (io_class) {
+    case IOClass::FOREGROUND: return "foreground";
+    case IOClass::FLUSH: return "flush";
+    case IOClass::COMPACTION: return "compaction";
+    case IOClass::COPY: return "copy";
+  }
+  LOG(FATAL) << "unknown I/O class: " << static_cast<int>(io_class);
+  return nullptr;
+}
+
+IOClass CurrentIOClass() {
+  return g_current_io_class;
+}
+
+ScopedIOClass::ScopedIOClass(IOClass io_class)
+    : prev_(g_current_io_class) {
+  g_current_io_class = io_class;
+}
+
+ScopedIOClass::~ScopedIOClass() {
+  g_current_io_class = prev_;
+}
+
+Status ParseIOClassWeights(const string& str, vector<int64_t>* weights) {
+  vector<string> parts = strings::Split(str, ",", strings::SkipWhitespace());
+  if (parts.size() != kNumIOClasses) {
+    return Status::InvalidArgument(Substitute(
+        "expected $0 I/O class weights, got '$1'", kNumIOClasses, str));
+  }
+  vector<int64_t> result;
+  for (const auto& p : parts) {
+    int64_t w;
+    if (!safe_strto64(p, &w) || w <= 0) {
+      return Status::InvalidArgument(Substitute("invalid I/O class weight: '$0'", p));
+    }
+    result.push_back(w);
+  }
+  *weights = std::move(result);
+  return Status::OK();
+}
+
+struct IOScheduler::Waiter {
+  Waiter(Mutex* lock, int64_t cost)
+      : cond(lock),
+        cost(cost),
+        admitted(false) {
+  }
+
+  ConditionVariable cond;
+  const int64_t cost;
+  bool admitted;
+};
+
+std::unique_ptr<IOScheduler> IOScheduler::CreateFromFlags(const IOSchedulerMetrics* metrics) {
+  if (FLAGS_fs_io_scheduler_max_outstanding_per_dir == 0) {
+    return nullptr;
+  }
+  vector<int64_t> weights;
+  CHECK_OK(ParseIOClassWeights(FLAGS_fs_io_class_weights, &weights));
+  return std::unique_ptr<IOScheduler>(new IOScheduler(
+      FLAGS_fs_io_scheduler_max_outstanding_per_dir, std::move(weights), metrics));
+}
+
+IOScheduler::IOScheduler(int max_outstanding,
+                         vector<int64_t> weights,
+                         const IOSchedulerMetrics* metrics)
+    : max_outstanding_(max_outstanding),
+      weights_(std::move(weights)),
+      metrics_(metrics),
+      outstanding_(0),
+      num_queued_(0),
+      virtual_time_(0) {
+  CHECK_GT(max_outstanding_, 0);
+  CHECK_EQ(kNumIOClasses, weights_.size());
+  std::fill(pass_, pass_ + kNumIOClasses, 0);
+}
+
+IOScheduler::~IOScheduler() {
+  MutexLock l(lock_);
+  DCHECK_EQ(0, outstanding_);
+  DCHECK_EQ(0, num_queued_);
+}
+
+int IOScheduler::num_outstanding() const {
+  MutexLock l(lock_);
+  return outstanding_;
+}
+
+int IOScheduler::num_queued() const {
+  MutexLock l(lock_);
+  return num_queued_;
+}
+
+void IOScheduler::Admit(IOClass io_class, int64_t bytes) {
+  const int c = static_cast<int>(io_class);
+  const int64_t cost = bytes + FLAGS_fs_io_scheduler_op_cost_bytes;
+  MutexLock l(lock_);
+  if (outstanding_ < max_outstanding_ && num_queued_ == 0) {
+    outstanding_++;
+    ChargeUnlocked(c, cost);
+    return;
+  }
+
+  MonoTime start = MonoTime::Now();
+  Waiter w(&lock_, cost);
+  queues_[c].push_back(&w);
+  num_queued_++;
+  do {
+    w.cond.Wait();
+  } while (!w.admitted);
+  if (metrics_ && metrics_->queue_time_us[c]) {
+    metrics_->queue_time_us[c]->Increment((MonoTime::Now() - start).ToMicroseconds());
+  }
+}
+
+void IOScheduler::Complete() {
+  MutexLock l(lock_);
+  DCHECK_GT(outstanding_, 0);
+  outstanding_--;
+  AdmitQueuedUnlocked();
+}
+
+void IOScheduler::ChargeUnlocked(int io_class, int64_t cost) {
+  lock_.AssertAcquired();
+  // A class which has been idle starts over from the current virtual time,
+  // rather than from where it left off, so it can't monopolize the disk to
+  // make up for the time it didn't use it.
+  pass_[io_class] = std::max(pass_[io_class], virtual_time_);
+  virtual_time_ = pass_[io_class];
+  pass_[io_class] += std::max<int64_t>(1, cost / weights_[io_class]);
+}
+
+void IOScheduler::AdmitQueuedUnlocked() {
+  lock_.AssertAcquired();
+  while (outstanding_ < max_outstanding_ && num_queued_ > 0) {
+    int next = -1;
+    int64_t min_pass = std::numeric_limits<int64_t>::max();
+    for (int c = 0; c < kNumIOClasses; c++) {
+      if (queues_[c].empty()) {
+        continue;
+      }
+      int64_t pass = std::max(pass_[c], virtual_time_);
+      if (pass < min_pass) {
+        min_pass = pass;
+        next = c;
+      }
+    }
+    DCHECK_NE(-1, next);
+    Waiter* w = queues_[next].front();
+    queues_[next].pop_front();
+    num_queued_--;
+    outstanding_++;
+    ChargeUnlocked(next, w->cost);
+    w->admitted = true;
+    w->cond.Signal();
+  }
+}
+
+} // namespace fs
+} // namespace kudu
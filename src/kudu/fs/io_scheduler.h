@@ -0,0 +1,172 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace fs {
+
+// The classes of block I/O which an IOScheduler arbitrates between.
+enum class IOClass {
+  // Scans and other reads on behalf of clients.
+  FOREGROUND,
+  // Flushes of in-memory stores.
+  FLUSH,
+  // Rowset and delta compactions, and other background maintenance.
+  COMPACTION,
+  // Tablet copies, on both the sending and the receiving end.
+  COPY,
+};
+constexpr int kNumIOClasses = 4;
+
+const char* IOClassToString(IOClass io_class);
+
+// Returns the I/O class of the calling thread: FOREGROUND, unless set
+// otherwise by a ScopedIOClass.
+IOClass CurrentIOClass();
+
+// Sets the I/O class of the calling thread while in scope.
+class ScopedIOClass {
+ public:
+  explicit ScopedIOClass(IOClass io_class);
+  ~ScopedIOClass();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedIOClass);
+
+  const IOClass prev_;
+};
+
+// Parses a comma-separated list of positive weights, one per I/O class in
+// declaration order, into 'weights'.
+Status ParseIOClassWeights(const std::string& str, std::vector<int64_t>* weights);
+
+// Metrics of the I/O schedulers of a directory manager.
+struct IOSchedulerMetrics {
+  // Time spent by I/O waiting to be issued, indexed by I/O class.
+  scoped_refptr<Histogram> queue_time_us[kNumIOClasses];
+};
+
+// Schedules the blocking I/O issued to a single disk.
+//
+// At most 'max_outstanding' I/O operations are issued at a time. Once that
+// many are outstanding, further ones queue up by class, and each class gets
+// a share of the disk proportional to its weight (see --fs_io_class_weights).
+// Shares are enforced by stride scheduling: every operation costs its size
+// plus a fixed per-operation amount, so that a class issuing many small
+// operations can't starve one issuing few large ones, and the next operation
+// issued is the oldest one of the class which has used the least of the disk
+// relative to its weight. A class which had nothing queued doesn't get to
+// make up for the time it was idle.
+//
+// Classes only contend when the disk is saturated, so a lone class is never
+// throttled.
+//
+// This class is thread-safe.
+class IOScheduler {
+ public:
+  // Create a scheduler configured by the --fs_io_scheduler_* flags, or
+  // return null if I/O scheduling is disabled.
+  static std::unique_ptr<IOScheduler> CreateFromFlags(const IOSchedulerMetrics* metrics);
+
+  // 'metrics', if not null, must outlive the scheduler.
+  IOScheduler(int max_outstanding,
+              std::vector<int64_t> weights,
+              const IOSchedulerMetrics* metrics);
+  ~IOScheduler();
+
+  // An I/O operation admitted by a scheduler, which is considered complete
+  // when this object goes out of scope. A null scheduler admits everything.
+  class ScopedIO {
+   public:
+    ScopedIO(IOScheduler* scheduler, int64_t bytes)
+        : scheduler_(scheduler) {
+      if (scheduler_) {
+        scheduler_->Admit(CurrentIOClass(), bytes);
+      }
+    }
+
+    ~ScopedIO() {
+      if (scheduler_) {
+        scheduler_->Complete();
+      }
+    }
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(ScopedIO);
+
+    IOScheduler* const scheduler_;
+  };
+
+  int num_outstanding() const;
+  int num_queued() const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(IOScheduler);
+
+  struct Waiter;
+
+  // Block until an I/O of 'bytes' bytes in 'io_class' may be issued.
+  void Admit(IOClass io_class, int64_t bytes);
+
+  // Mark an admitted I/O as complete, admitting queued ones in its place.
+  void Complete();
+
+  // Charge 'cost' to 'io_class' for an I/O being issued.
+  // Requires 'lock_' to be held.
+  void ChargeUnlocked(int io_class, int64_t cost);
+
+  // Admit queued I/O while there are free slots.
+  // Requires 'lock_' to be held.
+  void AdmitQueuedUnlocked();
+
+  const int max_outstanding_;
+  const std::vector<int64_t> weights_;
+  const IOSchedulerMetrics* const metrics_;
+
+  mutable Mutex lock_;
+
+  // The number of admitted I/Os which haven't completed yet.
+  int outstanding_;
+
+  // The number of I/Os waiting to be admitted, across all classes.
+  int num_queued_;
+
+  // Waiting I/Os of each class, oldest first.
+  std::deque<Waiter*> queues_[kNumIOClasses];
+
+  // The disk usage charged to each class so far, divided by its weight.
+  int64_t pass_[kNumIOClasses];
+
+  // The pass of the class which most recently had an I/O admitted.
+  int64_t virtual_time_;
+};
+
+} // namespace fs
+} // namespace kudu
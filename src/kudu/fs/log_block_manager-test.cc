@@ -83,6 +83,7 @@ DECLARE_double(log_container_live_metadata_before_compact_ratio);
 DECLARE_int32(fs_target_data_dirs_per_tablet);
 DECLARE_int64(block_manager_max_open_files);
 DECLARE_int64(log_container_max_blocks);
+DECLARE_int64(log_container_metadata_compact_min_dead_blocks);
 DECLARE_string(block_manager_preflush_control);
 DECLARE_string(env_inject_eio_globs);
 DECLARE_uint64(log_container_preallocate_bytes);
@@ -98,6 +99,7 @@ METRIC_DECLARE_counter(block_manager_total_blocks_deleted);
 // Log block manager metrics.
 METRIC_DECLARE_gauge_uint64(log_block_manager_bytes_under_management);
 METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
+METRIC_DECLARE_gauge_uint64(log_block_manager_block_map_memory_per_block);
 METRIC_DECLARE_counter(log_block_manager_holes_punched);
 METRIC_DECLARE_gauge_uint64(log_block_manager_containers);
 METRIC_DECLARE_gauge_uint64(log_block_manager_full_containers);
@@ -486,6 +488,89 @@ TEST_F(LogBlockManagerTest, MetricsTest) {
         {0, &METRIC_log_block_manager_dead_containers_deleted} }));
 }
 
+TEST_F(LogBlockManagerTest, TestBlockMapMemoryPerBlockMetric) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(ReopenBlockManager(entity));
+  NO_FATALS(CheckGaugeMetric(entity, 0, &METRIC_log_block_manager_block_map_memory_per_block));
+
+  vector<BlockId> block_ids;
+  for (int i = 0; i < 100; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK(block->Append("a"));
+    ASSERT_OK(block->Close());
+    block_ids.emplace_back(block->id());
+  }
+  auto* gauge = down_cast<AtomicGauge<uint64_t>*>(
+      entity->FindOrNull(METRIC_log_block_manager_block_map_memory_per_block).get());
+  ASSERT_GT(gauge->value(), 0);
+
+  {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    for (const auto& id : block_ids) {
+      deletion_transaction->AddDeletedBlock(id);
+    }
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+  }
+  NO_FATALS(CheckGaugeMetric(entity, 0, &METRIC_log_block_manager_block_map_memory_per_block));
+}
+
+// Test that the readers of a block share its LogBlock, and that deleting the
+// block while it's being read doesn't punch it out from under them.
+TEST_F(LogBlockManagerTest, TestReadersShareLogBlock) {
+  const auto num_readable_blocks = [&]() {
+    size_t num = 0;
+    for (const auto& mb : bm_->managed_block_shards_) {
+      num += mb.readable_blocks.size();
+    }
+    return num;
+  };
+
+  const string kData = "test data";
+  unique_ptr<WritableBlock> written_block;
+  ASSERT_OK(bm_->CreateBlock(test_block_opts_, &written_block));
+  ASSERT_OK(written_block->Append(kData));
+  ASSERT_OK(written_block->Close());
+  const BlockId block_id = written_block->id();
+  ASSERT_EQ(0, num_readable_blocks());
+
+  unique_ptr<ReadableBlock> reader1;
+  unique_ptr<ReadableBlock> reader2;
+  ASSERT_OK(bm_->OpenBlock(block_id, &reader1));
+  ASSERT_OK(bm_->OpenBlock(block_id, &reader2));
+  ASSERT_EQ(1, num_readable_blocks());
+  ASSERT_OK(reader1->Close());
+  ASSERT_EQ(1, num_readable_blocks());
+  ASSERT_OK(bm_->OpenBlock(block_id, &reader1));
+
+  // Once deleted, the block can't be opened anymore, but can still be read by
+  // its existing readers.
+  {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    deletion_transaction->AddDeletedBlock(block_id);
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+    ASSERT_EQ(1, deleted.size());
+  }
+  ASSERT_EQ(0, num_readable_blocks());
+  ASSERT_TRUE(bm_->OpenBlock(block_id, nullptr).IsNotFound());
+  ASSERT_OK(reader1->Close());
+  for (const auto& dd : dd_manager_->dirs()) {
+    dd->WaitOnClosures();
+  }
+
+  unique_ptr<uint8_t[]> scratch(new uint8_t[kData.size()]);
+  Slice data(scratch.get(), kData.size());
+  ASSERT_OK(reader2->Read(0, data));
+  ASSERT_EQ(kData, data);
+  ASSERT_OK(reader2->Close());
+  ASSERT_EQ(0, num_readable_blocks());
+}
+
 TEST_F(LogBlockManagerTest, ContainerPreallocationTest) {
   string kTestData = "test data";
 
@@ -1105,6 +1190,50 @@ TEST_F(LogBlockManagerTest, TestFailMultipleTransactionsPerContainer) {
   }
 }
 
+// Test that a transaction whose blocks span containers in several data
+// directories commits all of them.
+TEST_F(LogBlockManagerTest, TestCommitBlocksInMultipleDirectories) {
+  vector<string> test_dirs;
+  for (int i = 0; i < 3; i++) {
+    test_dirs.emplace_back(GetTestPath(Substitute("test_dir_$0", i)));
+  }
+  ASSERT_OK(ReopenBlockManager(nullptr, nullptr, test_dirs, /*force=*/true));
+
+  // Blocks which aren't finalized each get a container of their own.
+  const int kNumBlocks = 20;
+  vector<BlockId> block_ids;
+  unique_ptr<BlockCreationTransaction> transaction = bm_->NewCreationTransaction();
+  for (int i = 0; i < kNumBlocks; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK(block->Append(Substitute("block $0", i)));
+    block_ids.emplace_back(block->id());
+    transaction->AddCreatedBlock(std::move(block));
+  }
+  ASSERT_OK(transaction->CommitCreatedBlocks());
+  set<const Dir*> dirs;
+  for (const auto& e : bm_->all_containers_by_name_) {
+    dirs.insert(e.second->data_dir());
+  }
+  ASSERT_GT(dirs.size(), 1);
+
+  FsReport report;
+  ASSERT_OK(ReopenBlockManager(nullptr, &report, test_dirs));
+  ASSERT_EQ(kNumBlocks, report.stats.live_block_count);
+  for (int i = 0; i < kNumBlocks; i++) {
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(bm_->OpenBlock(block_ids[i], &block));
+    const string expected = Substitute("block $0", i);
+    uint64_t size;
+    ASSERT_OK(block->Size(&size));
+    ASSERT_EQ(expected.size(), size);
+    unique_ptr<uint8_t[]> scratch(new uint8_t[size]);
+    Slice data(scratch.get(), size);
+    ASSERT_OK(block->Read(0, data));
+    ASSERT_EQ(expected, data);
+  }
+}
+
 TEST_F(LogBlockManagerTest, TestLookupBlockLimit) {
   int64_t limit_1024 = LogBlockManager::LookupBlockLimit(1024);
   int64_t limit_2048 = LogBlockManager::LookupBlockLimit(2048);
@@ -1594,6 +1723,105 @@ TEST_F(LogBlockManagerTest, TestCompactFullContainerMetadataAtStartup) {
   ASSERT_EQ(last_live_aligned_bytes, report.stats.live_block_bytes_aligned);
 }
 
+TEST_F(LogBlockManagerTest, TestCompactAvailableContainerMetadataAtStartup) {
+  FLAGS_log_container_live_metadata_before_compact_ratio = 0.50;
+  FLAGS_log_container_metadata_compact_min_dead_blocks = 5;
+
+  // Create one container which is far from full.
+  FLAGS_log_container_max_blocks = 100;
+  vector<BlockId> block_ids;
+  for (int i = 0; i < 10; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK(block->Append("a"));
+    ASSERT_OK(block->Close());
+    block_ids.emplace_back(block->id());
+  }
+  string metadata_file_name;
+  NO_FATALS(GetOnlyContainerMetadataFile(&metadata_file_name));
+
+  // Delete blocks one at a time. The metadata file should get compacted at
+  // startup once enough of them are dead.
+  int num_blocks_deleted = 0;
+  for (const auto& id : block_ids) {
+    uint64_t pre_compaction_file_size;
+    ASSERT_OK(env_->GetFileSize(metadata_file_name, &pre_compaction_file_size));
+    {
+      shared_ptr<BlockDeletionTransaction> deletion_transaction =
+          bm_->NewDeletionTransaction();
+      deletion_transaction->AddDeletedBlock(id);
+      vector<BlockId> deleted;
+      ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+    }
+    num_blocks_deleted++;
+    ASSERT_OK(ReopenBlockManager());
+
+    uint64_t post_compaction_file_size;
+    ASSERT_OK(env_->GetFileSize(metadata_file_name, &post_compaction_file_size));
+    if (post_compaction_file_size < pre_compaction_file_size) {
+      break;
+    }
+  }
+  ASSERT_EQ(FLAGS_log_container_metadata_compact_min_dead_blocks, num_blocks_deleted);
+
+  // The container remains available, and new records appended to the
+  // compacted metadata file are read back at the next startup.
+  unique_ptr<WritableBlock> block;
+  ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+  ASSERT_OK(block->Append("a"));
+  ASSERT_OK(block->Close());
+  NO_FATALS(GetOnlyContainerMetadataFile(&metadata_file_name));
+  FsReport report;
+  ASSERT_OK(ReopenBlockManager(nullptr, &report));
+  ASSERT_EQ(1, report.stats.lbm_container_count);
+  ASSERT_EQ(block_ids.size() - num_blocks_deleted + 1, report.stats.live_block_count);
+}
+
+// Test that compacting a container's metadata doesn't lose its greatest
+// block ID when that block was deleted, so that block IDs aren't reused.
+TEST_F(LogBlockManagerTest, TestCompactedMetadataKeepsMaxBlockId) {
+  FLAGS_log_container_live_metadata_before_compact_ratio = 0.50;
+  FLAGS_log_container_metadata_compact_min_dead_blocks = 5;
+  FLAGS_log_container_max_blocks = 100;
+
+  vector<BlockId> block_ids;
+  for (int i = 0; i < 10; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK(block->Append("a"));
+    ASSERT_OK(block->Close());
+    block_ids.emplace_back(block->id());
+  }
+  string metadata_file_name;
+  NO_FATALS(GetOnlyContainerMetadataFile(&metadata_file_name));
+  uint64_t pre_compaction_file_size;
+  ASSERT_OK(env_->GetFileSize(metadata_file_name, &pre_compaction_file_size));
+
+  // Delete the newest blocks, including the one with the greatest ID.
+  {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    for (int i = 4; i < block_ids.size(); i++) {
+      deletion_transaction->AddDeletedBlock(block_ids[i]);
+    }
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+  }
+  ASSERT_OK(ReopenBlockManager());
+  uint64_t post_compaction_file_size;
+  ASSERT_OK(env_->GetFileSize(metadata_file_name, &post_compaction_file_size));
+  ASSERT_LT(post_compaction_file_size, pre_compaction_file_size);
+
+  // Blocks created after another restart still get new IDs.
+  FsReport report;
+  ASSERT_OK(ReopenBlockManager(nullptr, &report));
+  ASSERT_EQ(4, report.stats.live_block_count);
+  unique_ptr<WritableBlock> block;
+  ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+  ASSERT_GT(block->id().id(), block_ids.back().id());
+  ASSERT_OK(block->Abort());
+}
+
 // Regression test for a bug in which, after a metadata file was compacted,
 // we would not properly handle appending to the new (post-compaction) metadata.
 //
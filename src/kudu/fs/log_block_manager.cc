@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -31,6 +32,7 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -44,6 +46,7 @@
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_report.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/callback.h"
@@ -58,6 +61,7 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/array_view.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
 #include "kudu/util/file_cache.h"
 #include "kudu/util/flag_tags.h"
@@ -106,11 +110,31 @@ DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.50,
               "the container's metadata file will be compacted at startup.");
 TAG_FLAG(log_container_live_metadata_before_compact_ratio, experimental);
 
+DEFINE_int64(log_container_metadata_compact_min_dead_blocks, 1000,
+             "Minimum number of deleted blocks in a log container which isn't "
+             "full before its metadata file may be compacted at startup. "
+             "Compaction rewrites the metadata file with only the records of "
+             "live blocks, so that later startups don't have to replay the "
+             "records of deleted ones. Full containers are compacted based on "
+             "--log_container_live_metadata_before_compact_ratio alone. If -1, "
+             "the metadata of containers which aren't full is never compacted.");
+TAG_FLAG(log_container_metadata_compact_min_dead_blocks, advanced);
+TAG_FLAG(log_container_metadata_compact_min_dead_blocks, experimental);
+
 DEFINE_bool(log_block_manager_test_hole_punching, true,
             "Ensure hole punching is supported by the underlying filesystem");
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
 TAG_FLAG(log_block_manager_test_hole_punching, unsafe);
 
+DEFINE_uint64(log_block_manager_writeback_interval_bytes, 8 * 1024 * 1024,
+              "Number of bytes which may be appended to a block that is being "
+              "written before the kernel is asked to start writing them back to "
+              "disk, so that less dirty data is left to be synchronized when the "
+              "block is closed. If 0, or if --block_manager_preflush_control is "
+              "'never', no writeback is started while the block is being written.");
+TAG_FLAG(log_block_manager_writeback_interval_bytes, advanced);
+TAG_FLAG(log_block_manager_writeback_interval_bytes, experimental);
+
 DEFINE_bool(log_block_manager_delete_dead_container, true,
             "When enabled, full and dead log block containers will be deleted "
             "at runtime, which can potentially help improving log block manager "
@@ -142,6 +166,13 @@ METRIC_DEFINE_gauge_uint64(server, log_block_manager_full_containers,
                            "Number of full log block containers",
                            kudu::MetricLevel::kInfo);
 
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_block_map_memory_per_block,
+                           "Block Map Memory Per Block",
+                           kudu::MetricUnit::kBytes,
+                           "Average amount of memory used by the in-memory map of "
+                           "data blocks for each block under management",
+                           kudu::MetricLevel::kInfo);
+
 METRIC_DEFINE_counter(server, log_block_manager_holes_punched,
                       "Number of Holes Punched",
                       kudu::MetricUnit::kHoles,
@@ -191,8 +222,13 @@ struct LogBlockManagerMetrics {
   // Implementation-agnostic metrics.
   BlockManagerMetrics generic_metrics;
 
+  // Recomputes 'block_map_memory_per_block' from the memory consumed by the
+  // block map and 'blocks_under_management'.
+  void UpdateBlockMapMemoryPerBlock(int64_t block_map_memory) const;
+
   scoped_refptr<AtomicGauge<uint64_t>> bytes_under_management;
   scoped_refptr<AtomicGauge<uint64_t>> blocks_under_management;
+  scoped_refptr<AtomicGauge<uint64_t>> block_map_memory_per_block;
 
   scoped_refptr<AtomicGauge<uint64_t>> containers;
   scoped_refptr<AtomicGauge<uint64_t>> full_containers;
@@ -207,6 +243,7 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
   : generic_metrics(metric_entity),
     GINIT(bytes_under_management),
     GINIT(blocks_under_management),
+    GINIT(block_map_memory_per_block),
     GINIT(containers),
     GINIT(full_containers),
     MINIT(holes_punched),
@@ -214,15 +251,21 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
 }
 #undef GINIT
 
+void LogBlockManagerMetrics::UpdateBlockMapMemoryPerBlock(int64_t block_map_memory) const {
+  uint64_t blocks = blocks_under_management->value();
+  block_map_memory_per_block->set_value(blocks == 0 ? 0 : block_map_memory / blocks);
+}
+
 ////////////////////////////////////////////////////////////
 // LogBlock (declaration)
 ////////////////////////////////////////////////////////////
 
 // The persistent metadata that describes a logical block.
 //
-// A block grows a LogBlock when its data has been synchronized with
-// the disk. That's when it's fully immutable (i.e. none of its metadata
-// can change), and when it becomes readable and persistent.
+// A block's metadata is fully immutable (i.e. none of it can change) once
+// its data has been synchronized with the disk. To save memory, the block
+// manager only keeps the block's location from then on, and a LogBlock is
+// created when the block is opened for reading or deleted.
 //
 // LogBlocks are reference counted to simplify support for deletion with
 // outstanding readers. All refcount increments are performed with the
@@ -331,6 +374,10 @@ class LogWritableBlock : public WritableBlock {
   // The block's length. Changes with each Append().
   int64_t block_length_;
 
+  // The length of the prefix of the block whose writeback to disk has been
+  // started.
+  int64_t writeback_length_;
+
   // The state of the block describing where it is in the write lifecycle,
   // for example, has it been synchronized to disk?
   WritableBlock::State state_;
@@ -385,12 +432,24 @@ class LogBlockContainer: public RefCountedThreadSafe<LogBlockContainer> {
   // The destructor will delete files of this container if it is dead.
   ~LogBlockContainer();
 
+  // Sets of blocks to be closed together, each with its container.
+  typedef vector<std::pair<LogBlockContainer*, vector<LogWritableBlock*>>> BlocksByContainer;
+
   // Closes a set of blocks belonging to this container, possibly synchronizing
   // the dirty data and metadata to disk.
   //
   // If successful, adds all blocks to the block manager's in-memory maps.
   Status DoCloseBlocks(const vector<LogWritableBlock*>& blocks, SyncMode mode);
 
+  // Like DoCloseBlocks(), but for the blocks of several containers in the
+  // same data directory. Each step of closing the blocks is taken for all of
+  // the containers before the next one, so that their data files are synced
+  // back to back, then their metadata files, and then the directory once.
+  //
+  // A container whose blocks can't be closed doesn't prevent the blocks of
+  // the others from being closed. Returns the first failure, if any.
+  static Status DoCloseBlocksInDir(const BlocksByContainer& blocks, SyncMode mode);
+
   // Frees the space associated with a block or a group of blocks at 'offset'
   // and 'length'. This is a physical operation, not a logical one; a separate
   // AppendMetadata() is required to record the deletion in container metadata.
@@ -483,8 +542,9 @@ class LogBlockContainer: public RefCountedThreadSafe<LogBlockContainer> {
       vector<LogBlockRefPtr>* dead_blocks,
       uint64_t* max_block_id);
 
-  // Updates internal bookkeeping state to reflect the creation of a block.
-  void BlockCreated(const LogBlockRefPtr& block);
+  // Updates internal bookkeeping state to reflect the creation of a block
+  // with the given offset and length.
+  void BlockCreated(int64_t offset, int64_t length);
 
   // Updates internal bookkeeping state to reflect the deletion of a block.
   //
@@ -492,7 +552,11 @@ class LogBlockContainer: public RefCountedThreadSafe<LogBlockContainer> {
   // with creations.
   //
   // Note: the container is not made "unfull"; containers remain sparse until deleted.
-  void BlockDeleted(const LogBlockRefPtr& block);
+  void BlockDeleted(int64_t offset, int64_t length);
+
+  // Returns the length of a block with the given offset and length, aligned
+  // to the nearest filesystem block size.
+  int64_t fs_aligned_length(int64_t offset, int64_t length) const;
 
   // Finalizes a fully written block. It updates the container data file's position,
   // truncates the container if full and marks the container as available.
@@ -987,7 +1051,7 @@ Status LogBlockContainer::ProcessRecord(
     uint64_t* data_file_size,
     uint64_t* max_block_id) {
   const BlockId block_id(BlockId::FromPB(record->block_id()));
-  LogBlockRefPtr lb;
+  LogBlockManager::BlockLocation loc;
   switch (record->op_type()) {
     case CREATE:
       // First verify that the record's offset/length aren't wildly incorrect.
@@ -1017,8 +1081,8 @@ Status LogBlockContainer::ProcessRecord(
         break;
       }
 
-      lb = new LogBlock(this, block_id, record->offset(), record->length());
-      if (!InsertIfNotPresent(live_blocks, block_id, lb)) {
+      loc = { this, record->offset(), record->length() };
+      if (!InsertIfNotPresent(live_blocks, block_id, loc)) {
         // We found a record whose ID matches that of an already created block.
         //
         // TODO(adar): treat as a different kind of inconsistency?
@@ -1038,26 +1102,26 @@ Status LogBlockContainer::ProcessRecord(
       //
       // If we ignored deleted blocks, we would end up reusing the space
       // belonging to the last deleted block in the container.
-      UpdateNextBlockOffset(lb->offset(), lb->length());
-      BlockCreated(lb);
+      UpdateNextBlockOffset(loc.offset, loc.length);
+      BlockCreated(loc.offset, loc.length);
 
       (*live_block_records)[block_id].Swap(record);
       *max_block_id = std::max(*max_block_id, block_id.id());
       break;
     case DELETE:
-      lb = EraseKeyReturnValuePtr(live_blocks, block_id);
-      if (!lb) {
+      if (!FindCopy(*live_blocks, block_id, &loc)) {
         // We found a record for which there is no already created block.
         //
         // TODO(adar): treat as a different kind of inconsistency?
         report->malformed_record_check->entries.emplace_back(ToString(), record);
         break;
       }
+      live_blocks->erase(block_id);
       VLOG(2) << Substitute("Found DELETE block $0", block_id.ToString());
-      BlockDeleted(lb);
+      BlockDeleted(loc.offset, loc.length);
 
       CHECK_EQ(1, live_block_records->erase(block_id));
-      dead_blocks->emplace_back(std::move(lb));
+      dead_blocks->emplace_back(new LogBlock(this, block_id, loc.offset, loc.length));
       break;
     default:
       // We found a record with an unknown type.
@@ -1071,41 +1135,78 @@ Status LogBlockContainer::ProcessRecord(
 
 Status LogBlockContainer::DoCloseBlocks(const vector<LogWritableBlock*>& blocks,
                                         SyncMode mode) {
-  auto sync_blocks = [&]() -> Status {
-    if (mode == SYNC) {
-      VLOG(3) << "Syncing data file " << data_file_->filename();
-      RETURN_NOT_OK(SyncData());
+  return DoCloseBlocksInDir({ { this, blocks } }, mode);
+}
+
+Status LogBlockContainer::DoCloseBlocksInDir(const BlocksByContainer& blocks,
+                                             SyncMode mode) {
+  Status first_failure;
+  vector<const BlocksByContainer::value_type*> remaining;
+  remaining.reserve(blocks.size());
+  for (const auto& e : blocks) {
+    DCHECK_EQ(blocks.front().first->data_dir(), e.first->data_dir());
+    remaining.emplace_back(&e);
+  }
+
+  // Takes a step of closing the blocks for each remaining container, leaving
+  // out the containers for which it fails from the remaining steps.
+  const auto step = [&](const std::function<Status(LogBlockContainer*,
+                                                   const vector<LogWritableBlock*>&)>& f) {
+    vector<const BlocksByContainer::value_type*> succeeded;
+    for (const auto* e : remaining) {
+      Status s = f(e->first, e->second);
+      if (PREDICT_TRUE(s.ok())) {
+        succeeded.emplace_back(e);
+        continue;
+      }
+      // Make container read-only to forbid further writes in case of failure.
+      // Because the on-disk state may contain partial/incomplete data/metadata at
+      // this point, it is not safe to either overwrite it or append to it.
+      e->first->SetReadOnly(s);
+      if (first_failure.ok()) {
+        first_failure = s;
+      }
     }
+    remaining = std::move(succeeded);
+  };
+
+  if (mode == SYNC) {
+    step([](LogBlockContainer* c, const vector<LogWritableBlock*>& /* blocks */) {
+      VLOG(3) << "Syncing data file " << c->data_file_->filename();
+      return c->SyncData();
+    });
+  }
 
-    // Append metadata only after data is synced so that there's
-    // no chance of metadata landing on the disk before the data.
+  // Append metadata only after data is synced so that there's
+  // no chance of metadata landing on the disk before the data.
+  step([](LogBlockContainer* /* c */, const vector<LogWritableBlock*>& blocks) {
     for (auto* block : blocks) {
       RETURN_NOT_OK_PREPEND(block->AppendMetadata(),
                             "unable to append block's metadata during close");
     }
+    return Status::OK();
+  });
 
-    if (mode == SYNC) {
-      VLOG(3) << "Syncing metadata file " << metadata_file_->filename();
-      RETURN_NOT_OK(SyncMetadata());
-    }
+  if (mode == SYNC) {
+    step([](LogBlockContainer* c, const vector<LogWritableBlock*>& /* blocks */) {
+      VLOG(3) << "Syncing metadata file " << c->metadata_file_->filename();
+      return c->SyncMetadata();
+    });
+  }
 
-    RETURN_NOT_OK(block_manager()->SyncContainer(*this));
+  // The data directory is only synced for the first container, if at all:
+  // the others find it clean.
+  step([](LogBlockContainer* c, const vector<LogWritableBlock*>& /* blocks */) {
+    return c->block_manager()->SyncContainer(*c);
+  });
 
-    for (LogWritableBlock* block : blocks) {
-      if (blocks.size() > 1) DCHECK_EQ(block->state(), WritableBlock::State::FINALIZED);
+  for (const auto* e : remaining) {
+    for (LogWritableBlock* block : e->second) {
+      if (e->second.size() > 1) DCHECK_EQ(block->state(), WritableBlock::State::FINALIZED);
       block->DoClose();
     }
-    return Status::OK();
-  };
-
-  Status s = sync_blocks();
-  if (!s.ok()) {
-    // Make container read-only to forbid further writes in case of failure.
-    // Because the on-disk state may contain partial/incomplete data/metadata at
-    // this point, it is not safe to either overwrite it or append to it.
-    SetReadOnly(s);
   }
-  return s;
+  return first_failure;
 }
 
 Status LogBlockContainer::PunchHole(int64_t offset, int64_t length) {
@@ -1130,15 +1231,18 @@ Status LogBlockContainer::WriteVData(int64_t offset, ArrayView<const Slice> data
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   DCHECK_GE(offset, next_block_offset());
 
-  RETURN_NOT_OK_HANDLE_ERROR(data_file_->WriteV(offset, data));
-
-  // This append may have changed the container size if:
-  // 1. It was large enough that it blew out the preallocated space.
-  // 2. Preallocation was disabled.
   size_t data_size = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
                                 [&](int sum, const Slice& curr) {
                                   return sum + curr.size();
                                 });
+  {
+    IOScheduler::ScopedIO io(data_dir_->io_scheduler(), data_size);
+    RETURN_NOT_OK_HANDLE_ERROR(data_file_->WriteV(offset, data));
+  }
+
+  // This append may have changed the container size if:
+  // 1. It was large enough that it blew out the preallocated space.
+  // 2. Preallocation was disabled.
   if (offset + data_size > preallocated_offset_) {
     RETURN_NOT_OK_HANDLE_ERROR(data_dir_->RefreshAvailableSpace(Dir::RefreshMode::ALWAYS));
   }
@@ -1147,11 +1251,17 @@ Status LogBlockContainer::WriteVData(int64_t offset, ArrayView<const Slice> data
 
 Status LogBlockContainer::ReadData(int64_t offset, Slice result) const {
   DCHECK_GE(offset, 0);
+  IOScheduler::ScopedIO io(data_dir_->io_scheduler(), result.size());
   RETURN_NOT_OK_HANDLE_ERROR(data_file_->Read(offset, result));
   return Status::OK();
 }
 Status LogBlockContainer::ReadVData(int64_t offset, ArrayView<Slice> results) const {
   DCHECK_GE(offset, 0);
+  size_t read_size = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
+                                [&](size_t sum, const Slice& curr) {
+                                  return sum + curr.size();
+                                });
+  IOScheduler::ScopedIO io(data_dir_->io_scheduler(), read_size);
   RETURN_NOT_OK_HANDLE_ERROR(data_file_->ReadV(offset, results));
   return Status::OK();
 }
@@ -1182,6 +1292,7 @@ Status LogBlockContainer::SyncData() {
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   if (FLAGS_enable_data_block_fsync) {
     if (metrics_) metrics_->generic_metrics.total_disk_sync->Increment();
+    IOScheduler::ScopedIO io(data_dir_->io_scheduler(), 0);
     RETURN_NOT_OK_HANDLE_ERROR(data_file_->Sync());
   }
   return Status::OK();
@@ -1280,24 +1391,43 @@ void LogBlockContainer::UpdateNextBlockOffset(int64_t block_offset, int64_t bloc
   }
 }
 
-void LogBlockContainer::BlockCreated(const LogBlockRefPtr& block) {
-  DCHECK_GE(block->offset(), 0);
+void LogBlockContainer::BlockCreated(int64_t offset, int64_t length) {
+  DCHECK_GE(offset, 0);
 
-  total_bytes_.IncrementBy(block->fs_aligned_length());
+  int64_t aligned_length = fs_aligned_length(offset, length);
+  total_bytes_.IncrementBy(aligned_length);
   total_blocks_.Increment();
-  live_bytes_.IncrementBy(block->length());
-  live_bytes_aligned_.IncrementBy(block->fs_aligned_length());
+  live_bytes_.IncrementBy(length);
+  live_bytes_aligned_.IncrementBy(aligned_length);
   live_blocks_.Increment();
 }
 
-void LogBlockContainer::BlockDeleted(const LogBlockRefPtr& block) {
-  DCHECK_GE(block->offset(), 0);
+void LogBlockContainer::BlockDeleted(int64_t offset, int64_t length) {
+  DCHECK_GE(offset, 0);
 
-  live_bytes_.IncrementBy(-block->length());
-  live_bytes_aligned_.IncrementBy(-block->fs_aligned_length());
+  live_bytes_.IncrementBy(-length);
+  live_bytes_aligned_.IncrementBy(-fs_aligned_length(offset, length));
   live_blocks_.IncrementBy(-1);
 }
 
+int64_t LogBlockContainer::fs_aligned_length(int64_t offset, int64_t length) const {
+  uint64_t fs_block_size = instance()->filesystem_block_size_bytes();
+
+  // Nearly all blocks are placed on a filesystem block boundary, which means
+  // their length post-alignment is simply their length aligned up to the
+  // nearest fs block size.
+  //
+  // However, due to KUDU-1793, some blocks may start or end at misaligned
+  // offsets. We don't maintain enough state to precisely pinpoint such a
+  // block's (aligned) end offset in this case, so we'll just undercount it.
+  // This should be safe, although it may mean unreclaimed disk space (i.e.
+  // when fs_aligned_length() is used in hole punching).
+  if (PREDICT_TRUE(offset % fs_block_size == 0)) {
+    return KUDU_ALIGN_UP(length, fs_block_size);
+  }
+  return length;
+}
+
 void LogBlockContainer::ExecClosure(const Closure& task) {
   data_dir_->ExecClosure(task);
 }
@@ -1355,6 +1485,22 @@ void LogBlockCreationTransaction::AddCreatedBlock(
   created_blocks_.emplace_back(unique_ptr<LogWritableBlock>(lwb));
 }
 
+namespace {
+
+// Closes the blocks of containers in a data directory on behalf of
+// LogBlockCreationTransaction::CommitCreatedBlocks(), which waits on 'latch'.
+// The I/O is issued in the committing thread's I/O class.
+void CloseBlocksInDirTask(IOClass io_class,
+                          const LogBlockContainer::BlocksByContainer* blocks,
+                          Status* status,
+                          CountDownLatch* latch) {
+  ScopedIOClass scoped_io_class(io_class);
+  *status = LogBlockContainer::DoCloseBlocksInDir(*blocks, LogBlockContainer::SyncMode::SYNC);
+  latch->CountDown();
+}
+
+} // anonymous namespace
+
 Status LogBlockCreationTransaction::CommitCreatedBlocks() {
   if (created_blocks_.empty()) {
     return Status::OK();
@@ -1375,9 +1521,29 @@ Status LogBlockCreationTransaction::CommitCreatedBlocks() {
   // Close all blocks and sync the blocks belonging to the same
   // container together to reduce fsync() usage, waiting for them
   // to become durable.
-  for (const auto& entry : created_block_map) {
-    RETURN_NOT_OK(entry.first->DoCloseBlocks(entry.second,
-                                             LogBlockContainer::SyncMode::SYNC));
+  //
+  // The containers in each data directory are synced together, and the data
+  // directories are synced concurrently on their own thread pools, so that
+  // the fsyncs of different disks overlap rather than being issued one after
+  // the other.
+  unordered_map<Dir*, LogBlockContainer::BlocksByContainer> blocks_by_dir;
+  for (auto& entry : created_block_map) {
+    blocks_by_dir[entry.first->data_dir()].emplace_back(entry.first, std::move(entry.second));
+  }
+  vector<Status> statuses(blocks_by_dir.size());
+  CountDownLatch latch(blocks_by_dir.size() - 1);
+  auto it = blocks_by_dir.begin();
+  for (size_t i = 1; i < statuses.size(); i++) {
+    ++it;
+    it->first->ExecClosure(Bind(&CloseBlocksInDirTask, CurrentIOClass(), Unretained(&it->second),
+                                Unretained(&statuses[i]), Unretained(&latch)));
+  }
+  // The blocks of the first data directory are closed on this thread.
+  statuses[0] = LogBlockContainer::DoCloseBlocksInDir(blocks_by_dir.begin()->second,
+                                                      LogBlockContainer::SyncMode::SYNC);
+  latch.Wait();
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
   }
   created_blocks_.clear();
   return Status::OK();
@@ -1545,21 +1711,7 @@ LogBlock::LogBlock(LogBlockContainerRefPtr container, BlockId block_id,
 }
 
 int64_t LogBlock::fs_aligned_length() const {
-  uint64_t fs_block_size = container_->instance()->filesystem_block_size_bytes();
-
-  // Nearly all blocks are placed on a filesystem block boundary, which means
-  // their length post-alignment is simply their length aligned up to the
-  // nearest fs block size.
-  //
-  // However, due to KUDU-1793, some blocks may start or end at misaligned
-  // offsets. We don't maintain enough state to precisely pinpoint such a
-  // block's (aligned) end offset in this case, so we'll just undercount it.
-  // This should be safe, although it may mean unreclaimed disk space (i.e.
-  // when fs_aligned_length() is used in hole punching).
-  if (PREDICT_TRUE(offset_ % fs_block_size == 0)) {
-    return KUDU_ALIGN_UP(length_, fs_block_size);
-  }
-  return length_;
+  return container_->fs_aligned_length(offset_, length_);
 }
 
 void LogBlock::RegisterDeletion(
@@ -1580,6 +1732,7 @@ LogWritableBlock::LogWritableBlock(LogBlockContainerRefPtr container,
       block_id_(block_id),
       block_offset_(block_offset),
       block_length_(0),
+      writeback_length_(0),
       state_(CLEAN) {
   DCHECK_GE(block_offset, 0);
   DCHECK_EQ(0, block_offset % container_->instance()->filesystem_block_size_bytes());
@@ -1694,12 +1847,27 @@ Status LogWritableBlock::AppendV(ArrayView<const Slice> data) {
 
   block_length_ += data_size;
   state_ = DIRTY;
+
+  // Start writing back large blocks while they're still being written, so
+  // that their data doesn't all need to be written back when they're synced.
+  if (FLAGS_log_block_manager_writeback_interval_bytes > 0 &&
+      block_length_ - writeback_length_ >= FLAGS_log_block_manager_writeback_interval_bytes &&
+      FLAGS_block_manager_preflush_control != "never") {
+    RETURN_NOT_OK(FlushDataAsync());
+  }
   return Status::OK();
 }
 
 Status LogWritableBlock::FlushDataAsync() {
+  // Writeback may already have been started for a prefix of the block. A
+  // zero-length flush would extend to the end of the file, so skip it.
+  if (block_length_ == writeback_length_) {
+    return Status::OK();
+  }
   VLOG(3) << "Flushing block " << id();
-  RETURN_NOT_OK(container_->FlushData(block_offset_, block_length_));
+  RETURN_NOT_OK(container_->FlushData(block_offset_ + writeback_length_,
+                                      block_length_ - writeback_length_));
+  writeback_length_ = block_length_;
   return Status::OK();
 }
 
@@ -1751,10 +1919,9 @@ void LogWritableBlock::DoClose() {
     container_->FinalizeBlock(block_offset_, block_length_);
   }
 
-  LogBlockRefPtr lb = container_->block_manager()->CreateAndAddLogBlock(
-      container_, block_id_, block_offset_, block_length_);
-  CHECK(lb);
-  container_->BlockCreated(lb);
+  CHECK(container_->block_manager()->AddLogBlock(
+      container_.get(), block_id_, block_offset_, block_length_));
+  container_->BlockCreated(block_offset_, block_length_);
   state_ = CLOSED;
 }
 
@@ -1774,7 +1941,8 @@ Status LogWritableBlock::AppendMetadata() {
 
 // A log-backed block that has been opened for reading.
 //
-// Refers to a LogBlock representing the block's persisted metadata.
+// Refers to a LogBlock representing the block's persisted metadata, which is
+// shared with any other readers of the block.
 class LogReadableBlock : public ReadableBlock {
  public:
   explicit LogReadableBlock(LogBlockRefPtr log_block);
@@ -1825,7 +1993,8 @@ Status LogReadableBlock::Close() {
     if (log_block_->container()->metrics()) {
       log_block_->container()->metrics()->generic_metrics.blocks_open_reading->Decrement();
     }
-    log_block_.reset();
+    LogBlockManager* lbm = log_block_->container()->block_manager();
+    lbm->ReleaseLogBlock(std::move(log_block_));
   }
 
   return Status::OK();
@@ -1950,21 +2119,6 @@ LogBlockManager::LogBlockManager(Env* env,
 }
 
 LogBlockManager::~LogBlockManager() {
-  // Release all of the memory accounted by the blocks.
-  int64_t mem = 0;
-  for (const auto& mb : managed_block_shards_) {
-    for (const auto& entry : *mb.blocks_by_block_id) {
-      mem += kudu_malloc_usable_size(entry.second.get());
-    }
-  }
-  mem_tracker_->Release(mem);
-
-  // A LogBlock's destructor depends on its container, so all LogBlocks must be
-  // destroyed before their containers.
-  for (auto& mb : managed_block_shards_) {
-    mb.blocks_by_block_id->clear();
-  }
-
   // Containers may have outstanding tasks running on data directories; wait
   // for them to complete before destroying the containers.
   dd_manager_->WaitOnClosures();
@@ -2075,7 +2229,7 @@ Status LogBlockManager::Open(FsReport* report) {
     bool do_repair = true;
     for (const auto& container_result : container_results[i]) {
       RETURN_ON_NON_DISK_FAILURE(dd, container_result->status);
-      if (PREDICT_FALSE(!s.ok())) {
+      if (PREDICT_FALSE(!container_result->status.ok())) {
         // If open container error, do not try to repair.
         do_repair = false;
         break;
@@ -2167,8 +2321,19 @@ Status LogBlockManager::OpenBlock(const BlockId& block_id,
   LogBlockRefPtr lb;
   {
     int index = block_id.id() & kBlockMapMask;
-    std::lock_guard<simple_spinlock> l(*managed_block_shards_[index].lock);
-    lb = FindPtrOrNull(*managed_block_shards_[index].blocks_by_block_id, block_id);
+    auto& mb = managed_block_shards_[index];
+    std::lock_guard<simple_spinlock> l(*mb.lock);
+    const BlockLocation* loc = FindOrNull(*mb.blocks_by_block_id, block_id);
+    if (loc) {
+      // Share the LogBlock of any other readers of the block.
+      ReadableLogBlock* rb = &LookupOrInsert(&mb.readable_blocks, block_id,
+                                             ReadableLogBlock{ nullptr, 0 });
+      if (!rb->block) {
+        rb->block = new LogBlock(loc->container, block_id, loc->offset, loc->length);
+      }
+      rb->num_readers++;
+      lb = rb->block;
+    }
   }
   if (!lb) {
     return Status::NotFound("Can't find block", block_id.ToString());
@@ -2334,54 +2499,61 @@ bool LogBlockManager::TryUseBlockId(const BlockId& block_id) {
   return InsertIfNotPresent(&managed_block_shards_[index].open_block_ids, block_id);
 }
 
-LogBlockRefPtr LogBlockManager::CreateAndAddLogBlock(
-    LogBlockContainerRefPtr container,
-    const BlockId& block_id,
-    int64_t offset,
-    int64_t length) {
-  LogBlockRefPtr lb(new LogBlock(std::move(container), block_id, offset, length));
-  mem_tracker_->Consume(kudu_malloc_usable_size(lb.get()));
-
-  if (AddLogBlock(lb)) {
-    return lb;
-  }
-  return nullptr;
-}
-
-bool LogBlockManager::AddLogBlock(LogBlockRefPtr lb) {
-  // InsertIfNotPresent doesn't use move semantics, so instead we just
-  // insert an empty scoped_refptr and assign into it down below rather
-  // than using the utility function.
-  int index = lb->block_id().id() & kBlockMapMask;
+bool LogBlockManager::AddLogBlock(LogBlockContainer* container,
+                                  const BlockId& block_id,
+                                  int64_t offset,
+                                  int64_t length) {
+  DCHECK_GE(offset, 0);
+  DCHECK_GE(length, 0);
+  int index = block_id.id() & kBlockMapMask;
   std::lock_guard<simple_spinlock> l(*managed_block_shards_[index].lock);
   auto& blocks_by_block_id = *managed_block_shards_[index].blocks_by_block_id;
-  LogBlockRefPtr* entry_ptr = &blocks_by_block_id[lb->block_id()];
-  if (*entry_ptr) {
+  if (!InsertIfNotPresent(&blocks_by_block_id, block_id,
+                          BlockLocation{ container, offset, length })) {
     // Already have an entry for this block ID.
     return false;
   }
 
   VLOG(2) << Substitute("Added block: id $0, offset $1, length $2",
-                        lb->block_id().ToString(), lb->offset(), lb->length());
+                        block_id.ToString(), offset, length);
 
   // There may already be an entry in open_block_ids_arr_ (e.g. we just finished
   // writing out a block).
-  managed_block_shards_[index].open_block_ids.erase(lb->block_id());
+  managed_block_shards_[index].open_block_ids.erase(block_id);
   if (metrics()) {
     metrics()->blocks_under_management->Increment();
-    metrics()->bytes_under_management->IncrementBy(lb->length());
+    metrics()->bytes_under_management->IncrementBy(length);
+    metrics()->UpdateBlockMapMemoryPerBlock(mem_tracker_->consumption());
   }
-
-  *entry_ptr = std::move(lb);
   return true;
 }
 
+void LogBlockManager::ReleaseLogBlock(LogBlockRefPtr lb) {
+  {
+    int index = lb->block_id().id() & kBlockMapMask;
+    auto& mb = managed_block_shards_[index];
+    std::lock_guard<simple_spinlock> l(*mb.lock);
+
+    // The block may have been deleted since it was opened, in which case its
+    // LogBlock is no longer shared.
+    auto it = mb.readable_blocks.find(lb->block_id());
+    if (it != mb.readable_blocks.end() && it->second.block == lb.get() &&
+        --it->second.num_readers == 0) {
+      mb.readable_blocks.erase(it);
+    }
+  }
+
+  // Dropping the last reference to a deleted block punches it out, so it must
+  // be done outside of the lock.
+  lb.reset();
+}
+
 Status LogBlockManager::RemoveLogBlocks(vector<BlockId> block_ids,
                                         vector<LogBlockRefPtr>* log_blocks,
                                         vector<BlockId>* deleted) {
   Status first_failure;
   vector<LogBlockRefPtr> lbs;
-  int64_t malloc_space = 0, blocks_length = 0;
+  int64_t blocks_length = 0;
   for (const auto& block_id : block_ids) {
     LogBlockRefPtr lb;
     Status s = RemoveLogBlock(block_id, &lb);
@@ -2389,7 +2561,6 @@ Status LogBlockManager::RemoveLogBlocks(vector<BlockId> block_ids,
     if (!s.ok() && !s.IsNotFound()) {
       if (first_failure.ok()) first_failure = s;
     } else if (s.ok()) {
-      malloc_space += kudu_malloc_usable_size(lb.get());
       blocks_length += lb->length();
       lbs.emplace_back(std::move(lb));
     } else {
@@ -2398,15 +2569,15 @@ Status LogBlockManager::RemoveLogBlocks(vector<BlockId> block_ids,
   }
 
   // Update various metrics.
-  mem_tracker_->Release(malloc_space);
   if (metrics()) {
     metrics()->blocks_under_management->DecrementBy(lbs.size());
     metrics()->bytes_under_management->DecrementBy(blocks_length);
+    metrics()->UpdateBlockMapMemoryPerBlock(mem_tracker_->consumption());
   }
 
   for (auto& lb : lbs) {
     VLOG(3) << "Deleting block " << lb->block_id();
-    lb->container()->BlockDeleted(lb);
+    lb->container()->BlockDeleted(lb->offset(), lb->length());
 
     // Record the on-disk deletion.
     //
@@ -2442,14 +2613,15 @@ Status LogBlockManager::RemoveLogBlock(const BlockId& block_id,
                                        LogBlockRefPtr* lb) {
   int index = block_id.id() & kBlockMapMask;
   std::lock_guard<simple_spinlock> l(*managed_block_shards_[index].lock);
-  auto& blocks_by_block_id = managed_block_shards_[index].blocks_by_block_id;
+  auto& mb = managed_block_shards_[index];
+  auto& blocks_by_block_id = mb.blocks_by_block_id;
 
   auto it = blocks_by_block_id->find(block_id);
   if (it == blocks_by_block_id->end()) {
     return Status::NotFound("Can't find block", block_id.ToString());
   }
 
-  LogBlockContainer* container = it->second->container();
+  LogBlockContainer* container = it->second.container;
   HANDLE_DISK_FAILURE(container->read_only_status(),
       error_manager_->RunErrorNotificationCb(ErrorHandlerType::DISK_ERROR, container->data_dir()));
 
@@ -2464,7 +2636,17 @@ Status LogBlockManager::RemoveLogBlock(const BlockId& block_id,
       return Status::IOError("Block is in a failed directory");
     }
   }
-  *lb = std::move(it->second);
+
+  // If the block is open for reading, its deletion must be registered with
+  // the readers' LogBlock, so that it isn't punched out from under them. The
+  // LogBlock stops being shared, in case the block ID is reused.
+  auto rb = mb.readable_blocks.find(block_id);
+  if (rb != mb.readable_blocks.end()) {
+    *lb = rb->second.block;
+    mb.readable_blocks.erase(rb);
+  } else {
+    *lb = new LogBlock(container, block_id, it->second.offset, it->second.length);
+  }
   blocks_by_block_id->erase(it);
 
   VLOG(2) << Substitute("Removed block: id $0, offset $1, length $2",
@@ -2472,6 +2654,66 @@ Status LogBlockManager::RemoveLogBlock(const BlockId& block_id,
   return Status::OK();
 }
 
+vector<BlockRecordPB> LogBlockManager::SortedLiveBlockRecords(
+    BlockRecordMap* live_block_records) {
+  vector<BlockRecordPB> records(live_block_records->size());
+  int i = 0;
+  for (auto& e : *live_block_records) {
+    records[i].Swap(&e.second);
+    i++;
+  }
+
+  // Sort the records such that their ordering reflects the ordering in
+  // the pre-compacted metadata file.
+  //
+  // This is preferred to storing the records in an order-preserving
+  // container (such as std::map) because while records are temporarily
+  // retained for every container, only some containers will actually
+  // undergo metadata compaction.
+  std::sort(records.begin(), records.end(),
+            [](const BlockRecordPB& a, const BlockRecordPB& b) {
+    // Sort by timestamp.
+    if (a.timestamp_us() != b.timestamp_us()) {
+      return a.timestamp_us() < b.timestamp_us();
+    }
+
+    // If the timestamps match, sort by offset.
+    //
+    // If the offsets also match (i.e. both blocks are of zero length),
+    // it doesn't matter which of the two records comes first.
+    return a.offset() < b.offset();
+  });
+  return records;
+}
+
+vector<BlockRecordPB> LogBlockManager::RecordsToCompact(
+    BlockRecordMap* live_block_records,
+    const vector<LogBlockRefPtr>& dead_blocks,
+    uint64_t max_block_id) {
+  vector<BlockRecordPB> records = SortedLiveBlockRecords(live_block_records);
+  for (const auto& lb : dead_blocks) {
+    if (lb->block_id().id() != max_block_id) {
+      continue;
+    }
+    // The new records go last; only their block ID and byte range matter.
+    uint64_t now = GetCurrentTimeMicros();
+    BlockRecordPB create_record;
+    lb->block_id().CopyToPB(create_record.mutable_block_id());
+    create_record.set_op_type(CREATE);
+    create_record.set_timestamp_us(now);
+    create_record.set_offset(lb->offset());
+    create_record.set_length(lb->length());
+    BlockRecordPB delete_record;
+    lb->block_id().CopyToPB(delete_record.mutable_block_id());
+    delete_record.set_op_type(DELETE);
+    delete_record.set_timestamp_us(now);
+    records.emplace_back(std::move(create_record));
+    records.emplace_back(std::move(delete_record));
+    break;
+  }
+  return records;
+}
+
 void LogBlockManager::OpenDataDir(
     Dir* dir,
     vector<unique_ptr<internal::LogBlockContainerLoadResult>>* results,
@@ -2500,30 +2742,34 @@ void LogBlockManager::OpenDataDir(
       continue;
     }
 
-    // Add a new result for the container.
+    // Add a new result for the container, then open it and load its records
+    // asynchronously, so that the dir's threads open containers in parallel.
     results->emplace_back(new internal::LogBlockContainerLoadResult());
-    LogBlockContainerRefPtr container;
-    s = LogBlockContainer::Open(
-        this, dir, &results->back()->report, container_name, &container);
-    if (!s.ok()) {
-      if (s.IsAborted()) {
-        // Skip the container. Open() added a record of it to 'results->back()->report' for us.
-        continue;
-      }
-      if (opts_.read_only && s.IsNotFound()) {
-        // Skip the container while the operation is read-only and the files are away,
-        // especially for the kudu cli tool.
-        continue;
-      }
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", container_name));
+    dir->ExecClosure(Bind(&LogBlockManager::OpenAndLoadContainer, Unretained(this),
+                          dir, container_name, Unretained(results->back().get())));
+  }
+}
+
+void LogBlockManager::OpenAndLoadContainer(Dir* dir,
+                                           const string& container_name,
+                                           internal::LogBlockContainerLoadResult* result) {
+  LogBlockContainerRefPtr container;
+  Status s = LogBlockContainer::Open(this, dir, &result->report, container_name, &container);
+  if (!s.ok()) {
+    if (s.IsAborted()) {
+      // Skip the container. Open() added a record of it to 'result->report' for us.
       return;
     }
-
-    // Load the container's records asynchronously.
-    dir->ExecClosure(Bind(&LogBlockManager::LoadContainer, Unretained(this),
-                          dir, container, Unretained(results->back().get())));
+    if (opts_.read_only && s.IsNotFound()) {
+      // Skip the container while the operation is read-only and the files are away,
+      // especially for the kudu cli tool.
+      return;
+    }
+    result->status = s.CloneAndPrepend(Substitute(
+        "Could not open container $0", container_name));
+    return;
   }
+  LoadContainer(dir, std::move(container), result);
 }
 
 void LogBlockManager::LoadContainer(Dir* dir,
@@ -2565,7 +2811,7 @@ void LogBlockManager::LoadContainer(Dir* dir,
   // block manager. However, due to KUDU-1793, that invariant may have been
   // broken, so we'll note but otherwise allow it.
   for (const auto& e : live_blocks) {
-    if (PREDICT_FALSE(e.second->offset() %
+    if (PREDICT_FALSE(e.second.offset %
                       container->instance()->filesystem_block_size_bytes() != 0)) {
       result->report.misaligned_block_check->entries.emplace_back(
           container->ToString(), e.first);
@@ -2590,35 +2836,8 @@ void LogBlockManager::LoadContainer(Dir* dir,
       // container metadata compaction is also done in realtime. Until then,
       // it would be confusing to report it as such since it'll be a natural
       // event at startup.
-      vector<BlockRecordPB> records(live_block_records.size());
-      int i = 0;
-      for (auto& e : live_block_records) {
-        records[i].Swap(&e.second);
-        i++;
-      }
-
-      // Sort the records such that their ordering reflects the ordering in
-      // the pre-compacted metadata file.
-      //
-      // This is preferred to storing the records in an order-preserving
-      // container (such as std::map) because while records are temporarily
-      // retained for every container, only some containers will actually
-      // undergo metadata compaction.
-      std::sort(records.begin(), records.end(),
-                [](const BlockRecordPB& a, const BlockRecordPB& b) {
-        // Sort by timestamp.
-        if (a.timestamp_us() != b.timestamp_us()) {
-          return a.timestamp_us() < b.timestamp_us();
-        }
-
-        // If the timestamps match, sort by offset.
-        //
-        // If the offsets also match (i.e. both blocks are of zero length),
-        // it doesn't matter which of the two records comes first.
-        return a.offset() < b.offset();
-      });
-
-      result->low_live_block_containers[container->ToString()] = std::move(records);
+      result->low_live_block_containers[container->ToString()] =
+          RecordsToCompact(&live_block_records, dead_blocks, max_block_id);
     }
 
     // Having processed the block records, let's check whether any full
@@ -2673,6 +2892,17 @@ void LogBlockManager::LoadContainer(Dir* dir,
     }
 
     result->report.stats.lbm_full_container_count++;
+  } else if (FLAGS_log_container_metadata_compact_min_dead_blocks >= 0 &&
+             container->total_blocks() - container->live_blocks() >=
+                 FLAGS_log_container_metadata_compact_min_dead_blocks &&
+             static_cast<double>(container->live_blocks()) / container->total_blocks() <=
+                 FLAGS_log_container_live_metadata_before_compact_ratio) {
+    // Containers which aren't full yet can accumulate records of deleted
+    // blocks for a long time, so their metadata is compacted too. New records
+    // are appended to the compacted file, which acts as a checkpoint of the
+    // container's live blocks.
+    result->low_live_block_containers[container->ToString()] =
+        RecordsToCompact(&live_block_records, dead_blocks, max_block_id);
   }
   result->report.stats.live_block_bytes += container->live_bytes();
   result->report.stats.live_block_bytes_aligned += container->live_bytes_aligned();
@@ -2681,20 +2911,15 @@ void LogBlockManager::LoadContainer(Dir* dir,
 
   next_block_id_.StoreMax(max_block_id + 1);
 
-  int64_t mem_usage = 0;
-  for (UntrackedBlockMap::value_type& e : live_blocks) {
-    int block_mem = kudu_malloc_usable_size(e.second.get());
-    if (!AddLogBlock(std::move(e.second))) {
+  for (const auto& e : live_blocks) {
+    if (!AddLogBlock(container.get(), e.first, e.second.offset, e.second.length)) {
       // TODO(adar): track as an inconsistency?
       LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
                  << " which already is alive from another container when "
                  << " processing container " << container->ToString();
     }
-    mem_usage += block_mem;
   }
 
-  mem_tracker_->Consume(mem_usage);
-
   int64_t container_count = 0;
   {
     std::lock_guard<simple_spinlock> l(lock_);
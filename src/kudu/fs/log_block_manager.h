@@ -57,6 +57,7 @@ namespace internal {
 class LogBlock;
 class LogBlockContainer;
 class LogBlockDeletionTransaction;
+class LogReadableBlock;
 class LogWritableBlock;
 struct LogBlockContainerLoadResult;
 struct LogBlockManagerMetrics;
@@ -132,8 +133,10 @@ typedef scoped_refptr<internal::LogBlockContainer> LogBlockContainerRefPtr;
 // All log block manager metadata requests are served from memory. When an
 // existing block manager is opened, all on-disk container metadata is
 // parsed to build a single in-memory map describing the existence and
-// locations of various blocks. Each entry in the map consumes ~64 bytes,
-// putting the memory overhead at ~610 MB for 10 million blocks.
+// locations of various blocks. Each entry in the map is just a block's ID,
+// container and extent, consuming ~32 bytes and putting the memory overhead
+// at ~305 MB for 10 million blocks. The heavier LogBlock objects are only
+// materialized for blocks which are open for reading or being deleted.
 //
 // New blocks are placed on a filesystem block boundary, and the size of
 // hole punch requests is rounded up to the nearest filesystem block size.
@@ -214,6 +217,7 @@ class LogBlockManager : public BlockManager {
  private:
   FRIEND_TEST(LogBlockManagerTest, TestAbortBlock);
   FRIEND_TEST(LogBlockManagerTest, TestCloseFinalizedBlock);
+  FRIEND_TEST(LogBlockManagerTest, TestCommitBlocksInMultipleDirectories);
   FRIEND_TEST(LogBlockManagerTest, TestCompactFullContainerMetadataAtStartup);
   FRIEND_TEST(LogBlockManagerTest, TestFinalizeBlock);
   FRIEND_TEST(LogBlockManagerTest, TestLIFOContainerSelection);
@@ -222,19 +226,32 @@ class LogBlockManager : public BlockManager {
   FRIEND_TEST(LogBlockManagerTest, TestParseKernelRelease);
   FRIEND_TEST(LogBlockManagerTest, TestBumpBlockIds);
   FRIEND_TEST(LogBlockManagerTest, TestReuseBlockIds);
+  FRIEND_TEST(LogBlockManagerTest, TestReadersShareLogBlock);
   FRIEND_TEST(LogBlockManagerTest, TestFailMultipleTransactionsPerContainer);
 
   friend class internal::LogBlockContainer;
   friend class internal::LogBlockDeletionTransaction;
+  friend class internal::LogReadableBlock;
   friend class internal::LogWritableBlock;
 
+  // Where a live block's data is, which is all that is kept in the block map
+  // for it. There is one of these per block, so it's kept small.
+  //
+  // The container is not reference counted: a container is only destroyed
+  // once all of its blocks have been deleted.
+  struct BlockLocation {
+    internal::LogBlockContainer* container;
+    int64_t offset;
+    int64_t length;
+  };
+
   // Type for the actual block map used to store all live blocks.
   // We use sparse_hash_map<> here to reduce memory overhead.
   typedef MemTrackerAllocator<
-      std::pair<const BlockId, LogBlockRefPtr>> BlockAllocator;
+      std::pair<const BlockId, BlockLocation>> BlockAllocator;
   typedef spp::sparse_hash_map<
       BlockId,
-      LogBlockRefPtr,
+      BlockLocation,
       BlockIdHash,
       BlockIdEqual,
       BlockAllocator> BlockMap;
@@ -244,10 +261,16 @@ class LogBlockManager : public BlockManager {
   // Only used during startup.
   typedef std::unordered_map<
       const BlockId,
-      LogBlockRefPtr,
+      BlockLocation,
       BlockIdHash,
       BlockIdEqual> UntrackedBlockMap;
 
+  // A LogBlock shared by all of the readers of a block.
+  struct ReadableLogBlock {
+    internal::LogBlock* block;
+    int num_readers;
+  };
+
   // Map used to store live block records during container metadata processing.
   //
   // Only used during startup.
@@ -295,20 +318,17 @@ class LogBlockManager : public BlockManager {
   // use), false otherwise.
   bool TryUseBlockId(const BlockId& block_id);
 
-  // Creates and adds a LogBlock to in-memory data structures.
+  // Adds a block to in-memory data structures.
   //
-  // Returns the created LogBlock if it was successfully added or nullptr if a
-  // block with that ID was already present.
-  LogBlockRefPtr CreateAndAddLogBlock(
-      LogBlockContainerRefPtr container,
-      const BlockId& block_id,
-      int64_t offset,
-      int64_t length);
-
-  // Adds a LogBlock for an already-constructed LogBlock object.
-  //
-  // Returns true if the LogBlock was successfully added, false if it was already present.
-  bool AddLogBlock(LogBlockRefPtr lb);
+  // Returns true if the block was successfully added, false if it was already present.
+  bool AddLogBlock(internal::LogBlockContainer* container,
+                   const BlockId& block_id,
+                   int64_t offset,
+                   int64_t length);
+
+  // Releases a LogBlock obtained by OpenBlock(), once its reader is done
+  // with it.
+  void ReleaseLogBlock(LogBlockRefPtr lb);
 
   // Removes the given set of LogBlocks from in-memory data structures, and
   // appends the block deletion metadata to record the on-disk deletion.
@@ -368,12 +388,33 @@ class LogBlockManager : public BlockManager {
                    std::vector<std::unique_ptr<internal::LogBlockContainerLoadResult>>* results,
                    Status* result_status);
 
+  // Opens the log block container named 'container_name' in the data
+  // directory and then loads it like LoadContainer().
+  void OpenAndLoadContainer(Dir* dir,
+                            const std::string& container_name,
+                            internal::LogBlockContainerLoadResult* result);
+
   // Reads records from one log block container in the data directory.
   // The result details will be collected into 'result'.
   void LoadContainer(Dir* dir,
                      LogBlockContainerRefPtr container,
                      internal::LogBlockContainerLoadResult* result);
 
+  // Moves the records out of 'live_block_records', sorted such that their
+  // ordering reflects the ordering in the container's metadata file, for the
+  // file to be compacted by rewriting it with just them.
+  static std::vector<BlockRecordPB> SortedLiveBlockRecords(
+      BlockRecordMap* live_block_records);
+
+  // Like SortedLiveBlockRecords(), but if the block with the container's
+  // greatest ID, 'max_block_id', is one of 'dead_blocks', also keeps a CREATE
+  // and a DELETE record of it. Block IDs are allocated from the greatest ID
+  // found at startup, so dropping them could lead to block IDs being reused.
+  static std::vector<BlockRecordPB> RecordsToCompact(
+      BlockRecordMap* live_block_records,
+      const std::vector<LogBlockRefPtr>& dead_blocks,
+      uint64_t max_block_id);
+
   // Perform basic initialization.
   Status Init();
 
@@ -416,7 +457,7 @@ class LogBlockManager : public BlockManager {
 
   // Block IDs container used to prevent collisions when creating new anonymous blocks.
   struct ManagedBlockShard {
-    // Protects 'blocks_by_block_id' and 'open_block_ids'.
+    // Protects 'blocks_by_block_id', 'readable_blocks' and 'open_block_ids'.
     std::unique_ptr<simple_spinlock> lock;
 
     // Maps block IDs to blocks that are now readable, either because they
@@ -424,6 +465,12 @@ class LogBlockManager : public BlockManager {
     // they're WritableBlocks that were closed.
     std::unique_ptr<BlockMap> blocks_by_block_id;
 
+    // Maps the IDs of blocks in 'blocks_by_block_id' which are open for
+    // reading to their LogBlocks. Readers of a block share its LogBlock, so
+    // that deleting the block defers punching it out until all of them are
+    // done with it.
+    std::unordered_map<BlockId, ReadableLogBlock, BlockIdHash, BlockIdEqual> readable_blocks;
+
     // Contains block IDs for WritableBlocks that are still open for writing.
     // When a WritableBlock is closed, its ID is moved to 'blocks_by_block_id'.
     BlockIdSet open_block_ids;
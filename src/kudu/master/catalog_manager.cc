@@ -1435,6 +1435,11 @@ Status ValidateClientSchema(const optional<string>& name,
     if (!s.ok()) {
       return s.CloneAndPrepend(Substitute("invalid encoding for column '$0'", col.name()));
     }
+
+    for (ColumnAuxFileType aux_type : col.attributes().aux_files) {
+      RETURN_NOT_OK(ValidateColumnAuxFile(aux_type, col.name(), ti,
+                                          i < schema.num_key_columns()));
+    }
   }
   return Status::OK();
 }
@@ -138,6 +138,7 @@ Status Master::Init() {
   RETURN_NOT_OK(ThreadPoolBuilder("init").set_max_threads(1).Build(&init_pool_));
 
   RETURN_NOT_OK(KuduServer::Init());
+  cfile::BlockCache::GetSingleton()->OpenSsdTier(fs_manager_->uuid());
 
   if (web_server_) {
     RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
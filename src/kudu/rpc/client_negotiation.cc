@@ -67,6 +67,7 @@ using std::unique_ptr;
 
 using strings::Substitute;
 
+DECLARE_bool(rpc_compression_enabled);
 DECLARE_bool(rpc_encrypt_loopback_connections);
 
 namespace kudu {
@@ -321,6 +322,9 @@ Status ClientNegotiation::SendNegotiate() {
       client_features_.insert(TLS_AUTHENTICATION_ONLY);
     }
   }
+  if (FLAGS_rpc_compression_enabled) {
+    client_features_.insert(LZ4_COMPRESSION);
+  }
 
   for (RpcFeatureFlag feature : client_features_) {
     msg.add_supported_features(feature);
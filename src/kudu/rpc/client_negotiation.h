@@ -28,6 +28,7 @@
 #include <glog/logging.h>
 #include <sasl/sasl.h>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/negotiation.h"
 #include "kudu/rpc/rpc_header.pb.h"
@@ -94,6 +95,13 @@ class ClientNegotiation {
     return tls_negotiated_;
   }
 
+  // Returns true if both sides advertised support for compressed messages.
+  // Must be called after Negotiate().
+  bool compression_negotiated() const {
+    return ContainsKey(client_features_, LZ4_COMPRESSION) &&
+        ContainsKey(server_features_, LZ4_COMPRESSION);
+  }
+
   // Returns the set of RPC system features supported by the remote server.
   // Must be called before Negotiate().
   std::set<RpcFeatureFlag> server_features() const {
@@ -19,6 +19,7 @@
 
 #include <netinet/in.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include <algorithm>
 #include <cerrno>
@@ -31,6 +32,7 @@
 #include <boost/intrusive/detail/list_iterator.hpp>
 #include <boost/intrusive/list.hpp>
 #include <ev.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/map-util.h"
@@ -44,6 +46,10 @@
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/slice.h"
@@ -55,6 +61,46 @@
 #include <linux/tcp.h>
 #endif
 
+DEFINE_int32(rpc_read_ahead_bytes, 4096,
+             "The number of bytes read ahead from a connection's socket when "
+             "receiving RPC messages, so that small messages take a single "
+             "recv() call, and several of them which arrive together are "
+             "received together. 0 disables reading ahead.");
+DEFINE_validator(rpc_read_ahead_bytes,
+    [](const char* /*n*/, int32_t v) { return v >= 0; });
+TAG_FLAG(rpc_read_ahead_bytes, advanced);
+
+DEFINE_bool(rpc_compression_enabled, false,
+            "Whether to offer to compress RPC messages with LZ4 when negotiating "
+            "connections. Messages on connections whose remote end offers it "
+            "too are compressed if they are at least "
+            "--rpc_compression_min_message_bytes long, which trades CPU for "
+            "network bandwidth.");
+TAG_FLAG(rpc_compression_enabled, advanced);
+TAG_FLAG(rpc_compression_enabled, experimental);
+
+DEFINE_int64(rpc_compression_min_message_bytes, 16 * 1024,
+             "The size, in bytes, of the smallest RPC message which is "
+             "compressed on connections which negotiated compression. Smaller "
+             "messages are sent uncompressed.");
+DEFINE_validator(rpc_compression_min_message_bytes,
+    [](const char* /*n*/, int64_t v) { return v >= 0; });
+TAG_FLAG(rpc_compression_min_message_bytes, advanced);
+TAG_FLAG(rpc_compression_min_message_bytes, experimental);
+
+DEFINE_int64(rpc_zero_copy_min_bytes, 0,
+             "Writes of responses totalling at least this many bytes are sent "
+             "with MSG_ZEROCOPY on server connections which don't use TLS: "
+             "the kernel sends the responses and their sidecars straight from "
+             "their memory rather than copying them into the socket buffer "
+             "first, which is worthwhile for large responses such as scan "
+             "batches. Requires Linux 4.14 or later. 0 disables zero-copy "
+             "sends.");
+DEFINE_validator(rpc_zero_copy_min_bytes,
+    [](const char* /*n*/, int64_t v) { return v >= 0; });
+TAG_FLAG(rpc_zero_copy_min_bytes, advanced);
+TAG_FLAG(rpc_zero_copy_min_bytes, experimental);
+
 using std::includes;
 using std::set;
 using std::shared_ptr;
@@ -68,6 +114,12 @@ typedef OutboundCall::Phase Phase;
 
 namespace {
 
+// The maximum number of iovecs written with a single writev(), across all
+// the transfers being coalesced.
+constexpr int kMaxCoalescedIovecs = 64;
+static_assert(kMaxCoalescedIovecs >= TransferLimits::kMaxPayloadSlices,
+              "must be able to write any single transfer at once");
+
 // tcp_info struct duplicated from linux/tcp.h.
 //
 // This allows us to decouple the compile-time Linux headers from the
@@ -205,12 +257,17 @@ Connection::Connection(ReactorThread *reactor_thread,
       socket_(std::move(socket)),
       direction_(direction),
       last_activity_time_(MonoTime::Now()),
+      read_ahead_(reactor_thread->inbound_buffer_pool(), FLAGS_rpc_read_ahead_bytes),
       is_epoll_registered_(false),
       next_call_id_(1),
       credentials_policy_(policy),
       negotiation_complete_(false),
       is_confidential_(false),
-      scheduled_for_shutdown_(false) {
+      scheduled_for_shutdown_(false),
+      compression_codec_(nullptr),
+      zero_copy_(false),
+      zero_copy_sends_(0),
+      zero_copy_completed_(0) {
 }
 
 Status Connection::SetNonBlocking(bool enabled) {
@@ -260,7 +317,7 @@ bool Connection::Idle() const {
     return false;
   }
   // check if we still need to send something
-  if (!outbound_transfers_.empty()) {
+  if (!outbound_transfers_.empty() || !zero_copy_transfers_.empty()) {
     return false;
   }
   // can't kill a connection if calls are waiting response
@@ -314,19 +371,29 @@ void Connection::Shutdown(const Status &status,
   }
   awaiting_response_.clear();
 
-  // Clear any outbound transfers.
-  while (!outbound_transfers_.empty()) {
-    OutboundTransfer *t = &outbound_transfers_.front();
-    outbound_transfers_.pop_front();
-    delete t;
-  }
-
   read_io_.stop();
   write_io_.stop();
   is_epoll_registered_ = false;
   if (socket_) {
+    if (zero_copy_ && zero_copy_completed_ != zero_copy_sends_) {
+      // The kernel may still be sending from the memory of the transfers with
+      // zero-copy sends, which may be reused for other calls' data once
+      // they're destroyed below. Reset the connection, which discards the
+      // unsent data, rather than let the kernel keep sending it after the
+      // socket is closed.
+      WARN_NOT_OK(socket_->SetResetOnClose(),
+                  "Error discarding unsent zero-copy data");
+    }
     WARN_NOT_OK(socket_->Close(), "Error closing socket");
   }
+
+  // Clear any outbound transfers, now that the kernel is done with them.
+  while (!outbound_transfers_.empty()) {
+    OutboundTransfer *t = &outbound_transfers_.front();
+    outbound_transfers_.pop_front();
+    delete t;
+  }
+  zero_copy_transfers_.clear();
 }
 
 void Connection::QueueOutbound(gscoped_ptr<OutboundTransfer> transfer) {
@@ -532,8 +599,13 @@ void Connection::QueueOutboundCall(shared_ptr<OutboundCall> call) {
 
   TransferCallbacks *cb = new CallTransferCallbacks(std::move(call), this);
   awaiting_response_[call_id] = car.release();
-  QueueOutbound(gscoped_ptr<OutboundTransfer>(
-      OutboundTransfer::CreateForCallRequest(call_id, tmp_slices, n_slices, cb)));
+  gscoped_ptr<OutboundTransfer> t(
+      OutboundTransfer::CreateForCallRequest(call_id, tmp_slices, n_slices, cb));
+  if (compression_codec_) {
+    t->MaybeCompress(compression_codec_, FLAGS_rpc_compression_min_message_bytes,
+                     reactor_thread_->compression_metrics());
+  }
+  QueueOutbound(std::move(t));
 }
 
 // Callbacks for sending an RPC call response from the server.
@@ -613,6 +685,11 @@ void Connection::QueueResponseForCall(gscoped_ptr<InboundCall> call) {
   // when sending responses.
   gscoped_ptr<OutboundTransfer> t(
       OutboundTransfer::CreateForCallResponse(tmp_slices, n_slices, cb));
+  // Compress the response here rather than on the reactor thread.
+  if (compression_codec_) {
+    t->MaybeCompress(compression_codec_, FLAGS_rpc_compression_min_message_bytes,
+                     reactor_thread_->compression_metrics());
+  }
 
   QueueTransferTask *task = new QueueTransferTask(std::move(t), this);
   reactor_thread_->reactor()->ScheduleReactorTask(task);
@@ -622,6 +699,32 @@ void Connection::set_confidential(bool is_confidential) {
   is_confidential_ = is_confidential;
 }
 
+void Connection::set_compression_enabled(bool enabled) {
+  compression_codec_ = nullptr;
+  if (enabled) {
+    CHECK_OK(GetCompressionCodec(LZ4, &compression_codec_));
+  }
+}
+
+void Connection::MaybeEnableZeroCopy() {
+  DCHECK_EQ(direction_, SERVER);
+  zero_copy_ = false;
+  if (FLAGS_rpc_zero_copy_min_bytes == 0) {
+    return;
+  }
+  Status s = socket_->EnableZeroCopy();
+  if (s.IsNotSupported()) {
+    VLOG(2) << ToString() << ": not using zero-copy sends: " << s.ToString();
+    return;
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << ToString() << ": could not enable zero-copy sends: "
+                                   << s.ToString() << THROTTLE_MSG;
+    return;
+  }
+  zero_copy_ = true;
+}
+
 bool Connection::SatisfiesCredentialsPolicy(CredentialsPolicy policy) const {
   DCHECK_EQ(direction_, CLIENT);
   return (policy == CredentialsPolicy::ANY_CREDENTIALS) ||
@@ -643,11 +746,27 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
   }
   last_activity_time_ = reactor_thread_->cur_time();
 
+  // Completions of zero-copy sends are signalled as errors on the socket,
+  // which wake up the read watcher.
+  if (zero_copy_ && zero_copy_completed_ != zero_copy_sends_) {
+    Status s = HandleZeroCopyCompletions();
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(WARNING) << ToString() << " error reading zero-copy completions: " << s.ToString();
+      reactor_thread_->DestroyConnection(this, s);
+      return;
+    }
+  }
+
+  // Handling a call may destroy the connection, which we may still need to
+  // read the next one from.
+  scoped_refptr<Connection> self(this);
   while (true) {
     if (!inbound_) {
-      inbound_.reset(new InboundTransfer());
+      inbound_.reset(new InboundTransfer(reactor_thread_->inbound_buffer_pool(),
+                                         compression_codec_,
+                                         reactor_thread_->compression_metrics()));
     }
-    Status status = inbound_->ReceiveBuffer(*socket_);
+    Status status = inbound_->ReceiveBuffer(*socket_, &read_ahead_);
     if (PREDICT_FALSE(!status.ok())) {
       if (status.posix_code() == ESHUTDOWN) {
         VLOG(1) << ToString() << " shut down by remote end.";
@@ -671,14 +790,15 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
       LOG(FATAL) << "Invalid direction: " << direction_;
     }
 
-    // TODO: it would seem that it would be good to loop around and see if
-    // there is more data on the socket by trying another recv(), but it turns
-    // out that it really hurts throughput to do so. A better approach
-    // might be for each InboundTransfer to actually try to read an extra byte,
-    // and if it succeeds, then we'd copy that byte into a new InboundTransfer
-    // and loop around, since it's likely the next call also arrived at the
+    // Trying another recv() here to see whether there is more data on the
+    // socket really hurts throughput, as usually there isn't. However, the
+    // data that was read ahead along with this message has to be handled
+    // now: it no longer makes the socket readable, so nothing would wake us
+    // up for it. It's likely to hold the next call, which arrived at the
     // same time.
-    break;
+    if (read_ahead_.empty() || !is_epoll_registered_) {
+      break;
+    }
   }
 }
 
@@ -735,6 +855,42 @@ void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
   MaybeInjectCancellation(car->call);
 }
 
+bool Connection::StartOutboundTransfer(OutboundTransfer* transfer) {
+  if (!transfer->is_for_outbound_call()) {
+    return true;
+  }
+  CallAwaitingResponse* car = FindOrDie(awaiting_response_, transfer->call_id());
+  if (!car->call) {
+    // If the call has already timed out or has already been cancelled, the 'call'
+    // field would be set to NULL. In that case, don't bother sending it.
+    transfer->Abort(Status::Aborted("already timed out or cancelled"));
+    return false;
+  }
+
+  // If this is the start of the transfer, then check if the server has the
+  // required RPC flags. We have to wait until just before the transfer in
+  // order to ensure that the negotiation has taken place, so that the flags
+  // are available.
+  const set<RpcFeatureFlag>& required_features = car->call->required_rpc_features();
+  if (!includes(remote_features_.begin(), remote_features_.end(),
+                required_features.begin(), required_features.end())) {
+    Status s = Status::NotSupported("server does not support the required RPC features");
+    transfer->Abort(s);
+    Phase phase = negotiation_complete_ ? Phase::REMOTE_CALL : Phase::CONNECTION_NEGOTIATION;
+    car->call->SetFailed(std::move(s), phase);
+    // Test cancellation when 'call_' is in 'FINISHED_ERROR' state.
+    MaybeInjectCancellation(car->call);
+    car->call.reset();
+    return false;
+  }
+
+  car->call->SetSending();
+
+  // Test cancellation when 'call_' is in 'SENDING' state.
+  MaybeInjectCancellation(car->call);
+  return true;
+}
+
 void Connection::WriteHandler(ev::io &watcher, int revents) {
   DCHECK(reactor_thread_->IsCurrentThread());
 
@@ -745,7 +901,6 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   }
   DVLOG(3) << ToString() << ": writeHandler: revents = " << revents;
 
-  OutboundTransfer *transfer;
   if (outbound_transfers_.empty()) {
     LOG(WARNING) << ToString() << " got a ready-to-write callback, but there is "
       "nothing to write.";
@@ -754,62 +909,83 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   }
 
   while (!outbound_transfers_.empty()) {
-    transfer = &(outbound_transfers_.front());
-
-    if (!transfer->TransferStarted()) {
-
-      if (transfer->is_for_outbound_call()) {
-        CallAwaitingResponse* car = FindOrDie(awaiting_response_, transfer->call_id());
-        if (!car->call) {
-          // If the call has already timed out or has already been cancelled, the 'call'
-          // field would be set to NULL. In that case, don't bother sending it.
-          outbound_transfers_.pop_front();
-          transfer->Abort(Status::Aborted("already timed out or cancelled"));
-          delete transfer;
-          continue;
-        }
-
-        // If this is the start of the transfer, then check if the server has the
-        // required RPC flags. We have to wait until just before the transfer in
-        // order to ensure that the negotiation has taken place, so that the flags
-        // are available.
-        const set<RpcFeatureFlag>& required_features = car->call->required_rpc_features();
-        if (!includes(remote_features_.begin(), remote_features_.end(),
-                      required_features.begin(), required_features.end())) {
-          outbound_transfers_.pop_front();
-          Status s = Status::NotSupported("server does not support the required RPC features");
-          transfer->Abort(s);
-          Phase phase = negotiation_complete_ ? Phase::REMOTE_CALL : Phase::CONNECTION_NEGOTIATION;
-          car->call->SetFailed(std::move(s), phase);
-          // Test cancellation when 'call_' is in 'FINISHED_ERROR' state.
-          MaybeInjectCancellation(car->call);
-          car->call.reset();
-          delete transfer;
-          continue;
-        }
-
-        car->call->SetSending();
-
-        // Test cancellation when 'call_' is in 'SENDING' state.
-        MaybeInjectCancellation(car->call);
+    // Coalesce as many of the queued transfers as fit into a single writev(),
+    // so that a burst of small calls or responses costs a single syscall.
+    struct iovec iov[kMaxCoalescedIovecs];
+    int n_iov = 0;
+    auto it = outbound_transfers_.begin();
+    while (it != outbound_transfers_.end() &&
+           n_iov + it->num_remaining_slices() <= kMaxCoalescedIovecs) {
+      OutboundTransfer* transfer = &*it;
+      if (!transfer->TransferStarted() && !StartOutboundTransfer(transfer)) {
+        it = outbound_transfers_.erase(it);
+        delete transfer;
+        continue;
       }
+      n_iov += transfer->FillIovecs(&iov[n_iov]);
+      ++it;
+    }
+    if (n_iov == 0) {
+      // Every transfer we looked at was aborted.
+      continue;
+    }
+
+    // Large enough writes are sent with MSG_ZEROCOPY. Only responses are sent
+    // on server connections, so the transfers can simply be held on to until
+    // the kernel is done with their memory.
+    bool zero_copy = false;
+    if (zero_copy_) {
+      int64_t n_bytes = 0;
+      for (int i = 0; i < n_iov; i++) {
+        n_bytes += iov[i].iov_len;
+      }
+      zero_copy = n_bytes >= FLAGS_rpc_zero_copy_min_bytes;
     }
 
     last_activity_time_ = reactor_thread_->cur_time();
-    Status status = transfer->SendBuffer(*socket_);
+    int64_t written;
+    Status status = zero_copy ? socket_->WritevZeroCopy(iov, n_iov, &written)
+                              : socket_->Writev(iov, n_iov, &written);
+    if (zero_copy && status.posix_code() == ENOBUFS) {
+      // Too many zero-copy sends are still in flight for the socket's
+      // option memory limit to track another one.
+      zero_copy = false;
+      status = socket_->Writev(iov, n_iov, &written);
+    }
     if (PREDICT_FALSE(!status.ok())) {
+      if (Socket::IsTemporarySocketError(status.posix_code())) {
+        DVLOG(3) << ToString() << ": writeHandler: socket not ready.";
+        return;
+      }
       LOG(WARNING) << ToString() << " send error: " << status.ToString();
       reactor_thread_->DestroyConnection(this, status);
       return;
     }
 
-    if (!transfer->TransferFinished()) {
-      DVLOG(3) << ToString() << ": writeHandler: xfer not finished.";
-      return;
-    }
+    const uint32_t send_id = zero_copy ? zero_copy_sends_++ : 0;
 
-    outbound_transfers_.pop_front();
-    delete transfer;
+    // Retire the transfers which were sent in full.
+    while (!outbound_transfers_.empty()) {
+      OutboundTransfer* transfer = &outbound_transfers_.front();
+      if (!transfer->TransferStarted()) {
+        // Not part of this writev().
+        break;
+      }
+      if (zero_copy) {
+        transfer->MarkZeroCopySend(send_id);
+      }
+      written -= transfer->Advance(written);
+      if (!transfer->TransferFinished()) {
+        DCHECK_EQ(0, written);
+        DVLOG(3) << ToString() << ": writeHandler: xfer not finished.";
+        return;
+      }
+      outbound_transfers_.pop_front();
+      RetireOutboundTransfer(transfer);
+      if (written == 0) {
+        break;
+      }
+    }
   }
 
   // If we were able to write all of our outbound transfers,
@@ -817,6 +993,48 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   write_io_.stop();
 }
 
+void Connection::RetireOutboundTransfer(OutboundTransfer* transfer) {
+  if (transfer->zero_copy_pending()) {
+    if (!ZeroCopySendCompleted(transfer->last_zero_copy_send())) {
+      zero_copy_transfers_.emplace_back(transfer);
+      return;
+    }
+    transfer->ZeroCopySendsCompleted();
+  }
+  delete transfer;
+}
+
+Status Connection::HandleZeroCopyCompletions() {
+  RETURN_NOT_OK(socket_->ReadZeroCopyCompletions([this](uint32_t first, uint32_t last) {
+    if (first != zero_copy_completed_) {
+      zero_copy_completed_early_.emplace(first, last);
+      return;
+    }
+    zero_copy_completed_ = last + 1;
+    auto it = zero_copy_completed_early_.find(zero_copy_completed_);
+    while (it != zero_copy_completed_early_.end()) {
+      zero_copy_completed_ = it->second + 1;
+      zero_copy_completed_early_.erase(it);
+      it = zero_copy_completed_early_.find(zero_copy_completed_);
+    }
+  }));
+
+  // The transfers were sent in order, so those whose sends completed are at
+  // the front.
+  while (!zero_copy_transfers_.empty() &&
+         ZeroCopySendCompleted(zero_copy_transfers_.front()->last_zero_copy_send())) {
+    unique_ptr<OutboundTransfer> transfer = std::move(zero_copy_transfers_.front());
+    zero_copy_transfers_.pop_front();
+    transfer->ZeroCopySendsCompleted();
+  }
+  return Status::OK();
+}
+
+bool Connection::ZeroCopySendCompleted(uint32_t send_id) const {
+  // Compare modulo 2^32, as the send numbers wrap around.
+  return static_cast<int32_t>(send_id - zero_copy_completed_) < 0;
+}
+
 std::string Connection::ToString() const {
   // This may be called from other threads, so we cannot
   // include anything in the output about the current state,
@@ -20,7 +20,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <limits>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -48,6 +50,8 @@
 
 namespace kudu {
 
+class CompressionCodec;
+
 namespace rpc {
 
 class DumpConnectionsRequestPB;
@@ -165,6 +169,15 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Set/unset the 'confidentiality' property for this connection.
   void set_confidential(bool is_confidential);
 
+  // Set whether messages sent and received on the connection may be
+  // compressed, as negotiated with the remote end.
+  void set_compression_enabled(bool enabled);
+
+  // Send large responses on the connection with MSG_ZEROCOPY, if enabled by
+  // --rpc_zero_copy_min_bytes and supported by its socket. Must be called
+  // after negotiation, once the connection has adopted its final socket.
+  void MaybeEnableZeroCopy();
+
   // Credentials policy to start connection negotiation.
   CredentialsPolicy credentials_policy() const { return credentials_policy_; }
 
@@ -302,6 +315,21 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // This must be called from the reactor thread.
   void QueueOutbound(gscoped_ptr<OutboundTransfer> transfer);
 
+  // Prepare to start sending 'transfer'. Returns false if it mustn't be sent
+  // after all, in which case it has been aborted and should be discarded.
+  bool StartOutboundTransfer(OutboundTransfer* transfer);
+
+  // Delete a transfer which has been sent in full, or, if the kernel may
+  // still be reading its memory, hold on to it until it no longer does.
+  void RetireOutboundTransfer(OutboundTransfer* transfer);
+
+  // Read the notifications of completed zero-copy sends from the socket,
+  // and delete the transfers which were waiting for them.
+  Status HandleZeroCopyCompletions();
+
+  // Whether the zero-copy send numbered 'send_id' has completed.
+  bool ZeroCopySendCompleted(uint32_t send_id) const;
+
   // Internal test function for injecting cancellation request when 'call'
   // reaches state specified in 'FLAGS_rpc_inject_cancellation_state'.
   void MaybeInjectCancellation(const std::shared_ptr<OutboundCall> &call);
@@ -333,6 +361,10 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // the inbound transfer, if any
   gscoped_ptr<InboundTransfer> inbound_;
 
+  // Data read ahead from the socket, which inbound transfers are received
+  // through.
+  ReadAheadBuffer read_ahead_;
+
   // notifies us when our socket is writable.
   ev::io write_io_;
 
@@ -393,6 +425,27 @@ class Connection : public RefCountedThreadSafe<Connection> {
 
   // Whether the connection is scheduled for shutdown.
   bool scheduled_for_shutdown_;
+
+  // The codec which messages on the connection may be compressed with, or
+  // null if compression wasn't negotiated.
+  const CompressionCodec* compression_codec_;
+
+  // Whether large responses are sent with MSG_ZEROCOPY.
+  bool zero_copy_;
+
+  // The number of zero-copy sends made on the socket, which the kernel
+  // numbers consecutively from 0, and the number of the first one which
+  // hasn't completed yet. Both wrap around.
+  uint32_t zero_copy_sends_;
+  uint32_t zero_copy_completed_;
+
+  // Completed ranges of zero-copy sends which were reported before the
+  // sends preceding them, keyed by the first send of each range.
+  std::map<uint32_t, uint32_t> zero_copy_completed_early_;
+
+  // Transfers which were sent in full with MSG_ZEROCOPY, but whose last send
+  // hasn't completed yet, in the order they were sent.
+  std::deque<std::unique_ptr<OutboundTransfer>> zero_copy_transfers_;
 };
 
 } // namespace rpc
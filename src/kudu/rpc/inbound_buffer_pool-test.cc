@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/inbound_buffer_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+namespace rpc {
+
+class InboundBufferPoolTest : public KuduTest {
+ protected:
+  static constexpr size_t kMaxBufferSize = 64 * 1024;
+  static constexpr size_t kCapacity = 128 * 1024;
+
+  InboundBufferPoolTest()
+      : pool_(new InboundBufferPool(kMaxBufferSize, kCapacity)) {
+  }
+
+  scoped_refptr<InboundBufferPool> pool_;
+};
+
+constexpr size_t InboundBufferPoolTest::kMaxBufferSize;
+constexpr size_t InboundBufferPoolTest::kCapacity;
+
+TEST_F(InboundBufferPoolTest, TestBuffersAreReused) {
+  size_t capacity;
+  uint8_t* buf = InboundBufferPool::Acquire(pool_.get(), 5000, &capacity);
+  ASSERT_EQ(8192, capacity);
+  ASSERT_EQ(1, pool_->num_misses());
+  InboundBufferPool::Release(pool_.get(), buf, capacity);
+  ASSERT_EQ(8192, pool_->free_bytes());
+
+  // A message of the same size class gets the same buffer back.
+  size_t capacity2;
+  uint8_t* buf2 = InboundBufferPool::Acquire(pool_.get(), 8000, &capacity2);
+  ASSERT_EQ(buf, buf2);
+  ASSERT_EQ(capacity, capacity2);
+  ASSERT_EQ(1, pool_->num_hits());
+  ASSERT_EQ(0, pool_->free_bytes());
+
+  // One of another size class doesn't.
+  size_t capacity3;
+  uint8_t* buf3 = InboundBufferPool::Acquire(pool_.get(), 100, &capacity3);
+  ASSERT_EQ(InboundBufferPool::kMinBufferSize, capacity3);
+  ASSERT_EQ(2, pool_->num_misses());
+
+  InboundBufferPool::Release(pool_.get(), buf2, capacity2);
+  InboundBufferPool::Release(pool_.get(), buf3, capacity3);
+  ASSERT_EQ(8192 + InboundBufferPool::kMinBufferSize, pool_->free_bytes());
+}
+
+TEST_F(InboundBufferPoolTest, TestLargeBuffersAreNotPooled) {
+  size_t capacity;
+  uint8_t* buf = InboundBufferPool::Acquire(pool_.get(), kMaxBufferSize + 1, &capacity);
+  ASSERT_EQ(kMaxBufferSize + 1, capacity);
+  InboundBufferPool::Release(pool_.get(), buf, capacity);
+  ASSERT_EQ(0, pool_->free_bytes());
+}
+
+TEST_F(InboundBufferPoolTest, TestCapacity) {
+  // Only as many free buffers are kept as fit in the capacity of the pool.
+  const int kNumBuffers = 2 * kCapacity / kMaxBufferSize;
+  uint8_t* bufs[kNumBuffers];
+  size_t capacity;
+  for (int i = 0; i < kNumBuffers; i++) {
+    bufs[i] = InboundBufferPool::Acquire(pool_.get(), kMaxBufferSize, &capacity);
+    ASSERT_EQ(kMaxBufferSize, capacity);
+  }
+  for (int i = 0; i < kNumBuffers; i++) {
+    InboundBufferPool::Release(pool_.get(), bufs[i], capacity);
+  }
+  ASSERT_EQ(kCapacity, pool_->free_bytes());
+}
+
+TEST_F(InboundBufferPoolTest, TestNullPool) {
+  size_t capacity;
+  uint8_t* buf = InboundBufferPool::Acquire(nullptr, 100, &capacity);
+  ASSERT_EQ(100, capacity);
+  InboundBufferPool::Release(nullptr, buf, capacity);
+}
+
+} // namespace rpc
+} // namespace kudu
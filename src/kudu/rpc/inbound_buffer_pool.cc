@@ -0,0 +1,166 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/inbound_buffer_pool.h"
+
+#include <mutex>
+#include <ostream>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/util/flag_tags.h"
+
+DEFINE_int64(rpc_inbound_buffer_pool_capacity_mb, 16,
+             "The maximum total size, in MiB, of the free buffers which each "
+             "reactor thread keeps around to receive inbound RPC messages "
+             "into. 0 disables pooling of these buffers.");
+DEFINE_validator(rpc_inbound_buffer_pool_capacity_mb,
+    [](const char* /*n*/, int64_t v) { return v >= 0; });
+TAG_FLAG(rpc_inbound_buffer_pool_capacity_mb, advanced);
+TAG_FLAG(rpc_inbound_buffer_pool_capacity_mb, experimental);
+
+DEFINE_int64(rpc_inbound_buffer_pool_max_buffer_size, 1024 * 1024,
+             "The size, in bytes, of the largest inbound RPC message whose "
+             "buffer is pooled. Buffers of larger messages are allocated and "
+             "freed with each message.");
+DEFINE_validator(rpc_inbound_buffer_pool_max_buffer_size,
+    [](const char* /*n*/, int64_t v) { return v > 0; });
+TAG_FLAG(rpc_inbound_buffer_pool_max_buffer_size, advanced);
+TAG_FLAG(rpc_inbound_buffer_pool_max_buffer_size, experimental);
+
+namespace kudu {
+namespace rpc {
+
+constexpr size_t InboundBufferPool::kMinBufferSize;
+
+InboundBufferPool::InboundBufferPool(size_t max_buffer_size, size_t capacity)
+    : max_buffer_size_(max_buffer_size),
+      capacity_(capacity),
+      free_bytes_(0),
+      num_hits_(0),
+      num_misses_(0) {
+  int num_classes = 1;
+  while ((kMinBufferSize << (num_classes - 1)) < max_buffer_size_) {
+    num_classes++;
+  }
+  free_buffers_.resize(num_classes);
+}
+
+InboundBufferPool::~InboundBufferPool() {
+  for (const auto& buffers : free_buffers_) {
+    for (uint8_t* buf : buffers) {
+      delete[] buf;
+    }
+  }
+}
+
+scoped_refptr<InboundBufferPool> InboundBufferPool::CreateFromFlags() {
+  if (FLAGS_rpc_inbound_buffer_pool_capacity_mb == 0) {
+    return nullptr;
+  }
+  return make_scoped_refptr(new InboundBufferPool(
+      FLAGS_rpc_inbound_buffer_pool_max_buffer_size,
+      FLAGS_rpc_inbound_buffer_pool_capacity_mb * 1024 * 1024));
+}
+
+uint8_t* InboundBufferPool::Acquire(InboundBufferPool* pool, size_t size, size_t* capacity) {
+  if (pool) {
+    return pool->AcquireBuffer(size, capacity);
+  }
+  *capacity = size;
+  return new uint8_t[size];
+}
+
+void InboundBufferPool::Release(InboundBufferPool* pool, uint8_t* buf, size_t capacity) {
+  if (pool) {
+    pool->ReleaseBuffer(buf, capacity);
+    return;
+  }
+  delete[] buf;
+}
+
+int InboundBufferPool::SizeClass(size_t size) const {
+  if (size > max_buffer_size_) {
+    return -1;
+  }
+  int size_class = 0;
+  while ((kMinBufferSize << size_class) < size) {
+    size_class++;
+  }
+  DCHECK_LT(size_class, free_buffers_.size());
+  return size_class;
+}
+
+uint8_t* InboundBufferPool::AcquireBuffer(size_t size, size_t* capacity) {
+  int size_class = SizeClass(size);
+  if (size_class == -1) {
+    *capacity = size;
+    return new uint8_t[size];
+  }
+  *capacity = kMinBufferSize << size_class;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    auto& buffers = free_buffers_[size_class];
+    if (!buffers.empty()) {
+      uint8_t* buf = buffers.back();
+      buffers.pop_back();
+      free_bytes_ -= *capacity;
+      num_hits_++;
+      return buf;
+    }
+    num_misses_++;
+  }
+  return new uint8_t[*capacity];
+}
+
+void InboundBufferPool::ReleaseBuffer(uint8_t* buf, size_t capacity) {
+  // Most buffers which were too large to be pooled don't have the size of
+  // any size class, and are freed. Any which happen to are as good as pooled
+  // ones.
+  for (int size_class = 0; size_class < free_buffers_.size(); size_class++) {
+    if ((kMinBufferSize << size_class) != capacity) {
+      continue;
+    }
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (free_bytes_ + capacity <= capacity_) {
+      free_buffers_[size_class].push_back(buf);
+      free_bytes_ += capacity;
+      return;
+    }
+    break;
+  }
+  delete[] buf;
+}
+
+size_t InboundBufferPool::free_bytes() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return free_bytes_;
+}
+
+int64_t InboundBufferPool::num_hits() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return num_hits_;
+}
+
+int64_t InboundBufferPool::num_misses() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return num_misses_;
+}
+
+} // namespace rpc
+} // namespace kudu
@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+namespace rpc {
+
+// A pool of buffers which inbound RPC messages are received into.
+//
+// Each reactor thread receives messages into buffers from its own pool, so
+// that the buffer of a message doesn't have to be allocated from scratch. The
+// buffer lives as long as the call or response it was parsed into, whose
+// request, response and sidecars all point into it, and is then returned to
+// the pool. Since calls may be destroyed on any thread, and after the reactor
+// is gone, buffers hold a reference to the pool.
+//
+// Buffers are pooled in power-of-two size classes, from kMinBufferSize up to
+// 'max_buffer_size' bytes. Larger buffers are allocated and freed as needed,
+// as are those which don't fit within 'capacity' bytes of free buffers.
+//
+// This class is thread-safe.
+class InboundBufferPool : public RefCountedThreadSafe<InboundBufferPool> {
+ public:
+  static constexpr size_t kMinBufferSize = 4096;
+
+  InboundBufferPool(size_t max_buffer_size, size_t capacity);
+
+  // Create a pool configured by the --rpc_inbound_buffer_pool_* flags, or
+  // return null if pooling is disabled.
+  static scoped_refptr<InboundBufferPool> CreateFromFlags();
+
+  // Return a buffer of at least 'size' bytes, storing its actual size in
+  // 'capacity'. The contents of the buffer are undefined.
+  //
+  // 'pool' may be null, in which case the buffer is simply allocated.
+  static uint8_t* Acquire(InboundBufferPool* pool, size_t size, size_t* capacity);
+
+  // Return a buffer obtained from Acquire() with the same 'pool'.
+  static void Release(InboundBufferPool* pool, uint8_t* buf, size_t capacity);
+
+  // The total size of the free buffers held by the pool.
+  size_t free_bytes() const;
+
+  // The number of buffers acquired from the pool without allocating.
+  int64_t num_hits() const;
+
+  // The number of buffers acquired from the pool which had to be allocated.
+  int64_t num_misses() const;
+
+ private:
+  friend class RefCountedThreadSafe<InboundBufferPool>;
+  ~InboundBufferPool();
+
+  // Return the size class for a buffer of 'size' bytes, or -1 if buffers
+  // of that size aren't pooled.
+  int SizeClass(size_t size) const;
+
+  uint8_t* AcquireBuffer(size_t size, size_t* capacity);
+  void ReleaseBuffer(uint8_t* buf, size_t capacity);
+
+  const size_t max_buffer_size_;
+  const size_t capacity_;
+
+  mutable simple_spinlock lock_;
+
+  // The free buffers of each size class. Buffers are reused most recently
+  // freed first, as those are the most likely to still be in the CPU caches.
+  std::vector<std::vector<uint8_t*>> free_buffers_;
+  size_t free_bytes_;
+  int64_t num_hits_;
+  int64_t num_misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(InboundBufferPool);
+};
+
+} // namespace rpc
+} // namespace kudu
@@ -21,12 +21,14 @@
 #include <memory>
 #include <ostream>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/message_lite.h>
 
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/rpc/connection.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/rpc_sidecar.h"
@@ -37,7 +39,10 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/process_memory.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
+#include "kudu/util/trace_metrics.h"
 
 namespace google {
 namespace protobuf {
@@ -45,6 +50,9 @@ class FieldDescriptor;
 }
 }
 
+DECLARE_bool(rpc_call_profiling);
+DECLARE_bool(rpc_call_profiling_allocations);
+
 using google::protobuf::FieldDescriptor;
 using google::protobuf::Message;
 using google::protobuf::MessageLite;
@@ -59,6 +67,10 @@ namespace rpc {
 InboundCall::InboundCall(Connection* conn)
   : conn_(conn),
     trace_(new Trace),
+    handler_thread_id_(-1),
+    handler_cpu_start_us_(0),
+    handler_bytes_allocated_start_(0),
+    handler_count_allocations_(false),
     method_info_(nullptr),
     deadline_(MonoTime::Max()) {
   RecordCallReceived();
@@ -288,6 +300,16 @@ void InboundCall::RecordHandlingStarted(Histogram* incoming_queue_time) {
   timing_.time_handled = MonoTime::Now();
   incoming_queue_time->Increment(
       (timing_.time_handled - timing_.time_received).ToMicroseconds());
+
+  if (FLAGS_rpc_call_profiling) {
+    handler_thread_id_ = Thread::CurrentThreadId();
+    handler_cpu_start_us_ = GetThreadCpuTimeMicros();
+    handler_count_allocations_ = FLAGS_rpc_call_profiling_allocations;
+    if (handler_count_allocations_) {
+      process_memory::StartCountingThreadAllocations();
+      handler_bytes_allocated_start_ = process_memory::ThreadBytesAllocated();
+    }
+  }
 }
 
 void InboundCall::RecordHandlingCompleted() {
@@ -304,6 +326,21 @@ void InboundCall::RecordHandlingCompleted() {
     method_info_->handler_latency_histogram->Increment(
         (timing_.ProcessingDuration()).ToMicroseconds());
   }
+
+  // Calls which are handed off to other threads to respond to, such as
+  // writes, use resources on those which can't be attributed to them here.
+  if (handler_thread_id_ != -1 && handler_thread_id_ == Thread::CurrentThreadId()) {
+    RecordHandlerResourceUsage();
+  }
+}
+
+void InboundCall::RecordHandlerResourceUsage() {
+  TraceMetrics* metrics = trace_->metrics();
+  metrics->Increment("handler_cpu_us", GetThreadCpuTimeMicros() - handler_cpu_start_us_);
+  if (handler_count_allocations_) {
+    metrics->Increment("handler_allocated_bytes",
+                       process_memory::ThreadBytesAllocated() - handler_bytes_allocated_start_);
+  }
 }
 
 bool InboundCall::ClientTimedOut() const {
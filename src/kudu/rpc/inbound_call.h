@@ -238,6 +238,11 @@ class InboundCall {
   // Not thread-safe. Should only be called by the current "owner" thread.
   void RecordHandlingCompleted();
 
+  // Add the CPU time and allocations of the thread which handled the call
+  // to the call's trace metrics. Only called if the call is responded to
+  // from the thread which started handling it.
+  void RecordHandlerResourceUsage();
+
   // The connection on which this inbound call arrived.
   scoped_refptr<Connection> conn_;
 
@@ -275,6 +280,14 @@ class InboundCall {
   // Timing information related to this RPC call.
   InboundCallTiming timing_;
 
+  // The thread which started handling the call, and the CPU time it had used
+  // and bytes it had allocated by then, if --rpc_call_profiling is enabled.
+  // Otherwise the thread ID is -1.
+  int64_t handler_thread_id_;
+  int64_t handler_cpu_start_us_;
+  int64_t handler_bytes_allocated_start_;
+  bool handler_count_allocations_;
+
   // Proto service this calls belongs to. Used for routing.
   // This field is filled in when the inbound request header is parsed.
   RemoteMethod remote_method_;
@@ -219,6 +219,7 @@ static Status DoClientNegotiation(Connection* conn,
 
   // Transfer the negotiated socket and state back to the connection.
   conn->adopt_socket(client_negotiation.release_socket());
+  conn->set_compression_enabled(client_negotiation.compression_negotiated());
   conn->set_remote_features(client_negotiation.take_server_features());
   conn->set_confidential(client_negotiation.tls_negotiated() ||
       (conn->socket()->IsLoopbackConnection() && !FLAGS_rpc_encrypt_loopback_connections));
@@ -274,6 +275,8 @@ static Status DoServerNegotiation(Connection* conn,
 
   // Transfer the negotiated socket and state back to the connection.
   conn->adopt_socket(server_negotiation.release_socket());
+  conn->set_compression_enabled(server_negotiation.compression_negotiated());
+  conn->MaybeEnableZeroCopy();
   conn->set_remote_features(server_negotiation.take_client_features());
   conn->set_remote_user(server_negotiation.take_authenticated_user());
   conn->set_confidential(server_negotiation.tls_negotiated() ||
@@ -42,6 +42,7 @@
 #include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/server_negotiation.h"
+#include "kudu/rpc/thread_pinning.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/sanitizer_scopes.h"
 #include "kudu/util/flag_tags.h"
@@ -153,13 +154,15 @@ ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder& bld)
     coarse_timer_granularity_(bld.coarse_timer_granularity_),
     total_client_conns_cnt_(0),
     total_server_conns_cnt_(0),
-    rng_(GetRandomSeed32()) {
+    rng_(GetRandomSeed32()),
+    inbound_buffer_pool_(InboundBufferPool::CreateFromFlags()) {
 
   if (bld.metric_entity_) {
     invoke_us_histogram_ =
         METRIC_reactor_active_latency_us.Instantiate(bld.metric_entity_);
     load_percent_histogram_ =
         METRIC_reactor_load_percent.Instantiate(bld.metric_entity_);
+    compression_metrics_.reset(new RpcCompressionMetrics(bld.metric_entity_));
   }
 }
 
@@ -494,6 +497,7 @@ void ReactorThread::RunThread() {
   ThreadRestrictions::SetWaitAllowed(false);
   ThreadRestrictions::SetIOAllowed(false);
   DVLOG(6) << "Calling ReactorThread::RunThread()...";
+  MaybePinRpcThread(RpcThreadKind::REACTOR, name());
   loop_.run(0);
   VLOG(1) << name() << " thread exiting.";
 
@@ -32,8 +32,10 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/connection.h"
 #include "kudu/rpc/connection_id.h"
+#include "kudu/rpc/inbound_buffer_pool.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/rpc/transfer.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
@@ -198,6 +200,18 @@ class ReactorThread {
   // Must be called from the reactor thread.
   Status GetMetrics(ReactorMetrics *metrics);
 
+  // The pool of buffers that connections of this reactor receive messages
+  // into, or null if they aren't pooled.
+  const scoped_refptr<InboundBufferPool>& inbound_buffer_pool() const {
+    return inbound_buffer_pool_;
+  }
+
+  // Metrics on the compression of messages sent and received by connections
+  // of this reactor, or null if the messenger has no metric entity.
+  const RpcCompressionMetrics* compression_metrics() const {
+    return compression_metrics_.get();
+  }
+
  private:
   friend class AssignOutboundCallTask;
   friend class CancellationTask;
@@ -331,6 +345,10 @@ class ReactorThread {
   // Random number generator for randomizing the TCP keepalive interval.
   Random rng_;
 
+  const scoped_refptr<InboundBufferPool> inbound_buffer_pool_;
+
+  std::unique_ptr<RpcCompressionMetrics> compression_metrics_;
+
   // Accounting for determining load average in each cycle of TimerHandler.
   struct {
     // The cycle-time at which the load average was last calculated.
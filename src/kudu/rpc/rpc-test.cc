@@ -69,12 +69,23 @@
 
 METRIC_DECLARE_histogram(handler_latency_kudu_rpc_test_CalculatorService_Sleep);
 METRIC_DECLARE_histogram(rpc_incoming_queue_time);
+METRIC_DECLARE_counter(rpc_compression_input_bytes);
+METRIC_DECLARE_counter(rpc_compression_output_bytes);
 
+DECLARE_bool(rpc_compression_enabled);
 DECLARE_bool(rpc_reopen_outbound_connections);
+DECLARE_bool(socket_inject_short_recvs);
 DECLARE_int32(rpc_negotiation_inject_delay_ms);
+DECLARE_int32(rpc_read_ahead_bytes);
+DECLARE_int32(rpc_service_max_threads);
+DECLARE_int32(rpc_service_thread_grow_queue_time_ms);
+DECLARE_int32(rpc_service_thread_idle_timeout_ms);
+DECLARE_int32(rpc_service_thread_max_cpu_utilization_pct);
 DECLARE_int32(tcp_keepalive_probe_period_s);
 DECLARE_int32(tcp_keepalive_retry_period_s);
 DECLARE_int32(tcp_keepalive_retry_count);
+DECLARE_int64(rpc_compression_min_message_bytes);
+DECLARE_int64(rpc_zero_copy_min_bytes);
 
 using std::shared_ptr;
 using std::string;
@@ -187,6 +198,94 @@ TEST_P(TestRpc, TestCall) {
   }
 }
 
+// Test that many calls pipelined on a single connection, whose messages the
+// reactors receive several of at a time, are all handled correctly.
+TEST_P(TestRpc, TestPipelinedCalls) {
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServer(&server_addr, enable_ssl));
+
+  for (int read_ahead_bytes : { 0, 64, 4096 }) {
+    for (bool short_recvs : { false, true }) {
+      SCOPED_TRACE(strings::Substitute("read-ahead: $0 bytes, short recvs: $1",
+                                       read_ahead_bytes, short_recvs));
+      FLAGS_rpc_read_ahead_bytes = read_ahead_bytes;
+      FLAGS_socket_inject_short_recvs = short_recvs;
+
+      shared_ptr<Messenger> client_messenger;
+      ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+      Proxy p(client_messenger, server_addr, server_addr.host(),
+              GenericCalculatorService::static_service_name());
+
+      const int kNumCalls = 100;
+      vector<AddRequestPB> reqs(kNumCalls);
+      vector<AddResponsePB> resps(kNumCalls);
+      vector<unique_ptr<RpcController>> controllers;
+      CountDownLatch latch(kNumCalls);
+      for (int i = 0; i < kNumCalls; i++) {
+        reqs[i].set_x(i);
+        reqs[i].set_y(i * 2);
+        controllers.emplace_back(new RpcController());
+        p.AsyncRequest(GenericCalculatorService::kAddMethodName, reqs[i], &resps[i],
+                       controllers.back().get(),
+                       boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+      }
+      latch.Wait();
+      for (int i = 0; i < kNumCalls; i++) {
+        ASSERT_OK(controllers[i]->status());
+        ASSERT_EQ(i * 3, resps[i].result());
+      }
+      client_messenger->Shutdown();
+    }
+  }
+}
+
+// Test that large messages are compressed on connections which negotiated
+// compression, and that small ones and those of connections negotiated with
+// compression disabled aren't.
+TEST_P(TestRpc, TestCompressedMessages) {
+  FLAGS_rpc_compression_enabled = true;
+  FLAGS_rpc_compression_min_message_bytes = 1024;
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServerWithGeneratedCode(&server_addr, enable_ssl));
+
+  auto metric_map = server_messenger_->metric_entity()->UnsafeMetricsMapForTests();
+  auto* input_bytes = down_cast<Counter*>(
+      FindOrDie(metric_map, &METRIC_rpc_compression_input_bytes).get());
+  auto* output_bytes = down_cast<Counter*>(
+      FindOrDie(metric_map, &METRIC_rpc_compression_output_bytes).get());
+
+  // Echo a compressible message of 'size' bytes on a new connection, and
+  // return whether any of its messages were sent compressed.
+  auto echo = [&](bool enable_compression, int size, bool* compressed) {
+    FLAGS_rpc_compression_enabled = enable_compression;
+    shared_ptr<Messenger> client_messenger;
+    ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+    Proxy p(client_messenger, server_addr, server_addr.host(),
+            CalculatorService::static_service_name());
+    int64_t prev_output_bytes = output_bytes->value();
+    int64_t prev_input_bytes = input_bytes->value();
+    EchoRequestPB req;
+    req.set_data(string(size, 'x'));
+    EchoResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(p.SyncRequest("Echo", req, &resp, &controller));
+    ASSERT_EQ(req.data(), resp.data());
+    *compressed = output_bytes->value() - prev_output_bytes <
+        input_bytes->value() - prev_input_bytes;
+    client_messenger->Shutdown();
+  };
+
+  bool compressed;
+  NO_FATALS(echo(true, 1024 * 1024, &compressed));
+  ASSERT_TRUE(compressed);
+  NO_FATALS(echo(true, 100, &compressed));
+  ASSERT_FALSE(compressed);
+  NO_FATALS(echo(false, 1024 * 1024, &compressed));
+  ASSERT_FALSE(compressed);
+}
+
 // Test for KUDU-2091 and KUDU-2220.
 TEST_P(TestRpc, TestCallWithChainCertAndChainCA) {
   bool enable_ssl = GetParam();
@@ -840,6 +939,39 @@ TEST_P(TestRpc, TestRpcSidecar) {
   DoTestOutgoingSidecarExpectOK(p, 3000 * 1024, 2000 * 1024);
 }
 
+// Test that responses sent with MSG_ZEROCOPY arrive intact. Connections with
+// TLS fall back to copying sends.
+TEST_P(TestRpc, TestZeroCopySidecars) {
+  FLAGS_rpc_zero_copy_min_bytes = 1024;
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServer(&server_addr, enable_ssl));
+
+  shared_ptr<Messenger> client_messenger;
+  ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  // Responses both below and above the threshold, the larger of which take
+  // several sends each.
+  for (int i = 0; i < 10; i++) {
+    DoTestSidecar(p, 123, 456);
+    DoTestSidecar(p, 3000 * 1024, 2000 * 1024);
+  }
+}
+
+// Test that a sidecar keeps the owner of its memory alive until it's destroyed.
+TEST_F(TestRpc, TestSharedSliceSidecar) {
+  auto data = std::make_shared<string>("sidecar data");
+  unique_ptr<RpcSidecar> sidecar = RpcSidecar::FromSharedSlice(Slice(*data), data);
+  std::weak_ptr<string> weak_data = data;
+  data.reset();
+  ASSERT_FALSE(weak_data.expired());
+  ASSERT_EQ("sidecar data", sidecar->AsSlice().ToString());
+  sidecar.reset();
+  ASSERT_TRUE(weak_data.expired());
+}
+
 TEST_P(TestRpc, TestRpcSidecarLimits) {
   {
     // Test that the limits on the number of sidecars is respected.
@@ -1155,6 +1287,53 @@ TEST_P(TestRpc, TestRpcHandlerLatencyMetric) {
   ASSERT_TRUE(FindOrDie(metric_map, &METRIC_rpc_incoming_queue_time));
 }
 
+// Test that a service pool which falls behind adds threads, and that they
+// exit once they're idle.
+TEST_P(TestRpc, TestServicePoolGrowsAndShrinks) {
+  FLAGS_rpc_service_max_threads = 4;
+  FLAGS_rpc_service_thread_grow_queue_time_ms = 1;
+  FLAGS_rpc_service_thread_idle_timeout_ms = 100;
+  FLAGS_rpc_service_thread_max_cpu_utilization_pct = 100;
+  n_worker_threads_ = 1;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServer(&server_addr, enable_ssl));
+  ASSERT_EQ(1, service_pool_->num_threads());
+
+  shared_ptr<Messenger> client_messenger;
+  ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  // With a single thread, calls which each take a while pile up in the queue.
+  const int kNumCalls = 40;
+  SleepRequestPB req;
+  req.set_sleep_micros(50 * 1000);
+  vector<SleepResponsePB> resps(kNumCalls);
+  vector<unique_ptr<RpcController>> controllers;
+  CountDownLatch latch(kNumCalls);
+  for (int i = 0; i < kNumCalls; i++) {
+    controllers.emplace_back(new RpcController());
+    p.AsyncRequest(GenericCalculatorService::kSleepMethodName, req, &resps[i],
+                   controllers.back().get(),
+                   boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+  }
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_GT(service_pool_->num_threads(), 1);
+  });
+  latch.Wait();
+  for (const auto& controller : controllers) {
+    ASSERT_OK(controller->status());
+  }
+  ASSERT_LE(service_pool_->num_threads(), FLAGS_rpc_service_max_threads);
+
+  // The threads added are idle now.
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_EQ(1, service_pool_->num_threads());
+  });
+}
+
 static void DestroyMessengerCallback(shared_ptr<Messenger>* messenger,
                                      CountDownLatch* latch) {
   messenger->reset();
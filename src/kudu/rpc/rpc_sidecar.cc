@@ -28,6 +28,7 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
+using std::shared_ptr;
 using std::unique_ptr;
 
 namespace kudu {
@@ -54,6 +55,20 @@ class FaststringSidecar : public RpcSidecar {
   const unique_ptr<faststring> data_;
 };
 
+// Sidecar that wraps a Slice of memory kept alive by a reference to its owner.
+class SharedSliceSidecar : public RpcSidecar {
+ public:
+  SharedSliceSidecar(Slice slice, shared_ptr<const void> owner)
+      : slice_(slice),
+        owner_(std::move(owner)) {
+  }
+  Slice AsSlice() const override { return slice_; }
+
+ private:
+  const Slice slice_;
+  const shared_ptr<const void> owner_;
+};
+
 unique_ptr<RpcSidecar> RpcSidecar::FromFaststring(unique_ptr<faststring> data) {
   return unique_ptr<RpcSidecar>(new FaststringSidecar(std::move(data)));
 }
@@ -62,6 +77,10 @@ unique_ptr<RpcSidecar> RpcSidecar::FromSlice(Slice slice) {
   return unique_ptr<RpcSidecar>(new SliceSidecar(slice));
 }
 
+unique_ptr<RpcSidecar> RpcSidecar::FromSharedSlice(Slice slice, shared_ptr<const void> owner) {
+  return unique_ptr<RpcSidecar>(new SharedSliceSidecar(slice, std::move(owner)));
+}
+
 
 Status RpcSidecar::ParseSidecars(
     const ::google::protobuf::RepeatedField<::google::protobuf::uint32>& offsets,
@@ -53,6 +53,15 @@ class RpcSidecar {
   static std::unique_ptr<RpcSidecar> FromFaststring(std::unique_ptr<faststring> data);
   static std::unique_ptr<RpcSidecar> FromSlice(Slice slice);
 
+  // Sidecar of 'slice', whose memory is kept alive by a reference to 'owner'
+  // (for example a pooled buffer, or a block cache entry) for as long as the
+  // sidecar exists. The memory must not change until then. The sidecars of a
+  // response are destroyed when its transfer completes, which with
+  // --rpc_zero_copy_min_bytes includes the kernel being done reading them, so
+  // that's when 'owner' is released.
+  static std::unique_ptr<RpcSidecar> FromSharedSlice(Slice slice,
+                                                     std::shared_ptr<const void> owner);
+
   // Utility method to parse a series of sidecar slices into 'sidecars' from 'buffer' and
   // a set of offsets. 'sidecars' must have length >= TransferLimits::kMaxSidecars, and
   // will be filled from index 0.
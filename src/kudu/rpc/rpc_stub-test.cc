@@ -67,6 +67,7 @@
 #include "kudu/util/user.h"
 
 DEFINE_bool(is_panic_test_child, false, "Used by TestRpcPanic");
+DECLARE_bool(rpc_call_profiling);
 DECLARE_bool(socket_inject_short_recvs);
 
 using kudu::pb_util::SecureDebugString;
@@ -671,6 +672,43 @@ TEST_F(RpcStubTest, TestDumpSampledCalls) {
   ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "duration_ms");
 }
 
+// Test that the calls of each method are totalled by user, including the CPU
+// time recorded in their trace metrics.
+TEST_F(RpcStubTest, TestDumpUserStats) {
+  FLAGS_rpc_call_profiling = true;
+  const int kNumCalls = 10;
+  for (int i = 0; i < kNumCalls; i++) {
+    NO_FATALS(SendSimpleCall());
+  }
+
+  DumpRpczStoreRequestPB req;
+  req.set_include_samples(false);
+  req.set_include_user_stats(true);
+  DumpRpczStoreResponsePB resp;
+  server_messenger_->rpcz_store()->DumpPB(req, &resp);
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_EQ(1, resp.methods_size());
+  const auto& method_pb = resp.methods(0);
+  ASSERT_STR_CONTAINS(method_pb.method_name(), "AddRequestPB");
+  ASSERT_EQ(0, method_pb.samples_size());
+  ASSERT_EQ(1, method_pb.user_stats_size());
+
+  const auto& stats_pb = method_pb.user_stats(0);
+  string expected_user;
+  ASSERT_OK(GetLoggedInUser(&expected_user));
+  ASSERT_EQ(expected_user, stats_pb.user());
+  ASSERT_EQ(kNumCalls, stats_pb.num_calls());
+  ASSERT_GT(stats_pb.total_duration_us(), 0);
+  bool has_cpu_metric = false;
+  for (const auto& metric_pb : stats_pb.metrics()) {
+    if (metric_pb.key() == "handler_cpu_us") {
+      has_cpu_metric = true;
+      ASSERT_GE(metric_pb.value(), 0);
+    }
+  }
+  ASSERT_TRUE(has_cpu_metric);
+}
+
 namespace {
 struct RefCountedTest : public RefCountedThreadSafe<RefCountedTest> {
 };
@@ -19,10 +19,13 @@
 
 #include <algorithm>  // IWYU pragma: keep
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <map>
 #include <mutex> // for unique_lock
 #include <ostream>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -36,6 +39,7 @@
 #include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/rpc/inbound_call.h"
+#include "kudu/rpc/remote_user.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/service_if.h"
@@ -57,6 +61,26 @@ DEFINE_int32(rpc_duration_too_long_ms, 1000,
 TAG_FLAG(rpc_duration_too_long_ms, advanced);
 TAG_FLAG(rpc_duration_too_long_ms, runtime);
 
+DEFINE_bool(rpc_call_profiling, false,
+            "Whether to record the CPU time used by the thread handling each "
+            "RPC in the call's trace metrics, and to keep totals of the trace "
+            "metrics of the calls of each method by each user, which are "
+            "shown at /rpcz/stats. CPU time is only recorded for calls which "
+            "are responded to from the thread which started handling them. "
+            "Totalling takes a lock shared by all calls of a method.");
+TAG_FLAG(rpc_call_profiling, advanced);
+TAG_FLAG(rpc_call_profiling, runtime);
+
+DEFINE_bool(rpc_call_profiling_allocations, false,
+            "Whether to also record the bytes allocated by the thread handling "
+            "each RPC, if --rpc_call_profiling is enabled. Once enabled, every "
+            "allocation by the process is counted, which has a small cost. "
+            "Requires tcmalloc.");
+TAG_FLAG(rpc_call_profiling_allocations, advanced);
+TAG_FLAG(rpc_call_profiling_allocations, experimental);
+TAG_FLAG(rpc_call_profiling_allocations, runtime);
+
+using std::map;
 using std::pair;
 using std::string;
 using std::vector;
@@ -73,9 +97,14 @@ static const int kSampleIntervalMs = 1000;
 static const int kBucketThresholdsMs[] = {10, 100, 1000};
 static constexpr int kNumBuckets = arraysize(kBucketThresholdsMs) + 1;
 
+// The number of users whose calls of a method are totalled separately. The
+// calls of any further users are lumped together.
+static constexpr size_t kMaxUsersPerMethod = 100;
+static const char* const kOtherUsers = "<other users>";
+
 // An instance of this class is created For each RPC method implemented
 // on the server. It keeps several recent samples for each RPC, currently
-// based on fixed time buckets.
+// based on fixed time buckets, and totals of the calls by each user.
 class MethodSampler {
  public:
   MethodSampler() {}
@@ -84,9 +113,15 @@ class MethodSampler {
   // Potentially sample a single call.
   void SampleCall(InboundCall* call);
 
+  // Add a call to the totals of its user.
+  void AddCallStats(InboundCall* call);
+
   // Dump the current samples.
   void GetSamplePBs(RpczMethodPB* pb);
 
+  // Dump the totals of each user.
+  void GetUserStatsPBs(RpczMethodPB* pb);
+
  private:
   // Convert the trace metrics from 't' into protobuf entries in 'sample_pb'.
   // This function recurses through the parent-child relationship graph,
@@ -95,6 +130,9 @@ class MethodSampler {
                               const string& child_path,
                               RpczSamplePB* sample_pb);
 
+  // Add the trace metrics from 't' and its children to 'sums', by key.
+  static void SumTraceMetrics(const Trace& t, map<string, int64_t>* sums);
+
   // An individual recorded sample.
   struct Sample {
     RequestHeader header;
@@ -113,6 +151,19 @@ class MethodSampler {
   };
   std::array<SampleBucket, kNumBuckets> buckets_;
 
+  // The totals of the calls by a user.
+  struct UserStats {
+    UserStats() : num_calls(0), total_duration_us(0) {}
+
+    int64_t num_calls;
+    int64_t total_duration_us;
+    map<string, int64_t> metrics;
+  };
+
+  simple_spinlock stats_lock_;
+  // Keyed by user name. Protected by 'stats_lock_'.
+  std::unordered_map<string, UserStats> user_stats_;
+
   DISALLOW_COPY_AND_ASSIGN(MethodSampler);
 };
 
@@ -171,6 +222,50 @@ void MethodSampler::SampleCall(InboundCall* call) {
   }
 }
 
+void MethodSampler::AddCallStats(InboundCall* call) {
+  map<string, int64_t> metrics;
+  SumTraceMetrics(*call->trace(), &metrics);
+  int64_t duration_us = call->timing().TotalDuration().ToMicroseconds();
+  const string& user = call->remote_user().username();
+
+  std::lock_guard<simple_spinlock> l(stats_lock_);
+  auto it = user_stats_.find(user);
+  if (it == user_stats_.end()) {
+    it = user_stats_.emplace(user_stats_.size() < kMaxUsersPerMethod ? user : kOtherUsers,
+                             UserStats()).first;
+  }
+  UserStats* stats = &it->second;
+  stats->num_calls++;
+  stats->total_duration_us += duration_us;
+  for (const auto& e : metrics) {
+    stats->metrics[e.first] += e.second;
+  }
+}
+
+void MethodSampler::SumTraceMetrics(const Trace& t, map<string, int64_t>* sums) {
+  for (const auto& e : t.metrics().Get()) {
+    (*sums)[e.first] += e.second;
+  }
+  for (const auto& child_pair : t.ChildTraces()) {
+    SumTraceMetrics(*child_pair.second.get(), sums);
+  }
+}
+
+void MethodSampler::GetUserStatsPBs(RpczMethodPB* method_pb) {
+  std::lock_guard<simple_spinlock> l(stats_lock_);
+  for (const auto& e : user_stats_) {
+    auto* stats_pb = method_pb->add_user_stats();
+    stats_pb->set_user(e.first);
+    stats_pb->set_num_calls(e.second.num_calls);
+    stats_pb->set_total_duration_us(e.second.total_duration_us);
+    for (const auto& m : e.second.metrics) {
+      auto* metric_pb = stats_pb->add_metrics();
+      metric_pb->set_key(m.first);
+      metric_pb->set_value(m.second);
+    }
+  }
+}
+
 void MethodSampler::GetTraceMetrics(const Trace& t,
                                     const string& child_path,
                                     RpczSamplePB* sample_pb) {
@@ -217,6 +312,9 @@ void RpczStore::AddCall(InboundCall* call) {
   if (PREDICT_FALSE(!sampler)) return;
 
   sampler->SampleCall(call);
+  if (FLAGS_rpc_call_profiling) {
+    sampler->AddCallStats(call);
+  }
 }
 
 void RpczStore::DumpPB(const DumpRpczStoreRequestPB& req,
@@ -237,7 +335,12 @@ void RpczStore::DumpPB(const DumpRpczStoreRequestPB& req,
     // Currently this isn't conveniently plumbed here, but the type name
     // is close enough.
     method_pb->set_method_name(p.first->req_prototype->GetTypeName());
-    sampler->GetSamplePBs(method_pb);
+    if (req.include_samples()) {
+      sampler->GetSamplePBs(method_pb);
+    }
+    if (req.include_user_stats()) {
+      sampler->GetUserStatsPBs(method_pb);
+    }
   }
 }
 
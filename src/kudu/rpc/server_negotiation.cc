@@ -92,6 +92,7 @@ DEFINE_bool(rpc_send_channel_bindings, true,
 TAG_FLAG(rpc_send_channel_bindings, runtime);
 TAG_FLAG(rpc_send_channel_bindings, unsafe);
 
+DECLARE_bool(rpc_compression_enabled);
 DECLARE_bool(rpc_encrypt_loopback_connections);
 
 DEFINE_string(trusted_subnets,
@@ -539,6 +540,9 @@ Status ServerNegotiation::HandleNegotiate(const NegotiatePB& request) {
       server_features_.insert(TLS_AUTHENTICATION_ONLY);
     }
   }
+  if (FLAGS_rpc_compression_enabled) {
+    server_features_.insert(LZ4_COMPRESSION);
+  }
 
   for (RpcFeatureFlag feature : server_features_) {
     response.add_supported_features(feature);
@@ -27,6 +27,7 @@
 #include <glog/logging.h>
 #include <sasl/sasl.h>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/negotiation.h"
@@ -95,6 +96,13 @@ class ServerNegotiation {
     return tls_negotiated_;
   }
 
+  // Returns true if both sides advertised support for compressed messages.
+  // Must be called after Negotiate().
+  bool compression_negotiated() const {
+    return ContainsKey(client_features_, LZ4_COMPRESSION) &&
+        ContainsKey(server_features_, LZ4_COMPRESSION);
+  }
+
   // Returns the set of RPC system features supported by the remote client.
   // Must be called after Negotiate().
   std::set<RpcFeatureFlag> client_features() const {
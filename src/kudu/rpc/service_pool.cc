@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/service_pool.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <ostream>
@@ -26,6 +27,7 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/basictypes.h"
@@ -33,18 +35,59 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/remote_method.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/rpc/thread_pinning.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 
+DEFINE_int32(rpc_service_max_threads, 0,
+             "Maximum number of threads of each RPC service pool. A pool which "
+             "falls behind grows from the number of threads it started with "
+             "up to this many, and shrinks back as they become idle. If not "
+             "greater than the starting number, the number of threads is "
+             "fixed.");
+DEFINE_validator(rpc_service_max_threads,
+    [](const char* /*n*/, int32_t v) { return v >= 0; });
+TAG_FLAG(rpc_service_max_threads, advanced);
+TAG_FLAG(rpc_service_max_threads, experimental);
+
+DEFINE_int32(rpc_service_thread_grow_queue_time_ms, 10,
+             "An RPC service pool which may grow adds a thread when a call "
+             "waited in its queue for longer than this, and more calls are "
+             "queued behind it. At most one thread is added per this period.");
+DEFINE_validator(rpc_service_thread_grow_queue_time_ms,
+    [](const char* /*n*/, int32_t v) { return v > 0; });
+TAG_FLAG(rpc_service_thread_grow_queue_time_ms, advanced);
+TAG_FLAG(rpc_service_thread_grow_queue_time_ms, experimental);
+
+DEFINE_int32(rpc_service_thread_max_cpu_utilization_pct, 90,
+             "An RPC service pool doesn't add threads while the process uses "
+             "more than this percentage of the CPUs it may run on, since "
+             "more threads would only contend for them.");
+DEFINE_validator(rpc_service_thread_max_cpu_utilization_pct,
+    [](const char* /*n*/, int32_t v) { return v > 0 && v <= 100; });
+TAG_FLAG(rpc_service_thread_max_cpu_utilization_pct, advanced);
+TAG_FLAG(rpc_service_thread_max_cpu_utilization_pct, experimental);
+
+DEFINE_int32(rpc_service_thread_idle_timeout_ms, 30000,
+             "A thread which an RPC service pool added beyond its starting "
+             "number of threads exits after it has been idle for this long.");
+DEFINE_validator(rpc_service_thread_idle_timeout_ms,
+    [](const char* /*n*/, int32_t v) { return v > 0; });
+TAG_FLAG(rpc_service_thread_idle_timeout_ms, advanced);
+TAG_FLAG(rpc_service_thread_idle_timeout_ms, experimental);
+
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -57,6 +100,28 @@ METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         kudu::MetricLevel::kInfo,
                         60000000LU, 3);
 
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_high_priority,
+                        "RPC Queue Time (High Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the high priority "
+                        "class spend in the worker queue",
+                        kudu::MetricLevel::kInfo,
+                        60000000LU, 3);
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_normal_priority,
+                        "RPC Queue Time (Normal Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the normal priority "
+                        "class spend in the worker queue",
+                        kudu::MetricLevel::kInfo,
+                        60000000LU, 3);
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_low_priority,
+                        "RPC Queue Time (Low Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the low priority "
+                        "class spend in the worker queue",
+                        kudu::MetricLevel::kInfo,
+                        60000000LU, 3);
+
 METRIC_DEFINE_counter(server, rpcs_timed_out_in_queue,
                       "RPC Queue Timeouts",
                       kudu::MetricUnit::kRequests,
@@ -73,6 +138,16 @@ METRIC_DEFINE_counter(server, rpcs_queue_overflow,
 namespace kudu {
 namespace rpc {
 
+// The minimum period over which the CPU utilization of the process is
+// sampled. CPU time is only accounted in scheduler ticks, so it's not
+// meaningful over shorter periods.
+static const MonoDelta kCpuUtilizationSamplePeriod = MonoDelta::FromMilliseconds(100);
+
+// The maximum period over which the CPU utilization of the process is
+// sampled. Averaged over longer, the utilization says little about the
+// current load.
+static const MonoDelta kCpuUtilizationMaxSamplePeriod = MonoDelta::FromSeconds(1);
+
 ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
@@ -81,7 +156,20 @@ ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
+    min_threads_(0),
+    max_threads_(0),
+    threads_shutdown_(false),
+    num_cpus_(base::NumCPUs()),
+    cpu_stopwatch_(Stopwatch::ALL_THREADS),
+    cpu_utilization_(-1),
+    num_threads_(0),
     closing_(false) {
+  priority_queue_time_[static_cast<int>(RpcPriority::HIGH)] =
+      METRIC_rpc_incoming_queue_time_high_priority.Instantiate(entity);
+  priority_queue_time_[static_cast<int>(RpcPriority::NORMAL)] =
+      METRIC_rpc_incoming_queue_time_normal_priority.Instantiate(entity);
+  priority_queue_time_[static_cast<int>(RpcPriority::LOW)] =
+      METRIC_rpc_incoming_queue_time_low_priority.Instantiate(entity);
 }
 
 ServicePool::~ServicePool() {
@@ -89,23 +177,121 @@ ServicePool::~ServicePool() {
 }
 
 Status ServicePool::Init(int num_threads) {
+  min_threads_ = num_threads;
+  max_threads_ = std::max(num_threads, FLAGS_rpc_service_max_threads);
+  vector<int> cpus;
+  if (GetAllowedCpus(&cpus).ok()) {
+    num_cpus_ = cpus.size();
+  }
+  MutexLock l(threads_lock_);
+  cpu_stopwatch_.start();
   for (int i = 0; i < num_threads; i++) {
-    scoped_refptr<kudu::Thread> new_thread;
-    CHECK_OK(kudu::Thread::Create("service pool", "rpc worker",
-        &ServicePool::RunThread, this, &new_thread));
-    threads_.push_back(new_thread);
+    CHECK_OK(StartThreadUnlocked());
   }
   return Status::OK();
 }
 
+Status ServicePool::StartThreadUnlocked() {
+  threads_lock_.AssertAcquired();
+  scoped_refptr<kudu::Thread> new_thread;
+  RETURN_NOT_OK(kudu::Thread::Create("service pool", "rpc worker",
+      &ServicePool::RunThread, this, &new_thread));
+  threads_.push_back(new_thread);
+  num_threads_ = threads_.size();
+  return Status::OK();
+}
+
+void ServicePool::MaybeAddThread(const MonoDelta& queue_time) {
+  if (queue_time.ToMilliseconds() < FLAGS_rpc_service_thread_grow_queue_time_ms ||
+      num_threads_ >= max_threads_ ||
+      service_queue_.estimated_queue_length() == 0) {
+    return;
+  }
+
+  vector<scoped_refptr<kudu::Thread>> exited_threads;
+  {
+    MutexLock l(threads_lock_);
+    if (threads_shutdown_ || num_threads_ >= max_threads_) {
+      return;
+    }
+    // Give the last thread added time to take effect before adding another.
+    MonoTime now = MonoTime::Now();
+    if (last_thread_added_.Initialized() &&
+        now - last_thread_added_ <
+        MonoDelta::FromMilliseconds(FLAGS_rpc_service_thread_grow_queue_time_ms)) {
+      return;
+    }
+
+    // A sample which spans more than kCpuUtilizationMaxSamplePeriod, e.g.
+    // because the pool kept up for a while, is discarded, and no thread is
+    // added until the next sample.
+    CpuTimes cpu = cpu_stopwatch_.elapsed();
+    if (cpu.wall > kCpuUtilizationMaxSamplePeriod.ToNanoseconds()) {
+      cpu_utilization_ = -1;
+      cpu_stopwatch_.start();
+    } else if (cpu.wall >= kCpuUtilizationSamplePeriod.ToNanoseconds()) {
+      cpu_utilization_ = static_cast<double>(cpu.user + cpu.system) /
+                         (cpu.wall * num_cpus_);
+      cpu_stopwatch_.start();
+    }
+    if (cpu_utilization_ < 0 ||
+        cpu_utilization_ * 100 > FLAGS_rpc_service_thread_max_cpu_utilization_pct) {
+      return;
+    }
+
+    last_thread_added_ = now;
+    Status s = StartThreadUnlocked();
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 1) << Substitute("$0: could not add a service thread: $1",
+                                                  service_->service_name(), s.ToString())
+                                    << THROTTLE_MSG;
+      return;
+    }
+    VLOG(1) << Substitute("$0: added a service thread, now $1",
+                          service_->service_name(), threads_.size());
+    exited_threads.swap(exited_threads_);
+  }
+
+  // Reap any threads which exited earlier.
+  for (const auto& thread : exited_threads) {
+    CHECK_OK(ThreadJoiner(thread.get()).Join());
+  }
+}
+
+bool ServicePool::MaybeRemoveThread() {
+  MutexLock l(threads_lock_);
+  if (threads_shutdown_ || num_threads_ <= min_threads_) {
+    return false;
+  }
+  auto it = std::find_if(threads_.begin(), threads_.end(),
+                         [](const scoped_refptr<kudu::Thread>& t) {
+                           return t.get() == kudu::Thread::current_thread();
+                         });
+  DCHECK(it != threads_.end());
+  exited_threads_.push_back(*it);
+  threads_.erase(it);
+  num_threads_ = threads_.size();
+  VLOG(1) << Substitute("$0: removed an idle service thread, now $1",
+                        service_->service_name(), threads_.size());
+  return true;
+}
+
 void ServicePool::Shutdown() {
   service_queue_.Shutdown();
 
   MutexLock lock(shutdown_lock_);
   if (closing_) return;
   closing_ = true;
+  vector<scoped_refptr<kudu::Thread>> threads;
+  {
+    MutexLock l(threads_lock_);
+    threads_shutdown_ = true;
+    threads.swap(threads_);
+    threads.insert(threads.end(), exited_threads_.begin(), exited_threads_.end());
+    exited_threads_.clear();
+  }
   // TODO: Use a proper thread pool implementation.
-  for (scoped_refptr<kudu::Thread>& thread : threads_) {
+  for (scoped_refptr<kudu::Thread>& thread : threads) {
     CHECK_OK(ThreadJoiner(thread.get()).Join());
   }
 
@@ -194,14 +380,34 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
 }
 
 void ServicePool::RunThread() {
+  MaybePinRpcThread(RpcThreadKind::SERVICE, service_->service_name());
+
+  const bool adaptive = max_threads_ > min_threads_;
   while (true) {
     std::unique_ptr<InboundCall> incoming;
-    if (!service_queue_.BlockingGet(&incoming)) {
+    MonoTime deadline = adaptive ?
+        MonoTime::Now() + MonoDelta::FromMilliseconds(FLAGS_rpc_service_thread_idle_timeout_ms) :
+        MonoTime::Max();
+    bool timed_out;
+    if (!service_queue_.BlockingGet(&incoming, deadline, &timed_out)) {
+      if (timed_out) {
+        if (MaybeRemoveThread()) {
+          service_queue_.DetachConsumer();
+          return;
+        }
+        continue;
+      }
       VLOG(1) << "ServicePool: messenger shutting down.";
       return;
     }
 
     incoming->RecordHandlingStarted(incoming_queue_time_.get());
+    MonoDelta queue_time = incoming->GetTimeHandled() - incoming->GetTimeReceived();
+    priority_queue_time_[static_cast<int>(service_queue_.PriorityOf(incoming.get()))]->Increment(
+        queue_time.ToMicroseconds());
+    if (adaptive) {
+      MaybeAddThread(queue_time);
+    }
     ADOPT_TRACE(incoming->trace());
 
     if (PREDICT_FALSE(incoming->ClientTimedOut())) {
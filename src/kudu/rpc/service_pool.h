@@ -18,6 +18,7 @@
 #ifndef KUDU_SERVICE_POOL_H
 #define KUDU_SERVICE_POOL_H
 
+#include <atomic>
 #include <cstddef>
 #include <functional>
 #include <string>
@@ -30,8 +31,10 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/rpc_service.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
 
 namespace kudu {
 
@@ -50,6 +53,13 @@ struct RpcMethodInfo;
 
 // A pool of threads that handle new incoming RPC calls.
 // Also includes a queue that calls get pushed onto for handling by the pool.
+//
+// The pool starts with the number of threads passed to Init(). If
+// --rpc_service_max_threads is greater, it adds threads, up to that many,
+// while calls wait in the queue for longer than
+// --rpc_service_thread_grow_queue_time_ms and the process has CPU to spare,
+// and threads beyond the initial number exit once they have been idle for
+// --rpc_service_thread_idle_timeout_ms.
 class ServicePool : public RpcService {
  public:
   ServicePool(gscoped_ptr<ServiceIf> service,
@@ -68,7 +78,7 @@ class ServicePool : public RpcService {
     too_busy_hook_ = std::move(hook);
   }
 
-  // Start up the thread pool.
+  // Start up the thread pool, with 'num_threads' threads.
   virtual Status Init(int num_threads);
 
   // Shut down the queue and the thread pool.
@@ -90,19 +100,61 @@ class ServicePool : public RpcService {
     return rpcs_queue_overflow_.get();
   }
 
+  // The current number of service threads.
+  int num_threads() const {
+    return num_threads_;
+  }
+
   const std::string service_name() const;
 
  private:
   void RunThread();
   void RejectTooBusy(InboundCall* c);
 
+  // Start another service thread. Requires 'threads_lock_' to be held.
+  Status StartThreadUnlocked();
+
+  // Called by a service thread which dequeued a call that waited 'queue_time'
+  // in the queue. Starts another thread if the pool may grow and is falling
+  // behind.
+  void MaybeAddThread(const MonoDelta& queue_time);
+
+  // Called by a service thread which has been idle. Returns true if the
+  // thread should exit, in which case it has been removed from the pool.
+  bool MaybeRemoveThread();
+
   gscoped_ptr<ServiceIf> service_;
-  std::vector<scoped_refptr<kudu::Thread> > threads_;
   LifoServiceQueue service_queue_;
   scoped_refptr<Histogram> incoming_queue_time_;
+  // Indexed by RpcPriority.
+  scoped_refptr<Histogram> priority_queue_time_[kNumRpcPriorities];
   scoped_refptr<Counter> rpcs_timed_out_in_queue_;
   scoped_refptr<Counter> rpcs_queue_overflow_;
 
+  // The bounds on the number of service threads, set by Init().
+  int min_threads_;
+  int max_threads_;
+
+  // Protects the fields below, up to 'cpu_utilization_'.
+  Mutex threads_lock_;
+  std::vector<scoped_refptr<kudu::Thread> > threads_;
+  // Threads which have exited after being idle, which are yet to be joined.
+  std::vector<scoped_refptr<kudu::Thread> > exited_threads_;
+  // Set once the pool is shutting down, after which no threads are added or
+  // removed.
+  bool threads_shutdown_;
+  MonoTime last_thread_added_;
+  // The number of CPUs the process may run on, set by Init().
+  int num_cpus_;
+  // Measures the CPU used by the process since the last utilization sample.
+  Stopwatch cpu_stopwatch_;
+  // The fraction of the CPUs the process may run on which it used as of the
+  // last sample, or -1 if there is no recent sample.
+  double cpu_utilization_;
+
+  // The size of 'threads_', for reading without 'threads_lock_'.
+  std::atomic<int> num_threads_;
+
   mutable Mutex shutdown_lock_;
   bool closing_;
 
@@ -21,6 +21,7 @@
 #include <ostream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -30,16 +31,19 @@
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 DEFINE_int32(num_producers, 4,
              "Number of producer threads");
@@ -50,6 +54,8 @@ DEFINE_int32(num_consumers, 20,
 DEFINE_int32(max_queue_size, 50,
              "Max queue length");
 
+DECLARE_string(rpc_user_weights);
+
 namespace kudu {
 namespace rpc {
 
@@ -147,5 +153,99 @@ TEST(TestServiceQueue, LifoServiceQueuePerf) {
   LOG(INFO) << "Avg idle workers:     " << total_idle_workers / static_cast<double>(total_sample);
 }
 
+// Drain 'queue' from a separate consumer thread, since consumers are bound
+// to the first queue they access, returning the calls in dequeue order.
+static vector<InboundCall*> DrainQueue(LifoServiceQueue* queue, int num_calls) {
+  vector<InboundCall*> calls;
+  std::thread consumer([&]() {
+    for (int i = 0; i < num_calls; i++) {
+      unique_ptr<InboundCall> call;
+      CHECK(queue->BlockingGet(&call));
+      calls.push_back(call.release());
+    }
+  });
+  consumer.join();
+  return calls;
+}
+
+TEST(TestServiceQueue, TestPriorityClassesAndUsers) {
+  FLAGS_rpc_user_weights = "b:2";
+  LifoServiceQueue queue(100);
+  std::unordered_map<InboundCall*, string> labels;
+  auto put = [&](RpcPriority priority, const string& user) {
+    InboundCall* call = new InboundCall(nullptr);
+    labels[call] = Substitute("$0/$1", RpcPriorityToString(priority), user);
+    boost::optional<InboundCall*> evicted;
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(call, priority, user, &evicted));
+    ASSERT_EQ(boost::none, evicted);
+  };
+  for (int i = 0; i < 6; i++) {
+    NO_FATALS(put(RpcPriority::LOW, "a"));
+    NO_FATALS(put(RpcPriority::NORMAL, "a"));
+    NO_FATALS(put(RpcPriority::NORMAL, "b"));
+    NO_FATALS(put(RpcPriority::HIGH, "a"));
+  }
+
+  // With the default class weights of 4,2,1, each round dequeues four high
+  // priority calls, two normal priority ones and a low priority one. Within
+  // the normal class, user 'b' dequeues two calls per turn to user 'a''s one.
+  vector<InboundCall*> calls = DrainQueue(&queue, 24);
+  vector<string> order;
+  for (InboundCall* c : calls) {
+    order.push_back(labels[c]);
+    delete c;
+  }
+  ASSERT_EQ(vector<string>({
+        "high/a", "high/a", "high/a", "high/a", "normal/a", "normal/b", "low/a",
+        "high/a", "high/a", "normal/b", "normal/a", "low/a",
+        "normal/b", "normal/b", "low/a",
+        "normal/a", "normal/b", "low/a",
+        "normal/b", "normal/a", "low/a",
+        "normal/a", "normal/a", "low/a" }), order);
+  ASSERT_TRUE(queue.empty());
+  FLAGS_rpc_user_weights = "";
+}
+
+TEST(TestServiceQueue, TestEvictionFavorsLightUsers) {
+  LifoServiceQueue queue(4);
+  vector<InboundCall*> a_calls;
+  boost::optional<InboundCall*> evicted;
+  for (int i = 0; i < 3; i++) {
+    a_calls.push_back(new InboundCall(nullptr));
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(a_calls.back(), RpcPriority::NORMAL, "a", &evicted));
+  }
+  ASSERT_EQ(QUEUE_SUCCESS,
+            queue.Put(new InboundCall(nullptr), RpcPriority::NORMAL, "b", &evicted));
+  ASSERT_EQ(boost::none, evicted);
+
+  // The queue is full. A call from 'b' evicts the last of 'a''s calls.
+  ASSERT_EQ(QUEUE_SUCCESS,
+            queue.Put(new InboundCall(nullptr), RpcPriority::NORMAL, "b", &evicted));
+  ASSERT_EQ(a_calls[2], evicted.get());
+  delete evicted.get();
+  evicted = boost::none;
+
+  // Another call from 'a' would only evict one of its own calls, all of which
+  // have an earlier deadline, so it is rejected.
+  SleepFor(MonoDelta::FromMilliseconds(1));
+  unique_ptr<InboundCall> rejected(new InboundCall(nullptr));
+  ASSERT_EQ(QUEUE_FULL, queue.Put(rejected.get(), RpcPriority::NORMAL, "a", &evicted));
+  ASSERT_EQ(boost::none, evicted);
+
+  // As is a call of a lower priority class.
+  ASSERT_EQ(QUEUE_FULL, queue.Put(rejected.get(), RpcPriority::LOW, "c", &evicted));
+
+  // But a call of a higher priority class evicts one of a normal priority.
+  ASSERT_EQ(QUEUE_SUCCESS,
+            queue.Put(new InboundCall(nullptr), RpcPriority::HIGH, "c", &evicted));
+  ASSERT_NE(boost::none, evicted);
+  delete evicted.get();
+
+  for (InboundCall* c : DrainQueue(&queue, 4)) {
+    delete c;
+  }
+  ASSERT_TRUE(queue.empty());
+}
+
 } // namespace rpc
 } // namespace kudu
@@ -17,44 +17,178 @@
 
 #include "kudu/rpc/service_queue.h"
 
+#include <algorithm>
+#include <iterator>
 #include <mutex>
 #include <ostream>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/rpc/remote_method.h"
+#include "kudu/rpc/remote_user.h"
+#include "kudu/util/flag_tags.h"
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace kudu {
+namespace rpc {
+
+namespace {
+
+bool ParseWeight(const string& str, int* weight) {
+  return safe_strto32(str, weight) && *weight > 0;
+}
+
+bool ParsePriorityWeights(const string& str, vector<int>* weights) {
+  vector<string> parts = strings::Split(str, ",", strings::SkipWhitespace());
+  if (parts.size() != static_cast<size_t>(kNumRpcPriorities)) {
+    return false;
+  }
+  vector<int> result(kNumRpcPriorities);
+  for (int i = 0; i < kNumRpcPriorities; i++) {
+    if (!ParseWeight(parts[i], &result[i])) {
+      return false;
+    }
+  }
+  *weights = std::move(result);
+  return true;
+}
+
+bool ParseUserWeights(const string& str, unordered_map<string, int>* weights) {
+  unordered_map<string, int> result;
+  for (const string& pair : strings::Split(str, ",", strings::SkipWhitespace())) {
+    vector<string> kv = strings::Split(pair, ":");
+    if (kv.size() != 2 || kv[0].empty() || !ParseWeight(kv[1], &result[kv[0]])) {
+      return false;
+    }
+  }
+  *weights = std::move(result);
+  return true;
+}
+
+} // anonymous namespace
+
+} // namespace rpc
+} // namespace kudu
+
+DEFINE_string(rpc_high_priority_methods, "UpdateConsensus,RequestConsensusVote",
+              "Comma-separated names of the RPC methods whose calls are queued "
+              "in the high priority class of their service's queue.");
+TAG_FLAG(rpc_high_priority_methods, advanced);
+TAG_FLAG(rpc_high_priority_methods, experimental);
+
+DEFINE_string(rpc_low_priority_methods, "Scan,Checksum",
+              "Comma-separated names of the RPC methods whose calls are queued "
+              "in the low priority class of their service's queue. Calls of "
+              "all other methods are of normal priority.");
+TAG_FLAG(rpc_low_priority_methods, advanced);
+TAG_FLAG(rpc_low_priority_methods, experimental);
+
+DEFINE_string(rpc_priority_weights, "4,2,1",
+              "Comma-separated weights of the high, normal and low priority "
+              "classes of RPC calls. When calls of several classes are queued, "
+              "each class gets to dequeue a number of calls proportional to "
+              "its weight.");
+DEFINE_validator(rpc_priority_weights, [](const char* /*n*/, const string& v) {
+  vector<int> weights;
+  return kudu::rpc::ParsePriorityWeights(v, &weights);
+});
+TAG_FLAG(rpc_priority_weights, advanced);
+TAG_FLAG(rpc_priority_weights, experimental);
+
+DEFINE_string(rpc_user_weights, "",
+              "Comma-separated list of <user>:<weight> pairs. When calls from "
+              "several users are queued in the same priority class, each user "
+              "gets to dequeue a number of calls proportional to its weight. "
+              "Users not listed have a weight of 1.");
+DEFINE_validator(rpc_user_weights, [](const char* /*n*/, const string& v) {
+  unordered_map<string, int> weights;
+  return kudu::rpc::ParseUserWeights(v, &weights);
+});
+TAG_FLAG(rpc_user_weights, advanced);
+TAG_FLAG(rpc_user_weights, experimental);
 
 namespace kudu {
 namespace rpc {
 
+const char* RpcPriorityToString(RpcPriority priority) {
+  switch (priority) {
+    case RpcPriority::HIGH: return "high";
+    case RpcPriority::NORMAL: return "normal";
+    case RpcPriority::LOW: return "low";
+  }
+  LOG(FATAL) << "unknown RPC priority: " << static_cast<int>(priority);
+  return nullptr;
+}
+
 __thread LifoServiceQueue::ConsumerState* LifoServiceQueue::tl_consumer_ = nullptr;
 
 LifoServiceQueue::LifoServiceQueue(int max_size)
    : shutdown_(false),
-     max_queue_size_(max_size) {
+     max_queue_size_(max_size),
+     num_queued_(0),
+     cur_priority_(0),
+     priority_deficit_(0) {
   CHECK_GT(max_queue_size_, 0);
+  for (const string& m : strings::Split(FLAGS_rpc_low_priority_methods, ",",
+                                        strings::SkipWhitespace())) {
+    method_priorities_[m] = RpcPriority::LOW;
+  }
+  for (const string& m : strings::Split(FLAGS_rpc_high_priority_methods, ",",
+                                        strings::SkipWhitespace())) {
+    method_priorities_[m] = RpcPriority::HIGH;
+  }
+  CHECK(ParsePriorityWeights(FLAGS_rpc_priority_weights, &priority_weights_));
+  CHECK(ParseUserWeights(FLAGS_rpc_user_weights, &user_weights_));
 }
 
 LifoServiceQueue::~LifoServiceQueue() {
-  DCHECK(queue_.empty())
+  DCHECK_EQ(0, num_queued_)
       << "ServiceQueue holds bare pointers at destruction time";
 }
 
-bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
+RpcPriority LifoServiceQueue::PriorityOf(const InboundCall* call) const {
+  auto it = method_priorities_.find(call->remote_method().method_name());
+  return it == method_priorities_.end() ? RpcPriority::NORMAL : it->second;
+}
+
+const string& LifoServiceQueue::UserOf(const InboundCall* call) {
+  static const string kNoUser;
+  return call->connection() ? call->remote_user().username() : kNoUser;
+}
+
+LifoServiceQueue::ConsumerState* LifoServiceQueue::GetConsumer() {
   auto consumer = tl_consumer_;
   if (PREDICT_FALSE(!consumer)) {
     consumer = tl_consumer_ = new ConsumerState(this);
     std::lock_guard<simple_spinlock> l(lock_);
     consumers_.emplace_back(consumer);
   }
+  return consumer;
+}
+
+bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
+  bool timed_out;
+  return BlockingGet(out, MonoTime::Max(), &timed_out);
+}
+
+bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out,
+                                   const MonoTime& deadline,
+                                   bool* timed_out) {
+  *timed_out = false;
+  auto consumer = GetConsumer();
 
   while (true) {
     {
       std::lock_guard<simple_spinlock> l(lock_);
-      if (!queue_.empty()) {
-        auto it = queue_.begin();
-        out->reset(*it);
-        queue_.erase(it);
+      if (num_queued_ > 0) {
+        out->reset(PopNextUnlocked());
         return true;
       }
       if (PREDICT_FALSE(shutdown_)) {
@@ -63,7 +197,21 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
       consumer->DCheckBoundInstance(this);
       waiting_consumers_.push_back(consumer);
     }
-    InboundCall* call = consumer->Wait();
+    InboundCall* call;
+    if (!consumer->Wait(deadline, &call)) {
+      {
+        std::lock_guard<simple_spinlock> l(lock_);
+        auto it = std::find(waiting_consumers_.begin(), waiting_consumers_.end(), consumer);
+        if (it != waiting_consumers_.end()) {
+          waiting_consumers_.erase(it);
+          *timed_out = true;
+          return false;
+        }
+      }
+      // A producer, or Shutdown(), already took this consumer off the stack
+      // and is about to post to it.
+      call = consumer->Wait();
+    }
     if (call != nullptr) {
       out->reset(call);
       return true;
@@ -73,17 +221,41 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
   }
 }
 
+void LifoServiceQueue::DetachConsumer() {
+  auto consumer = tl_consumer_;
+  if (!consumer) {
+    return;
+  }
+  tl_consumer_ = nullptr;
+  std::lock_guard<simple_spinlock> l(lock_);
+  DCHECK(std::find(waiting_consumers_.begin(), waiting_consumers_.end(), consumer) ==
+         waiting_consumers_.end());
+  auto it = std::find_if(consumers_.begin(), consumers_.end(),
+                         [consumer](const std::unique_ptr<ConsumerState>& c) {
+                           return c.get() == consumer;
+                         });
+  DCHECK(it != consumers_.end());
+  consumers_.erase(it);
+}
+
 QueueStatus LifoServiceQueue::Put(InboundCall* call,
                                   boost::optional<InboundCall*>* evicted) {
+  return Put(call, PriorityOf(call), UserOf(call), evicted);
+}
+
+QueueStatus LifoServiceQueue::Put(InboundCall* call,
+                                  RpcPriority priority,
+                                  const string& user,
+                                  boost::optional<InboundCall*>* evicted) {
   std::unique_lock<simple_spinlock> l(lock_);
   if (PREDICT_FALSE(shutdown_)) {
     return QUEUE_SHUTDOWN;
   }
 
-  DCHECK(!(waiting_consumers_.size() > 0 && queue_.size() > 0));
+  DCHECK(!(waiting_consumers_.size() > 0 && num_queued_ > 0));
 
   // fast path
-  if (queue_.empty() && waiting_consumers_.size() > 0) {
+  if (num_queued_ == 0 && waiting_consumers_.size() > 0) {
     auto consumer = waiting_consumers_[waiting_consumers_.size() - 1];
     waiting_consumers_.pop_back();
     // Notify condition var(and wake up consumer thread) takes time,
@@ -93,23 +265,124 @@ QueueStatus LifoServiceQueue::Put(InboundCall* call,
     return QUEUE_SUCCESS;
   }
 
-  if (PREDICT_FALSE(queue_.size() >= max_queue_size_)) {
+  if (PREDICT_FALSE(num_queued_ >= max_queue_size_)) {
     // eviction
-    DCHECK_EQ(queue_.size(), max_queue_size_);
-    auto it = queue_.end();
-    --it;
-    if (DeadlineLess(*it, call)) {
+    DCHECK_EQ(num_queued_, max_queue_size_);
+    int victim_priority = kNumRpcPriorities - 1;
+    while (queues_[victim_priority].size == 0) {
+      victim_priority--;
+    }
+    if (static_cast<int>(priority) > victim_priority) {
+      // Everything queued is of a higher priority.
       return QUEUE_FULL;
     }
-
-    *evicted = *it;
-    queue_.erase(it);
+    PriorityQueue* pq = &queues_[victim_priority];
+    UserQueue* victim = *std::max_element(
+        pq->active.begin(), pq->active.end(),
+        [](const UserQueue* a, const UserQueue* b) {
+          return a->calls.size() < b->calls.size();
+        });
+    if (static_cast<int>(priority) == victim_priority) {
+      // If the call's user would have the most calls queued in its class,
+      // it's one of that user's calls which has to go, possibly this one.
+      auto it = pq->users.find(user);
+      size_t num_user_calls = it == pq->users.end() ? 0 : it->second->calls.size();
+      if (num_user_calls + 1 >= victim->calls.size()) {
+        if (num_user_calls == 0) {
+          return QUEUE_FULL;
+        }
+        victim = it->second.get();
+        if (DeadlineLess(*victim->calls.rbegin(), call)) {
+          return QUEUE_FULL;
+        }
+      }
+    }
+    *evicted = EvictUnlocked(victim_priority, victim);
   }
 
-  queue_.insert(call);
+  InsertUnlocked(call, priority, user);
   return QUEUE_SUCCESS;
 }
 
+void LifoServiceQueue::InsertUnlocked(InboundCall* call,
+                                      RpcPriority priority,
+                                      const string& user) {
+  PriorityQueue* pq = &queues_[static_cast<int>(priority)];
+  auto& uq = pq->users[user];
+  if (!uq) {
+    int weight = 1;
+    auto it = user_weights_.find(user);
+    if (it != user_weights_.end()) {
+      weight = it->second;
+    }
+    uq.reset(new UserQueue(user, weight));
+    pq->active.push_back(uq.get());
+  }
+  uq->calls.insert(call);
+  pq->size++;
+  num_queued_++;
+}
+
+InboundCall* LifoServiceQueue::EvictUnlocked(int priority, UserQueue* uq) {
+  auto it = std::prev(uq->calls.end());
+  InboundCall* call = *it;
+  uq->calls.erase(it);
+  queues_[priority].size--;
+  num_queued_--;
+  if (uq->calls.empty()) {
+    RemoveUserUnlocked(priority, uq);
+  }
+  return call;
+}
+
+InboundCall* LifoServiceQueue::PopNextUnlocked() {
+  DCHECK_GT(num_queued_, 0);
+  // Find the next priority class with queued calls, starting with the one
+  // whose turn it is.
+  while (queues_[cur_priority_].size == 0) {
+    cur_priority_ = (cur_priority_ + 1) % kNumRpcPriorities;
+    priority_deficit_ = 0;
+  }
+  if (priority_deficit_ == 0) {
+    priority_deficit_ = priority_weights_[cur_priority_];
+  }
+  const int priority = cur_priority_;
+  PriorityQueue* pq = &queues_[priority];
+
+  // Likewise for the users within the class.
+  UserQueue* uq = pq->active.front();
+  if (uq->deficit == 0) {
+    uq->deficit = uq->weight;
+  }
+  auto it = uq->calls.begin();
+  InboundCall* call = *it;
+  uq->calls.erase(it);
+  pq->size--;
+  num_queued_--;
+
+  if (uq->calls.empty()) {
+    RemoveUserUnlocked(priority, uq);
+  } else if (--uq->deficit == 0) {
+    pq->active.pop_front();
+    pq->active.push_back(uq);
+  }
+
+  if (--priority_deficit_ == 0) {
+    cur_priority_ = (cur_priority_ + 1) % kNumRpcPriorities;
+  }
+  return call;
+}
+
+void LifoServiceQueue::RemoveUserUnlocked(int priority, UserQueue* uq) {
+  DCHECK(uq->calls.empty());
+  PriorityQueue* pq = &queues_[priority];
+  auto it = std::find(pq->active.begin(), pq->active.end(), uq);
+  DCHECK(it != pq->active.end());
+  pq->active.erase(it);
+  // Destroys 'uq'.
+  pq->users.erase(pq->users.find(uq->user));
+}
+
 void LifoServiceQueue::Shutdown() {
   std::lock_guard<simple_spinlock> l(lock_);
   shutdown_ = true;
@@ -123,7 +396,7 @@ void LifoServiceQueue::Shutdown() {
 
 bool LifoServiceQueue::empty() const {
   std::lock_guard<simple_spinlock> l(lock_);
-  return queue_.empty();
+  return num_queued_ == 0;
 }
 
 int LifoServiceQueue::max_size() const {
@@ -134,9 +407,13 @@ std::string LifoServiceQueue::ToString() const {
   std::string ret;
 
   std::lock_guard<simple_spinlock> l(lock_);
-  for (const auto* t : queue_) {
-    ret.append(t->ToString());
-    ret.append("\n");
+  for (const auto& pq : queues_) {
+    for (const auto* uq : pq.active) {
+      for (const auto* t : uq->calls) {
+        ret.append(t->ToString());
+        ret.append("\n");
+      }
+    }
   }
   return ret;
 }
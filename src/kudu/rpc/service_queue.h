@@ -17,9 +17,12 @@
 #ifndef KUDU_UTIL_SERVICE_QUEUE_H
 #define KUDU_UTIL_SERVICE_QUEUE_H
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -47,15 +50,38 @@ enum QueueStatus {
   QUEUE_FULL = 2
 };
 
+// The priority classes of RPC methods, as configured by the
+// --rpc_{high,low}_priority_methods flags.
+enum class RpcPriority {
+  HIGH = 0,
+  NORMAL = 1,
+  LOW = 2,
+};
+constexpr int kNumRpcPriorities = 3;
+
+const char* RpcPriorityToString(RpcPriority priority);
+
 // Blocking queue used for passing inbound RPC calls to the service handler pool.
-// Calls are dequeued in 'earliest-deadline first' order. The queue also maintains a
-// bounded number of calls. If the queue overflows, then calls with deadlines farthest
-// in the future are evicted.
+//
+// Calls are classified by the priority class of their method and by the user
+// making them. Queued calls are dequeued by deficit round robin at two
+// levels: each priority class in turn gets to dequeue as many calls as its
+// weight (see --rpc_priority_weights), and within a class, each user with
+// queued calls in turn gets to dequeue as many as its weight (see
+// --rpc_user_weights). A user's own calls are dequeued in 'earliest-deadline
+// first' order. This way a flood of calls of one class, or from one user,
+// can't monopolize the service.
+//
+// The queue also maintains a bounded number of calls. If the queue overflows,
+// a call is evicted from the lowest priority class which has any queued, from
+// whichever user has the most calls queued in it: the one with the deadline
+// farthest in the future. A new call which would itself be the one evicted
+// is rejected instead.
 //
 // When calls do not provide deadlines, the RPC layer considers their deadline to
 // be infinitely in the future. This means that any call that does have a deadline
-// can evict any call that does not have a deadline. This incentivizes clients to
-// provide accurate deadlines for their calls.
+// can evict any call from the same user that does not have a deadline. This
+// incentivizes clients to provide accurate deadlines for their calls.
 //
 // In order to improve concurrent throughput, this class uses a LIFO design:
 // Each consumer thread has its own lock and condition variable. If a
@@ -85,6 +111,16 @@ class LifoServiceQueue {
   // getting the element.
   bool BlockingGet(std::unique_ptr<InboundCall>* out);
 
+  // Like the above, but gives up waiting for an element at 'deadline'. Returns
+  // false, setting 'timed_out', if 'deadline' passed before getting one.
+  bool BlockingGet(std::unique_ptr<InboundCall>* out,
+                   const MonoTime& deadline,
+                   bool* timed_out);
+
+  // Forget about the calling consumer thread, which is about to exit. It must
+  // not access the queue again.
+  void DetachConsumer();
+
   // Add a new call to the queue.
   // Returns:
   // - QUEUE_SHUTDOWN if Shutdown() has already been called.
@@ -97,6 +133,13 @@ class LifoServiceQueue {
   // call that was bumped.
   QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted);
 
+  // Like the above, but with an explicit priority class and user for 'call',
+  // rather than those of its method and connection.
+  QueueStatus Put(InboundCall* call,
+                  RpcPriority priority,
+                  const std::string& user,
+                  boost::optional<InboundCall*>* evicted);
+
   // Shut down the queue.
   // When a blocking queue is shut down, no more elements can be added to it,
   // and Put() will return QUEUE_SHUTDOWN.
@@ -110,14 +153,13 @@ class LifoServiceQueue {
 
   std::string ToString() const;
 
+  // Return the priority class of 'call'.
+  RpcPriority PriorityOf(const InboundCall* call) const;
+
   // Return an estimate of the current queue length.
   int estimated_queue_length() const {
     ANNOTATE_IGNORE_READS_BEGIN();
-    // The C++ standard says that std::multiset::size must be constant time,
-    // so this method won't try to traverse any actual nodes of the underlying
-    // RB tree. Investigation of the libstdcxx implementation confirms that
-    // size() is a simple field access of the _Rb_tree structure.
-    int ret = queue_.size();
+    int ret = num_queued_;
     ANNOTATE_IGNORE_READS_END();
     return ret;
   }
@@ -153,6 +195,58 @@ class LifoServiceQueue {
     }
   };
 
+  // The calls queued by a single user in a single priority class.
+  struct UserQueue {
+    UserQueue(std::string user, int weight)
+        : user(std::move(user)),
+          weight(weight),
+          deficit(0) {
+    }
+
+    const std::string user;
+    const int weight;
+
+    // The number of calls left for this user to dequeue in its current turn.
+    int deficit;
+
+    std::multiset<InboundCall*, DeadlineLessStruct> calls;
+  };
+
+  // The calls queued in a single priority class.
+  struct PriorityQueue {
+    PriorityQueue()
+        : size(0) {
+    }
+
+    // Keyed by user. Only users with queued calls have an entry.
+    std::unordered_map<std::string, std::unique_ptr<UserQueue>> users;
+
+    // The users with queued calls, in round robin order. The user at the
+    // front is the one whose turn it is.
+    std::deque<UserQueue*> active;
+
+    // The total number of queued calls.
+    int size;
+  };
+
+  // Return the user on whose behalf 'call' was made.
+  static const std::string& UserOf(const InboundCall* call);
+
+  // Add 'call' to the queues. Requires 'lock_' to be held.
+  void InsertUnlocked(InboundCall* call, RpcPriority priority, const std::string& user);
+
+  // Remove the latest-deadline call of 'uq', in 'priority', and return it.
+  // Requires 'lock_' to be held.
+  InboundCall* EvictUnlocked(int priority, UserQueue* uq);
+
+  // Remove and return the next call to be handled. Requires 'lock_' to be
+  // held, and the queues not to be empty.
+  InboundCall* PopNextUnlocked();
+
+  // Forget about 'uq', which has no more queued calls, destroying it.
+  // Requires 'lock_' to be held.
+  void RemoveUserUnlocked(int priority, UserQueue* uq);
+
   // The thread-local record corresponding to a single consumer thread.
   // Threads push this record onto the waiting_consumers_ stack when
   // they are awaiting work. Producers pop the top waiting consumer and
@@ -175,14 +269,25 @@ class LifoServiceQueue {
     }
 
     InboundCall* Wait() {
+      InboundCall* ret;
+      CHECK(Wait(MonoTime::Max(), &ret));
+      return ret;
+    }
+
+    // Like the above, but returns false if 'deadline' passes first.
+    bool Wait(const MonoTime& deadline, InboundCall** call) {
       MutexLock l(lock_);
       while (should_wake_ == false) {
-        cond_.Wait();
+        if (deadline == MonoTime::Max()) {
+          cond_.Wait();
+        } else if (!cond_.WaitUntil(deadline) && !should_wake_) {
+          return false;
+        }
       }
       should_wake_ = false;
-      InboundCall* ret = call_;
+      *call = call_;
       call_ = nullptr;
-      return ret;
+      return true;
     }
 
     void DCheckBoundInstance(LifoServiceQueue* q) {
@@ -200,6 +305,9 @@ class LifoServiceQueue {
     LifoServiceQueue* bound_queue_;
   };
 
+  // Return the record of the calling consumer thread, creating it if needed.
+  ConsumerState* GetConsumer();
+
   static __thread ConsumerState* tl_consumer_;
 
   mutable simple_spinlock lock_;
@@ -209,9 +317,20 @@ class LifoServiceQueue {
   // Stack of consumer threads which are currently waiting for work.
   std::vector<ConsumerState*> waiting_consumers_;
 
-  // The actual queue. Work is only added to the queue when there were no
-  // consumers available for a "direct hand-off".
-  std::multiset<InboundCall*, DeadlineLessStruct> queue_;
+  // Classification of calls, set at construction time from flags.
+  std::unordered_map<std::string, RpcPriority> method_priorities_;
+  std::vector<int> priority_weights_;
+  std::unordered_map<std::string, int> user_weights_;
+
+  // The actual queues, indexed by priority. Work is only added to the queues
+  // when there were no consumers available for a "direct hand-off".
+  PriorityQueue queues_[kNumRpcPriorities];
+  int num_queued_;
+
+  // The priority class whose turn it is, and the number of calls it has
+  // left to dequeue in its turn.
+  int cur_priority_;
+  int priority_deficit_;
 
   // The total set of consumers who have ever accessed this queue.
   std::vector<std::unique_ptr<ConsumerState>> consumers_;
@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/thread_pinning.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/os-util.h"
+#include "kudu/util/status.h"
+
+DEFINE_bool(rpc_pin_threads_to_cores, false,
+            "Whether to pin each RPC reactor thread, and each service thread "
+            "of each RPC service pool, to a single CPU core. The cores the "
+            "process may run on are split between reactor threads, which get "
+            "a quarter of them, and service threads, which get the rest, and "
+            "threads are spread round robin across their share.");
+TAG_FLAG(rpc_pin_threads_to_cores, advanced);
+TAG_FLAG(rpc_pin_threads_to_cores, experimental);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace rpc {
+
+namespace {
+
+// The CPUs set aside for each kind of RPC thread, and the process-wide
+// counters which spread the threads of each kind across them.
+class RpcThreadCpus {
+ public:
+  RpcThreadCpus() {
+    vector<int> cpus;
+    Status s = GetAllowedCpus(&cpus);
+    if (!s.ok()) {
+      LOG(WARNING) << "Not pinning RPC threads to cores: " << s.ToString();
+      return;
+    }
+    if (cpus.size() < 2) {
+      reactor_cpus_ = cpus;
+      service_cpus_ = cpus;
+      return;
+    }
+    const size_t num_reactor_cpus = std::max<size_t>(1, cpus.size() / 4);
+    reactor_cpus_.assign(cpus.begin(), cpus.begin() + num_reactor_cpus);
+    service_cpus_.assign(cpus.begin() + num_reactor_cpus, cpus.end());
+  }
+
+  // Returns the CPU to pin the next thread of kind 'kind' to, or -1 if the
+  // allowed CPUs are unknown.
+  int NextCpu(RpcThreadKind kind) {
+    const bool reactor = kind == RpcThreadKind::REACTOR;
+    const vector<int>& cpus = reactor ? reactor_cpus_ : service_cpus_;
+    if (cpus.empty()) {
+      return -1;
+    }
+    std::atomic<uint32_t>& next = reactor ? next_reactor_cpu_ : next_service_cpu_;
+    return cpus[next++ % cpus.size()];
+  }
+
+ private:
+  vector<int> reactor_cpus_;
+  vector<int> service_cpus_;
+  std::atomic<uint32_t> next_reactor_cpu_{0};
+  std::atomic<uint32_t> next_service_cpu_{0};
+};
+
+} // anonymous namespace
+
+void MaybePinRpcThread(RpcThreadKind kind, const string& thread_name) {
+  if (!FLAGS_rpc_pin_threads_to_cores) {
+    return;
+  }
+  // Constructed by the first thread to be pinned, before any thread is
+  // restricted to a single CPU.
+  static RpcThreadCpus cpus;
+  const int cpu = cpus.NextCpu(kind);
+  if (cpu < 0) {
+    return;
+  }
+  WARN_NOT_OK(PinCurrentThreadToCpu(cpu),
+              Substitute("$0: could not pin thread to CPU $1", thread_name, cpu));
+}
+
+} // namespace rpc
+} // namespace kudu
@@ -0,0 +1,45 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <string>
+
+namespace kudu {
+namespace rpc {
+
+// The kinds of RPC threads which --rpc_pin_threads_to_cores pins to CPUs.
+enum class RpcThreadKind {
+  REACTOR,
+  SERVICE
+};
+
+// If --rpc_pin_threads_to_cores is set, pin the calling thread, named
+// 'thread_name', to a single CPU.
+//
+// The CPUs are those the process is allowed to run on when the first thread
+// is pinned, e.g. as restricted by its cpuset. A quarter of them, and at
+// least one, are set aside for reactor threads and the rest for service
+// threads, so that the two never compete for a CPU. Only if the process may
+// run on a single CPU do they share it. Within each set, threads of the whole
+// process are assigned CPUs round robin.
+//
+// Failures to pin are logged and otherwise ignored.
+void MaybePinRpcThread(RpcThreadKind kind, const std::string& thread_name);
+
+} // namespace rpc
+} // namespace kudu
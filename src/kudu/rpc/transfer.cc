@@ -21,9 +21,12 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -32,8 +35,11 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
 
 DEFINE_int64(rpc_max_message_size, (50 * 1024 * 1024),
@@ -56,14 +62,55 @@ static bool ValidateMaxMessageSize(const char* flagname, int64_t value) {
 }
 DEFINE_validator(rpc_max_message_size, &ValidateMaxMessageSize);
 
+METRIC_DEFINE_counter(server, rpc_compression_input_bytes,
+                      "RPC Compression Input Bytes",
+                      kudu::MetricUnit::kBytes,
+                      "Total size of the RPC messages which were compressed before "
+                      "being sent.",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, rpc_compression_output_bytes,
+                      "RPC Compression Output Bytes",
+                      kudu::MetricUnit::kBytes,
+                      "Total size at which the RPC messages counted by "
+                      "rpc_compression_input_bytes were sent. Messages which didn't "
+                      "compress well were sent uncompressed.",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_histogram(server, rpc_compression_time_us,
+                        "RPC Compression Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds taken to compress each RPC message "
+                        "before it was sent.",
+                        kudu::MetricLevel::kDebug,
+                        10000000LU, 2);
+METRIC_DEFINE_histogram(server, rpc_decompression_time_us,
+                        "RPC Decompression Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds taken to decompress each compressed RPC "
+                        "message received.",
+                        kudu::MetricLevel::kDebug,
+                        10000000LU, 2);
+
 namespace kudu {
 namespace rpc {
 
 using std::ostringstream;
 using std::set;
 using std::string;
+using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
+namespace {
+
+// Set in the length prefix of a compressed message.
+constexpr uint32_t kCompressedMessageFlag = 1U << 31;
+
+// The size of the uncompressed length which follows the length prefix of a
+// compressed message.
+constexpr uint32_t kUncompressedLengthSize = sizeof(uint32_t);
+
+} // anonymous namespace
+
 #define RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status)               \
   do {                                                            \
     Status _s = (status);                                         \
@@ -78,18 +125,130 @@ using strings::Substitute;
 TransferCallbacks::~TransferCallbacks()
 {}
 
+RpcCompressionMetrics::RpcCompressionMetrics(const scoped_refptr<MetricEntity>& entity)
+    : input_bytes(METRIC_rpc_compression_input_bytes.Instantiate(entity)),
+      output_bytes(METRIC_rpc_compression_output_bytes.Instantiate(entity)),
+      compress_time_us(METRIC_rpc_compression_time_us.Instantiate(entity)),
+      decompress_time_us(METRIC_rpc_decompression_time_us.Instantiate(entity)) {
+}
+
+RpcCompressionMetrics::~RpcCompressionMetrics() {
+}
+
+ReadAheadBuffer::ReadAheadBuffer(scoped_refptr<InboundBufferPool> pool, size_t size)
+  : pool_(std::move(pool)),
+    size_(size),
+    buf_(nullptr),
+    buf_capacity_(0),
+    begin_(0),
+    end_(0) {
+}
+
+ReadAheadBuffer::~ReadAheadBuffer() {
+  if (buf_) {
+    InboundBufferPool::Release(pool_.get(), buf_, buf_capacity_);
+  }
+}
+
+Status ReadAheadBuffer::Recv(Socket* socket, uint8_t* buf, int32_t amount, int32_t* nread) {
+  DCHECK_GT(amount, 0);
+  int32_t n = std::min<size_t>(amount, end_ - begin_);
+  if (n > 0) {
+    memcpy(buf, &buf_[begin_], n);
+    begin_ += n;
+    MaybeReleaseBuffer();
+    if (n == amount) {
+      *nread = n;
+      return Status::OK();
+    }
+  }
+  DCHECK(empty());
+
+  // Read the rest from the socket: straight into 'buf' if reading ahead
+  // wouldn't save a recv() call, otherwise into our buffer.
+  int32_t rem = amount - n;
+  int32_t socket_nread;
+  Status s;
+  if (static_cast<size_t>(rem) >= size_) {
+    s = socket->Recv(buf + n, rem, &socket_nread);
+  } else {
+    if (!buf_) {
+      buf_ = InboundBufferPool::Acquire(pool_.get(), size_, &buf_capacity_);
+    }
+    s = socket->Recv(buf_, buf_capacity_, &socket_nread);
+    if (s.ok()) {
+      end_ = socket_nread;
+      socket_nread = std::min(socket_nread, rem);
+      memcpy(buf + n, buf_, socket_nread);
+      begin_ = socket_nread;
+    }
+    MaybeReleaseBuffer();
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    if (n > 0) {
+      // The caller will come across the error on its next read.
+      *nread = n;
+      return Status::OK();
+    }
+    return s;
+  }
+  *nread = n + socket_nread;
+  return Status::OK();
+}
+
+void ReadAheadBuffer::MaybeReleaseBuffer() {
+  if (!empty() || !buf_) {
+    return;
+  }
+  begin_ = 0;
+  end_ = 0;
+  // Without a pool, there's nothing to be saved by freeing the buffer only
+  // to allocate it again on the next read.
+  if (pool_) {
+    InboundBufferPool::Release(pool_.get(), buf_, buf_capacity_);
+    buf_ = nullptr;
+    buf_capacity_ = 0;
+  }
+}
+
 InboundTransfer::InboundTransfer()
-  : total_length_(kMsgLengthPrefixLength),
+  : InboundTransfer(nullptr) {
+}
+
+InboundTransfer::InboundTransfer(scoped_refptr<InboundBufferPool> pool)
+  : InboundTransfer(std::move(pool), nullptr, nullptr) {
+}
+
+InboundTransfer::InboundTransfer(scoped_refptr<InboundBufferPool> pool,
+                                 const CompressionCodec* codec,
+                                 const RpcCompressionMetrics* metrics)
+  : pool_(std::move(pool)),
+    codec_(codec),
+    metrics_(metrics),
+    compressed_(false),
+    buf_(nullptr),
+    buf_capacity_(0),
+    total_length_(kMsgLengthPrefixLength),
     cur_offset_(0) {
-  buf_.resize(kMsgLengthPrefixLength);
+}
+
+InboundTransfer::~InboundTransfer() {
+  if (buf_) {
+    InboundBufferPool::Release(pool_.get(), buf_, buf_capacity_);
+  }
 }
 
 Status InboundTransfer::ReceiveBuffer(Socket &socket) {
+  ReadAheadBuffer no_read_ahead(nullptr, 0);
+  return ReceiveBuffer(socket, &no_read_ahead);
+}
+
+Status InboundTransfer::ReceiveBuffer(Socket &socket, ReadAheadBuffer* read_ahead) {
   if (cur_offset_ < kMsgLengthPrefixLength) {
     // receive uint32 length prefix
     int32_t rem = kMsgLengthPrefixLength - cur_offset_;
     int32_t nread;
-    Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+    Status status = read_ahead->Recv(&socket, &length_prefix_[cur_offset_], rem, &nread);
     RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
     if (nread == 0) {
       return Status::OK();
@@ -107,7 +266,16 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
 
     // The length prefix doesn't include its own 4 bytes, so we have to
     // add that back in.
-    total_length_ = NetworkByteOrder::Load32(&buf_[0]) + kMsgLengthPrefixLength;
+    uint32_t length = NetworkByteOrder::Load32(length_prefix_);
+    if (codec_ && (length & kCompressedMessageFlag)) {
+      compressed_ = true;
+      length &= ~kCompressedMessageFlag;
+      if (length <= kUncompressedLengthSize) {
+        return Status::NetworkError(Substitute(
+            "compressed RPC frame had invalid length of $0", length));
+      }
+    }
+    total_length_ = length + kMsgLengthPrefixLength;
     if (total_length_ > FLAGS_rpc_max_message_size) {
       return Status::NetworkError(Substitute(
           "RPC frame had a length of $0, but we only support messages up to $1 bytes "
@@ -117,7 +285,10 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
       return Status::NetworkError(Substitute("RPC frame had invalid length of $0",
                                              total_length_));
     }
-    buf_.resize(total_length_);
+    // Receive the whole message, length prefix included, into a single buffer
+    // so that it can be parsed in place.
+    buf_ = InboundBufferPool::Acquire(pool_.get(), total_length_, &buf_capacity_);
+    memcpy(buf_, length_prefix_, kMsgLengthPrefixLength);
 
     // Fall through to receive the message body, which is likely to be already
     // available on the socket.
@@ -132,10 +303,51 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
   // currently only used for unit tests.
   int32_t rem = std::min(total_length_ - cur_offset_,
       static_cast<uint32_t>(std::numeric_limits<int32_t>::max()));
-  Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+  Status status = read_ahead->Recv(&socket, &buf_[cur_offset_], rem, &nread);
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
   cur_offset_ += nread;
 
+  if (compressed_ && TransferFinished()) {
+    return Decompress();
+  }
+  return Status::OK();
+}
+
+Status InboundTransfer::Decompress() {
+  DCHECK(compressed_);
+  MonoTime start = MonoTime::Now();
+  const uint8_t* compressed = buf_ + kMsgLengthPrefixLength;
+  const uint32_t uncompressed_length = NetworkByteOrder::Load32(compressed);
+  const int64_t new_total_length =
+      static_cast<int64_t>(uncompressed_length) + kMsgLengthPrefixLength;
+  if (uncompressed_length == 0 || new_total_length > FLAGS_rpc_max_message_size) {
+    return Status::NetworkError(Substitute(
+        "compressed RPC frame had an uncompressed length of $0, but we only support "
+        "messages up to $1 bytes long.", uncompressed_length, FLAGS_rpc_max_message_size));
+  }
+
+  size_t capacity;
+  uint8_t* buf = InboundBufferPool::Acquire(pool_.get(), new_total_length, &capacity);
+  Status s = codec_->Uncompress(
+      Slice(compressed + kUncompressedLengthSize,
+            total_length_ - kMsgLengthPrefixLength - kUncompressedLengthSize),
+      buf + kMsgLengthPrefixLength, uncompressed_length);
+  if (PREDICT_FALSE(!s.ok())) {
+    InboundBufferPool::Release(pool_.get(), buf, capacity);
+    return Status::NetworkError("could not decompress RPC frame", s.ToString());
+  }
+  NetworkByteOrder::Store32(buf, uncompressed_length);
+
+  InboundBufferPool::Release(pool_.get(), buf_, buf_capacity_);
+  buf_ = buf;
+  buf_capacity_ = capacity;
+  total_length_ = new_total_length;
+  cur_offset_ = new_total_length;
+  compressed_ = false;
+
+  if (metrics_) {
+    metrics_->decompress_time_us->Increment((MonoTime::Now() - start).ToMicroseconds());
+  }
   return Status::OK();
 }
 
@@ -173,7 +385,9 @@ OutboundTransfer::OutboundTransfer(int32_t call_id,
     callbacks_(callbacks),
     call_id_(call_id),
     started_(false),
-    aborted_(false) {
+    aborted_(false),
+    zero_copy_pending_(false),
+    last_zero_copy_send_(0) {
 
   n_payload_slices_ = n_payload_slices;
   CHECK_LE(n_payload_slices_, payload_slices_.size());
@@ -186,6 +400,54 @@ OutboundTransfer::~OutboundTransfer() {
   if (!TransferFinished() && !aborted_) {
     callbacks_->NotifyTransferAborted(
       Status::RuntimeError("RPC transfer destroyed before it finished sending"));
+  } else if (zero_copy_pending_) {
+    // The connection was shut down before the kernel reported the last send
+    // complete. The connection resets its socket first, discarding whatever
+    // the kernel hadn't sent yet, so the memory may be released.
+    callbacks_->NotifyTransferFinished();
+  }
+}
+
+void OutboundTransfer::MaybeCompress(const CompressionCodec* codec,
+                                     int64_t min_bytes,
+                                     const RpcCompressionMetrics* metrics) {
+  DCHECK(!started_);
+  const int32_t total_length = TotalLength();
+  if (total_length < min_bytes) {
+    return;
+  }
+  MonoTime start = MonoTime::Now();
+
+  // The message starts with its length prefix, which isn't compressed.
+  vector<Slice> slices(payload_slices_.begin(), payload_slices_.begin() + n_payload_slices_);
+  DCHECK_GE(slices[0].size(), kMsgLengthPrefixLength);
+  slices[0].remove_prefix(kMsgLengthPrefixLength);
+  const uint32_t uncompressed_length = total_length - kMsgLengthPrefixLength;
+  const size_t header_length = kMsgLengthPrefixLength + kUncompressedLengthSize;
+
+  unique_ptr<uint8_t[]> buf(
+      new uint8_t[header_length + codec->MaxCompressedLength(uncompressed_length)]);
+  size_t compressed_length;
+  Status s = codec->Compress(slices, buf.get() + header_length, &compressed_length);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 1) << "could not compress RPC message: " << s.ToString()
+                                  << THROTTLE_MSG;
+    return;
+  }
+  // Send the message compressed if that's any smaller.
+  if (header_length + compressed_length < static_cast<size_t>(total_length)) {
+    NetworkByteOrder::Store32(
+        buf.get(), (kUncompressedLengthSize + compressed_length) | kCompressedMessageFlag);
+    NetworkByteOrder::Store32(buf.get() + kMsgLengthPrefixLength, uncompressed_length);
+    payload_slices_[0] = Slice(buf.get(), header_length + compressed_length);
+    n_payload_slices_ = 1;
+    compressed_message_ = std::move(buf);
+  }
+
+  if (metrics) {
+    metrics->compress_time_us->Increment((MonoTime::Now() - start).ToMicroseconds());
+    metrics->input_bytes->IncrementBy(total_length);
+    metrics->output_bytes->IncrementBy(TotalLength());
   }
 }
 
@@ -196,26 +458,25 @@ void OutboundTransfer::Abort(const Status &status) {
   aborted_ = true;
 }
 
-Status OutboundTransfer::SendBuffer(Socket &socket) {
+int OutboundTransfer::FillIovecs(struct iovec* iov) {
   CHECK_LT(cur_slice_idx_, n_payload_slices_);
 
   started_ = true;
-  int n_iovecs = n_payload_slices_ - cur_slice_idx_;
-  struct iovec iovec[n_iovecs];
-  {
-    int offset_in_slice = cur_offset_in_slice_;
-    for (int i = 0; i < n_iovecs; i++) {
-      Slice &slice = payload_slices_[cur_slice_idx_ + i];
-      iovec[i].iov_base = slice.mutable_data() + offset_in_slice;
-      iovec[i].iov_len = slice.size() - offset_in_slice;
-
-      offset_in_slice = 0;
-    }
+  int n_iovecs = num_remaining_slices();
+  int offset_in_slice = cur_offset_in_slice_;
+  for (int i = 0; i < n_iovecs; i++) {
+    Slice &slice = payload_slices_[cur_slice_idx_ + i];
+    iov[i].iov_base = slice.mutable_data() + offset_in_slice;
+    iov[i].iov_len = slice.size() - offset_in_slice;
+
+    offset_in_slice = 0;
   }
+  return n_iovecs;
+}
 
-  int64_t written;
-  Status status = socket.Writev(iovec, n_iovecs, &written);
-  RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
+int64_t OutboundTransfer::Advance(int64_t written) {
+  DCHECK(started_);
+  int64_t consumed = 0;
 
   // Adjust our accounting of current writer position.
   for (int i = cur_slice_idx_; i < n_payload_slices_; i++) {
@@ -223,27 +484,45 @@ Status OutboundTransfer::SendBuffer(Socket &socket) {
     int rem_in_slice = slice.size() - cur_offset_in_slice_;
     DCHECK_GE(rem_in_slice, 0);
 
-    if (written >= rem_in_slice) {
+    if (written - consumed >= rem_in_slice) {
       // Used up this entire slice, advance to the next slice.
       cur_slice_idx_++;
       cur_offset_in_slice_ = 0;
-      written -= rem_in_slice;
+      consumed += rem_in_slice;
     } else {
       // Partially used up this slice, just advance the offset within it.
-      cur_offset_in_slice_ += written;
+      cur_offset_in_slice_ += written - consumed;
+      consumed = written;
       break;
     }
   }
 
   if (cur_slice_idx_ == n_payload_slices_) {
-    callbacks_->NotifyTransferFinished();
+    if (!zero_copy_pending_) {
+      callbacks_->NotifyTransferFinished();
+    }
     DCHECK_EQ(0, cur_offset_in_slice_);
   } else {
     DCHECK_LT(cur_slice_idx_, n_payload_slices_);
     DCHECK_LT(cur_offset_in_slice_, payload_slices_[cur_slice_idx_].size());
   }
 
-  return Status::OK();
+  return consumed;
+}
+
+void OutboundTransfer::MarkZeroCopySend(uint32_t send_id) {
+  DCHECK(started_);
+  DCHECK(!TransferFinished());
+  zero_copy_pending_ = true;
+  last_zero_copy_send_ = send_id;
+}
+
+void OutboundTransfer::ZeroCopySendsCompleted() {
+  DCHECK(zero_copy_pending_);
+  zero_copy_pending_ = false;
+  if (TransferFinished()) {
+    callbacks_->NotifyTransferFinished();
+  }
 }
 
 bool OutboundTransfer::TransferStarted() const {
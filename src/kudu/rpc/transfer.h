@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <limits.h>
+#include <memory>
 #include <string>
 
 #include <boost/intrusive/list_hook.hpp>
@@ -29,21 +30,43 @@
 #include <glog/logging.h>
 
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/constants.h"
-#include "kudu/util/faststring.h"
+#include "kudu/rpc/inbound_buffer_pool.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 DECLARE_int64(rpc_max_message_size);
 
+struct iovec;
+
 namespace kudu {
 
+class CompressionCodec;
+class Counter;
+class Histogram;
+class MetricEntity;
 class Socket;
 
 namespace rpc {
 
 struct TransferCallbacks;
 
+// Metrics on the compression of RPC messages.
+struct RpcCompressionMetrics {
+  explicit RpcCompressionMetrics(const scoped_refptr<MetricEntity>& entity);
+  ~RpcCompressionMetrics();
+
+  // The total size of the messages which compression was attempted on, and
+  // the total size they were sent at, whether compressed or not.
+  scoped_refptr<Counter> input_bytes;
+  scoped_refptr<Counter> output_bytes;
+
+  // The time taken to compress and to decompress each message.
+  scoped_refptr<Histogram> compress_time_us;
+  scoped_refptr<Histogram> decompress_time_us;
+};
+
 class TransferLimits {
  public:
   enum {
@@ -57,28 +80,98 @@ class TransferLimits {
 
 typedef std::array<Slice, TransferLimits::kMaxPayloadSlices> TransferPayload;
 
+// Data read ahead from a connection's socket.
+//
+// Small reads, such as of the length prefix of a message, read as much as
+// the socket has available, up to a buffer's worth, keeping what wasn't
+// asked for to serve later reads. This way the prefix and body of a small
+// message, and often the next few messages too, take a single recv() rather
+// than two recv() calls per message.
+//
+// The buffer is taken from 'pool' while it holds data, and returned to it
+// once drained, so that idle connections don't hold on to one.
+class ReadAheadBuffer {
+ public:
+  // Read ahead up to 'size' bytes at a time. A size of 0 disables reading
+  // ahead.
+  ReadAheadBuffer(scoped_refptr<InboundBufferPool> pool, size_t size);
+  ~ReadAheadBuffer();
+
+  // Read up to 'amount' bytes into 'buf', first from the data read ahead,
+  // then from 'socket'. Same semantics as Socket::Recv(), except that an
+  // error from the socket is deferred to the next call if some data could
+  // be returned.
+  Status Recv(Socket* socket, uint8_t* buf, int32_t amount, int32_t* nread);
+
+  // Whether there is no data read ahead. Since that data is no longer
+  // pending on the socket, the socket won't be reported as readable
+  // because of it.
+  bool empty() const {
+    return begin_ == end_;
+  }
+
+ private:
+  // Return the buffer to the pool, if it was drained.
+  void MaybeReleaseBuffer();
+
+  const scoped_refptr<InboundBufferPool> pool_;
+  const size_t size_;
+
+  uint8_t* buf_;
+  size_t buf_capacity_;
+
+  // The data read ahead is buf_[begin_, end_).
+  size_t begin_;
+  size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadAheadBuffer);
+};
+
 // This class is used internally by the RPC layer to represent an inbound
 // transfer in progress.
 //
 // Inbound Transfer objects are created by a Connection receiving data. When the
 // message is fully received, it is either parsed as a call, or a call response,
 // and the InboundTransfer object itself is handed off.
+//
+// The message is received into a buffer from 'pool', if not null, which is
+// returned to the pool when the transfer is destroyed. Parsed calls and
+// responses, including their sidecars, refer to the message in place, so
+// the transfer is kept alive for as long as they are.
+//
+// On connections which negotiated compression, 'codec' is the codec of the
+// connection. A message may then be sent compressed, which is flagged by the
+// top bit of its length prefix. The length prefix is followed by the length
+// of the uncompressed message, without its prefix, and then the compressed
+// message. Such messages are decompressed once received, so data() is the
+// message as it was before compression.
 class InboundTransfer {
  public:
 
   InboundTransfer();
+  explicit InboundTransfer(scoped_refptr<InboundBufferPool> pool);
+  InboundTransfer(scoped_refptr<InboundBufferPool> pool,
+                  const CompressionCodec* codec,
+                  const RpcCompressionMetrics* metrics);
+  ~InboundTransfer();
 
   // read from the socket into our buffer
   Status ReceiveBuffer(Socket &socket);
 
+  // Like the above, but reads through 'read_ahead'.
+  Status ReceiveBuffer(Socket &socket, ReadAheadBuffer* read_ahead);
+
   // Return true if any bytes have yet been sent.
   bool TransferStarted() const;
 
   // Return true if the entire transfer has been sent.
   bool TransferFinished() const;
 
+  // The message received, including its length prefix. Only valid once the
+  // transfer has finished.
   Slice data() const {
-    return Slice(buf_);
+    DCHECK(TransferFinished());
+    return Slice(buf_, total_length_);
   }
 
   // Return a string indicating the status of this transfer (number of bytes received, etc)
@@ -89,7 +182,25 @@ class InboundTransfer {
 
   Status ProcessInboundHeader();
 
-  faststring buf_;
+  // Replace the compressed message in 'buf_' with the decompressed one.
+  Status Decompress();
+
+  const scoped_refptr<InboundBufferPool> pool_;
+
+  // May be null.
+  const CompressionCodec* const codec_;
+  const RpcCompressionMetrics* const metrics_;
+
+  // Whether the message being received is compressed.
+  bool compressed_;
+
+  // The length prefix of the message, which is received before we know how
+  // large a buffer the message needs.
+  uint8_t length_prefix_[kMsgLengthPrefixLength];
+
+  // The buffer the message is received into, once its length is known.
+  uint8_t* buf_;
+  size_t buf_capacity_;
 
   uint32_t total_length_;
   uint32_t cur_offset_;
@@ -138,8 +249,52 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // This triggers TransferCallbacks::NotifyTransferAborted.
   void Abort(const Status &status);
 
-  // send from our buffers into the sock
-  Status SendBuffer(Socket &socket);
+  // Fill 'iov' with the parts of the transfer which are yet to be sent,
+  // returning the number of iovecs filled, at most num_remaining_slices().
+  // The transfer is considered started from then on.
+  int FillIovecs(struct iovec* iov);
+
+  // Account for 'written' bytes having been sent from the iovecs last filled
+  // by FillIovecs(), and any which followed them, returning the number of
+  // bytes which belonged to this transfer. Triggers
+  // TransferCallbacks::NotifyTransferFinished once the transfer is complete.
+  int64_t Advance(int64_t written);
+
+  // The number of iovecs needed to send the rest of this transfer.
+  int num_remaining_slices() const {
+    return n_payload_slices_ - cur_slice_idx_;
+  }
+
+  // Note that some of the transfer was sent by the zero-copy send numbered
+  // 'send_id' (see Socket::WritevZeroCopy()). The kernel may then read its
+  // memory until that send completes, so TransferCallbacks::
+  // NotifyTransferFinished, which may free it, is held back until
+  // ZeroCopySendsCompleted() is called. Must be called before Advance()
+  // accounts for the bytes of that send.
+  void MarkZeroCopySend(uint32_t send_id);
+
+  // Called once the kernel has completed last_zero_copy_send().
+  void ZeroCopySendsCompleted();
+
+  // Whether the kernel may still be reading the memory of the transfer.
+  bool zero_copy_pending() const {
+    return zero_copy_pending_;
+  }
+
+  // The number of the last zero-copy send which the transfer was part of.
+  // Only valid if zero_copy_pending().
+  uint32_t last_zero_copy_send() const {
+    DCHECK(zero_copy_pending_);
+    return last_zero_copy_send_;
+  }
+
+  // If the message to be sent is at least 'min_bytes' long, compress it with
+  // 'codec', and send it compressed if that makes it smaller. See
+  // InboundTransfer for the format of compressed messages. 'metrics' may be
+  // null. Must be called before the transfer is started.
+  void MaybeCompress(const CompressionCodec* codec,
+                     int64_t min_bytes,
+                     const RpcCompressionMetrics* metrics);
 
   // Return true if any bytes have yet been sent.
   bool TransferStarted() const;
@@ -181,6 +336,10 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
 
   TransferCallbacks *callbacks_;
 
+  // The compressed message, if MaybeCompress() compressed it. The payload
+  // slices then refer to this rather than to the caller's memory.
+  std::unique_ptr<uint8_t[]> compressed_message_;
+
   // In the case of outbound calls, the associated call ID.
   // In the case of call responses, kInvalidCallId
   int32_t call_id_;
@@ -192,6 +351,11 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
 
   bool aborted_;
 
+  // Whether some of the transfer was sent with MSG_ZEROCOPY, and the last
+  // such send hasn't completed yet.
+  bool zero_copy_pending_;
+  uint32_t last_zero_copy_send_;
+
   DISALLOW_COPY_AND_ASSIGN(OutboundTransfer);
 };
 
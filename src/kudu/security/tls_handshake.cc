@@ -20,6 +20,8 @@
 #include <memory>
 #include <string>
 
+#include <gflags/gflags.h>
+#include <glog/logging.h>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
@@ -28,6 +30,8 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/security/cert.h"
 #include "kudu/security/tls_socket.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
@@ -36,6 +40,16 @@
 #include "kudu/security/x509_check_host.h"
 #endif // OPENSSL_VERSION_NUMBER
 
+DEFINE_bool(rpc_tls_kernel_offload, false,
+            "Whether to hand the keys of TLS-encrypted RPC connections to the "
+            "kernel once the TLS handshake is done, so that the kernel encrypts "
+            "and decrypts their traffic (kTLS) rather than the reactor threads. "
+            "Requires a Linux kernel with the 'tls' module loaded and the "
+            "TLSv1.2 protocol with an AES-GCM cipher. Connections for which "
+            "this isn't possible are encrypted by OpenSSL as usual.");
+TAG_FLAG(rpc_tls_kernel_offload, advanced);
+TAG_FLAG(rpc_tls_kernel_offload, experimental);
+
 using std::string;
 using std::unique_ptr;
 using strings::Substitute;
@@ -211,7 +225,15 @@ Status TlsHandshake::Finish(unique_ptr<Socket>* socket) {
   }
 
   // Transfer the SSL instance to the socket.
-  socket->reset(new TlsSocket(fd, std::move(ssl_)));
+  unique_ptr<TlsSocket> tls_socket(new TlsSocket(fd, std::move(ssl_)));
+  if (FLAGS_rpc_tls_kernel_offload) {
+    Status s = tls_socket->EnableKernelTls();
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "could not offload TLS to the kernel: "
+                                     << s.ToString() << THROTTLE_MSG;
+    }
+  }
+  *socket = std::move(tls_socket);
 
   return Status::OK();
 }
@@ -17,21 +17,48 @@
 
 #include "kudu/security/tls_socket.h"
 
+#include <sys/socket.h>
 #include <sys/uio.h>
 
 #include <cerrno>
+#include <cstring>
 #include <string>
 #include <utility>
 
 #include <glog/logging.h>
+#include <openssl/crypto.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
 
 #include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/security/openssl_util.h"
 #include "kudu/util/errno.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/scoped_cleanup.h"
+
+// Kernel TLS needs the kTLS UAPI headers, and the OpenSSL 1.1.1 APIs which
+// expose what's needed to derive the keys of a session.
+#if defined(__linux__) && defined(__has_include) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+#if __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <openssl/kdf.h>
+#define KUDU_HAVE_KTLS 1
+#endif
+#endif
+
+#ifdef KUDU_HAVE_KTLS
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
 
 using std::string;
 using strings::Substitute;
@@ -39,9 +66,88 @@ using strings::Substitute;
 namespace kudu {
 namespace security {
 
+#ifdef KUDU_HAVE_KTLS
+namespace {
+
+// The size of the implicit part of the AES-GCM nonce, which TLS derives
+// along with the keys.
+constexpr size_t kSaltLength = 4;
+
+// The TLS sequence number of the first record sent in either direction after
+// the handshake. The Finished message, which has sequence number 0, is the
+// only record either side encrypts during a TLSv1.2 handshake.
+constexpr uint64_t kFirstRecordSequenceNumber = 1;
+
+// Derive the TLSv1.2 key block of the session of 'ssl' into 'key_block', per
+// RFC 5246 section 6.3, using 'md' as the digest of the PRF.
+Status DeriveKeyBlock(SSL* ssl, const EVP_MD* md, uint8_t* key_block, size_t len) {
+  uint8_t master_key[SSL_MAX_MASTER_KEY_LENGTH];
+  SCOPED_CLEANUP({ OPENSSL_cleanse(master_key, sizeof(master_key)); });
+  size_t master_key_len = SSL_SESSION_get_master_key(
+      SSL_get_session(ssl), master_key, sizeof(master_key));
+  uint8_t client_random[SSL3_RANDOM_SIZE];
+  uint8_t server_random[SSL3_RANDOM_SIZE];
+  SSL_get_client_random(ssl, client_random, sizeof(client_random));
+  SSL_get_server_random(ssl, server_random, sizeof(server_random));
+
+  static const char kLabel[] = "key expansion";
+  c_unique_ptr<EVP_PKEY_CTX> ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr),
+                                 &EVP_PKEY_CTX_free);
+  OPENSSL_RET_IF_NULL(ctx, "failed to create TLS PRF context");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_derive_init(ctx.get()), "failed to initialize TLS PRF");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_set_tls1_prf_md(ctx.get(), md),
+                     "failed to set TLS PRF digest");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_set1_tls1_prf_secret(ctx.get(), master_key, master_key_len),
+                     "failed to set TLS PRF secret");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), kLabel, sizeof(kLabel) - 1),
+                     "failed to set TLS PRF seed");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), server_random,
+                                                     sizeof(server_random)),
+                     "failed to set TLS PRF seed");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), client_random,
+                                                     sizeof(client_random)),
+                     "failed to set TLS PRF seed");
+  OPENSSL_RET_NOT_OK(EVP_PKEY_derive(ctx.get(), key_block, &len),
+                     "failed to derive TLS key block");
+  return Status::OK();
+}
+
+// Hand the key and salt of one direction of a TLSv1.2 AES-GCM session to the
+// kernel. 'direction' is TLS_TX or TLS_RX.
+template<typename CryptoInfo>
+Status SetKernelTlsKeys(int fd, int direction, uint16_t cipher_type,
+                        const uint8_t* key, const uint8_t* salt) {
+  CryptoInfo info;
+  memset(&info, 0, sizeof(info));
+  SCOPED_CLEANUP({ OPENSSL_cleanse(&info, sizeof(info)); });
+  info.info.version = TLS_1_2_VERSION;
+  info.info.cipher_type = cipher_type;
+  memcpy(info.key, key, sizeof(info.key));
+  memcpy(info.salt, salt, sizeof(info.salt));
+  static_assert(sizeof(info.rec_seq) == sizeof(uint64_t), "unexpected sequence number size");
+  BigEndian::Store64(info.rec_seq, kFirstRecordSequenceNumber);
+  // The explicit part of the nonce of each record only has to be unique, and
+  // RFC 5288 suggests the sequence number for it. The kernel increments it
+  // with each record sent.
+  static_assert(sizeof(info.iv) == sizeof(uint64_t), "unexpected explicit nonce size");
+  BigEndian::Store64(info.iv, kFirstRecordSequenceNumber);
+  if (setsockopt(fd, SOL_TLS, direction, &info, sizeof(info)) != 0) {
+    int err = errno;
+    return Status::NetworkError(Substitute("failed to set kernel TLS $0 keys",
+                                           direction == TLS_TX ? "send" : "receive"),
+                                ErrnoToString(err), err);
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+#endif
+
 TlsSocket::TlsSocket(int fd, c_unique_ptr<SSL> ssl)
     : Socket(fd),
-      ssl_(std::move(ssl)) {
+      ssl_(std::move(ssl)),
+      ktls_send_(false),
+      ktls_recv_(false) {
 }
 
 TlsSocket::~TlsSocket() {
@@ -59,6 +165,9 @@ Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
     // it, because SSL_write can return '0' to indicate certain types of errors.
     return Status::OK();
   }
+  if (ktls_send_) {
+    return Socket::Write(buf, amt, nwritten);
+  }
 
   errno = 0;
   int32_t bytes_written = SSL_write(ssl_.get(), buf, amt);
@@ -83,6 +192,11 @@ Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
 Status TlsSocket::Writev(const struct ::iovec *iov, int iov_len, int64_t *nwritten) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   CHECK(ssl_);
+  if (ktls_send_) {
+    // The kernel encrypts whatever is written, so there's no need to write
+    // the buffers one at a time.
+    return Socket::Writev(iov, iov_len, nwritten);
+  }
   *nwritten = 0;
   // Allows packets to be aggresively be accumulated before sending.
   RETURN_NOT_OK(SetTcpCork(1));
@@ -112,6 +226,12 @@ Status TlsSocket::Recv(uint8_t *buf, int32_t amt, int32_t *nread) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
 
   CHECK(ssl_);
+  if (ktls_recv_) {
+    // Records other than application data, such as alerts, fail the read
+    // with EIO, which ends the connection just as the alerts themselves
+    // would.
+    return Socket::Recv(buf, amt, nread);
+  }
   errno = 0;
   int32_t bytes_read = SSL_read(ssl_.get(), buf, amt);
   int save_errno = errno;
@@ -169,13 +289,18 @@ Status TlsSocket::Close() {
 
   // Start the TLS shutdown processes. We don't care about waiting for the
   // response, since the underlying socket will not be reused.
-  int32_t ret = SSL_shutdown(ssl_.get());
+  //
+  // If the kernel encrypts what's sent, OpenSSL no longer knows the state of
+  // the session to send the close_notify alert with, so the socket is simply
+  // closed.
   Status ssl_shutdown;
-  if (ret >= 0) {
-    ssl_shutdown = Status::OK();
-  } else {
-    auto error_code = SSL_get_error(ssl_.get(), ret);
-    ssl_shutdown = Status::NetworkError("TlsSocket::Close", GetSSLErrorDescription(error_code));
+  if (!ktls_send_) {
+    int32_t ret = SSL_shutdown(ssl_.get());
+    if (ret < 0) {
+      auto error_code = SSL_get_error(ssl_.get(), ret);
+      ssl_shutdown = Status::NetworkError("TlsSocket::Close",
+                                          GetSSLErrorDescription(error_code));
+    }
   }
 
   ssl_.reset();
@@ -185,5 +310,85 @@ Status TlsSocket::Close() {
   return ssl_shutdown;
 }
 
+Status TlsSocket::EnableZeroCopy() {
+  return Status::NotSupported("zero-copy sends are not supported on TLS sockets");
+}
+
+Status TlsSocket::EnableKernelTls() {
+#ifndef KUDU_HAVE_KTLS
+  return Status::NotSupported("kernel TLS is not supported on this platform");
+#else
+  SCOPED_OPENSSL_NO_PENDING_ERRORS;
+  CHECK(ssl_);
+  DCHECK(!ktls_send_ && !ktls_recv_);
+  if (SSL_version(ssl_.get()) != TLS1_2_VERSION) {
+    return Status::NotSupported("kernel TLS is only supported with TLSv1.2",
+                                SSL_get_version(ssl_.get()));
+  }
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl_.get());
+  size_t key_length;
+  uint16_t cipher_type;
+  switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+    case NID_aes_128_gcm:
+      key_length = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+      cipher_type = TLS_CIPHER_AES_GCM_128;
+      break;
+    case NID_aes_256_gcm:
+      key_length = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+      cipher_type = TLS_CIPHER_AES_GCM_256;
+      break;
+    default:
+      return Status::NotSupported("kernel TLS is not supported with cipher",
+                                  SSL_CIPHER_get_name(cipher));
+  }
+
+  // With AEAD ciphers, the key block consists of the client and server keys
+  // followed by the client and server salts.
+  uint8_t key_block[2 * TLS_CIPHER_AES_GCM_256_KEY_SIZE + 2 * kSaltLength];
+  SCOPED_CLEANUP({ OPENSSL_cleanse(key_block, sizeof(key_block)); });
+  RETURN_NOT_OK(DeriveKeyBlock(ssl_.get(), SSL_CIPHER_get_handshake_digest(cipher),
+                               key_block, 2 * key_length + 2 * kSaltLength));
+  const uint8_t* client_key = key_block;
+  const uint8_t* server_key = key_block + key_length;
+  const uint8_t* client_salt = key_block + 2 * key_length;
+  const uint8_t* server_salt = client_salt + kSaltLength;
+  const bool is_server = SSL_is_server(ssl_.get());
+
+  static const char kTlsUlp[] = "tls";
+  if (setsockopt(GetFd(), SOL_TCP, TCP_ULP, kTlsUlp, sizeof(kTlsUlp)) != 0) {
+    int err = errno;
+    return Status::NotSupported("kernel TLS is not available", ErrnoToString(err), err);
+  }
+  auto set_keys = [&](int direction, const uint8_t* key, const uint8_t* salt) {
+    if (cipher_type == TLS_CIPHER_AES_GCM_128) {
+      return SetKernelTlsKeys<tls12_crypto_info_aes_gcm_128>(
+          GetFd(), direction, cipher_type, key, salt);
+    }
+    return SetKernelTlsKeys<tls12_crypto_info_aes_gcm_256>(
+        GetFd(), direction, cipher_type, key, salt);
+  };
+  RETURN_NOT_OK(set_keys(TLS_TX,
+                         is_server ? server_key : client_key,
+                         is_server ? server_salt : client_salt));
+  ktls_send_ = true;
+
+  // Any records OpenSSL already read off the socket would be lost to the
+  // kernel, so receives stay with OpenSSL if there are any. Older kernels
+  // support offloading sends only.
+  if (SSL_has_pending(ssl_.get())) {
+    return Status::OK();
+  }
+  Status s = set_keys(TLS_RX,
+                      is_server ? client_key : server_key,
+                      is_server ? client_salt : server_salt);
+  if (s.ok()) {
+    ktls_recv_ = true;
+  } else {
+    VLOG(1) << "could not offload TLS receives to the kernel: " << s.ToString();
+  }
+  return Status::OK();
+#endif
+}
+
 } // namespace security
 } // namespace kudu
@@ -46,14 +46,39 @@ class TlsSocket : public Socket {
 
   Status Close() override WARN_UNUSED_RESULT;
 
+  // Zero-copy sends aren't supported, as the data must be encrypted first.
+  Status EnableZeroCopy() override WARN_UNUSED_RESULT;
+
+  // Whether records sent on the socket are encrypted by the kernel rather
+  // than by OpenSSL.
+  bool kernel_tls_send() const { return ktls_send_; }
+
+  // Whether records received on the socket are decrypted by the kernel rather
+  // than by OpenSSL.
+  bool kernel_tls_recv() const { return ktls_recv_; }
+
  private:
 
   friend class TlsHandshake;
 
   TlsSocket(int fd, c_unique_ptr<SSL> ssl);
 
+  // Hand the keys of the TLS session to the kernel (kTLS), so that sends and
+  // receives are plain socket syscalls which the kernel encrypts and
+  // decrypts. Must be called right after the handshake, before any records
+  // are sent or received on the socket.
+  //
+  // Only TLSv1.2 sessions with AES-GCM ciphers on Linux are supported. If
+  // the kernel can only take the send keys, receives are still decrypted by
+  // OpenSSL. Returns an error if neither direction could be offloaded, in
+  // which case the socket remains usable as is.
+  Status EnableKernelTls();
+
   // Owned SSL handle.
   c_unique_ptr<SSL> ssl_;
+
+  bool ktls_send_;
+  bool ktls_recv_;
 };
 
 } // namespace security
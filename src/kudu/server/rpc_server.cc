@@ -69,7 +69,8 @@ DEFINE_int32(rpc_num_acceptors_per_address, 1,
 TAG_FLAG(rpc_num_acceptors_per_address, advanced);
 
 DEFINE_int32(rpc_num_service_threads, 10,
-             "Number of RPC worker threads to run");
+             "Number of RPC worker threads to run. Services may add more "
+             "threads while they fall behind; see --rpc_service_max_threads.");
 TAG_FLAG(rpc_num_service_threads, advanced);
 
 DEFINE_int32(rpc_service_queue_length, 50,
@@ -38,6 +38,7 @@ using kudu::rpc::DumpConnectionsResponsePB;
 using kudu::rpc::DumpRpczStoreRequestPB;
 using kudu::rpc::DumpRpczStoreResponsePB;
 using kudu::rpc::Messenger;
+using kudu::rpc::RpczMethodPB;
 using std::ostringstream;
 using std::shared_ptr;
 using std::string;
@@ -74,12 +75,49 @@ void RpczPathHandler(const shared_ptr<Messenger>& messenger,
 
 }
 
+// Shows the totals of the calls of each method by each user. The 'method'
+// and 'user' arguments restrict the output to the methods whose names
+// contain the former and to the user named by the latter.
+void RpczStatsPathHandler(const shared_ptr<Messenger>& messenger,
+                          const Webserver::WebRequest& req,
+                          Webserver::PrerenderedWebResponse* resp) {
+  DumpRpczStoreResponsePB stats;
+  {
+    DumpRpczStoreRequestPB dump_req;
+    dump_req.set_include_samples(false);
+    dump_req.set_include_user_stats(true);
+    messenger->rpcz_store()->DumpPB(dump_req, &stats);
+  }
+
+  const string method = FindWithDefault(req.parsed_args, "method", "");
+  const string user = FindWithDefault(req.parsed_args, "user", "");
+  DumpRpczStoreResponsePB filtered;
+  for (const auto& method_pb : stats.methods()) {
+    if (method_pb.method_name().find(method) == string::npos) {
+      continue;
+    }
+    RpczMethodPB* filtered_method_pb = filtered.add_methods();
+    filtered_method_pb->set_method_name(method_pb.method_name());
+    for (const auto& user_pb : method_pb.user_stats()) {
+      if (user.empty() || user_pb.user() == user) {
+        *filtered_method_pb->add_user_stats() = user_pb;
+      }
+    }
+  }
+
+  JsonWriter writer(&resp->output, JsonWriter::PRETTY);
+  writer.Protobuf(filtered);
+}
+
 } // anonymous namespace
 
 void AddRpczPathHandlers(const shared_ptr<Messenger>& messenger, Webserver* webserver) {
   webserver->RegisterPrerenderedPathHandler("/rpcz", "RPCs",
                                             boost::bind(RpczPathHandler, messenger, _1, _2),
                                             false, true);
+  webserver->RegisterPrerenderedPathHandler("/rpcz/stats", "RPC totals",
+                                            boost::bind(RpczStatsPathHandler, messenger, _1, _2),
+                                            false, false);
 }
 
 } // namespace kudu
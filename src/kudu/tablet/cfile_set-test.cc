@@ -58,6 +58,8 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(scan_use_column_blooms);
+DECLARE_bool(scan_use_secondary_indexes);
 DECLARE_int32(cfile_default_block_size);
 
 using std::shared_ptr;
@@ -564,5 +566,202 @@ TEST_F(TestCFileSet, TestBloomFilterPredicates) {
   DoTestBloomFilterScan(fileset, { bf_with_range }, ret1_contain_range);
 }
 
+// Fixture for the per-column auxiliary files: c1 and c2 carry secondary
+// indexes, and c3 carries a bloom filter.
+class TestCFileSetColumnAuxFiles : public KuduRowSetTest {
+ public:
+  TestCFileSetColumnAuxFiles()
+      : KuduRowSetTest(Schema({ ColumnSchema("c0", INT32),
+                                ColumnSchema("c1", INT32, false, nullptr, nullptr,
+                                             GetStorage(SECONDARY_INDEX_FILE)),
+                                ColumnSchema("c2", STRING, true, nullptr, nullptr,
+                                             GetStorage(SECONDARY_INDEX_FILE)),
+                                ColumnSchema("c3", STRING, true, nullptr, nullptr,
+                                             GetStorage(BLOOM_FILTER_FILE)) }, 1)) {
+  }
+
+  void SetUp() override {
+    KuduRowSetTest::SetUp();
+
+    // Use a small cfile block size so that skipped rows translate into
+    // skipped blocks.
+    FLAGS_cfile_default_block_size = 512;
+  }
+
+  // Write out a test rowset where:
+  // - c0 is the row index,
+  // - c1 is the row index divided by 100,
+  // - c2 is NULL for every fifth row and otherwise holds one of seven strings,
+  // - c3 is NULL for every third row and otherwise holds "id<row index>".
+  void WriteTestRowSet(int nrows) {
+    DiskRowSetWriter rsw(rowset_meta_.get(), &schema_,
+                         BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(rsw.Open());
+
+    RowBuilder rb(&schema_);
+    for (int i = 0; i < nrows; i++) {
+      rb.Reset();
+      rb.AddInt32(i);
+      rb.AddInt32(i / 100);
+      if (i % 5 == 0) {
+        rb.AddNull();
+      } else {
+        rb.AddString(StringPrintf("s%d", i % 7));
+      }
+      if (i % 3 == 0) {
+        rb.AddNull();
+      } else {
+        rb.AddString(StringPrintf("id%d", i));
+      }
+      ASSERT_OK_FAST(WriteRow(rb.data(), &rsw));
+    }
+    ASSERT_OK(rsw.Finish());
+  }
+
+  // Scan 'fileset' with 'predicates', returning the values of c0 of the
+  // result rows and the number of blocks read from c0.
+  void DoScan(const shared_ptr<CFileSet>& fileset,
+              const vector<ColumnPredicate>& predicates,
+              vector<int32_t>* keys,
+              int64_t* key_blocks_read) {
+    unique_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_, nullptr));
+    unique_ptr<RowwiseIterator> iter(NewMaterializingIterator(std::move(cfile_iter)));
+    ScanSpec spec;
+    for (const auto& pred : predicates) {
+      spec.AddPredicate(pred);
+    }
+    ASSERT_OK(iter->Init(&spec));
+
+    keys->clear();
+    Arena arena(1024);
+    RowBlock block(&schema_, 100, &arena);
+    while (iter->HasNext()) {
+      ASSERT_OK_FAST(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (block.selection_vector()->IsRowSelected(i)) {
+          keys->push_back(*schema_.ExtractColumnFromRow<INT32>(block.row(i), 0));
+        }
+      }
+    }
+    vector<IteratorStats> stats;
+    iter->GetIteratorStats(&stats);
+    ASSERT_EQ(schema_.num_columns(), stats.size());
+    *key_blocks_read = stats[0].blocks_read;
+  }
+
+  void OpenFileSet(shared_ptr<CFileSet>* fileset) {
+    ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(),
+                             MemTracker::GetRootTracker(), nullptr, fileset));
+    ASSERT_GT((*fileset)->ColumnAuxFilesOnDiskSize(), 0);
+  }
+
+ private:
+  static ColumnStorageAttributes GetStorage(ColumnAuxFileType type) {
+    ColumnStorageAttributes attr;
+    attr.aux_files.insert(type);
+    return attr;
+  }
+
+ protected:
+  google::FlagSaver saver;
+};
+
+TEST_F(TestCFileSetColumnAuxFiles, TestSecondaryIndexPredicates) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+  ASSERT_EQ(2, rowset_meta_->GetColumnAuxBlocksById(SECONDARY_INDEX_FILE).size());
+  shared_ptr<CFileSet> fileset;
+  NO_FATALS(OpenFileSet(&fileset));
+
+  int32_t c1_value = 42;
+  auto c1_eq = ColumnPredicate::Equality(schema_.column(1), &c1_value);
+  Slice s3("s3");
+  Slice s5("s5");
+  vector<const void*> c2_values = { &s3, &s5 };
+  auto c2_in = ColumnPredicate::InList(schema_.column(2), &c2_values);
+
+  vector<int32_t> expected_eq;
+  vector<int32_t> expected_both;
+  for (int i = 4200; i < 4300; i++) {
+    expected_eq.push_back(i);
+    if (i % 5 != 0 && (i % 7 == 3 || i % 7 == 5)) {
+      expected_both.push_back(i);
+    }
+  }
+
+  for (bool use_index : { true, false }) {
+    SCOPED_TRACE(use_index);
+    FLAGS_scan_use_secondary_indexes = use_index;
+    vector<int32_t> keys;
+    int64_t key_blocks_read;
+
+    NO_FATALS(DoScan(fileset, { c1_eq }, &keys, &key_blocks_read));
+    EXPECT_EQ(expected_eq, keys);
+    NO_FATALS(DoScan(fileset, { c1_eq, c2_in }, &keys, &key_blocks_read));
+    EXPECT_EQ(expected_both, keys);
+
+    // The matching rows span at most two blocks of the key column, which is
+    // all that should be read when the index can be used.
+    if (use_index) {
+      EXPECT_LE(key_blocks_read, 2);
+    }
+
+    // A value which is not present at all.
+    int32_t missing = kNumRows;
+    NO_FATALS(DoScan(fileset, { ColumnPredicate::Equality(schema_.column(1), &missing) },
+                     &keys, &key_blocks_read));
+    EXPECT_TRUE(keys.empty());
+    if (use_index) {
+      EXPECT_EQ(0, key_blocks_read);
+    }
+  }
+}
+
+TEST_F(TestCFileSetColumnAuxFiles, TestColumnBloomPruning) {
+  const int kNumRows = 3000;
+  WriteTestRowSet(kNumRows);
+  ASSERT_EQ(1, rowset_meta_->GetColumnAuxBlocksById(BLOOM_FILTER_FILE).size());
+  shared_ptr<CFileSet> fileset;
+  NO_FATALS(OpenFileSet(&fileset));
+
+  Slice present("id1234");
+  Slice absent("id-missing");
+  Slice null_row("id3");
+  vector<const void*> some_present = { &absent, &present };
+  vector<const void*> none_present = { &absent, &null_row };
+
+  for (bool use_blooms : { true, false }) {
+    SCOPED_TRACE(use_blooms);
+    FLAGS_scan_use_column_blooms = use_blooms;
+    vector<int32_t> keys;
+    int64_t key_blocks_read;
+
+    NO_FATALS(DoScan(fileset, { ColumnPredicate::Equality(schema_.column(3), &present) },
+                     &keys, &key_blocks_read));
+    EXPECT_EQ(vector<int32_t>({ 1234 }), keys);
+    NO_FATALS(DoScan(fileset, { ColumnPredicate::InList(schema_.column(3), &some_present) },
+                     &keys, &key_blocks_read));
+    EXPECT_EQ(vector<int32_t>({ 1234 }), keys);
+
+    // Values which were never written, or only appear in rows where the
+    // column is NULL, let the base data be skipped entirely (barring a false
+    // positive, which is unlikely for these few probes).
+    NO_FATALS(DoScan(fileset, { ColumnPredicate::Equality(schema_.column(3), &absent) },
+                     &keys, &key_blocks_read));
+    EXPECT_TRUE(keys.empty());
+    if (use_blooms) {
+      EXPECT_EQ(0, key_blocks_read);
+    } else {
+      EXPECT_GT(key_blocks_read, 0);
+    }
+    NO_FATALS(DoScan(fileset, { ColumnPredicate::InList(schema_.column(3), &none_present) },
+                     &keys, &key_blocks_read));
+    EXPECT_TRUE(keys.empty());
+    if (use_blooms) {
+      EXPECT_EQ(0, key_blocks_read);
+    }
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
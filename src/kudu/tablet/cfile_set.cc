@@ -17,6 +17,7 @@
 #include "kudu/tablet/cfile_set.h"
 
 #include <algorithm>
+#include <iterator>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -33,7 +34,9 @@
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/secondary_index.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/iterator_stats.h"
@@ -53,6 +56,8 @@
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/slice.h"
@@ -61,6 +66,18 @@
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_bool(scan_use_secondary_indexes, true,
+            "Whether scans consult the secondary indexes of non-key columns to skip "
+            "rows which cannot satisfy equality or IN-list predicates");
+TAG_FLAG(scan_use_secondary_indexes, advanced);
+TAG_FLAG(scan_use_secondary_indexes, runtime);
+
+DEFINE_bool(scan_use_column_blooms, true,
+            "Whether scans consult the per-column bloom filters of rowsets to skip the "
+            "base data of rowsets which cannot match equality or IN-list predicates");
+TAG_FLAG(scan_use_column_blooms, advanced);
+TAG_FLAG(scan_use_column_blooms, runtime);
+
 DECLARE_bool(rowset_metadata_store_keys);
 
 namespace kudu {
@@ -75,6 +92,7 @@ using cfile::CFileReader;
 using cfile::ColumnIterator;
 using cfile::ReaderOptions;
 using cfile::DefaultColumnValueIterator;
+using cfile::SecondaryIndexReader;
 using fs::IOContext;
 using fs::ReadableBlock;
 using std::shared_ptr;
@@ -98,6 +116,7 @@ static Status OpenReader(FsManager* fs,
   ReaderOptions opts;
   opts.parent_mem_tracker = std::move(cfile_reader_tracker);
   opts.io_context = io_context;
+  opts.readahead_pool = fs->readahead_pool();
   return CFileReader::OpenNoInit(std::move(block),
                                  std::move(opts),
                                  new_reader);
@@ -154,6 +173,44 @@ Status CFileSet::DoOpen(const IOContext* io_context) {
   }
   readers_by_col_id_.shrink_to_fit();
 
+  // Lazily open the column auxiliary files too, skipping those for columns
+  // which have since been dropped.
+  for (const auto& type_and_blocks : rowset_metadata_->GetAllColumnAuxBlocks()) {
+    for (const RowSetMetadata::ColumnIdToBlockIdMap::value_type& e : type_and_blocks.second) {
+      int col_idx = tablet_schema().find_column_by_id(e.first);
+      if (col_idx == Schema::kColumnNotFound) {
+        continue;
+      }
+      unique_ptr<ReadableBlock> block;
+      RETURN_NOT_OK(rowset_metadata_->fs_manager()->OpenBlock(e.second, &block));
+      ReaderOptions opts;
+      opts.io_context = io_context;
+      switch (type_and_blocks.first) {
+        case SECONDARY_INDEX_FILE: {
+          opts.parent_mem_tracker = cfile_reader_tracker_;
+          unique_ptr<SecondaryIndexReader> reader;
+          RETURN_NOT_OK(SecondaryIndexReader::OpenNoInit(
+              std::move(block), tablet_schema().column(col_idx).type_info(),
+              std::move(opts), &reader));
+          secondary_index_readers_by_col_id_[e.first] = std::move(reader);
+          break;
+        }
+        case BLOOM_FILTER_FILE: {
+          opts.parent_mem_tracker = bloomfile_tracker_;
+          unique_ptr<BloomFileReader> reader;
+          RETURN_NOT_OK(BloomFileReader::OpenNoInit(std::move(block), std::move(opts), &reader));
+          column_bloom_readers_by_col_id_[e.first] = std::move(reader);
+          break;
+        }
+        default:
+          return Status::Corruption(Substitute("unknown auxiliary file type $0 for column $1",
+                                               type_and_blocks.first, e.first));
+      }
+    }
+  }
+  secondary_index_readers_by_col_id_.shrink_to_fit();
+  column_bloom_readers_by_col_id_.shrink_to_fit();
+
   if (rowset_metadata_->has_adhoc_index_block()) {
     RETURN_NOT_OK(OpenReader(rowset_metadata_->fs_manager(),
                              cfile_reader_tracker_,
@@ -274,6 +331,38 @@ uint64_t CFileSet::OnDiskColumnDataSize(const ColumnId& col_id) const {
   return FindOrDie(readers_by_col_id_, col_id)->file_size();
 }
 
+uint64_t CFileSet::ColumnAuxFilesOnDiskSize() const {
+  uint64_t ret = 0;
+  for (const auto& e : secondary_index_readers_by_col_id_) {
+    ret += e.second->FileSize();
+  }
+  for (const auto& e : column_bloom_readers_by_col_id_) {
+    ret += e.second->FileSize();
+  }
+  return ret;
+}
+
+Status CFileSet::FindRowIdsWithValue(ColumnId col_id,
+                                     const void* value,
+                                     const IOContext* io_context,
+                                     vector<rowid_t>* rowids) const {
+  SecondaryIndexReader* reader = FindOrDie(secondary_index_readers_by_col_id_, col_id).get();
+  RETURN_NOT_OK(reader->Init(io_context));
+  return reader->FindRowIds(value, io_context, rowids);
+}
+
+Status CFileSet::CheckColumnValuePresent(ColumnId col_id,
+                                         const TypeInfo* type_info,
+                                         const void* value,
+                                         const IOContext* io_context,
+                                         bool* maybe_present) const {
+  BloomFileReader* reader = FindOrDie(column_bloom_readers_by_col_id_, col_id).get();
+  RETURN_NOT_OK(reader->Init(io_context));
+  faststring key;
+  cfile::ColumnBloomFileWriter::EncodeKey(type_info, value, &key);
+  return reader->CheckKeyPresent(BloomKeyProbe(Slice(key)), io_context, maybe_present);
+}
+
 Status CFileSet::FindRow(const RowSetKeyProbe &probe,
                          const IOContext* io_context,
                          boost::optional<rowid_t>* idx,
@@ -400,6 +489,20 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // If there is a range predicate on the key column, push that down into an
   // ordinal range.
   RETURN_NOT_OK(PushdownRangeScanPredicate(spec));
+  for (const auto& col_iter : col_iters_) {
+    col_iter->SetReadaheadLimit(upper_bound_idx_);
+  }
+
+  // If the column bloom files rule out every row, select none of them;
+  // otherwise restrict the selected rows using any secondary indexes.
+  bool may_match;
+  RETURN_NOT_OK(CheckColumnBloomPredicates(spec, &may_match));
+  if (may_match) {
+    RETURN_NOT_OK(PushdownSecondaryIndexPredicates(spec));
+  } else {
+    has_index_matches_ = true;
+    index_matched_rowids_.clear();
+  }
 
   initted_ = true;
 
@@ -470,6 +573,119 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status CFileSet::Iterator::PushdownSecondaryIndexPredicates(const ScanSpec* spec) {
+  has_index_matches_ = false;
+  index_matched_rowids_.clear();
+
+  if (spec == nullptr || !FLAGS_scan_use_secondary_indexes) {
+    return Status::OK();
+  }
+
+  for (const auto& e : spec->predicates()) {
+    const ColumnPredicate& pred = e.second;
+    if (pred.predicate_type() != PredicateType::Equality &&
+        pred.predicate_type() != PredicateType::InList) {
+      continue;
+    }
+    int col_idx = projection_->find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    ColumnId col_id = projection_->column_id(col_idx);
+    if (!base_data_->has_secondary_index_for_column_id(col_id)) {
+      continue;
+    }
+
+    vector<rowid_t> matches;
+    if (pred.predicate_type() == PredicateType::Equality) {
+      RETURN_NOT_OK(base_data_->FindRowIdsWithValue(col_id, pred.raw_lower(),
+                                                    io_context_, &matches));
+    } else {
+      // Each row holds a single value, so the per-value matches are disjoint.
+      for (const void* value : pred.raw_values()) {
+        RETURN_NOT_OK(base_data_->FindRowIdsWithValue(col_id, value, io_context_, &matches));
+      }
+      std::sort(matches.begin(), matches.end());
+    }
+
+    if (!has_index_matches_) {
+      index_matched_rowids_.swap(matches);
+      has_index_matches_ = true;
+    } else {
+      vector<rowid_t> intersection;
+      std::set_intersection(index_matched_rowids_.begin(), index_matched_rowids_.end(),
+                            matches.begin(), matches.end(),
+                            std::back_inserter(intersection));
+      index_matched_rowids_.swap(intersection);
+    }
+    VLOG(1) << "Secondary index on column " << pred.column().name() << " narrowed scan of "
+            << base_data_->ToString() << " to " << index_matched_rowids_.size() << " rows";
+    if (index_matched_rowids_.empty()) {
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::CheckColumnBloomPredicates(const ScanSpec* spec, bool* may_match) {
+  *may_match = true;
+  if (spec == nullptr || !FLAGS_scan_use_column_blooms) {
+    return Status::OK();
+  }
+
+  for (const auto& e : spec->predicates()) {
+    const ColumnPredicate& pred = e.second;
+    if (pred.predicate_type() != PredicateType::Equality &&
+        pred.predicate_type() != PredicateType::InList) {
+      continue;
+    }
+    int col_idx = projection_->find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    ColumnId col_id = projection_->column_id(col_idx);
+    if (!base_data_->has_column_bloom_for_column_id(col_id)) {
+      continue;
+    }
+
+    const TypeInfo* type_info = pred.column().type_info();
+    bool any_present = false;
+    auto check_value = [&](const void* value) {
+      bool present = true;
+      Status s = base_data_->CheckColumnValuePresent(col_id, type_info, value,
+                                                     io_context_, &present);
+      if (PREDICT_FALSE(!s.ok())) {
+        KLOG_EVERY_N_SECS(WARNING, 1) << Substitute("Unable to query column bloom in $0: $1",
+                                                    base_data_->ToString(), s.ToString());
+        if (s.IsDiskFailure()) {
+          return s;
+        }
+        // Continue as if the value may be present.
+        present = true;
+      }
+      any_present |= present;
+      return Status::OK();
+    };
+    if (pred.predicate_type() == PredicateType::Equality) {
+      RETURN_NOT_OK(check_value(pred.raw_lower()));
+    } else {
+      for (const void* value : pred.raw_values()) {
+        RETURN_NOT_OK(check_value(value));
+        if (any_present) {
+          break;
+        }
+      }
+    }
+    if (!any_present) {
+      VLOG(1) << "Bloom filter on column " << pred.column().name() << " excluded all rows of "
+              << base_data_->ToString();
+      *may_match = false;
+      return Status::OK();
+    }
+  }
+  return Status::OK();
+}
+
 void CFileSet::Iterator::Unprepare() {
   prepared_count_ = 0;
   prepared_iters_.clear();
@@ -522,7 +738,19 @@ Status CFileSet::Iterator::PrepareColumn(ColumnMaterializationContext *ctx) {
 }
 
 Status CFileSet::Iterator::InitializeSelectionVector(SelectionVector *sel_vec) {
-  sel_vec->SetAllTrue();
+  if (!has_index_matches_) {
+    sel_vec->SetAllTrue();
+    return Status::OK();
+  }
+
+  // Only select the rows which the secondary indexes found to match.
+  DCHECK_EQ(prepared_count_, sel_vec->nrows());
+  sel_vec->SetAllFalse();
+  auto it = std::lower_bound(index_matched_rowids_.begin(), index_matched_rowids_.end(),
+                             cur_idx_);
+  for (; it != index_matched_rowids_.end() && *it < cur_idx_ + prepared_count_; ++it) {
+    sel_vec->SetRowSelected(*it - cur_idx_);
+  }
   return Status::OK();
 }
 
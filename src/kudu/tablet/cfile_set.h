@@ -50,10 +50,12 @@ class ColumnMaterializationContext;
 class MemTracker;
 class ScanSpec;
 class SelectionVector;
+class TypeInfo;
 struct IteratorStats;
 
 namespace cfile {
 class BloomFileReader;
+class SecondaryIndexReader;
 }  // namespace cfile
 
 namespace fs {
@@ -105,6 +107,29 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   // The size on-disk of column cfile's data, in bytes.
   uint64_t OnDiskColumnDataSize(const ColumnId& col_id) const;
 
+  // The on-disk size, in bytes, of this cfile set's column auxiliary files,
+  // i.e. its secondary indexes and column bloom files. Returns 0 if there
+  // are none.
+  uint64_t ColumnAuxFilesOnDiskSize() const;
+
+  // Append to 'rowids', in ascending order, the ordinals of the rows whose
+  // base data for the given column equals 'value'. The column must have a
+  // secondary index in this cfile set.
+  Status FindRowIdsWithValue(ColumnId col_id,
+                             const void* value,
+                             const fs::IOContext* io_context,
+                             std::vector<rowid_t>* rowids) const;
+
+  // Check whether the base data for the given column may contain 'value'.
+  // The column must have a bloom file in this cfile set.
+  //
+  // Sets *maybe_present to false if no row's base data holds 'value'.
+  Status CheckColumnValuePresent(ColumnId col_id,
+                                 const TypeInfo* type_info,
+                                 const void* value,
+                                 const fs::IOContext* io_context,
+                                 bool* maybe_present) const;
+
   // Determine the index of the given row key.
   // Sets *idx to boost::none if the row is not found.
   Status FindRow(const RowSetKeyProbe& probe,
@@ -126,6 +151,16 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
     return ContainsKey(readers_by_col_id_, col_id);
   }
 
+  // Return true if there exists a secondary index for the given column ID.
+  bool has_secondary_index_for_column_id(ColumnId col_id) const {
+    return ContainsKey(secondary_index_readers_by_col_id_, col_id);
+  }
+
+  // Return true if there exists a bloom file for the given column ID.
+  bool has_column_bloom_for_column_id(ColumnId col_id) const {
+    return ContainsKey(column_bloom_readers_by_col_id_, col_id);
+  }
+
   virtual ~CFileSet();
 
  private:
@@ -172,6 +207,18 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   // index pertains to more than one column, as in the case of composite keys.
   std::unique_ptr<cfile::CFileReader> ad_hoc_idx_reader_;
   std::unique_ptr<cfile::BloomFileReader> bloom_reader_;
+
+  // Map of column ID to the reader for that column's secondary index, if
+  // any. Like the column readers, these are opened lazily.
+  typedef boost::container::flat_map<int, std::unique_ptr<cfile::SecondaryIndexReader>>
+      SecondaryIndexReaderMap;
+  SecondaryIndexReaderMap secondary_index_readers_by_col_id_;
+
+  // Map of column ID to the reader for that column's bloom file, if any.
+  // Also opened lazily.
+  typedef boost::container::flat_map<int, std::unique_ptr<cfile::BloomFileReader>>
+      ColumnBloomReaderMap;
+  ColumnBloomReaderMap column_bloom_readers_by_col_id_;
 };
 
 
@@ -230,6 +277,7 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         initted_(false),
         cur_idx_(0),
         prepared_count_(0),
+        has_index_matches_(false),
         io_context_(io_context) {}
 
   // Fill in col_iters_ for each of the requested columns.
@@ -240,6 +288,18 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // store it in member fields.
   Status PushdownRangeScanPredicate(ScanSpec *spec);
 
+  // Look for equality and IN-list predicates on columns with a secondary
+  // index, and collect the ordinals of the rows which may satisfy all of
+  // them. The predicates are left in the scan spec: the index only describes
+  // the base data, so rows must still be evaluated after deltas are applied.
+  Status PushdownSecondaryIndexPredicates(const ScanSpec* spec);
+
+  // Look for equality and IN-list predicates on columns with a bloom file.
+  // Sets *may_match to false if, for any of them, the bloom file shows that
+  // the base data holds none of the predicate's values. As with the
+  // secondary indexes, the predicates are left in the scan spec.
+  Status CheckColumnBloomPredicates(const ScanSpec* spec, bool* may_match);
+
   void Unprepare();
 
   // Prepare the given column. The column must not have been prepared yet.
@@ -267,6 +327,12 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   rowid_t lower_bound_idx_;
   rowid_t upper_bound_idx_;
 
+  // Whether secondary index or column bloom lookups restricted the rows
+  // selected by InitializeSelectionVector(). If so, 'index_matched_rowids_'
+  // holds the sorted ordinals of the only rows whose base data may match.
+  bool has_index_matches_;
+  std::vector<rowid_t> index_matched_rowids_;
+
   const fs::IOContext* io_context_;
 
   // The underlying columns are prepared lazily, so that if a column is never
@@ -122,6 +122,12 @@ Status DeltaApplier::InitializeSelectionVector(SelectionVector *sel_vec) {
     deltas.ToSelectionVector(sel_vec);
   } else {
     RETURN_NOT_OK(base_iter_->InitializeSelectionVector(sel_vec));
+    if (delta_iter_->MayHaveDeltas()) {
+      // The base iterator may deselect rows using indexes over the base data,
+      // which are stale for rows updated in this batch. Reselect just those
+      // rows so that predicates are evaluated against their current values.
+      RETURN_NOT_OK(delta_iter_->SelectUpdatedRows(sel_vec));
+    }
   }
   if (!opts_.include_deleted_rows) {
     RETURN_NOT_OK(delta_iter_->ApplyDeletes(sel_vec));
@@ -269,7 +269,8 @@ Status MajorDeltaCompaction::OpenBaseDataWriter() {
 
   gscoped_ptr<MultiColumnWriter> w(new MultiColumnWriter(fs_manager_,
                                                          &partial_schema_,
-                                                         tablet_id_));
+                                                         tablet_id_,
+                                                         fs::StorageTier::ANY));
   RETURN_NOT_OK(w->Open());
   base_data_writer_.swap(w);
   return Status::OK();
@@ -427,6 +428,13 @@ Status MajorDeltaCompaction::UpdateDeltaTracker(DeltaTracker* tracker,
   SharedDeltaStoreVector new_redo_stores;
   RETURN_NOT_OK(tracker->OpenDeltaReaders(new_redo_blocks, io_context, &new_redo_stores, REDO));
 
+  // The new REDO file carries the updates to any columns left for a later
+  // compaction. Initialize it now so that its stats are visible when
+  // selecting the columns for that compaction.
+  for (const auto& store : new_redo_stores) {
+    RETURN_NOT_OK(store->Init(io_context));
+  }
+
   // Create blocks for the new undo deltas.
   SharedDeltaStoreVector new_undo_stores;
   if (undo_delta_mutations_written_ > 0) {
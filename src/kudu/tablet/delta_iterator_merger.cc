@@ -79,6 +79,13 @@ Status DeltaIteratorMerger::ApplyDeletes(SelectionVector* sel_vec) {
   return Status::OK();
 }
 
+Status DeltaIteratorMerger::SelectUpdatedRows(SelectionVector* sel_vec) {
+  for (const unique_ptr<DeltaIterator>& iter : iters_) {
+    RETURN_NOT_OK(iter->SelectUpdatedRows(sel_vec));
+  }
+  return Status::OK();
+}
+
 Status DeltaIteratorMerger::SelectDeltas(SelectedDeltas* deltas) {
   for (const unique_ptr<DeltaIterator>& iter : iters_) {
     RETURN_NOT_OK(iter->SelectDeltas(deltas));
@@ -425,6 +425,22 @@ Status DeltaPreparer<Traits>::ApplyDeletes(SelectionVector* sel_vec) {
   return Status::OK();
 }
 
+template<class Traits>
+Status DeltaPreparer<Traits>::SelectUpdatedRows(SelectionVector* sel_vec) {
+  DCHECK(prepared_flags_ & DeltaIterator::PREPARE_FOR_APPLY);
+  DCHECK_LE(cur_prepared_idx_ - prev_prepared_idx_, sel_vec->nrows());
+
+  for (const UpdatesForColumn& ufc : updates_by_col_) {
+    for (const ColumnUpdate& cu : ufc) {
+      sel_vec->SetRowSelected(cu.row_id - prev_prepared_idx_);
+    }
+  }
+  for (const auto& row_id : reinserted_) {
+    sel_vec->SetRowSelected(row_id - prev_prepared_idx_);
+  }
+  return Status::OK();
+}
+
 template<class Traits>
 Status DeltaPreparer<Traits>::SelectDeltas(SelectedDeltas* deltas) {
   DCHECK(prepared_flags_ & DeltaIterator::PREPARE_FOR_SELECT);
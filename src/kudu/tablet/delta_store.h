@@ -271,6 +271,12 @@ class PreparedDeltas {
   // Deltas must have been prepared with the flag PREPARE_FOR_APPLY.
   virtual Status ApplyDeletes(SelectionVector* sel_vec) = 0;
 
+  // Selects in 'sel_vec' every row that has a relevant update or reinsert in
+  // the prepared batch. Rows without such deltas are left unmodified.
+  //
+  // Deltas must have been prepared with the flag PREPARE_FOR_APPLY.
+  virtual Status SelectUpdatedRows(SelectionVector* sel_vec) = 0;
+
   // Modifies the given SelectedDeltas to include rows with relevant deltas from
   // the current prepared batch.
   //
@@ -434,6 +440,8 @@ class DeltaPreparer : public PreparedDeltas {
 
   Status ApplyDeletes(SelectionVector* sel_vec) override;
 
+  Status SelectUpdatedRows(SelectionVector* sel_vec) override;
+
   Status SelectDeltas(SelectedDeltas* deltas) override;
 
   Status CollectMutations(std::vector<Mutation*>* dst, Arena* arena) override;
@@ -18,6 +18,7 @@
 #include "kudu/tablet/delta_tracker.h"
 
 #include <algorithm>
+#include <map>
 #include <mutex>
 #include <ostream>
 #include <set>
@@ -878,6 +879,23 @@ void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const
   col_ids->assign(column_ids_with_updates.begin(), column_ids_with_updates.end());
 }
 
+void DeltaTracker::GetColumnUpdateCounts(std::map<ColumnId, int64_t>* update_counts) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+
+  update_counts->clear();
+  for (const shared_ptr<DeltaStore>& ds : redo_delta_stores_) {
+    if (!ds->Initted()) {
+      continue;
+    }
+    const DeltaStats& stats = ds->delta_stats();
+    set<ColumnId> col_ids;
+    stats.AddColumnIdsWithUpdates(&col_ids);
+    for (ColumnId col_id : col_ids) {
+      (*update_counts)[col_id] += stats.update_count_for_col_id(col_id);
+    }
+  }
+}
+
 Status DeltaTracker::InitAllDeltaStoresForTests(WhichStores stores) {
   shared_lock<rw_spinlock> lock(component_lock_);
   if (stores == UNDOS_AND_REDOS || stores == UNDOS_ONLY) {
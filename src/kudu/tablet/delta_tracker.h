@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -253,6 +254,11 @@ class DeltaTracker {
   // Retrieves the list of column indexes that currently have updates.
   void GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const;
 
+  // Retrieves the number of updates in the REDO delta files to each column
+  // that currently has updates. Like GetColumnIdsWithUpdates(), delta files
+  // which have not been opened yet are not consulted.
+  void GetColumnUpdateCounts(std::map<ColumnId, int64_t>* update_counts) const;
+
   Mutex* compact_flush_lock() {
     return &compact_flush_lock_;
   }
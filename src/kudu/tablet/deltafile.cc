@@ -27,6 +27,7 @@
 #include <gflags/gflags_declare.h>
 
 #include "kudu/cfile/binary_plain_block.h"
+#include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
@@ -74,6 +75,7 @@ namespace kudu {
 class MemTracker;
 
 using cfile::BinaryPlainBlockDecoder;
+using cfile::BlockCache;
 using cfile::BlockPointer;
 using cfile::CFileReader;
 using cfile::IndexTreeIterator;
@@ -485,8 +487,8 @@ Status DeltaFileIterator<Type>::ReadCurrentBlockOntoQueue() {
   unique_ptr<PreparedDeltaBlock> pdb(new PreparedDeltaBlock());
   BlockPointer dblk_ptr = index_iter_->GetCurrentBlockPointer();
   shared_ptr<CFileReader> reader = dfr_->cfile_reader();
-  RETURN_NOT_OK(reader->ReadBlock(preparer_.opts().io_context,
-                                  dblk_ptr, cache_blocks_, &pdb->block_));
+  RETURN_NOT_OK(reader->ReadBlock(preparer_.opts().io_context, dblk_ptr, cache_blocks_,
+                                  BlockCache::Priority::NORMAL, &pdb->block_));
 
   // The data has been successfully read. Finish creating the decoder.
   pdb->prepared_block_start_idx_ = 0;
@@ -680,6 +682,11 @@ Status DeltaFileIterator<Type>::ApplyDeletes(SelectionVector* sel_vec) {
   return preparer_.ApplyDeletes(sel_vec);
 }
 
+template<DeltaType Type>
+Status DeltaFileIterator<Type>::SelectUpdatedRows(SelectionVector* sel_vec) {
+  return preparer_.SelectUpdatedRows(sel_vec);
+}
+
 template<DeltaType Type>
 Status DeltaFileIterator<Type>::SelectDeltas(SelectedDeltas* deltas) {
   return preparer_.SelectDeltas(deltas);
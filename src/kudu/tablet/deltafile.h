@@ -236,6 +236,8 @@ class DeltaFileIterator : public DeltaIterator {
 
   Status ApplyDeletes(SelectionVector* sel_vec) override;
 
+  Status SelectUpdatedRows(SelectionVector* sel_vec) override;
+
   Status SelectDeltas(SelectedDeltas* deltas) override;
 
   Status CollectMutations(std::vector<Mutation*>*dst, Arena* arena) override;
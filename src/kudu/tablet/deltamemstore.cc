@@ -289,6 +289,10 @@ Status DMSIterator::ApplyDeletes(SelectionVector* sel_vec) {
   return preparer_.ApplyDeletes(sel_vec);
 }
 
+Status DMSIterator::SelectUpdatedRows(SelectionVector* sel_vec) {
+  return preparer_.SelectUpdatedRows(sel_vec);
+}
+
 Status DMSIterator::SelectDeltas(SelectedDeltas* deltas) {
   return preparer_.SelectDeltas(deltas);
 }
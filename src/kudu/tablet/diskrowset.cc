@@ -18,8 +18,10 @@
 #include "kudu/tablet/diskrowset.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <map>
 #include <ostream>
+#include <utility>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -28,11 +30,14 @@
 #include <glog/stl_logging.h>
 
 #include "kudu/cfile/bloomfile.h"
+#include "kudu/cfile/column_aux_file_writer.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/secondary_index.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/timestamp.h"
@@ -40,7 +45,9 @@
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/delta_compaction.h"
@@ -71,6 +78,14 @@ DEFINE_double(tablet_delta_store_major_compact_min_ratio, 0.1f,
              "can run (Advanced option)");
 TAG_FLAG(tablet_delta_store_major_compact_min_ratio, experimental);
 
+DEFINE_int64(tablet_delta_store_major_compact_max_bytes, 512 * 1024 * 1024,
+             "Approximate maximum amount of base data, in bytes, that a single major "
+             "delta compaction rewrites. Columns with updates beyond this budget are left "
+             "to subsequent compactions, so each compaction commits its progress on its own "
+             "and other maintenance operations can run in between. At least one column is "
+             "always compacted. A value of 0 or less compacts all updated columns at once.");
+TAG_FLAG(tablet_delta_store_major_compact_max_bytes, advanced);
+
 DEFINE_int32(default_composite_key_index_block_size_bytes, 4096,
              "Block size used for composite key indexes.");
 TAG_FLAG(default_composite_key_index_block_size_bytes, experimental);
@@ -80,6 +95,18 @@ DEFINE_bool(rowset_metadata_store_keys, false,
             "metadata. If false, keys will be read from the data blocks.");
 TAG_FLAG(rowset_metadata_store_keys, experimental);
 
+DEFINE_int32(column_bloom_block_size, 4096,
+             "Block size of the bloom filters written over the values of columns "
+             "with the bloom filter storage attribute.");
+TAG_FLAG(column_bloom_block_size, advanced);
+
+DEFINE_double(column_bloom_target_fp_rate, 0.01f,
+              "Target false-positive rate (between 0 and 1) to size the bloom filters "
+              "written over the values of columns with the bloom filter storage attribute. "
+              "A lower rate lets scans with equality predicates on such columns skip more "
+              "rowsets, at the expense of more space for the bloom filters.");
+TAG_FLAG(column_bloom_target_fp_rate, advanced);
+
 namespace kudu {
 
 class Mutex;
@@ -101,6 +128,7 @@ using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 const char *DiskRowSet::kMinKeyMetaEntryName = "min_key";
 const char *DiskRowSet::kMaxKeyMetaEntryName = "max_key";
@@ -111,17 +139,22 @@ DiskRowSetWriter::DiskRowSetWriter(RowSetMetadata* rowset_metadata,
     : rowset_metadata_(rowset_metadata),
       schema_(schema),
       bloom_sizing_(bloom_sizing),
+      tier_(fs::StorageTier::ANY),
       finished_(false),
       written_count_(0) {
   CHECK(schema->has_column_ids());
 }
 
+CreateBlockOptions DiskRowSetWriter::block_opts() const {
+  return CreateBlockOptions({ rowset_metadata_->tablet_metadata()->tablet_id(), tier_ });
+}
+
 Status DiskRowSetWriter::Open() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::Open");
 
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  col_writer_.reset(new MultiColumnWriter(fs, schema_, tablet_id));
+  col_writer_.reset(new MultiColumnWriter(fs, schema_, tablet_id, tier_));
   RETURN_NOT_OK(col_writer_->Open());
 
   // Open bloom filter.
@@ -132,6 +165,8 @@ Status DiskRowSetWriter::Open() {
     RETURN_NOT_OK(InitAdHocIndexWriter());
   }
 
+  InitColumnAuxFileWriters();
+
   return Status::OK();
 }
 
@@ -139,9 +174,7 @@ Status DiskRowSetWriter::InitBloomFileWriter() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::InitBloomFileWriter");
   unique_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
-  const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id }),
-                                           &block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(block_opts(), &block),
                         "Couldn't allocate a block for bloom filter");
   rowset_metadata_->set_bloom_block(block->id());
 
@@ -154,9 +187,7 @@ Status DiskRowSetWriter::InitAdHocIndexWriter() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::InitAdHocIndexWriter");
   unique_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
-  const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id }),
-                                           &block),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(block_opts(), &block),
                         "Couldn't allocate a block for compoound index");
 
   rowset_metadata_->set_adhoc_index_block(block->id());
@@ -183,6 +214,58 @@ Status DiskRowSetWriter::InitAdHocIndexWriter() {
 
 }
 
+void DiskRowSetWriter::InitColumnAuxFileWriters() {
+  for (int i = 0; i < schema_->num_columns(); i++) {
+    const ColumnSchema& col = schema_->column(i);
+    for (ColumnAuxFileType type : col.attributes().aux_files) {
+      DCHECK_OK(ValidateColumnAuxFile(type, col.name(), col.type_info(),
+                                      i < schema_->num_key_columns()));
+      unique_ptr<cfile::ColumnAuxFileWriter> writer;
+      switch (type) {
+        case SECONDARY_INDEX_FILE:
+          writer.reset(new cfile::SecondaryIndexWriter(col.type_info()));
+          break;
+        case BLOOM_FILTER_FILE:
+          writer.reset(new cfile::ColumnBloomFileWriter(
+              col.type_info(),
+              BloomFilterSizing::BySizeAndFPRate(FLAGS_column_bloom_block_size,
+                                                 FLAGS_column_bloom_target_fp_rate)));
+          break;
+        default:
+          LOG(DFATAL) << "unknown auxiliary file type " << type << " on column "
+                      << col.ToString();
+          continue;
+      }
+      aux_file_writers_[type].emplace(i, std::move(writer));
+    }
+  }
+}
+
+Status DiskRowSetWriter::FinishColumnAuxFiles(BlockCreationTransaction* transaction) {
+  FsManager* fs = rowset_metadata_->fs_manager();
+  for (const auto& type_and_writers : aux_file_writers_) {
+    std::map<ColumnId, BlockId> aux_blocks;
+    for (const auto& e : type_and_writers.second) {
+      // Columns with only NULL cells get no auxiliary file; readers treat a
+      // missing file as carrying no information about the column.
+      if (e.second->empty()) {
+        continue;
+      }
+      unique_ptr<WritableBlock> block;
+      RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(block_opts(), &block),
+                            Substitute("Couldn't allocate a block for $0",
+                                       ColumnAuxFileType_Name(type_and_writers.first)));
+      BlockId block_id = block->id();
+      RETURN_NOT_OK_PREPEND(e.second->FinishAndReleaseBlock(std::move(block), transaction),
+                            Substitute("Unable to finish $0 writer",
+                                       ColumnAuxFileType_Name(type_and_writers.first)));
+      InsertOrDie(&aux_blocks, schema_->column_id(e.first), block_id);
+    }
+    rowset_metadata_->SetColumnAuxBlocks(type_and_writers.first, aux_blocks);
+  }
+  return Status::OK();
+}
+
 Status DiskRowSetWriter::AppendBlock(const RowBlock &block, int live_row_count) {
   DCHECK_EQ(block.schema()->num_columns(), schema_->num_columns());
   CHECK(!finished_);
@@ -201,6 +284,12 @@ Status DiskRowSetWriter::AppendBlock(const RowBlock &block, int live_row_count)
   // Write the batch to each of the columns
   RETURN_NOT_OK(col_writer_->AppendBlock(block));
 
+  for (const auto& type_and_writers : aux_file_writers_) {
+    for (const auto& e : type_and_writers.second) {
+      e.second->AppendValues(block.column_block(e.first), written_count_);
+    }
+  }
+
   // Increase the live row count if necessary.
   rowset_metadata_->IncrementLiveRows(live_row_count);
 
@@ -277,6 +366,8 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(BlockCreationTransaction* transa
   col_writer_->GetFlushedBlocksByColumnId(&flushed_blocks);
   rowset_metadata_->SetColumnDataBlocks(flushed_blocks);
 
+  RETURN_NOT_OK(FinishColumnAuxFiles(transaction));
+
   if (ad_hoc_index_writer_ != nullptr) {
     Status s = ad_hoc_index_writer_->FinishAndReleaseBlock(transaction);
     if (!s.ok()) {
@@ -315,6 +406,12 @@ size_t DiskRowSetWriter::written_size() const {
     size += ad_hoc_index_writer_->written_size();
   }
 
+  for (const auto& type_and_writers : aux_file_writers_) {
+    for (const auto& e : type_and_writers.second) {
+      size += e.second->buffered_size();
+    }
+  }
+
   return size;
 }
 
@@ -329,6 +426,7 @@ RollingDiskRowSetWriter::RollingDiskRowSetWriter(
       schema_(schema),
       bloom_sizing_(bloom_sizing),
       target_rowset_size_(target_rowset_size),
+      tier_(fs::StorageTier::ANY),
       row_idx_in_cur_drs_(0),
       can_roll_(false),
       written_count_(0),
@@ -355,15 +453,15 @@ Status RollingDiskRowSetWriter::RollWriter() {
   RETURN_NOT_OK(tablet_metadata_->CreateRowSet(&cur_drs_metadata_));
 
   cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_));
+  cur_writer_->set_storage_tier(tier_);
   RETURN_NOT_OK(cur_writer_->Open());
 
   FsManager* fs = tablet_metadata_->fs_manager();
   unique_ptr<WritableBlock> undo_data_block;
   unique_ptr<WritableBlock> redo_data_block;
-  RETURN_NOT_OK(fs->CreateNewBlock(CreateBlockOptions({ tablet_metadata_->tablet_id() }),
-                                   &undo_data_block));
-  RETURN_NOT_OK(fs->CreateNewBlock(CreateBlockOptions({ tablet_metadata_->tablet_id() }),
-                                   &redo_data_block));
+  const CreateBlockOptions block_opts({ tablet_metadata_->tablet_id(), tier_ });
+  RETURN_NOT_OK(fs->CreateNewBlock(block_opts, &undo_data_block));
+  RETURN_NOT_OK(fs->CreateNewBlock(block_opts, &redo_data_block));
   cur_undo_ds_block_id_ = undo_data_block->id();
   cur_redo_ds_block_id_ = redo_data_block->id();
   cur_undo_writer_.reset(new DeltaFileWriter(std::move(undo_data_block)));
@@ -530,7 +628,8 @@ DiskRowSet::DiskRowSet(shared_ptr<RowSetMetadata> rowset_metadata,
       log_anchor_registry_(log_anchor_registry),
       mem_trackers_(std::move(mem_trackers)),
       num_rows_(-1),
-      has_been_compacted_(false) {}
+      has_been_compacted_(false),
+      last_read_time_(ToLastReadTime(MonoTime::Now())) {}
 
 Status DiskRowSet::Open(const IOContext* io_context) {
   TRACE_EVENT0("tablet", "DiskRowSet::Open");
@@ -564,7 +663,7 @@ Status DiskRowSet::MinorCompactDeltaStores(const IOContext* io_context) {
 Status DiskRowSet::MajorCompactDeltaStores(const IOContext* io_context,
                                            HistoryGcOpts history_gc_opts) {
   vector<ColumnId> col_ids;
-  delta_tracker_->GetColumnIdsWithUpdates(&col_ids);
+  SelectColumnsForMajorDeltaCompaction(&col_ids);
 
   if (col_ids.empty()) {
     VLOG_WITH_PREFIX(2) << "There are no column ids with updates";
@@ -574,6 +673,46 @@ Status DiskRowSet::MajorCompactDeltaStores(const IOContext* io_context,
   return MajorCompactDeltaStoresWithColumnIds(col_ids, io_context, std::move(history_gc_opts));
 }
 
+void DiskRowSet::SelectColumnsForMajorDeltaCompaction(vector<ColumnId>* col_ids) const {
+  DCHECK(open_);
+  col_ids->clear();
+
+  std::map<ColumnId, int64_t> update_counts;
+  delta_tracker_->GetColumnUpdateCounts(&update_counts);
+  if (update_counts.empty()) {
+    return;
+  }
+
+  // Compact the most-updated columns first, since they benefit the most.
+  vector<std::pair<ColumnId, int64_t>> by_updates(update_counts.begin(), update_counts.end());
+  std::stable_sort(by_updates.begin(), by_updates.end(),
+                   [](const std::pair<ColumnId, int64_t>& a,
+                      const std::pair<ColumnId, int64_t>& b) {
+                     return a.second > b.second;
+                   });
+
+  const int64_t budget = FLAGS_tablet_delta_store_major_compact_max_bytes;
+  int64_t selected_bytes = 0;
+  shared_lock<rw_spinlock> l(component_lock_);
+  for (const auto& e : by_updates) {
+    ColumnId col_id = e.first;
+    // Columns without base data (e.g. added after the flush, or since
+    // dropped) cost nothing to rewrite.
+    int64_t col_bytes = base_data_->has_data_for_column_id(col_id) ?
+        base_data_->OnDiskColumnDataSize(col_id) : 0;
+    if (budget > 0 && !col_ids->empty() && selected_bytes + col_bytes > budget) {
+      continue;
+    }
+    col_ids->push_back(col_id);
+    selected_bytes += col_bytes;
+  }
+  if (col_ids->size() < by_updates.size()) {
+    VLOG_WITH_PREFIX(1) << "Major delta compaction limited to " << col_ids->size() << " of "
+                        << by_updates.size() << " updated columns (" << selected_bytes
+                        << " bytes of base data)";
+  }
+}
+
 Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>& col_ids,
                                                         const IOContext* io_context,
                                                         HistoryGcOpts history_gc_opts) {
@@ -661,6 +800,7 @@ Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
 Status DiskRowSet::NewRowIterator(const RowIteratorOptions& opts,
                                   unique_ptr<RowwiseIterator>* out) const {
   DCHECK(open_);
+  last_read_time_.store(ToLastReadTime(MonoTime::Now()), std::memory_order_relaxed);
   shared_lock<rw_spinlock> l(component_lock_);
 
   shared_ptr<CFileSet::Iterator> base_iter(base_data_->NewIterator(opts.projection,
@@ -775,6 +915,7 @@ void DiskRowSet::GetDiskRowSetSpaceUsage(DiskRowSetSpace* drss) const {
   drss->base_data_size = base_data_->OnDiskDataSize();
   drss->bloom_size = base_data_->BloomFileOnDiskSize();
   drss->ad_hoc_index_size = base_data_->AdhocIndexOnDiskSize();
+  drss->column_aux_files_size = base_data_->ColumnAuxFilesOnDiskSize();
   drss->redo_deltas_size = delta_tracker_->RedoDeltaOnDiskSize();
   drss->undo_deltas_size = delta_tracker_->UndoDeltaOnDiskSize();
 }
@@ -23,6 +23,7 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -34,6 +35,7 @@
 #include "kudu/common/rowid.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/dir_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -47,6 +49,7 @@
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -60,6 +63,7 @@ class Timestamp;
 namespace cfile {
 class BloomFileWriter;
 class CFileWriter;
+class ColumnAuxFileWriter;
 }
 
 namespace consensus {
@@ -95,6 +99,10 @@ class DiskRowSetWriter {
 
   ~DiskRowSetWriter();
 
+  // Prefer placing the rowset's blocks in data dirs of the given storage
+  // tier. Must be called before Open().
+  void set_storage_tier(fs::StorageTier tier) { tier_ = tier; }
+
   Status Open();
 
   // The block is written to all column writers as well as the bloom filter,
@@ -136,14 +144,26 @@ class DiskRowSetWriter {
   // this index is written to a new file instead of embedded in the col_* files
   Status InitAdHocIndexWriter();
 
+  // Initializes a writer for each auxiliary file requested by the storage
+  // attributes of the columns in 'schema_'.
+  void InitColumnAuxFileWriters();
+
+  // Writes out the buffered column auxiliary files, releasing their blocks
+  // to 'transaction' and recording them in the rowset metadata.
+  Status FinishColumnAuxFiles(fs::BlockCreationTransaction* transaction);
+
   // Return the cfile::Writer responsible for writing the key index.
   // (the ad-hoc writer for composite keys, otherwise the key column writer)
   cfile::CFileWriter *key_index_writer();
 
+  // Returns the options with which to create the rowset's blocks.
+  fs::CreateBlockOptions block_opts() const;
+
   RowSetMetadata* rowset_metadata_;
   const Schema* const schema_;
 
   BloomFilterSizing bloom_sizing_;
+  fs::StorageTier tier_;
 
   bool finished_;
   rowid_t written_count_;
@@ -151,6 +171,11 @@ class DiskRowSetWriter {
   gscoped_ptr<cfile::BloomFileWriter> bloom_writer_;
   gscoped_ptr<cfile::CFileWriter> ad_hoc_index_writer_;
 
+  // Column auxiliary file writers, keyed by the type of file and then by the
+  // index of the column within 'schema_'.
+  std::map<ColumnAuxFileType, std::map<int, std::unique_ptr<cfile::ColumnAuxFileWriter>>>
+      aux_file_writers_;
+
   // The last encoded key written.
   faststring last_encoded_key_;
 };
@@ -171,6 +196,10 @@ class RollingDiskRowSetWriter {
                           size_t target_rowset_size);
   ~RollingDiskRowSetWriter();
 
+  // Prefer placing the blocks of the written rowsets in data dirs of the
+  // given storage tier. Must be called before Open().
+  void set_storage_tier(fs::StorageTier tier) { tier_ = tier; }
+
   Status Open();
 
   // The block is written to all column writers as well as the bloom filter,
@@ -247,6 +276,7 @@ class RollingDiskRowSetWriter {
   std::shared_ptr<RowSetMetadata> cur_drs_metadata_;
   const BloomFilterSizing bloom_sizing_;
   const size_t target_rowset_size_;
+  fs::StorageTier tier_;
 
   gscoped_ptr<DiskRowSetWriter> cur_writer_;
 
@@ -284,6 +314,7 @@ class RollingDiskRowSetWriter {
 //   - base data
 //   - bloom file
 //   - ad hoc index
+//   - column auxiliary files (secondary indexes, column bloom files)
 // - delta files
 //   - UNDO deltas
 //   - REDO deltas
@@ -292,12 +323,13 @@ struct DiskRowSetSpace {
   uint64_t base_data_size;
   uint64_t bloom_size;
   uint64_t ad_hoc_index_size;
+  uint64_t column_aux_files_size;
   uint64_t redo_deltas_size;
   uint64_t undo_deltas_size;
 
   // Helper method to compute the size of the diskrowset's underlying cfile set.
   uint64_t CFileSetOnDiskSize() {
-    return base_data_size + bloom_size + ad_hoc_index_size;
+    return base_data_size + bloom_size + ad_hoc_index_size + column_aux_files_size;
   }
 };
 
@@ -408,7 +440,13 @@ class DiskRowSet : public RowSet {
   Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark, const fs::IOContext* io_context,
                                  int64_t* blocks_deleted, int64_t* bytes_deleted) override;
 
-  // Major compacts all the delta files for all the columns.
+  // Major compacts the delta files for the columns that have updates.
+  //
+  // To bound the work done by a single compaction, the columns are compacted
+  // in chunks of roughly --tablet_delta_store_major_compact_max_bytes of
+  // base data, most-updated first. Each call compacts and commits one chunk;
+  // the updates to the remaining columns are carried over into a new REDO
+  // delta file and left for subsequent calls.
   Status MajorCompactDeltaStores(const fs::IOContext* io_context, HistoryGcOpts history_gc_opts);
 
   std::mutex *compact_flush_lock() override {
@@ -427,6 +465,19 @@ class DiskRowSet : public RowSet {
     return DCHECK_NOTNULL(delta_tracker_.get());
   }
 
+  // The last time a scan of this rowset started or, if it hasn't been scanned
+  // since, the time it was opened.
+  MonoTime last_read_time() const {
+    return MonoTime::Min() +
+        MonoDelta::FromNanoseconds(last_read_time_.load(std::memory_order_relaxed));
+  }
+
+  // Overrides the last read time, e.g. so that the output of a compaction
+  // inherits the last read time of its inputs.
+  void set_last_read_time(const MonoTime& time) {
+    last_read_time_.store(ToLastReadTime(time), std::memory_order_relaxed);
+  }
+
   std::shared_ptr<RowSetMetadata> metadata() override {
     return rowset_metadata_;
   }
@@ -465,6 +516,9 @@ class DiskRowSet : public RowSet {
                                  const fs::IOContext* io_context,
                                  gscoped_ptr<MajorDeltaCompaction>* out) const;
 
+  // Selects the next chunk of updated columns for MajorCompactDeltaStores().
+  void SelectColumnsForMajorDeltaCompaction(std::vector<ColumnId>* col_ids) const;
+
   // Major compacts all the delta files for the specified columns.
   Status MajorCompactDeltaStoresWithColumnIds(const std::vector<ColumnId>& col_ids,
                                               const fs::IOContext* io_context,
@@ -495,6 +549,15 @@ class DiskRowSet : public RowSet {
   // and thus should not be scheduled for further compactions.
   std::atomic<bool> has_been_compacted_;
 
+  // Converts 'time' to the representation of 'last_read_time_'.
+  static int64_t ToLastReadTime(const MonoTime& time) {
+    return (time - MonoTime::Min()).ToNanoseconds();
+  }
+
+  // The last read time, in nanoseconds since MonoTime::Min(). It is updated
+  // by every scan, which shouldn't contend on a lock for it.
+  mutable std::atomic<int64_t> last_read_time_;
+
   DISALLOW_COPY_AND_ASSIGN(DiskRowSet);
 };
 
@@ -31,9 +31,12 @@
 #include "kudu/common/partial_row.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/io_context.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/delta_tracker.h"
+#include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
@@ -43,6 +46,7 @@
 #include "kudu/util/test_macros.h"
 
 DECLARE_double(cfile_inject_corruption);
+DECLARE_int64(tablet_delta_store_major_compact_max_bytes);
 
 using std::shared_ptr;
 using std::string;
@@ -384,6 +388,41 @@ TEST_F(TestMajorDeltaCompaction, TestReinserts) {
   NO_FATALS(VerifyDataWithMvccAndExpectedState(second_batch_inserts, old_state));
 }
 
+// Verify that a major delta compaction limited by size compacts the updated
+// columns in chunks, each of which commits on its own.
+TEST_F(TestMajorDeltaCompaction, TestIncrementalCompaction) {
+  const int kNumRows = 100;
+  NO_FATALS(WriteTestTablet(kNumRows));
+  ASSERT_OK(tablet()->Flush());
+  NO_FATALS(UpdateRows(kNumRows, false));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  NO_FATALS(VerifyData());
+
+  vector<shared_ptr<RowSet>> all_rowsets;
+  tablet()->GetRowSetsForTests(&all_rowsets);
+  ASSERT_EQ(1, all_rowsets.size());
+  DiskRowSet* drs = down_cast<DiskRowSet*>(all_rowsets.front().get());
+
+  // UpdateRows() touches three columns. With a tiny budget, each compaction
+  // only rewrites one of them.
+  FLAGS_tablet_delta_store_major_compact_max_bytes = 1;
+  fs::IOContext io_context({ "test-tablet" });
+  vector<ColumnId> col_ids_with_updates;
+  drs->delta_tracker()->GetColumnIdsWithUpdates(&col_ids_with_updates);
+  ASSERT_EQ(3, col_ids_with_updates.size());
+  for (int remaining = 2; remaining >= 0; remaining--) {
+    SCOPED_TRACE(Substitute("$0 columns remaining", remaining));
+    ASSERT_OK(drs->MajorCompactDeltaStores(&io_context, tablet()->GetHistoryGcOpts()));
+    drs->delta_tracker()->GetColumnIdsWithUpdates(&col_ids_with_updates);
+    ASSERT_EQ(remaining, col_ids_with_updates.size());
+    NO_FATALS(VerifyData());
+  }
+
+  // Nothing is left to do.
+  ASSERT_OK(drs->MajorCompactDeltaStores(&io_context, tablet()->GetHistoryGcOpts()));
+  NO_FATALS(VerifyData());
+}
+
 // Verify that we won't schedule a major compaction when files are just composed of deletes.
 TEST_F(TestMajorDeltaCompaction, TestJustDeletes) {
   const int kNumRows = 100;
@@ -41,17 +41,20 @@ class CFileWriter;
 
 namespace fs {
 class BlockCreationTransaction;
+enum class StorageTier;
 } // namespace fs
 
 namespace tablet {
 
 // Wrapper which writes several columns in parallel corresponding to some
-// Schema. Written blocks will fall in the tablet_id's data dir group.
+// Schema. Written blocks will fall in the tablet_id's data dir group,
+// preferably in data dirs of the given storage tier.
 class MultiColumnWriter {
  public:
   MultiColumnWriter(FsManager* fs,
                     const Schema* schema,
-                    std::string tablet_id);
+                    std::string tablet_id,
+                    fs::StorageTier tier);
 
   virtual ~MultiColumnWriter();
 
@@ -87,6 +90,7 @@ class MultiColumnWriter {
   bool finished_;
 
   const std::string tablet_id_;
+  const fs::StorageTier tier_;
 
   std::vector<cfile::CFileWriter *> cfile_writers_;
   std::vector<BlockId> block_ids_;
@@ -105,6 +105,13 @@ void RowSetMetadata::LoadFromPB(const RowSetDataPB& pb) {
     blocks_by_col_id_[col_id] = BlockId::FromPB(col_pb.block());
   }
 
+  // Load Column Auxiliary Files.
+  aux_blocks_by_type_.clear();
+  for (const ColumnAuxDataPB& aux_pb : pb.column_aux_files()) {
+    ColumnId col_id = ColumnId(aux_pb.column_id());
+    aux_blocks_by_type_[aux_pb.type()][col_id] = BlockId::FromPB(aux_pb.block());
+  }
+
   // Load redo delta files.
   redo_delta_blocks_.clear();
   for (const DeltaDataPB& redo_delta_pb : pb.redo_deltas()) {
@@ -140,6 +147,16 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
     col_data->set_column_id(col_id);
   }
 
+  // Write Column Auxiliary Files
+  for (const auto& type_and_blocks : aux_blocks_by_type_) {
+    for (const ColumnIdToBlockIdMap::value_type& e : type_and_blocks.second) {
+      ColumnAuxDataPB *aux_data = pb->add_column_aux_files();
+      aux_data->set_type(type_and_blocks.first);
+      aux_data->set_column_id(e.first);
+      e.second.CopyToPB(aux_data->mutable_block());
+    }
+  }
+
   // Write Delta Files
   pb->set_last_durable_dms_id(last_durable_redo_dms_id_);
 
@@ -186,6 +203,28 @@ void RowSetMetadata::SetColumnDataBlocks(const std::map<ColumnId, BlockId>& bloc
   blocks_by_col_id_ = std::move(new_map);
 }
 
+void RowSetMetadata::SetColumnAuxBlocks(ColumnAuxFileType type,
+                                        const std::map<ColumnId, BlockId>& blocks_by_col_id) {
+  ColumnIdToBlockIdMap new_map(blocks_by_col_id.begin(), blocks_by_col_id.end());
+  new_map.shrink_to_fit();
+  std::lock_guard<LockType> l(lock_);
+  if (new_map.empty()) {
+    aux_blocks_by_type_.erase(type);
+  } else {
+    aux_blocks_by_type_[type] = std::move(new_map);
+  }
+}
+
+void RowSetMetadata::RemoveColumnAuxBlocksUnlocked(ColumnId col_id, BlockIdContainer* removed) {
+  for (auto& type_and_blocks : aux_blocks_by_type_) {
+    BlockId old_block_id;
+    if (FindCopy(type_and_blocks.second, col_id, &old_block_id)) {
+      type_and_blocks.second.erase(col_id);
+      removed->push_back(old_block_id);
+    }
+  }
+}
+
 Status RowSetMetadata::CommitRedoDeltaDataBlock(int64_t dms_id,
                                                 int64_t num_deleted_rows,
                                                 const BlockId& block_id) {
@@ -268,12 +307,15 @@ void RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update,
       if (UpdateReturnCopy(&blocks_by_col_id_, e.first, e.second, &old_block_id)) {
         removed->push_back(old_block_id);
       }
+      // The column's auxiliary files no longer match the replaced base data.
+      RemoveColumnAuxBlocksUnlocked(e.first, removed);
     }
 
     for (const ColumnId& col_id : update.col_ids_to_remove_) {
       BlockId old = FindOrDie(blocks_by_col_id_, col_id);
       CHECK_EQ(1, blocks_by_col_id_.erase(col_id));
       removed->push_back(old);
+      RemoveColumnAuxBlocksUnlocked(col_id, removed);
     }
   }
 
@@ -308,6 +350,9 @@ BlockIdContainer RowSetMetadata::GetAllBlocks() {
     blocks.push_back(bloom_block_);
   }
   AppendValuesFromMap(blocks_by_col_id_, &blocks);
+  for (const auto& type_and_blocks : aux_blocks_by_type_) {
+    AppendValuesFromMap(type_and_blocks.second, &blocks);
+  }
 
   blocks.insert(blocks.end(),
                 undo_delta_blocks_.begin(), undo_delta_blocks_.end());
@@ -117,6 +117,10 @@ class RowSetMetadata {
 
   void SetColumnDataBlocks(const std::map<ColumnId, BlockId>& blocks_by_col_id);
 
+  // Replaces the auxiliary files of type 'type' with 'blocks_by_col_id'.
+  void SetColumnAuxBlocks(ColumnAuxFileType type,
+                          const std::map<ColumnId, BlockId>& blocks_by_col_id);
+
   // Atomically commit the new redo delta block to RowSetMetadata.
   // This atomic operation includes updates to last_durable_redo_dms_id_ and live_row_count_.
   Status CommitRedoDeltaDataBlock(int64_t dms_id,
@@ -181,6 +185,21 @@ class RowSetMetadata {
     return blocks_by_col_id_;
   }
 
+  // Returns the blocks of this rowset's auxiliary files of type 'type',
+  // keyed by column id. Columns without such a file have no entry.
+  ColumnIdToBlockIdMap GetColumnAuxBlocksById(ColumnAuxFileType type) const {
+    std::lock_guard<LockType> l(lock_);
+    const ColumnIdToBlockIdMap* blocks = FindOrNull(aux_blocks_by_type_, type);
+    return blocks ? *blocks : ColumnIdToBlockIdMap();
+  }
+
+  // Returns the blocks of all of this rowset's auxiliary files, keyed by type
+  // and then by column id.
+  std::map<ColumnAuxFileType, ColumnIdToBlockIdMap> GetAllColumnAuxBlocks() const {
+    std::lock_guard<LockType> l(lock_);
+    return aux_blocks_by_type_;
+  }
+
   std::vector<BlockId> redo_delta_blocks() const {
     std::lock_guard<LockType> l(lock_);
     return redo_delta_blocks_;
@@ -262,6 +281,10 @@ class RowSetMetadata {
 
   void IncrementLiveRowsUnlocked(int64_t row_count);
 
+  // Removes the auxiliary files of the column 'col_id', appending their
+  // blocks to 'removed'.
+  void RemoveColumnAuxBlocksUnlocked(ColumnId col_id, BlockIdContainer* removed);
+
   TabletMetadata* const tablet_metadata_;
   bool initted_;
   int64_t id_;
@@ -278,6 +301,12 @@ class RowSetMetadata {
 
   // Map of column ID to block ID.
   ColumnIdToBlockIdMap blocks_by_col_id_;
+
+  // Map of auxiliary file type to a map of column ID to the block ID of that
+  // column's auxiliary file. An auxiliary file only describes the base data
+  // it was written alongside, so it is dropped whenever that column's base
+  // data is replaced or removed.
+  std::map<ColumnAuxFileType, ColumnIdToBlockIdMap> aux_blocks_by_type_;
   std::vector<BlockId> redo_delta_blocks_;
   std::vector<BlockId> undo_delta_blocks_;
 
@@ -34,6 +34,8 @@
 #include "kudu/tablet/mock-rowsets.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_tree.h"
+#include "kudu/util/interval_tree.h"
+#include "kudu/util/interval_tree-inl.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
@@ -65,6 +67,44 @@ static RowSetVector GenerateRandomRowSets(int num_sets) {
   return vec;
 }
 
+// Entry and traits for building the pointer-based IntervalTree over the same
+// rowsets as a RowSetTree, for comparison.
+struct BoundedRowSet {
+  string min_key;
+  string max_key;
+  RowSet* rowset;
+};
+
+struct BoundedRowSetTraits {
+  typedef Slice point_type;
+  typedef BoundedRowSet* interval_type;
+
+  static Slice get_left(const BoundedRowSet* rs) {
+    return Slice(rs->min_key);
+  }
+
+  static Slice get_right(const BoundedRowSet* rs) {
+    return Slice(rs->max_key);
+  }
+
+  static int compare(const Slice& a, const Slice& b) {
+    return a.compare(b);
+  }
+};
+
+// Returns the rowsets found by each query of 'tree' as sets, for comparing
+// trees which may return them in different orders.
+static vector<unordered_set<RowSet*>> QueryAll(const RowSetTree& tree,
+                                                const vector<string>& queries) {
+  vector<unordered_set<RowSet*>> results;
+  for (const auto& q : queries) {
+    vector<RowSet*> out;
+    tree.FindRowSetsWithKeyInRange(Slice(q), &out);
+    results.emplace_back(out.begin(), out.end());
+  }
+  return results;
+}
+
 } // anonymous namespace
 
 TEST_F(TestRowSetTree, TestTree) {
@@ -352,6 +392,123 @@ TEST_P(TestRowSetTreePerformance, TestPerformance) {
                             batch_total ? (oat_total / batch_total) : 0);
 }
 
+// Compare the flattened index inside RowSetTree against the pointer-based
+// IntervalTree it replaced, on the same rowsets and queries.
+class TestRowSetTreeVsIntervalTree : public TestRowSetTree,
+                                     public testing::WithParamInterface<int> {
+};
+INSTANTIATE_TEST_CASE_P(NumRowSets, TestRowSetTreeVsIntervalTree,
+                        testing::Values(100, 1000, 10000));
+
+TEST_P(TestRowSetTreeVsIntervalTree, TestPerformance) {
+  const int kNumRowSets = GetParam();
+  const int kNumQueries = 1000;
+  const int kNumIterations = AllowSlowTests() ? 100 : 3;
+  SeedRandom();
+
+  Stopwatch flat_timer;
+  Stopwatch tree_timer;
+  for (int i = 0; i < kNumIterations; i++) {
+    RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
+    RowSetTree flat;
+    ASSERT_OK(flat.Reset(vec));
+
+    vector<BoundedRowSet> bounded(vec.size());
+    vector<BoundedRowSet*> intervals;
+    for (int j = 0; j < vec.size(); j++) {
+      ASSERT_OK(vec[j]->GetBounds(&bounded[j].min_key, &bounded[j].max_key));
+      bounded[j].rowset = vec[j].get();
+      intervals.push_back(&bounded[j]);
+    }
+    IntervalTree<BoundedRowSetTraits> tree(intervals);
+
+    vector<string> queries;
+    for (int j = 0; j < kNumQueries; j++) {
+      queries.emplace_back(StringPrintf("%04d", rand() % 10000));
+    }
+
+    int flat_matches = 0;
+    flat_timer.resume();
+    {
+      vector<RowSet*> out;
+      for (const auto& q : queries) {
+        out.clear();
+        flat.FindRowSetsWithKeyInRange(Slice(q), &out);
+        flat_matches += out.size();
+      }
+    }
+    flat_timer.stop();
+
+    int tree_matches = 0;
+    tree_timer.resume();
+    {
+      vector<BoundedRowSet*> out;
+      for (const auto& q : queries) {
+        out.clear();
+        tree.FindContainingPoint(Slice(q), &out);
+        tree_matches += out.size();
+      }
+    }
+    tree_timer.stop();
+
+    ASSERT_EQ(tree_matches, flat_matches);
+  }
+
+  double flat_total = flat_timer.elapsed().user;
+  double tree_total = tree_timer.elapsed().user;
+  const string& case_desc = StringPrintf("Q=% 5d R=% 5d", kNumQueries, kNumRowSets);
+  LOG(INFO) << StringPrintf("%s %15s %d ms",
+                            case_desc.c_str(),
+                            "interval tree",
+                            static_cast<int>(tree_total/1e6));
+  LOG(INFO) << StringPrintf("%s %15s %d ms (%.2fx)",
+                            case_desc.c_str(),
+                            "flat",
+                            static_cast<int>(flat_total/1e6),
+                            flat_total ? (tree_total / flat_total) : 0);
+}
+
+// Test that swapping rowsets in and out of a tree yields the same results as
+// building a new tree from scratch.
+TEST_F(TestRowSetTree, TestResetWithSwap) {
+  SeedRandom();
+  RowSetVector vec = GenerateRandomRowSets(100);
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+  shared_ptr<RowSetTree> tree(new RowSetTree());
+  ASSERT_OK(tree->Reset(vec));
+
+  vector<string> queries;
+  for (int i = 0; i < 100; i++) {
+    queries.emplace_back(StringPrintf("%04d", rand() % 10000));
+  }
+
+  for (int i = 0; i < 50; i++) {
+    RowSetVector to_remove;
+    for (const auto& rs : tree->all_rowsets()) {
+      if (rand() % 10 == 0) {
+        to_remove.push_back(rs);
+      }
+    }
+    RowSetVector to_add = GenerateRandomRowSets(rand() % 10);
+    shared_ptr<RowSetTree> new_tree(new RowSetTree());
+    ASSERT_OK(new_tree->ResetWithSwap(*tree, to_remove, to_add));
+    // The old tree may go away before the new one.
+    tree = std::move(new_tree);
+
+    RowSetTree fresh;
+    ASSERT_OK(fresh.Reset(tree->all_rowsets()));
+    ASSERT_EQ(QueryAll(fresh, queries), QueryAll(*tree, queries));
+    ASSERT_EQ(fresh.key_endpoints().size(), tree->key_endpoints().size());
+    for (int j = 0; j < fresh.key_endpoints().size(); j++) {
+      const auto& a = fresh.key_endpoints()[j];
+      const auto& b = tree->key_endpoints()[j];
+      ASSERT_EQ(a.rowset_, b.rowset_);
+      ASSERT_EQ(a.endpoint_, b.endpoint_);
+      ASSERT_EQ(a.slice_, b.slice_);
+    }
+  }
+}
+
 TEST_F(TestRowSetTree, TestEndpointsConsistency) {
   const int kNumRowSets = 1000;
   RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
@@ -19,24 +19,28 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 #include <ostream>
 
 #include <glog/logging.h>
 
-#include "kudu/gutil/stl_util.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
-#include "kudu/util/interval_tree.h"
-#include "kudu/util/interval_tree-inl.h"
 #include "kudu/util/slice.h"
 
 using std::vector;
 using std::shared_ptr;
 using std::string;
+using std::unordered_map;
+using std::unordered_set;
 
 namespace kudu {
 namespace tablet {
@@ -64,88 +68,108 @@ struct QueryStruct {
 
 } // anonymous namespace
 
-// Entry for use in the interval tree.
-struct RowSetWithBounds {
-  string min_key;
-  string max_key;
+RowSetTree::RowSetTree()
+  : initted_(false) {
+}
 
-  // NOTE: the ordering of struct fields here is purposeful: we access
-  // min_key and max_key frequently, so putting them first in the struct
-  // ensures they fill a single 64-byte cache line (each is 32 bytes).
-  // The 'rowset' pointer is accessed comparitively rarely.
-  RowSet *rowset;
-};
+Status RowSetTree::Reset(const RowSetVector &rowsets) {
+  CHECK(!initted_);
+  RowSetVector unbounded;
+  vector<IntervalEntry> entries;
+  entries.reserve(rowsets.size());
+  // Backing storage for the bounds until they're packed into the arena. The
+  // vector is never resized after this point, so the Slices stay valid.
+  vector<string> bounds(rowsets.size() * 2);
 
-// Traits struct for IntervalTree.
-struct RowSetIntervalTraits {
-  typedef Slice point_type;
-  typedef RowSetWithBounds *interval_type;
+  // Iterate over each of the provided RowSets, fetching their
+  // bounds and adding them to the local vectors.
+  for (int i = 0; i < rowsets.size(); i++) {
+    const shared_ptr<RowSet>& rs = rowsets[i];
+    string* min_key = &bounds[i * 2];
+    string* max_key = &bounds[i * 2 + 1];
+    Status s = rs->GetBounds(min_key, max_key);
+    if (s.IsNotSupported()) {
+      // This rowset is a MemRowSet, for which the bounds change as more
+      // data gets inserted. Therefore we can't put it in the static
+      // interval tree -- instead put it on the list which is consulted
+      // on every access.
+      unbounded.push_back(rs);
+      continue;
+    } else if (!s.ok()) {
+      LOG(WARNING) << "Unable to construct RowSetTree: "
+                   << rs->ToString() << " unable to determine its bounds: "
+                   << s.ToString();
+      return s;
+    }
+    DCHECK_LE(min_key->compare(*max_key), 0)
+      << "Rowset min must be <= max: " << rs->ToString();
 
-  static Slice get_left(const RowSetWithBounds *rs) {
-    return Slice(rs->min_key);
+    entries.push_back({ Slice(*min_key), Slice(*max_key), rs.get() });
   }
-
-  static Slice get_right(const RowSetWithBounds *rs) {
-    return Slice(rs->max_key);
+  PackKeys(&entries);
+
+  // Load into key endpoints and sort them.
+  vector<RSEndpoint> endpoints;
+  endpoints.reserve(entries.size() * 2);
+  for (const IntervalEntry& e : entries) {
+    endpoints.emplace_back(e.rowset, START, e.min_key);
+    endpoints.emplace_back(e.rowset, STOP, e.max_key);
   }
+  std::sort(endpoints.begin(), endpoints.end(), RSEndpointBySliceCompare);
 
-  static int compare(const Slice &a, const Slice &b) {
-    return a.compare(b);
-  }
+  InstallIndex(entries, std::move(endpoints), std::move(unbounded), rowsets);
+  return Status::OK();
+}
 
-  static int compare(const Slice &a, const QueryStruct &b) {
-    return a.compare(b.slice);
-  }
+Status RowSetTree::ResetWithSwap(const RowSetTree& old_tree,
+                                 const RowSetVector& to_remove,
+                                 const RowSetVector& to_add) {
+  CHECK(!initted_);
+  DCHECK(old_tree.initted_);
 
-  static int compare(const QueryStruct &a, const Slice &b) {
-    return -compare(b, a);
+  // Collect the set of rowsets excluding the removed ones, then push the new
+  // rowsets on the end of the new list.
+  unordered_set<RowSet*> removed;
+  for (const shared_ptr<RowSet>& rs : to_remove) {
+    removed.insert(rs.get());
   }
-
-  // When 'a' is boost::none:
-  //  (1)'a' is +OO when 'positive_direction' is true;
-  //  (2)'a' is -OO when 'positive_direction' is false.
-  static int compare(const boost::optional<Slice>& a,
-                     const Slice& b,
-                     const EndpointIfNone& type) {
-    if (a == boost::none) {
-      return ((POSITIVE_INFINITY == type) ? 1 : -1);
+  RowSetVector post_swap;
+  post_swap.reserve(old_tree.all_rowsets_.size() + to_add.size());
+  int num_removed = 0;
+  for (const shared_ptr<RowSet>& rs : old_tree.all_rowsets_) {
+    if (ContainsKey(removed, rs.get())) {
+      num_removed++;
+    } else {
+      post_swap.push_back(rs);
     }
-
-    return compare(*a, b);
   }
-
-  static int compare(const Slice& a,
-                     const boost::optional<Slice>& b,
-                     const EndpointIfNone& type) {
-    return -compare(b, a, type);
+  CHECK_EQ(num_removed, to_remove.size());
+  std::copy(to_add.begin(), to_add.end(), std::back_inserter(post_swap));
+
+  // Carry over the bounds of the rowsets that are already known to the old
+  // tree. Rowset bounds never change, so there's no need to fetch them again.
+  unordered_map<RowSet*, const IntervalEntry*> old_entries;
+  old_entries.reserve(old_tree.by_asc_left_.size());
+  for (const IntervalEntry& e : old_tree.by_asc_left_) {
+    InsertOrDie(&old_entries, e.rowset, &e);
   }
-};
-
-RowSetTree::RowSetTree()
-  : initted_(false) {
-}
 
-Status RowSetTree::Reset(const RowSetVector &rowsets) {
-  CHECK(!initted_);
-  std::vector<RowSetWithBounds *> entries;
   RowSetVector unbounded;
-  ElementDeleter deleter(&entries);
-  entries.reserve(rowsets.size());
-  std::vector<RSEndpoint> endpoints;
-  endpoints.reserve(rowsets.size()*2);
-
-  // Iterate over each of the provided RowSets, fetching their
-  // bounds and adding them to the local vectors.
-  for (const shared_ptr<RowSet> &rs : rowsets) {
-    gscoped_ptr<RowSetWithBounds> rsit(new RowSetWithBounds());
-    rsit->rowset = rs.get();
+  vector<IntervalEntry> entries;
+  entries.reserve(post_swap.size());
+  vector<string> bounds(to_add.size() * 2);
+  int num_fetched = 0;
+  for (const shared_ptr<RowSet>& rs : post_swap) {
+    const IntervalEntry* old_entry = FindWithDefault(old_entries, rs.get(), nullptr);
+    if (old_entry) {
+      entries.push_back(*old_entry);
+      continue;
+    }
+    // Either a newly added rowset, or one which had no bounds in the old tree.
+    // In the latter case it may be fetched past the end of 'to_add'.
     string min_key, max_key;
     Status s = rs->GetBounds(&min_key, &max_key);
     if (s.IsNotSupported()) {
-      // This rowset is a MemRowSet, for which the bounds change as more
-      // data gets inserted. Therefore we can't put it in the static
-      // interval tree -- instead put it on the list which is consulted
-      // on every access.
       unbounded.push_back(rs);
       continue;
     } else if (!s.ok()) {
@@ -156,26 +180,91 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
     }
     DCHECK_LE(min_key.compare(max_key), 0)
       << "Rowset min must be <= max: " << rs->ToString();
+    CHECK_LT(num_fetched, to_add.size())
+        << "rowset " << rs->ToString() << " gained bounds since the old tree was built";
+    bounds[num_fetched * 2] = std::move(min_key);
+    bounds[num_fetched * 2 + 1] = std::move(max_key);
+    entries.push_back({ Slice(bounds[num_fetched * 2]),
+                        Slice(bounds[num_fetched * 2 + 1]),
+                        rs.get() });
+    num_fetched++;
+  }
+  PackKeys(&entries);
 
-    // Load bounds and save entry
-    rsit->min_key = std::move(min_key);
-    rsit->max_key = std::move(max_key);
+  unordered_map<RowSet*, const IntervalEntry*> new_entries;
+  new_entries.reserve(entries.size());
+  for (const IntervalEntry& e : entries) {
+    InsertOrDie(&new_entries, e.rowset, &e);
+  }
 
-    // Load into key endpoints.
-    endpoints.emplace_back(rsit->rowset, START, rsit->min_key);
-    endpoints.emplace_back(rsit->rowset, STOP, rsit->max_key);
+  // The old endpoints are already sorted, so only the new ones need sorting
+  // before the two lists are merged.
+  vector<RSEndpoint> kept_endpoints;
+  kept_endpoints.reserve(old_tree.key_endpoints_.size());
+  for (const RSEndpoint& rse : old_tree.key_endpoints_) {
+    const IntervalEntry* e = FindWithDefault(new_entries, rse.rowset_, nullptr);
+    if (e) {
+      kept_endpoints.emplace_back(e->rowset, rse.endpoint_,
+                                  rse.endpoint_ == START ? e->min_key : e->max_key);
+    }
+  }
+  vector<RSEndpoint> added_endpoints;
+  added_endpoints.reserve(num_fetched * 2);
+  for (const IntervalEntry& e : entries) {
+    if (!ContainsKey(old_entries, e.rowset)) {
+      added_endpoints.emplace_back(e.rowset, START, e.min_key);
+      added_endpoints.emplace_back(e.rowset, STOP, e.max_key);
+    }
+  }
+  std::sort(added_endpoints.begin(), added_endpoints.end(), RSEndpointBySliceCompare);
+  vector<RSEndpoint> endpoints;
+  endpoints.reserve(kept_endpoints.size() + added_endpoints.size());
+  std::merge(kept_endpoints.begin(), kept_endpoints.end(),
+             added_endpoints.begin(), added_endpoints.end(),
+             std::back_inserter(endpoints), RSEndpointBySliceCompare);
+
+  InstallIndex(entries, std::move(endpoints), std::move(unbounded), post_swap);
+  return Status::OK();
+}
 
-    entries.push_back(rsit.release());
+void RowSetTree::PackKeys(vector<IntervalEntry>* entries) {
+  size_t total_size = 0;
+  for (const IntervalEntry& e : *entries) {
+    total_size += e.min_key.size() + e.max_key.size();
+  }
+  key_arena_.reset(new uint8_t[total_size]);
+  uint8_t* dst = key_arena_.get();
+  for (IntervalEntry& e : *entries) {
+    memcpy(dst, e.min_key.data(), e.min_key.size());
+    e.min_key = Slice(dst, e.min_key.size());
+    dst += e.min_key.size();
+    memcpy(dst, e.max_key.data(), e.max_key.size());
+    e.max_key = Slice(dst, e.max_key.size());
+    dst += e.max_key.size();
   }
+}
 
-  // Sort endpoints
-  std::sort(endpoints.begin(), endpoints.end(), RSEndpointBySliceCompare);
+void RowSetTree::InstallIndex(const vector<IntervalEntry>& entries,
+                              vector<RSEndpoint> endpoints,
+                              RowSetVector unbounded,
+                              const RowSetVector& rowsets) {
+  // Every node holds at least the interval containing its split point, so
+  // there are never more nodes than intervals.
+  nodes_.reserve(entries.size());
+  by_asc_left_.reserve(entries.size());
+  by_desc_right_.reserve(entries.size());
+  if (!entries.empty()) {
+    vector<int32_t> all(entries.size());
+    for (int32_t i = 0; i < entries.size(); i++) {
+      all[i] = i;
+    }
+    BuildNode(entries, all);
+  }
+  DCHECK_EQ(entries.size(), by_asc_left_.size());
 
   // Install the vectors into the object.
-  entries_.swap(entries);
-  unbounded_rowsets_.swap(unbounded);
-  tree_.reset(new IntervalTree<RowSetIntervalTraits>(entries_));
-  key_endpoints_.swap(endpoints);
+  unbounded_rowsets_ = std::move(unbounded);
+  key_endpoints_ = std::move(endpoints);
   all_rowsets_.assign(rowsets.begin(), rowsets.end());
 
   // Build the mapping from DRS ID to DRS.
@@ -187,8 +276,63 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   }
 
   initted_ = true;
+}
 
-  return Status::OK();
+// Select a split point which is the median of all of the interval boundaries,
+// and partition 'subset' into those intervals fully left of the split point,
+// those overlapping it and those fully right of it. See IntervalTree::Partition
+// for an illustration.
+int32_t RowSetTree::BuildNode(const vector<IntervalEntry>& entries,
+                              const vector<int32_t>& subset) {
+  DCHECK(!subset.empty());
+  vector<Slice> endpoints;
+  endpoints.reserve(subset.size() * 2);
+  for (int32_t idx : subset) {
+    endpoints.push_back(entries[idx].min_key);
+    endpoints.push_back(entries[idx].max_key);
+  }
+  auto median = endpoints.begin() + endpoints.size() / 2;
+  std::nth_element(endpoints.begin(), median, endpoints.end(), Slice::Comparator());
+  const Slice split_point = *median;
+
+  vector<int32_t> left;
+  vector<int32_t> right;
+  IntervalNode node;
+  node.split_point = split_point;
+  node.overlap_begin = by_asc_left_.size();
+  for (int32_t idx : subset) {
+    const IntervalEntry& e = entries[idx];
+    if (e.max_key.compare(split_point) < 0) {
+      left.push_back(idx);
+    } else if (e.min_key.compare(split_point) > 0) {
+      right.push_back(idx);
+    } else {
+      by_asc_left_.push_back(e);
+      by_desc_right_.push_back(e);
+    }
+  }
+  node.overlap_end = by_asc_left_.size();
+  DCHECK_LT(node.overlap_begin, node.overlap_end);
+
+  // Stable sorts keep ties in the order the rowsets were provided, so results
+  // are deterministic across rebuilds.
+  std::stable_sort(by_asc_left_.begin() + node.overlap_begin, by_asc_left_.end(),
+                   [](const IntervalEntry& a, const IntervalEntry& b) {
+                     return a.min_key.compare(b.min_key) < 0;
+                   });
+  std::stable_sort(by_desc_right_.begin() + node.overlap_begin, by_desc_right_.end(),
+                   [](const IntervalEntry& a, const IntervalEntry& b) {
+                     return a.max_key.compare(b.max_key) > 0;
+                   });
+
+  // Reserve this node's slot before recursing so that the nodes end up in
+  // pre-order, with each left subtree adjacent to its parent.
+  int32_t node_idx = nodes_.size();
+  nodes_.emplace_back();
+  node.left = left.empty() ? -1 : BuildNode(entries, left);
+  node.right = right.empty() ? -1 : BuildNode(entries, right);
+  nodes_[node_idx] = node;
+  return node_idx;
 }
 
 void RowSetTree::FindRowSetsIntersectingInterval(const boost::optional<Slice>& lower_bound,
@@ -201,12 +345,59 @@ void RowSetTree::FindRowSetsIntersectingInterval(const boost::optional<Slice>& l
     rowsets->push_back(rs.get());
   }
 
-  vector<RowSetWithBounds *> from_tree;
-  from_tree.reserve(all_rowsets_.size());
-  tree_->FindIntersectingInterval(lower_bound, upper_bound, &from_tree);
-  rowsets->reserve(rowsets->size() + from_tree.size());
-  for (RowSetWithBounds *rs : from_tree) {
-    rowsets->push_back(rs->rowset);
+  if (!nodes_.empty()) {
+    rowsets->reserve(rowsets->size() + by_asc_left_.size());
+    FindIntersectingInterval(0, lower_bound, upper_bound, rowsets);
+  }
+}
+
+void RowSetTree::FindIntersectingInterval(int32_t node_idx,
+                                          const boost::optional<Slice>& lower_bound,
+                                          const boost::optional<Slice>& upper_bound,
+                                          vector<RowSet*>* rowsets) const {
+  const IntervalNode& node = nodes_[node_idx];
+  if (upper_bound && upper_bound->compare(node.split_point) <= 0) {
+    // The query interval is fully left of the split point, so it may not
+    // overlap with any interval in the right subtree.
+    if (node.left != -1) {
+      FindIntersectingInterval(node.left, lower_bound, upper_bound, rowsets);
+    }
+
+    // Any interval whose left edge is < the query interval's right edge
+    // intersects the query interval.
+    for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+      const IntervalEntry& e = by_asc_left_[i];
+      if (e.min_key.compare(*upper_bound) >= 0) break;
+      rowsets->push_back(e.rowset);
+    }
+  } else if (lower_bound && lower_bound->compare(node.split_point) > 0) {
+    // The query interval is fully right of the split point, so it may not
+    // overlap with any interval in the left subtree.
+    if (node.right != -1) {
+      FindIntersectingInterval(node.right, lower_bound, upper_bound, rowsets);
+    }
+
+    // Any interval whose right edge is >= the query interval's left edge
+    // intersects the query interval.
+    for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+      const IntervalEntry& e = by_desc_right_[i];
+      if (e.max_key.compare(*lower_bound) < 0) break;
+      rowsets->push_back(e.rowset);
+    }
+  } else {
+    // The query interval contains the split point. Therefore all intervals
+    // which also contain the split point are intersecting.
+    for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+      rowsets->push_back(by_asc_left_[i].rowset);
+    }
+
+    // The query interval may _also_ intersect some in either subtree.
+    if (node.left != -1) {
+      FindIntersectingInterval(node.left, lower_bound, upper_bound, rowsets);
+    }
+    if (node.right != -1) {
+      FindIntersectingInterval(node.right, lower_bound, upper_bound, rowsets);
+    }
   }
 }
 
@@ -221,12 +412,47 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
 
   // Query the interval tree to efficiently find rowsets with known bounds
   // whose ranges overlap the probe key.
-  vector<RowSetWithBounds *> from_tree;
-  from_tree.reserve(all_rowsets_.size());
-  tree_->FindContainingPoint(encoded_key, &from_tree);
-  rowsets->reserve(rowsets->size() + from_tree.size());
-  for (RowSetWithBounds *rs : from_tree) {
-    rowsets->push_back(rs->rowset);
+  if (!nodes_.empty()) {
+    FindContainingPoint(0, encoded_key, rowsets);
+  }
+}
+
+void RowSetTree::FindContainingPoint(int32_t node_idx, const Slice& key,
+                                     vector<RowSet*>* rowsets) const {
+  const IntervalNode& node = nodes_[node_idx];
+  int cmp = key.compare(node.split_point);
+  if (cmp < 0) {
+    // None of the intervals in the right subtree may contain the key.
+    if (node.left != -1) {
+      FindContainingPoint(node.left, key, rowsets);
+    }
+
+    // Any intervals which start before the key and overlap the split point
+    // must therefore contain the key.
+    for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+      const IntervalEntry& e = by_asc_left_[i];
+      if (e.min_key.compare(key) > 0) break;
+      rowsets->push_back(e.rowset);
+    }
+  } else if (cmp > 0) {
+    // None of the intervals in the left subtree may contain the key.
+    if (node.right != -1) {
+      FindContainingPoint(node.right, key, rowsets);
+    }
+
+    // Any intervals which end after the key and overlap the split point
+    // must therefore contain the key.
+    for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+      const IntervalEntry& e = by_desc_right_[i];
+      if (e.max_key.compare(key) < 0) break;
+      rowsets->push_back(e.rowset);
+    }
+  } else {
+    // The key is exactly the split point: every interval overlapping the
+    // split point contains it.
+    for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+      rowsets->push_back(by_asc_left_[i].rowset);
+    }
   }
 }
 
@@ -243,26 +469,86 @@ void RowSetTree::ForEachRowSetContainingKeys(
     }
   }
 
-  // The interval tree batch query callback would naturally just give us back
-  // the matching Slices, but that won't allow us to easily tell the caller
-  // which specific operation _index_ matched the RowSet. So, we make a vector
-  // of QueryStructs to pair the Slice with its original index.
+  if (nodes_.empty()) {
+    return;
+  }
+
+  // The batch query would naturally just give us back the matching Slices,
+  // but that won't allow us to easily tell the caller which specific
+  // operation _index_ matched the RowSet. So, we make a vector of
+  // QueryStructs to pair the Slice with its original index.
   vector<QueryStruct> queries;
   queries.resize(encoded_keys.size());
   for (int i = 0; i < encoded_keys.size(); i++) {
     queries[i] = {encoded_keys[i], i};
   }
 
-  tree_->ForEachIntervalContainingPoints(
-      queries,
-      [&](const QueryStruct& qs, RowSetWithBounds* rs) {
-        cb(rs->rowset, qs.idx);
+  ForEachIntervalContainingKeys(
+      0, queries.cbegin(), queries.cend(),
+      [&](const QueryStruct& qs, RowSet* rs) {
+        cb(rs, qs.idx);
       });
 }
 
+template<class ItType, class Callback>
+void RowSetTree::ForEachIntervalContainingKeys(int32_t node_idx,
+                                               ItType begin_keys,
+                                               ItType end_keys,
+                                               const Callback& cb) const {
+  if (begin_keys == end_keys) return;
+  const IntervalNode& node = nodes_[node_idx];
+
+  // Partition the keys into those less than the split point and those greater
+  // than or equal to it. The keys are sorted, so a binary search suffices.
+  auto partition_point = std::partition_point(
+      begin_keys, end_keys,
+      [&](const QueryStruct& q) { return q.slice.compare(node.split_point) < 0; });
+
+  // Keys left of the split point may be contained in the left subtree.
+  if (node.left != -1) {
+    ForEachIntervalContainingKeys(node.left, begin_keys, partition_point, cb);
+  }
+
+  // Handle the keys < split point: each of them which is >= the min key of an
+  // overlapping interval is contained in it. Since the intervals are sorted by
+  // ascending min key, the search for the next interval can start at the first
+  // match of the current one.
+  auto rem_keys = begin_keys;
+  for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+    const IntervalEntry& e = by_asc_left_[i];
+    auto first_match = std::partition_point(
+        rem_keys, partition_point,
+        [&](const QueryStruct& q) { return q.slice.compare(e.min_key) < 0; });
+    for (auto it = first_match; it != partition_point; ++it) {
+      cb(*it, e.rowset);
+    }
+    rem_keys = first_match;
+  }
+
+  // Handle the keys >= split point symmetrically, using the intervals sorted
+  // by descending max key.
+  rem_keys = end_keys;
+  for (uint32_t i = node.overlap_begin; i < node.overlap_end; i++) {
+    const IntervalEntry& e = by_desc_right_[i];
+    auto first_non_match = std::partition_point(
+        partition_point, rem_keys,
+        [&](const QueryStruct& q) { return q.slice.compare(e.max_key) <= 0; });
+    for (auto it = partition_point; it != first_non_match; ++it) {
+      cb(*it, e.rowset);
+    }
+    rem_keys = first_non_match;
+  }
+
+  if (node.right != -1) {
+    while (partition_point != end_keys &&
+           partition_point->slice.compare(node.split_point) == 0) {
+      ++partition_point;
+    }
+    ForEachIntervalContainingKeys(node.right, partition_point, end_keys, cb);
+  }
+}
 
 RowSetTree::~RowSetTree() {
-  STLDeleteElements(&entries_);
 }
 
 } // namespace tablet
@@ -139,6 +139,16 @@ DEFINE_int32(tablet_history_max_age_sec, 60 * 60 * 24 * 7,
 TAG_FLAG(tablet_history_max_age_sec, advanced);
 TAG_FLAG(tablet_history_max_age_sec, stable);
 
+DEFINE_int32(tablet_cold_rowset_secs, 60 * 60 * 24,
+             "Rowsets which haven't been scanned in this many seconds are "
+             "considered cold. When all the inputs of a compaction are cold, "
+             "its output is placed on the slow storage tier, if data "
+             "directories are tiered (see --fs_data_dirs_fast_tier). Otherwise, "
+             "like flushes, it is placed on the fast tier. 0 disables moving "
+             "cold rowsets to the slow tier.");
+TAG_FLAG(tablet_cold_rowset_secs, advanced);
+TAG_FLAG(tablet_cold_rowset_secs, experimental);
+
 // Large encoded keys cause problems because we store the min/max encoded key in the
 // CFile footer for the composite key column. The footer has a max length of 64K, so
 // the default here comfortably fits two of them with room for other metadata.
@@ -201,6 +211,18 @@ static CompactionPolicy *CreateCompactionPolicy() {
   return new BudgetedCompactionPolicy(FLAGS_tablet_compaction_budget_mb);
 }
 
+// Returns the most recent time any of the compaction's input rowsets was read.
+static MonoTime LastReadTimeOfInput(const RowSetsInCompaction& input) {
+  if (input.rowsets().empty()) {
+    return MonoTime::Now();
+  }
+  MonoTime last_read = down_cast<DiskRowSet*>(input.rowsets().front().get())->last_read_time();
+  for (const auto& rs : input.rowsets()) {
+    last_read = std::max(last_read, down_cast<DiskRowSet*>(rs.get())->last_read_time());
+  }
+  return last_read;
+}
+
 ////////////////////////////////////////////////////////////
 // TabletComponents
 ////////////////////////////////////////////////////////////
@@ -1011,36 +1033,7 @@ void Tablet::ModifyRowSetTree(const RowSetTree& old_tree,
                               const RowSetVector& rowsets_to_remove,
                               const RowSetVector& rowsets_to_add,
                               RowSetTree* new_tree) {
-  RowSetVector post_swap;
-
-  // O(n^2) diff algorithm to collect the set of rowsets excluding
-  // the rowsets that were included in the compaction
-  int num_removed = 0;
-
-  for (const shared_ptr<RowSet> &rs : old_tree.all_rowsets()) {
-    // Determine if it should be removed
-    bool should_remove = false;
-    for (const shared_ptr<RowSet> &to_remove : rowsets_to_remove) {
-      if (to_remove == rs) {
-        should_remove = true;
-        num_removed++;
-        break;
-      }
-    }
-    if (!should_remove) {
-      post_swap.push_back(rs);
-    }
-  }
-
-  CHECK_EQ(num_removed, rowsets_to_remove.size());
-
-  // Then push the new rowsets on the end of the new list
-  std::copy(rowsets_to_add.begin(),
-            rowsets_to_add.end(),
-            std::back_inserter(post_swap));
-
-
-  CHECK_OK(new_tree->Reset(post_swap));
+  CHECK_OK(new_tree->ResetWithSwap(old_tree, rowsets_to_remove, rowsets_to_add));
 }
 
 void Tablet::AtomicSwapRowSets(const RowSetVector &to_remove,
@@ -1528,8 +1521,17 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   shared_ptr<CompactionInput> merge;
   RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &io_context, &merge));
 
+  // Flushed data, and the output of compactions of recently read rowsets, go
+  // on the fast storage tier; the output of compactions of cold rowsets goes
+  // on the slow tier, and stays cold.
+  const bool is_flush = mrs_being_flushed != TabletMetadata::kNoMrsFlushed;
+  const MonoTime input_last_read = is_flush ? MonoTime::Now() : LastReadTimeOfInput(input);
+  const bool is_cold = FLAGS_tablet_cold_rowset_secs > 0 &&
+      input_last_read + MonoDelta::FromSeconds(FLAGS_tablet_cold_rowset_secs) < MonoTime::Now();
+
   RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), DefaultBloomSizing(),
                                compaction_policy_->target_rowset_size());
+  drsw.set_storage_tier(is_cold ? fs::StorageTier::SLOW : fs::StorageTier::FAST);
   RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
 
   HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
@@ -1573,6 +1575,9 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                                  << meta->ToString() << ": " << s.ToString();
         return s;
       }
+      if (!is_flush) {
+        new_rowset->set_last_read_time(input_last_read);
+      }
       new_disk_rowsets.push_back(new_rowset);
     }
   }
@@ -173,6 +173,9 @@ vector<BlockIdPB> TabletMetadata::CollectBlockIdPBs(const TabletSuperBlockPB& su
     for (const ColumnDataPB& column : rowset.columns()) {
       block_ids.push_back(column.block());
     }
+    for (const ColumnAuxDataPB& aux_file : rowset.column_aux_files()) {
+      block_ids.push_back(aux_file.block());
+    }
     for (const DeltaDataPB& redo : rowset.redo_deltas()) {
       block_ids.push_back(redo.block());
     }
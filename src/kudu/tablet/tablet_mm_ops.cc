@@ -26,6 +26,7 @@
 #include <glog/logging.h>
 
 #include "kudu/common/common.pb.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/rowset.h"
@@ -156,6 +157,7 @@ bool CompactRowSetsOp::Prepare() {
 }
 
 void CompactRowSetsOp::Perform() {
+  fs::ScopedIOClass io_class(fs::IOClass::COMPACTION);
   WARN_NOT_OK(tablet_->Compact(Tablet::COMPACT_NO_FLAGS),
               Substitute("$0Compaction failed on $1",
                          LogPrefix(), tablet_->tablet_id()));
@@ -234,6 +236,7 @@ bool MinorDeltaCompactionOp::Prepare() {
 }
 
 void MinorDeltaCompactionOp::Perform() {
+  fs::ScopedIOClass io_class(fs::IOClass::COMPACTION);
   WARN_NOT_OK(tablet_->CompactWorstDeltas(RowSet::MINOR_DELTA_COMPACTION),
               Substitute("$0Minor delta compaction failed on $1",
                          LogPrefix(), tablet_->tablet_id()));
@@ -317,6 +320,7 @@ bool MajorDeltaCompactionOp::Prepare() {
 }
 
 void MajorDeltaCompactionOp::Perform() {
+  fs::ScopedIOClass io_class(fs::IOClass::COMPACTION);
   WARN_NOT_OK(tablet_->CompactWorstDeltas(RowSet::MAJOR_DELTA_COMPACTION),
               Substitute("$0Major delta compaction failed on $1",
                          LogPrefix(), tablet_->tablet_id()));
@@ -360,6 +364,7 @@ bool UndoDeltaBlockGCOp::Prepare() {
 }
 
 void UndoDeltaBlockGCOp::Perform() {
+  fs::ScopedIOClass io_class(fs::IOClass::COMPACTION);
   MonoDelta time_budget = MonoDelta::FromMilliseconds(FLAGS_undo_delta_block_gc_init_budget_millis);
   int64_t bytes_in_ancient_undos = 0;
   Status s = tablet_->InitAncientUndoDeltas(time_budget, &bytes_in_ancient_undos);
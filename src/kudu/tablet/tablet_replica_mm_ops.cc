@@ -28,6 +28,7 @@
 #include <glog/logging.h>
 
 #include "kudu/common/common.pb.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -193,6 +194,7 @@ bool FlushMRSOp::Prepare() {
 }
 
 void FlushMRSOp::Perform() {
+  fs::ScopedIOClass io_class(fs::IOClass::FLUSH);
   Tablet* tablet = tablet_replica_->tablet();
   CHECK(!tablet->rowsets_flush_sem_.try_lock());
   SCOPED_CLEANUP({
@@ -254,6 +256,7 @@ void FlushDeltaMemStoresOp::UpdateStats(MaintenanceOpStats* stats) {
 }
 
 void FlushDeltaMemStoresOp::Perform() {
+  fs::ScopedIOClass io_class(fs::IOClass::FLUSH);
   map<int64_t, int64_t> max_idx_to_replay_size;
   if (!tablet_replica_->GetReplaySizeMap(&max_idx_to_replay_size).ok()) {
     LOG(WARNING) << "Won't flush deltas since tablet shutting down: "
@@ -799,6 +799,17 @@ Status List(const RunnerContext& /*context*/) {
         RETURN_NOT_OK(AddBlockInfoRow(&table, group, fields, &fs_manager, tablet,
                                       rowset, "adhoc-index", boost::none,
                                       rowset.adhoc_index_block()));
+        for (const auto& aux_blocks : rowset.GetAllColumnAuxBlocks()) {
+          // e.g. SECONDARY_INDEX_FILE is listed as "secondary-index-file".
+          string block_kind = ColumnAuxFileType_Name(aux_blocks.first);
+          ToLowerCase(&block_kind);
+          std::replace(block_kind.begin(), block_kind.end(), '_', '-');
+          for (const auto& aux_block : aux_blocks.second) {
+            RETURN_NOT_OK(AddBlockInfoRow(&table, group, fields, &fs_manager, tablet,
+                                          rowset, block_kind.c_str(), aux_block.first,
+                                          aux_block.second));
+          }
+        }
 
       }
     }
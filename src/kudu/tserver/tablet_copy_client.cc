@@ -41,6 +41,7 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
@@ -557,6 +558,7 @@ int TabletCopyClient::CountRemoteBlocks() const {
   int num_blocks = 0;
   for (const RowSetDataPB& rowset : remote_superblock_->rowsets()) {
     num_blocks += rowset.columns_size();
+    num_blocks += rowset.column_aux_files_size();
     num_blocks += rowset.redo_deltas_size();
     num_blocks += rowset.undo_deltas_size();
     if (rowset.has_bloom_block()) {
@@ -571,6 +573,7 @@ int TabletCopyClient::CountRemoteBlocks() const {
 
 Status TabletCopyClient::DownloadBlocks() {
   CHECK_EQ(kStarted, state_);
+  fs::ScopedIOClass io_class(fs::IOClass::COPY);
 
   // Count up the total number of blocks to download.
   int num_remote_blocks = CountRemoteBlocks();
@@ -588,6 +591,7 @@ Status TabletCopyClient::DownloadBlocks() {
     // TODO(mpercy): This is pretty fragile. Consider building a class
     // structure on top of SuperBlockPB to abstract copying details.
     dst_rowset->clear_columns();
+    dst_rowset->clear_column_aux_files();
     dst_rowset->clear_redo_deltas();
     dst_rowset->clear_undo_deltas();
     dst_rowset->clear_bloom_block();
@@ -604,6 +608,14 @@ Status TabletCopyClient::DownloadBlocks() {
       *dst_col = src_col;
       *dst_col->mutable_block() = new_block_id;
     }
+    for (const ColumnAuxDataPB& src_aux : src_rowset.column_aux_files()) {
+      BlockIdPB new_block_id;
+      RETURN_NOT_OK(DownloadAndRewriteBlock(src_aux.block(), num_remote_blocks,
+                                            &block_count, &new_block_id));
+      ColumnAuxDataPB* dst_aux = dst_rowset->add_column_aux_files();
+      *dst_aux = src_aux;
+      *dst_aux->mutable_block() = new_block_id;
+    }
     for (const DeltaDataPB& src_redo : src_rowset.redo_deltas()) {
       BlockIdPB new_block_id;
       RETURN_NOT_OK(DownloadAndRewriteBlock(src_redo.block(), num_remote_blocks,
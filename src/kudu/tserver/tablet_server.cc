@@ -95,6 +95,7 @@ Status TabletServer::Init() {
   }
 
   RETURN_NOT_OK(KuduServer::Init());
+  cfile::BlockCache::GetSingleton()->OpenSsdTier(fs_manager_->uuid());
   if (web_server_) {
     RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
   }
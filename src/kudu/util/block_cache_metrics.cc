@@ -17,6 +17,10 @@
 
 #include "kudu/util/block_cache_metrics.h"
 
+#include <cstdint>
+
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/bind_helpers.h"
 #include "kudu/util/metrics.h"
 
 METRIC_DEFINE_counter(server, block_cache_inserts,
@@ -57,6 +61,125 @@ METRIC_DEFINE_gauge_uint64(server, block_cache_usage, "Block Cache Memory Usage"
                            "Memory consumed by the block cache",
                            kudu::MetricLevel::kInfo);
 
+METRIC_DEFINE_gauge_double(server, block_cache_hit_ratio, "Block Cache Hit Ratio",
+                           kudu::MetricUnit::kUnits,
+                           "Fraction of the lookups expecting a block that found one, "
+                           "since the server started",
+                           kudu::MetricLevel::kInfo);
+
+METRIC_DEFINE_counter(server, block_cache_decoded_inserts,
+                      "Block Cache Decoded Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of decoded data blocks inserted in the block cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_decoded_lookups,
+                      "Block Cache Decoded Lookups", kudu::MetricUnit::kBlocks,
+                      "Number of decoded data blocks looked up from the block cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_decoded_evictions,
+                      "Block Cache Decoded Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of decoded data blocks evicted from the block cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_decoded_misses,
+                      "Block Cache Decoded Misses", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of decoded data blocks that didn't yield a block",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_decoded_misses_caching,
+                      "Block Cache Decoded Misses (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of decoded data blocks that were expecting a block "
+                      "that didn't yield one",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_decoded_hits,
+                      "Block Cache Decoded Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of decoded data blocks that found a block",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_decoded_hits_caching,
+                      "Block Cache Decoded Hits (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of decoded data blocks that were expecting a block "
+                      "that found one",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_gauge_uint64(server, block_cache_decoded_usage,
+                           "Block Cache Decoded Memory Usage", kudu::MetricUnit::kBytes,
+                           "Memory consumed by the decoded data blocks of the block cache",
+                           kudu::MetricLevel::kInfo);
+
+// High-priority blocks are the B-tree index, bloom filter and dictionary
+// blocks of CFiles; normal-priority blocks are all other blocks.
+METRIC_DEFINE_counter(server, block_cache_high_priority_inserts,
+                      "Block Cache High-Priority Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of high-priority blocks inserted in the cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_high_priority_evictions,
+                      "Block Cache High-Priority Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of high-priority blocks evicted from the cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_high_priority_hits_caching,
+                      "Block Cache High-Priority Hits (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of high-priority blocks that were expecting a block "
+                      "that found one",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_high_priority_misses_caching,
+                      "Block Cache High-Priority Misses (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of high-priority blocks that were expecting a block "
+                      "that didn't yield one",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_gauge_uint64(server, block_cache_high_priority_usage,
+                           "Block Cache High-Priority Usage", kudu::MetricUnit::kBytes,
+                           "Total size of the high-priority blocks in the block cache",
+                           kudu::MetricLevel::kInfo);
+
+METRIC_DEFINE_counter(server, block_cache_normal_priority_inserts,
+                      "Block Cache Normal-Priority Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of normal-priority blocks inserted in the cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_normal_priority_evictions,
+                      "Block Cache Normal-Priority Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of normal-priority blocks evicted from the cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_normal_priority_hits_caching,
+                      "Block Cache Normal-Priority Hits (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of normal-priority blocks that were expecting a block "
+                      "that found one",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_normal_priority_misses_caching,
+                      "Block Cache Normal-Priority Misses (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of lookups of normal-priority blocks that were expecting a block "
+                      "that didn't yield one",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_gauge_uint64(server, block_cache_normal_priority_usage,
+                           "Block Cache Normal-Priority Usage", kudu::MetricUnit::kBytes,
+                           "Total size of the normal-priority blocks in the block cache",
+                           kudu::MetricLevel::kInfo);
+
+METRIC_DEFINE_counter(server, block_cache_ssd_inserts,
+                      "Block Cache SSD Tier Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from memory which were written to the "
+                      "SSD tier of the block cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_ssd_dropped_inserts,
+                      "Block Cache SSD Tier Dropped Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from memory which couldn't be written to "
+                      "the SSD tier of the block cache, because too many writes were "
+                      "outstanding or a write failed",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_ssd_evictions,
+                      "Block Cache SSD Tier Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from the SSD tier of the block cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_ssd_hits,
+                      "Block Cache SSD Tier Hits", kudu::MetricUnit::kBlocks,
+                      "Number of blocks missing from memory which were read back from "
+                      "the SSD tier of the block cache",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_counter(server, block_cache_ssd_misses,
+                      "Block Cache SSD Tier Misses", kudu::MetricUnit::kBlocks,
+                      "Number of blocks missing from memory which weren't found in the "
+                      "SSD tier of the block cache either",
+                      kudu::MetricLevel::kDebug);
+METRIC_DEFINE_gauge_uint64(server, block_cache_ssd_usage,
+                           "Block Cache SSD Tier Usage", kudu::MetricUnit::kBytes,
+                           "Total size of the blocks in the SSD tier of the block cache",
+                           kudu::MetricLevel::kInfo);
+
 namespace kudu {
 
 #define MINIT(member, x) member = METRIC_##x.Instantiate(entity)
@@ -70,6 +193,52 @@ BlockCacheMetrics::BlockCacheMetrics(const scoped_refptr<MetricEntity>& entity)
   MINIT(cache_misses, block_cache_misses);
   MINIT(cache_misses_caching, block_cache_misses_caching);
   GINIT(cache_usage, block_cache_usage);
+  METRIC_block_cache_hit_ratio.InstantiateFunctionGauge(
+      entity, Bind(&BlockCacheMetrics::HitRatio, Unretained(this)))
+      ->AutoDetach(&metric_detacher_);
+}
+
+double BlockCacheMetrics::HitRatio() const {
+  int64_t hits = cache_hits_caching->value();
+  int64_t lookups = hits + cache_misses_caching->value();
+  return lookups == 0 ? 0 : static_cast<double>(hits) / lookups;
+}
+
+BlockCacheDecodedMetrics::BlockCacheDecodedMetrics(const scoped_refptr<MetricEntity>& entity) {
+  MINIT(inserts, block_cache_decoded_inserts);
+  MINIT(lookups, block_cache_decoded_lookups);
+  MINIT(evictions, block_cache_decoded_evictions);
+  MINIT(cache_hits, block_cache_decoded_hits);
+  MINIT(cache_hits_caching, block_cache_decoded_hits_caching);
+  MINIT(cache_misses, block_cache_decoded_misses);
+  MINIT(cache_misses_caching, block_cache_decoded_misses_caching);
+  GINIT(cache_usage, block_cache_decoded_usage);
+}
+
+BlockCacheTierMetrics::BlockCacheTierMetrics(const scoped_refptr<MetricEntity>& entity,
+                                             bool high_priority) {
+  if (high_priority) {
+    MINIT(inserts, block_cache_high_priority_inserts);
+    MINIT(evictions, block_cache_high_priority_evictions);
+    MINIT(hits_caching, block_cache_high_priority_hits_caching);
+    MINIT(misses_caching, block_cache_high_priority_misses_caching);
+    GINIT(usage, block_cache_high_priority_usage);
+  } else {
+    MINIT(inserts, block_cache_normal_priority_inserts);
+    MINIT(evictions, block_cache_normal_priority_evictions);
+    MINIT(hits_caching, block_cache_normal_priority_hits_caching);
+    MINIT(misses_caching, block_cache_normal_priority_misses_caching);
+    GINIT(usage, block_cache_normal_priority_usage);
+  }
+}
+
+BlockCacheSsdMetrics::BlockCacheSsdMetrics(const scoped_refptr<MetricEntity>& entity) {
+  MINIT(inserts, block_cache_ssd_inserts);
+  MINIT(dropped_inserts, block_cache_ssd_dropped_inserts);
+  MINIT(evictions, block_cache_ssd_evictions);
+  MINIT(hits, block_cache_ssd_hits);
+  MINIT(misses, block_cache_ssd_misses);
+  GINIT(usage, block_cache_ssd_usage);
 }
 #undef MINIT
 #undef GINIT
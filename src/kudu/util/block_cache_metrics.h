@@ -17,8 +17,12 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/cache_metrics.h"
+#include "kudu/util/file_backed_cache.h"
+#include "kudu/util/metrics.h"
 
 namespace kudu {
 
@@ -26,6 +30,37 @@ class MetricEntity;
 
 struct BlockCacheMetrics : public CacheMetrics {
   explicit BlockCacheMetrics(const scoped_refptr<MetricEntity>& entity);
+
+  // The fraction of lookups expecting a block which found it, or 0 if there
+  // were no such lookups.
+  double HitRatio() const;
+
+ private:
+  FunctionGaugeDetacher metric_detacher_;
+};
+
+// Metrics of the decoded data blocks of the block cache, which are kept in a
+// cache of their own.
+struct BlockCacheDecodedMetrics : public CacheMetrics {
+  explicit BlockCacheDecodedMetrics(const scoped_refptr<MetricEntity>& entity);
+};
+
+// Metrics of the blocks of one priority in the block cache.
+struct BlockCacheTierMetrics {
+  // 'high_priority' selects whether the metrics of high-priority or of
+  // normal-priority blocks are instantiated.
+  BlockCacheTierMetrics(const scoped_refptr<MetricEntity>& entity, bool high_priority);
+
+  scoped_refptr<Counter> inserts;
+  scoped_refptr<Counter> evictions;
+  scoped_refptr<Counter> hits_caching;
+  scoped_refptr<Counter> misses_caching;
+  scoped_refptr<AtomicGauge<uint64_t>> usage;
+};
+
+// Metrics of the second, file-backed tier of the block cache.
+struct BlockCacheSsdMetrics : public FileBackedCacheMetrics {
+  explicit BlockCacheSsdMetrics(const scoped_refptr<MetricEntity>& entity);
 };
 
 } // namespace kudu
@@ -42,6 +42,8 @@
 
 DEFINE_int32(num_threads, 16, "The number of threads to access the cache concurrently.");
 DEFINE_int32(run_seconds, 1, "The number of seconds to run the benchmark");
+DEFINE_int32(max_scaling_threads, 64,
+             "The largest number of threads to run the thread scaling benchmark with.");
 
 using std::atomic;
 using std::pair;
@@ -64,10 +66,16 @@ struct BenchSetup {
     // vast majority of lookups.
     ZIPFIAN,
     // Every item is equally likely to be looked up.
-    UNIFORM
+    UNIFORM,
+    // Zipfian lookups interleaved with a sequential scan over a range of
+    // items several times larger than the cache, each of which is looked up
+    // only once per pass.
+    ZIPFIAN_WITH_SCAN
   };
   Pattern pattern;
 
+  Cache::EvictionPolicy eviction_policy;
+
   // The ratio between the size of the dataset and the cache.
   //
   // A value smaller than 1 will ensure that the whole dataset fits
@@ -79,6 +87,12 @@ struct BenchSetup {
     switch (pattern) {
       case Pattern::ZIPFIAN: ret += "ZIPFIAN"; break;
       case Pattern::UNIFORM: ret += "UNIFORM"; break;
+      case Pattern::ZIPFIAN_WITH_SCAN: ret += "ZIPFIAN_WITH_SCAN"; break;
+    }
+    switch (eviction_policy) {
+      case Cache::EvictionPolicy::LRU: ret += " LRU"; break;
+      case Cache::EvictionPolicy::TINYLFU: ret += " TINYLFU"; break;
+      default: LOG(FATAL) << "unexpected eviction policy";
     }
     ret += StringPrintf(" ratio=%.2fx n_unique=%d", dataset_cache_ratio, max_key());
     return ret;
@@ -95,7 +109,18 @@ class CacheBench : public KuduTest,
  public:
   void SetUp() override {
     KuduTest::SetUp();
-    cache_.reset(NewCache(kCacheCapacity, "test-cache"));
+    switch (GetParam().eviction_policy) {
+      case Cache::EvictionPolicy::LRU:
+        cache_.reset(NewCache<Cache::EvictionPolicy::LRU, Cache::MemoryType::DRAM>(
+            kCacheCapacity, "test-cache"));
+        break;
+      case Cache::EvictionPolicy::TINYLFU:
+        cache_.reset(NewCache<Cache::EvictionPolicy::TINYLFU, Cache::MemoryType::DRAM>(
+            kCacheCapacity, "test-cache"));
+        break;
+      default:
+        FAIL() << "unexpected eviction policy";
+    }
   }
 
   // Run queries against the cache until '*done' becomes true.
@@ -106,11 +131,24 @@ class CacheBench : public KuduTest,
     int64_t lookups = 0;
     int64_t hits = 0;
     while (!*done) {
-      uint32_t int_key;
-      if (setup.pattern == BenchSetup::Pattern::ZIPFIAN) {
-        int_key = r.Skewed(Bits::Log2Floor(setup.max_key()));
-      } else {
-        int_key = r.Uniform(setup.max_key());
+      uint32_t int_key = 0;
+      switch (setup.pattern) {
+        case BenchSetup::Pattern::ZIPFIAN:
+          int_key = r.Skewed(Bits::Log2Floor(setup.max_key()));
+          break;
+        case BenchSetup::Pattern::UNIFORM:
+          int_key = r.Uniform(setup.max_key());
+          break;
+        case BenchSetup::Pattern::ZIPFIAN_WITH_SCAN:
+          // Scanned keys don't overlap with the zipfian ones, and are shared
+          // by all threads, like the blocks of a large table being scanned
+          // concurrently with point lookups.
+          if (r.OneIn(2)) {
+            int_key = r.Skewed(Bits::Log2Floor(setup.max_key()));
+          } else {
+            int_key = setup.max_key() + scan_pos_++ % (kScanCacheRatio * setup.max_key());
+          }
+          break;
       }
       char key_buf[sizeof(int_key)];
       memcpy(key_buf, &int_key, sizeof(int_key));
@@ -151,18 +189,64 @@ class CacheBench : public KuduTest,
   }
 
  protected:
+  // The ratio between the range scanned by ZIPFIAN_WITH_SCAN and the range of
+  // its zipfian lookups.
+  static constexpr int kScanCacheRatio = 4;
+
   unique_ptr<Cache> cache_;
+
+  // Next key to be looked up by the scan of ZIPFIAN_WITH_SCAN.
+  atomic<uint32_t> scan_pos_ { 0 };
 };
 
-// Test both distributions, and for each, test both the case where the data
-// fits in the cache and where it is a bit larger.
+// Test all distributions with both eviction policies, and for each, test both
+// the case where the data fits in the cache and where it is a bit larger.
 INSTANTIATE_TEST_CASE_P(Patterns, CacheBench, testing::ValuesIn(std::vector<BenchSetup>{
-      {BenchSetup::Pattern::ZIPFIAN, 1.0},
-      {BenchSetup::Pattern::ZIPFIAN, 3.0},
-      {BenchSetup::Pattern::UNIFORM, 1.0},
-      {BenchSetup::Pattern::UNIFORM, 3.0}
+      {BenchSetup::Pattern::ZIPFIAN, Cache::EvictionPolicy::LRU, 1.0},
+      {BenchSetup::Pattern::ZIPFIAN, Cache::EvictionPolicy::LRU, 3.0},
+      {BenchSetup::Pattern::UNIFORM, Cache::EvictionPolicy::LRU, 1.0},
+      {BenchSetup::Pattern::UNIFORM, Cache::EvictionPolicy::LRU, 3.0},
+      {BenchSetup::Pattern::ZIPFIAN_WITH_SCAN, Cache::EvictionPolicy::LRU, 1.0},
+      {BenchSetup::Pattern::ZIPFIAN, Cache::EvictionPolicy::TINYLFU, 1.0},
+      {BenchSetup::Pattern::ZIPFIAN, Cache::EvictionPolicy::TINYLFU, 3.0},
+      {BenchSetup::Pattern::UNIFORM, Cache::EvictionPolicy::TINYLFU, 1.0},
+      {BenchSetup::Pattern::UNIFORM, Cache::EvictionPolicy::TINYLFU, 3.0},
+      {BenchSetup::Pattern::ZIPFIAN_WITH_SCAN, Cache::EvictionPolicy::TINYLFU, 1.0}
     }));
 
+// Measure how lookup throughput scales with the number of threads, doubling
+// it each round. Run with a workload where nearly all lookups hit, which only
+// takes shard locks in shared mode, and with one where most lookups miss and
+// are followed by an insert, which takes them exclusively.
+TEST_P(CacheBench, ThreadScaling) {
+  const BenchSetup& setup = GetParam();
+  const bool hit_heavy = setup.pattern == BenchSetup::Pattern::ZIPFIAN &&
+      setup.dataset_cache_ratio <= 1.0;
+  const bool miss_heavy = setup.pattern == BenchSetup::Pattern::UNIFORM &&
+      setup.dataset_cache_ratio > 1.0;
+  if (!hit_heavy && !miss_heavy) {
+    return;
+  }
+  RunQueryThreads(FLAGS_max_scaling_threads, 1);
+
+  int64_t single_thread_l_per_sec = 0;
+  for (int n_threads = 1; n_threads <= FLAGS_max_scaling_threads; n_threads *= 2) {
+    pair<int64_t, int64_t> hits_lookups = RunQueryThreads(n_threads, FLAGS_run_seconds);
+    int64_t l_per_sec = hits_lookups.second / FLAGS_run_seconds;
+    if (n_threads == 1) {
+      single_thread_l_per_sec = l_per_sec;
+    }
+    LOG(INFO) << setup.ToString() << " threads=" << n_threads << ": "
+              << HumanReadableNum::ToString(l_per_sec) << " lookups/sec ("
+              << StringPrintf("%.1fx", static_cast<double>(l_per_sec) /
+                                       single_thread_l_per_sec)
+              << " of one thread, "
+              << StringPrintf("%.1f", static_cast<double>(hits_lookups.first) * 100.0 /
+                                      hits_lookups.second)
+              << "% hit rate)";
+  }
+}
+
 TEST_P(CacheBench, RunBench) {
   const BenchSetup& setup = GetParam();
 
@@ -4,9 +4,11 @@
 
 #include "kudu/util/cache.h"
 
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -26,6 +28,7 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/nvm_cache.h"
+#include "kudu/util/random.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -145,6 +148,15 @@ class CacheBaseTest : public KuduTest,
         }
         MemTracker::FindTracker("cache_test-sharded_lru_cache", &mem_tracker_);
         break;
+      case Cache::EvictionPolicy::TINYLFU:
+        if (mem_type != Cache::MemoryType::DRAM) {
+          FAIL() << "TinyLFU cache can only be of DRAM type";
+        }
+        cache_.reset(NewCache<Cache::EvictionPolicy::TINYLFU,
+                              Cache::MemoryType::DRAM>(cache_size(),
+                                                       "cache_test"));
+        MemTracker::FindTracker("cache_test-sharded_tinylfu_cache", &mem_tracker_);
+        break;
       default:
         FAIL() << "unrecognized cache eviction policy";
         break;
@@ -207,6 +219,12 @@ INSTANTIATE_TEST_CASE_P(
         make_tuple(Cache::MemoryType::DRAM,
                    Cache::EvictionPolicy::LRU,
                    ShardingPolicy::SingleShard),
+        make_tuple(Cache::MemoryType::DRAM,
+                   Cache::EvictionPolicy::TINYLFU,
+                   ShardingPolicy::MultiShard),
+        make_tuple(Cache::MemoryType::DRAM,
+                   Cache::EvictionPolicy::TINYLFU,
+                   ShardingPolicy::SingleShard),
         make_tuple(Cache::MemoryType::NVM,
                    Cache::EvictionPolicy::LRU,
                    ShardingPolicy::MultiShard),
@@ -423,6 +441,53 @@ TEST_P(CacheTest, InvalidateOddKeyEntries) {
   }
 }
 
+// Lookups racing with inserts which replace and evict the entries they find
+// must only see complete entries, and all the entries must be freed once
+// they're erased.
+TEST_P(CacheTest, ConcurrentLookupsAndEvictions) {
+  RETURN_IF_NO_NVM_CACHE(std::get<0>(GetParam()));
+  constexpr int kNumKeys = 1024;
+  constexpr int kNumReaders = 4;
+  // Only a quarter of the keys fit in the cache at a time.
+  const int charge = cache_size() / (kNumKeys / 4);
+
+  std::atomic<bool> done(false);
+  vector<std::thread> readers;
+  for (int i = 0; i < kNumReaders; i++) {
+    readers.emplace_back([&, i]() {
+      Random rng(i);
+      while (!done) {
+        const int key = rng.Uniform(kNumKeys);
+        auto handle(cache_->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE));
+        if (handle) {
+          CHECK_EQ(key, DecodeInt(cache_->Value(handle)) % kNumKeys);
+        }
+      }
+    });
+  }
+  // Insert without an eviction callback: the readers may free entries when
+  // releasing their handles, and EvictedEntry() isn't thread-safe.
+  for (int i = 0; i < 20 * kNumKeys; i++) {
+    const std::string key_str = EncodeInt(i % kNumKeys);
+    const std::string val_str = EncodeInt(i);
+    auto handle(cache_->Allocate(key_str, val_str.size(), charge));
+    ASSERT_TRUE(handle);
+    memcpy(cache_->MutableValue(&handle), val_str.data(), val_str.size());
+    cache_->Insert(std::move(handle), nullptr);
+  }
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+
+  for (int i = 0; i < kNumKeys; i++) {
+    Erase(i);
+  }
+  if (mem_tracker_) {
+    ASSERT_EQ(0, mem_tracker_->consumption());
+  }
+}
+
 // This class is dedicated for scenarios specific for FIFOCache.
 // The scenarios use a single-shard cache for simpler logic.
 class FIFOCacheTest : public CacheBaseTest {
@@ -532,4 +597,90 @@ TEST_P(LRUCacheTest, EvictionPolicy) {
   ASSERT_EQ(-1, Lookup(200));
 }
 
+// This class is dedicated for scenarios specific for the TinyLFU cache.
+// The scenarios use a single-shard cache for simpler logic.
+class TinyLFUCacheTest : public CacheBaseTest {
+ public:
+  TinyLFUCacheTest()
+      : CacheBaseTest(16 * 1024 * 1024) {
+  }
+
+  void SetUp() override {
+    SetupWithParameters(Cache::MemoryType::DRAM,
+                        Cache::EvictionPolicy::TINYLFU,
+                        ShardingPolicy::SingleShard);
+  }
+};
+
+// Verify that a frequently looked up working set survives a scan over many
+// more entries than fit in the cache, each of which is looked up only once.
+TEST_F(TinyLFUCacheTest, ScanResistance) {
+  static constexpr int kNumElems = 1000;
+  static constexpr int kNumHot = 100;
+  const int size_per_elem = cache_size() / kNumElems;
+
+  // Populate the hot working set, looking each entry up a few times.
+  for (int i = 0; i < kNumHot; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+    Insert(i, i, size_per_elem);
+  }
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < kNumHot; i++) {
+      ASSERT_EQ(i, Lookup(i));
+    }
+  }
+
+  // Scan through ten times the capacity of the cache, the way a block cache
+  // would be used by a large scan: each entry is looked up, missed, inserted,
+  // and never used again. Meanwhile, the working set keeps being looked up,
+  // but too rarely for an LRU cache to retain it.
+  for (int i = kNumHot; i < kNumHot + 10 * kNumElems; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+    Insert(i, i, size_per_elem);
+    if (i % 20 == 0) {
+      Lookup((i / 20) % kNumHot);
+    }
+  }
+  ASSERT_FALSE(evicted_keys_.empty());
+
+  // The whole working set is still cached.
+  for (int i = 0; i < kNumHot; i++) {
+    SCOPED_TRACE(Substitute("hot entry $0", i));
+    ASSERT_EQ(i, Lookup(i));
+  }
+
+  // The most recent entry of the scan also made it into the cache: entries
+  // first go into a window which is not subject to the admission policy.
+  ASSERT_EQ(kNumHot + 10 * kNumElems - 1, Lookup(kNumHot + 10 * kNumElems - 1));
+}
+
+// Verify that entries which become frequently used displace the entries
+// which are no longer used.
+TEST_F(TinyLFUCacheTest, AdmitsFrequentEntries) {
+  static constexpr int kNumElems = 1000;
+  const int size_per_elem = cache_size() / kNumElems;
+
+  // Fill the cache with entries which are looked up once.
+  for (int i = 0; i < 2 * kNumElems; i++) {
+    Lookup(i);
+    Insert(i, i, size_per_elem);
+  }
+
+  // A new working set is looked up repeatedly; every lookup miss is followed
+  // by an insertion. Eventually all of it is cached.
+  static constexpr int kFirstNew = 10 * kNumElems;
+  static constexpr int kNumNew = kNumElems / 2;
+  for (int round = 0; round < 5; round++) {
+    for (int i = kFirstNew; i < kFirstNew + kNumNew; i++) {
+      if (Lookup(i) == -1) {
+        Insert(i, i, size_per_elem);
+      }
+    }
+  }
+  for (int i = kFirstNew; i < kFirstNew + kNumNew; i++) {
+    SCOPED_TRACE(Substitute("new entry $0", i));
+    ASSERT_EQ(i, Lookup(i));
+  }
+}
+
 }  // namespace kudu
@@ -4,9 +4,13 @@
 
 #include "kudu/util/cache.h"
 
+#include <sched.h>
+
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <ostream>
@@ -40,6 +44,24 @@ DEFINE_bool(cache_force_single_shard, false,
             "Override all cache implementations to use just one shard");
 TAG_FLAG(cache_force_single_shard, hidden);
 
+DEFINE_int32(cache_num_shards, 0,
+             "Number of shards of each cache, rounded up to a power of two. "
+             "More shards reduce contention between concurrent inserts, at the "
+             "cost of less accurate eviction, since each shard evicts entries "
+             "independently. If 0, the number of CPUs is used.");
+TAG_FLAG(cache_num_shards, advanced);
+TAG_FLAG(cache_num_shards, experimental);
+
+static bool ValidateCacheNumShards(const char* flagname, int32_t value) {
+  if (value < 0 || value > 4096) {
+    LOG(ERROR) << flagname << " must be between 0 and 4096, value " << value
+               << " is invalid";
+    return false;
+  }
+  return true;
+}
+DEFINE_validator(cache_num_shards, &ValidateCacheNumShards);
+
 DEFINE_double(cache_memtracker_approximation_ratio, 0.01,
               "The MemTracker associated with a cache can accumulate error up to "
               "this ratio to improve performance. For tests.");
@@ -75,7 +97,7 @@ namespace {
 // criterion (e.g., access time for LRU policy, insertion time for FIFO policy).
 struct RLHandle {
   Cache::EvictionCallback* eviction_callback;
-  RLHandle* next_hash;
+  std::atomic<RLHandle*> next_hash;
   RLHandle* next;
   RLHandle* prev;
   size_t charge;      // TODO(opt): Only allow uint32_t?
@@ -83,6 +105,9 @@ struct RLHandle {
   uint32_t val_length;
   std::atomic<int32_t> refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  uint8_t list;       // The RecencyList the entry is on
+  // Whether an LRU entry was looked up since it was last appended to its list.
+  std::atomic<bool> referenced;
 
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
@@ -106,6 +131,132 @@ struct RLHandle {
   }
 };
 
+// The recency lists of a cache shard.
+//
+// FIFO and LRU shards keep all their entries on the main list. TinyLFU shards
+// keep newly inserted entries on a small window list, and the rest on a
+// segmented LRU: entries enter the main list on probation, and are promoted
+// to the protected list once accessed there. The lists are ordered from the
+// least to the most valuable.
+enum RecencyList : uint8_t {
+  kMainList = 0,
+  kWindowList,
+  kProtectedList,
+  kNumRecencyLists
+};
+
+// Percentage of a TinyLFU shard's capacity taken up by the window list.
+constexpr int kTinyLFUWindowPercent = 1;
+
+// Percentage of the rest of a TinyLFU shard's capacity which protected entries
+// may take up.
+constexpr int kTinyLFUProtectedPercent = 80;
+
+// Multipliers used to derive the frequency sketch's per-row hashes.
+constexpr uint64_t kSketchSeeds[] = {
+  0xc3a5c85c97cb3127ULL,
+  0xb492b66fbe98f273ULL,
+  0x9ae16a3b2f90404fULL,
+  0xcbf29ce484222325ULL,
+};
+
+// Number of rows of the frequency sketch.
+constexpr int kSketchDepth = arraysize(kSketchSeeds);
+
+// Maximum value of a frequency sketch counter.
+constexpr uint8_t kSketchMaxCount = 15;
+
+// Minimum number of distinct keys a frequency sketch is sized for.
+constexpr size_t kSketchMinKeys = 16;
+
+// The frequency sketch of a TinyLFU shard is initially sized for as many
+// entries of this charge as fit in the shard. It grows if more entries do.
+constexpr size_t kSketchNominalCharge = 16 * 1024;
+
+// Estimates how often each key has been looked up recently, to decide whether
+// TinyLFU caches should admit an entry in place of another one.
+//
+// This is a count-min sketch of small saturating counters, with four counters
+// per row for each key it is sized for, using conservative updates. Once the
+// number of increments reaches ten times that number of keys, all counters
+// are halved, so that the estimates keep reflecting recent history.
+class FrequencySketch {
+ public:
+  FrequencySketch()
+      : num_keys_(kSketchMinKeys),
+        log_width_(Bits::Log2Ceiling64(4 * kSketchMinKeys)),
+        counters_(kSketchDepth << log_width_),
+        num_increments_(0) {
+  }
+
+  // Make sure the sketch is sized for at least 'num_keys' distinct keys.
+  void EnsureCapacity(size_t num_keys) {
+    while (num_keys > num_keys_) {
+      Grow();
+    }
+  }
+
+  void Increment(uint32_t hash) {
+    // Only increment the counters holding the current estimate: the others
+    // have already been inflated by collisions.
+    const uint8_t estimate = Estimate(hash);
+    if (estimate == kSketchMaxCount) {
+      return;
+    }
+    for (int row = 0; row < kSketchDepth; row++) {
+      uint8_t* counter = &counters_[Index(hash, row)];
+      if (*counter == estimate) {
+        ++*counter;
+      }
+    }
+    if (++num_increments_ >= 10 * num_keys_) {
+      Age();
+    }
+  }
+
+  uint8_t Estimate(uint32_t hash) const {
+    uint8_t count = kSketchMaxCount;
+    for (int row = 0; row < kSketchDepth; row++) {
+      count = std::min(count, counters_[Index(hash, row)]);
+    }
+    return count;
+  }
+
+ private:
+  size_t Index(uint32_t hash, int row) const {
+    return (static_cast<size_t>(row) << log_width_) +
+        ((static_cast<uint64_t>(hash) * kSketchSeeds[row]) >> (64 - log_width_));
+  }
+
+  // Double the width of the sketch. The counter at index i of a row is
+  // split into the counters at 2i and 2i+1, which are the indexes the keys
+  // that mapped to it map to now, so no estimate decreases.
+  void Grow() {
+    vector<uint8_t> counters(counters_.size() * 2);
+    for (size_t i = 0; i < counters_.size(); i++) {
+      // Index 'i' is at offset i % width of row i / width, which maps to
+      // offset 2 * (i % width) of the same row in the doubled sketch.
+      counters[2 * i] = counters_[i];
+      counters[2 * i + 1] = counters_[i];
+    }
+    counters_.swap(counters);
+    num_keys_ *= 2;
+    log_width_++;
+  }
+
+  void Age() {
+    for (auto& c : counters_) {
+      c >>= 1;
+    }
+    num_increments_ /= 2;
+  }
+
+  size_t num_keys_;
+  int log_width_;
+  vector<uint8_t> counters_;
+  size_t num_increments_;
+};
+
 // We provide our own simple hash table since it removes a whole bunch
 // of porting hacks and is also faster than some of the built-in hash
 // table implementations in some of the compiler/runtime combinations
@@ -113,21 +264,42 @@ struct RLHandle {
 // 4.4.3's builtin hashtable.
 class HandleTable {
  public:
-  HandleTable() : length_(0), elems_(0), list_(nullptr) { Resize(); }
-  ~HandleTable() { delete[] list_; }
-
-  RLHandle* Lookup(const Slice& key, uint32_t hash) {
-    return *FindPointer(key, hash);
+  HandleTable() : elems_(0), resizes_(0), buckets_(nullptr) { Resize(); }
+
+  uint32_t size() const { return elems_; }
+
+  // Unlike the other methods, this may run concurrently with mutations of
+  // the table, as long as the entries it may be reading aren't freed under
+  // it. An entry which is being moved to another bucket by a concurrent
+  // resize may be missed, in which case the lookup is retried.
+  RLHandle* Lookup(const Slice& key, uint32_t hash) const {
+    while (true) {
+      const uint32_t resizes = resizes_.load(std::memory_order_acquire);
+      const Buckets* buckets = buckets_.load(std::memory_order_acquire);
+      RLHandle* h = buckets->heads[hash & (buckets->length - 1)].load(
+          std::memory_order_acquire);
+      while (h != nullptr && (h->hash != hash || key != h->key())) {
+        h = h->next_hash.load(std::memory_order_acquire);
+      }
+      if (h != nullptr) {
+        return h;
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (resizes % 2 == 0 && resizes_.load(std::memory_order_relaxed) == resizes) {
+        return nullptr;
+      }
+    }
   }
 
   RLHandle* Insert(RLHandle* h) {
-    RLHandle** ptr = FindPointer(h->key(), h->hash);
-    RLHandle* old = *ptr;
-    h->next_hash = (old == nullptr ? nullptr : old->next_hash);
-    *ptr = h;
+    std::atomic<RLHandle*>* ptr = FindPointer(h->key(), h->hash);
+    RLHandle* old = ptr->load(std::memory_order_relaxed);
+    h->next_hash.store(old == nullptr ? nullptr : old->next_hash.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    ptr->store(h, std::memory_order_release);
     if (old == nullptr) {
       ++elems_;
-      if (elems_ > length_) {
+      if (elems_ > buckets_.load(std::memory_order_relaxed)->length) {
         // Since each cache entry is fairly large, we aim for a small
         // average linked list length (<= 1).
         Resize();
@@ -136,31 +308,56 @@ class HandleTable {
     return old;
   }
 
+  // The removed entry keeps pointing to the next one in its bucket, so that
+  // concurrent lookups which are reading it can go on.
   RLHandle* Remove(const Slice& key, uint32_t hash) {
-    RLHandle** ptr = FindPointer(key, hash);
-    RLHandle* result = *ptr;
+    std::atomic<RLHandle*>* ptr = FindPointer(key, hash);
+    RLHandle* result = ptr->load(std::memory_order_relaxed);
     if (result != nullptr) {
-      *ptr = result->next_hash;
+      ptr->store(result->next_hash.load(std::memory_order_relaxed), std::memory_order_release);
       --elems_;
     }
     return result;
   }
 
  private:
-  // The table consists of an array of buckets where each bucket is
-  // a linked list of cache entries that hash into the bucket.
-  uint32_t length_;
+  // An array of buckets where each bucket is a linked list of cache entries
+  // that hash into the bucket.
+  struct Buckets {
+    explicit Buckets(uint32_t length)
+        : length(length),
+          heads(new std::atomic<RLHandle*>[length]()) {
+    }
+
+    const uint32_t length;
+    const unique_ptr<std::atomic<RLHandle*>[]> heads;
+  };
+
   uint32_t elems_;
-  RLHandle** list_;
+
+  // Incremented before and after each resize, so that lookups can tell
+  // whether one ran concurrently.
+  std::atomic<uint32_t> resizes_;
+
+  // The current bucket array.
+  std::atomic<Buckets*> buckets_;
+
+  // All the bucket arrays of the table, including the current one. Lookups
+  // may still be reading those replaced by Resize(), so they are only freed
+  // with the table. Since the table only grows, at least twofold each time,
+  // they take up less memory than the current one.
+  vector<unique_ptr<Buckets>> bucket_arrays_;
 
   // Return a pointer to slot that points to a cache entry that
   // matches key/hash.  If there is no such cache entry, return a
   // pointer to the trailing slot in the corresponding linked list.
-  RLHandle** FindPointer(const Slice& key, uint32_t hash) {
-    RLHandle** ptr = &list_[hash & (length_ - 1)];
-    while (*ptr != nullptr &&
-           ((*ptr)->hash != hash || key != (*ptr)->key())) {
-      ptr = &(*ptr)->next_hash;
+  std::atomic<RLHandle*>* FindPointer(const Slice& key, uint32_t hash) {
+    Buckets* buckets = buckets_.load(std::memory_order_relaxed);
+    std::atomic<RLHandle*>* ptr = &buckets->heads[hash & (buckets->length - 1)];
+    RLHandle* h;
+    while ((h = ptr->load(std::memory_order_relaxed)) != nullptr &&
+           (h->hash != hash || key != h->key())) {
+      ptr = &h->next_hash;
     }
     return ptr;
   }
@@ -170,25 +367,28 @@ class HandleTable {
     while (new_length < elems_ * 1.5) {
       new_length *= 2;
     }
-    auto new_list = new RLHandle*[new_length];
-    memset(new_list, 0, sizeof(new_list[0]) * new_length);
+    bucket_arrays_.emplace_back(new Buckets(new_length));
+    Buckets* new_buckets = bucket_arrays_.back().get();
+    Buckets* old_buckets = buckets_.load(std::memory_order_relaxed);
+
+    const uint32_t resizes = resizes_.load(std::memory_order_relaxed);
+    resizes_.store(resizes + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
     uint32_t count = 0;
-    for (uint32_t i = 0; i < length_; i++) {
-      RLHandle* h = list_[i];
+    for (uint32_t i = 0; old_buckets != nullptr && i < old_buckets->length; i++) {
+      RLHandle* h = old_buckets->heads[i].load(std::memory_order_relaxed);
       while (h != nullptr) {
-        RLHandle* next = h->next_hash;
-        uint32_t hash = h->hash;
-        RLHandle** ptr = &new_list[hash & (new_length - 1)];
-        h->next_hash = *ptr;
-        *ptr = h;
+        RLHandle* next = h->next_hash.load(std::memory_order_relaxed);
+        std::atomic<RLHandle*>* ptr = &new_buckets->heads[h->hash & (new_length - 1)];
+        h->next_hash.store(ptr->load(std::memory_order_relaxed), std::memory_order_relaxed);
+        ptr->store(h, std::memory_order_relaxed);
         h = next;
         count++;
       }
     }
     DCHECK_EQ(elems_, count);
-    delete[] list_;
-    list_ = new_list;
-    length_ = new_length;
+    buckets_.store(new_buckets, std::memory_order_release);
+    resizes_.store(resizes + 2, std::memory_order_release);
   }
 };
 
@@ -198,6 +398,8 @@ string ToString(Cache::EvictionPolicy p) {
       return "fifo";
     case Cache::EvictionPolicy::LRU:
       return "lru";
+    case Cache::EvictionPolicy::TINYLFU:
+      return "tinylfu";
     default:
       LOG(FATAL) << "unexpected cache eviction policy: " << static_cast<int>(p);
       break;
@@ -205,17 +407,135 @@ string ToString(Cache::EvictionPolicy p) {
   return "unknown";
 }
 
+// Tracks the lookups running without the lock in the FIFO and LRU shards of a
+// cache, so that the entries they may be reading are only freed once they are
+// done.
+//
+// Lookups register in the current epoch by incrementing a counter in the slot
+// of the CPU they run on, so that concurrent lookups don't share cache lines,
+// and unregister by decrementing the same counter. Entries removed from a hash
+// table are tagged with the epoch current at that point: only lookups which
+// registered in that epoch or before may still be reading them. Lookups which
+// registered in the epoch before the current one share counters with those
+// which would register in the next one, so the epoch only advances once they
+// are done, and entries may be freed once the epoch is two past their tag.
+class EpochTracker {
+ public:
+  // Keeps a lookup registered for the lifetime of the object.
+  class Guard {
+   public:
+    explicit Guard(EpochTracker* tracker)
+        : counter_(tracker->Enter()) {
+    }
+
+    ~Guard() {
+      counter_->fetch_sub(1, std::memory_order_release);
+    }
+
+   private:
+    std::atomic<int64_t>* counter_;
+
+    DISALLOW_COPY_AND_ASSIGN(Guard);
+  };
+
+  EpochTracker()
+      : epoch_(0),
+#if defined(__APPLE__)
+        // OSX doesn't have a way to get the index of the CPU running this
+        // thread, so all lookups share one slot.
+        num_slots_(1),
+#else
+        num_slots_(base::MaxCPUIndex() + 1),
+#endif
+        slots_(new Slot[num_slots_]) {
+  }
+
+  // Return the epoch to tag entries removed from a hash table before the call
+  // with in '*tag', after advancing the epoch up to twice past it if the
+  // running lookups allow, and the epoch after the call in '*epoch'.
+  void Synchronize(uint64_t* tag, uint64_t* epoch) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    uint64_t e = epoch_.load(std::memory_order_relaxed);
+    *tag = e;
+    for (int i = 0; i < 2 && NumLookups((e + 1) % 2) == 0; i++) {
+      epoch_.store(++e);
+    }
+    *epoch = e;
+  }
+
+ private:
+  struct Slot {
+    Slot() {
+      for (auto& c : lookups) {
+        c.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    // Number of lookups registered in even and odd epochs.
+    std::atomic<int64_t> lookups[2];
+    char padding[CACHELINE_SIZE - 2 * sizeof(std::atomic<int64_t>)];
+  };
+
+  // Register a lookup in the current epoch, returning the counter to
+  // decrement once it's done.
+  std::atomic<int64_t>* Enter() {
+#if defined(__APPLE__)
+    const int cpu = 0;
+#else
+    const int cpu = sched_getcpu();
+    DCHECK_LT(cpu, num_slots_);
+#endif
+    while (true) {
+      const uint64_t e = epoch_.load();
+      std::atomic<int64_t>* counter = &slots_[cpu].lookups[e % 2];
+      counter->fetch_add(1);
+      // Had the epoch advanced in the meantime, Synchronize() may have missed
+      // the increment, and the counter may no longer be that of the current
+      // epoch.
+      if (PREDICT_TRUE(epoch_.load() == e)) {
+        return counter;
+      }
+      counter->fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  int64_t NumLookups(int parity) const {
+    int64_t n = 0;
+    for (int i = 0; i < num_slots_; i++) {
+      n += slots_[i].lookups[parity].load();
+    }
+    return n;
+  }
+
+  std::atomic<uint64_t> epoch_;
+
+  // Serializes Synchronize().
+  simple_spinlock lock_;
+
+  const int num_slots_;
+  const unique_ptr<Slot[]> slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(EpochTracker);
+};
+
 // A single shard of sharded cache.
 template<Cache::EvictionPolicy policy>
 class CacheShard {
  public:
-  explicit CacheShard(MemTracker* tracker);
+  // Lookups in FIFO and LRU shards run without the lock, registering with
+  // 'epochs', which may be shared between shards. TinyLFU shards ignore it.
+  CacheShard(MemTracker* tracker, EpochTracker* epochs);
   ~CacheShard();
 
   // Separate from constructor so caller can easily make an array of CacheShard
   void SetCapacity(size_t capacity) {
     capacity_ = capacity;
     max_deferred_consumption_ = capacity * FLAGS_cache_memtracker_approximation_ratio;
+    window_capacity_ = capacity * kTinyLFUWindowPercent / 100;
+    protected_capacity_ = (capacity - window_capacity_) * kTinyLFUProtectedPercent / 100;
+    if (policy == Cache::EvictionPolicy::TINYLFU) {
+      sketch_.EnsureCapacity(capacity / kSketchNominalCharge);
+    }
   }
 
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
@@ -228,15 +548,40 @@ class CacheShard {
   size_t Invalidate(const Cache::InvalidationControl& ctl);
 
  private:
+  // Whether lookups run without taking 'mutex_'. Lookups in TinyLFU shards
+  // update the frequency sketch and the lists, so they need it.
+  static constexpr bool kLockFreeLookups = policy != Cache::EvictionPolicy::TINYLFU;
+
   void RL_Remove(RLHandle* e);
-  void RL_Append(RLHandle* e);
-  // Update the recency list after a lookup operation.
+  void RL_Append(RLHandle* e, RecencyList list);
+  // Update the recency lists after a lookup operation. Except for TinyLFU
+  // shards, 'mutex_' isn't held, so this must not modify the lists.
   void RL_UpdateAfterLookup(RLHandle* e);
+  // Evict entries until the shard is within its capacity, chaining those
+  // which are no longer referenced onto 'to_remove_head'.
+  void RL_EvictIfNeeded(RLHandle** to_remove_head);
+  // Remove 'e', already taken off its recency list, from the hash table, and
+  // chain it onto 'to_remove_head' if that dropped its last reference.
+  void RL_Evict(RLHandle* e, RLHandle** to_remove_head);
+  // The entry that would be evicted first from the main and protected lists,
+  // or nullptr if both are empty.
+  RLHandle* RL_MainVictim();
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(RLHandle* e);
+  // Take a reference to 'e', found by a lookup, unless it has already lost
+  // its last one, in which case it is about to be freed. Return true if
+  // a reference was taken.
+  static bool TryRef(RLHandle* e);
+  // Take the entries chained onto 'to_remove_head', which lost their last
+  // reference once removed from the hash table, and return the chain of
+  // entries which are safe to free. Those which lookups may still be reading
+  // are held back until they are done. Requires 'mutex_'.
+  RLHandle* RetireEntries(RLHandle* to_remove_head);
   // Call the user's eviction callback, if it exists, and free the entry.
   void FreeEntry(RLHandle* e);
+  // Free the entries chained onto 'to_free_head'.
+  void FreeEntries(RLHandle* to_free_head);
 
 
   // Update the memtracker's consumption by the given amount.
@@ -265,16 +610,36 @@ class CacheShard {
   // Initialized before use.
   size_t capacity_;
 
+  // Capacities of the window and protected lists of TinyLFU shards.
+  size_t window_capacity_;
+  size_t protected_capacity_;
+
+  EpochTracker* const epochs_;
+
   // mutex_ protects the following state.
   simple_spinlock mutex_;
   size_t usage_;
 
-  // Dummy head of recency list.
-  // rl.prev is newest entry, rl.next is oldest entry.
-  RLHandle rl_;
+  // Dummy heads of the recency lists, indexed by RecencyList.
+  // rl_[i].prev is the newest entry of list i, rl_[i].next is its oldest entry.
+  RLHandle rl_[kNumRecencyLists];
+
+  // Total charge of the entries on each recency list.
+  size_t rl_usage_[kNumRecencyLists];
 
   HandleTable table_;
 
+  // Entries which lost their last reference, but which lookups may still be
+  // reading, chained through 'next' by the epoch they were tagged with.
+  struct RetiredEntries {
+    uint64_t epoch;
+    RLHandle* head;
+  };
+  std::deque<RetiredEntries> retired_;
+
+  // Lookup frequencies; only maintained by TinyLFU shards.
+  FrequencySketch sketch_;
+
   MemTracker* mem_tracker_;
   atomic<int64_t> deferred_consumption_ { 0 };
 
@@ -286,25 +651,34 @@ class CacheShard {
 };
 
 template<Cache::EvictionPolicy policy>
-CacheShard<policy>::CacheShard(MemTracker* tracker)
-    : usage_(0),
+CacheShard<policy>::CacheShard(MemTracker* tracker, EpochTracker* epochs)
+    : epochs_(epochs),
+      usage_(0),
       mem_tracker_(tracker),
       metrics_(nullptr) {
-  // Make empty circular linked list.
-  rl_.next = &rl_;
-  rl_.prev = &rl_;
+  // Make empty circular linked lists.
+  for (int i = 0; i < kNumRecencyLists; i++) {
+    rl_[i].next = &rl_[i];
+    rl_[i].prev = &rl_[i];
+    rl_usage_[i] = 0;
+  }
 }
 
 template<Cache::EvictionPolicy policy>
 CacheShard<policy>::~CacheShard() {
-  for (RLHandle* e = rl_.next; e != &rl_; ) {
-    RLHandle* next = e->next;
-    DCHECK_EQ(e->refs.load(std::memory_order_relaxed), 1)
-        << "caller has an unreleased handle";
-    if (Unref(e)) {
-      FreeEntry(e);
+  for (auto& rl : rl_) {
+    for (RLHandle* e = rl.next; e != &rl; ) {
+      RLHandle* next = e->next;
+      DCHECK_EQ(e->refs.load(std::memory_order_relaxed), 1)
+          << "caller has an unreleased handle";
+      if (Unref(e)) {
+        FreeEntry(e);
+      }
+      e = next;
     }
-    e = next;
+  }
+  for (const auto& r : retired_) {
+    FreeEntries(r.head);
   }
   mem_tracker_->Consume(deferred_consumption_);
 }
@@ -315,6 +689,50 @@ bool CacheShard<policy>::Unref(RLHandle* e) {
   return e->refs.fetch_sub(1) == 1;
 }
 
+template<Cache::EvictionPolicy policy>
+bool CacheShard<policy>::TryRef(RLHandle* e) {
+  int32_t refs = e->refs.load(std::memory_order_relaxed);
+  do {
+    if (refs == 0) {
+      return false;
+    }
+  } while (!e->refs.compare_exchange_weak(refs, refs + 1, std::memory_order_relaxed));
+  return true;
+}
+
+template<Cache::EvictionPolicy policy>
+RLHandle* CacheShard<policy>::RetireEntries(RLHandle* to_remove_head) {
+  if (!kLockFreeLookups || (to_remove_head == nullptr && retired_.empty())) {
+    return to_remove_head;
+  }
+  uint64_t tag;
+  uint64_t epoch;
+  epochs_->Synchronize(&tag, &epoch);
+  if (to_remove_head != nullptr) {
+    if (retired_.empty() || retired_.back().epoch != tag) {
+      retired_.push_back({ tag, nullptr });
+    }
+    RLHandle** head = &retired_.back().head;
+    while (to_remove_head != nullptr) {
+      RLHandle* next = to_remove_head->next;
+      to_remove_head->next = *head;
+      *head = to_remove_head;
+      to_remove_head = next;
+    }
+  }
+  RLHandle* to_free_head = nullptr;
+  while (!retired_.empty() && retired_.front().epoch + 2 <= epoch) {
+    for (RLHandle* e = retired_.front().head; e != nullptr; ) {
+      RLHandle* next = e->next;
+      e->next = to_free_head;
+      to_free_head = e;
+      e = next;
+    }
+    retired_.pop_front();
+  }
+  return to_free_head;
+}
+
 template<Cache::EvictionPolicy policy>
 void CacheShard<policy>::FreeEntry(RLHandle* e) {
   DCHECK_EQ(e->refs.load(std::memory_order_relaxed), 0);
@@ -329,6 +747,15 @@ void CacheShard<policy>::FreeEntry(RLHandle* e) {
   delete [] e;
 }
 
+template<Cache::EvictionPolicy policy>
+void CacheShard<policy>::FreeEntries(RLHandle* to_free_head) {
+  while (to_free_head != nullptr) {
+    RLHandle* next = to_free_head->next;
+    FreeEntry(to_free_head);
+    to_free_head = next;
+  }
+}
+
 template<Cache::EvictionPolicy policy>
 void CacheShard<policy>::UpdateMemTracker(int64_t delta) {
   int64_t old_deferred = deferred_consumption_.fetch_add(delta);
@@ -367,16 +794,40 @@ void CacheShard<policy>::RL_Remove(RLHandle* e) {
   e->prev->next = e->next;
   DCHECK_GE(usage_, e->charge);
   usage_ -= e->charge;
+  DCHECK_GE(rl_usage_[e->list], e->charge);
+  rl_usage_[e->list] -= e->charge;
 }
 
 template<Cache::EvictionPolicy policy>
-void CacheShard<policy>::RL_Append(RLHandle* e) {
-  // Make "e" newest entry by inserting just before rl_.
-  e->next = &rl_;
-  e->prev = rl_.prev;
+void CacheShard<policy>::RL_Append(RLHandle* e, RecencyList list) {
+  // Make "e" newest entry by inserting just before rl_[list].
+  RLHandle* head = &rl_[list];
+  e->list = list;
+  e->next = head;
+  e->prev = head->prev;
   e->prev->next = e;
   e->next->prev = e;
   usage_ += e->charge;
+  rl_usage_[list] += e->charge;
+}
+
+template<Cache::EvictionPolicy policy>
+void CacheShard<policy>::RL_Evict(RLHandle* e, RLHandle** to_remove_head) {
+  table_.Remove(e->key(), e->hash);
+  if (Unref(e)) {
+    e->next = *to_remove_head;
+    *to_remove_head = e;
+  }
+}
+
+template<Cache::EvictionPolicy policy>
+RLHandle* CacheShard<policy>::RL_MainVictim() {
+  for (RecencyList list : { kMainList, kProtectedList }) {
+    if (rl_[list].next != &rl_[list]) {
+      return rl_[list].next;
+    }
+  }
+  return nullptr;
 }
 
 template<>
@@ -385,8 +836,99 @@ void CacheShard<Cache::EvictionPolicy::FIFO>::RL_UpdateAfterLookup(RLHandle* /*
 
 template<>
 void CacheShard<Cache::EvictionPolicy::LRU>::RL_UpdateAfterLookup(RLHandle* e) {
+  // Rather than moving the entry to the end of the list, which would need the
+  // lock, mark it so that eviction gives it a second chance (as in
+  // the CLOCK algorithm). Avoid dirtying the cache line if it's already set.
+  if (!e->referenced.load(std::memory_order_relaxed)) {
+    e->referenced.store(true, std::memory_order_relaxed);
+  }
+}
+
+template<>
+void CacheShard<Cache::EvictionPolicy::TINYLFU>::RL_UpdateAfterLookup(RLHandle* e) {
+  const auto list = static_cast<RecencyList>(e->list);
   RL_Remove(e);
-  RL_Append(e);
+  if (list != kMainList) {
+    RL_Append(e, list);
+    return;
+  }
+  // A probationary entry which is accessed again gets protected, demoting the
+  // least recently used protected entries if there isn't room for it.
+  RL_Append(e, kProtectedList);
+  while (rl_usage_[kProtectedList] > protected_capacity_) {
+    RLHandle* demoted = rl_[kProtectedList].next;
+    RL_Remove(demoted);
+    RL_Append(demoted, kMainList);
+  }
+}
+
+template<Cache::EvictionPolicy policy>
+void CacheShard<policy>::RL_EvictIfNeeded(RLHandle** to_remove_head) {
+  // Lookups running concurrently may mark entries again, so limit the second
+  // chances to one pass over the list.
+  size_t second_chances = table_.size();
+  while (usage_ > capacity_ && rl_[kMainList].next != &rl_[kMainList]) {
+    RLHandle* old = rl_[kMainList].next;
+    RL_Remove(old);
+    // Entries looked up since they were appended go to the end of the list
+    // instead.
+    if (second_chances > 0 && old->referenced.load(std::memory_order_relaxed)) {
+      second_chances--;
+      old->referenced.store(false, std::memory_order_relaxed);
+      RL_Append(old, kMainList);
+      continue;
+    }
+    RL_Evict(old, to_remove_head);
+  }
+}
+
+template<>
+void CacheShard<Cache::EvictionPolicy::TINYLFU>::RL_EvictIfNeeded(RLHandle** to_remove_head) {
+  sketch_.EnsureCapacity(table_.size());
+
+  // Entries overflowing the window are admitted to the main list only if
+  // there is room for them, or if they have been looked up more often than
+  // the entry they would displace. This keeps frequently used entries from
+  // being flushed out by a stream of entries which are used only once.
+  const size_t main_capacity = capacity_ - window_capacity_;
+  while (rl_usage_[kWindowList] > window_capacity_) {
+    RLHandle* candidate = rl_[kWindowList].next;
+    RL_Remove(candidate);
+    RLHandle* victim = RL_MainVictim();
+    if (victim != nullptr &&
+        rl_usage_[kMainList] + rl_usage_[kProtectedList] + candidate->charge > main_capacity) {
+      if (sketch_.Estimate(candidate->hash) <= sketch_.Estimate(victim->hash)) {
+        RL_Evict(candidate, to_remove_head);
+        // Give the next candidates a different probationary entry to compete
+        // with, in case this one's estimate is inflated by collisions.
+        if (victim->list == kMainList) {
+          RL_Remove(victim);
+          RL_Append(victim, kMainList);
+        }
+        continue;
+      }
+      do {
+        RL_Remove(victim);
+        RL_Evict(victim, to_remove_head);
+        victim = RL_MainVictim();
+      } while (victim != nullptr &&
+               rl_usage_[kMainList] + rl_usage_[kProtectedList] + candidate->charge >
+                   main_capacity);
+    }
+    RL_Append(candidate, kMainList);
+  }
+
+  while (usage_ > capacity_) {
+    RLHandle* old = RL_MainVictim();
+    if (old == nullptr) {
+      old = rl_[kWindowList].next;
+      if (old == &rl_[kWindowList]) {
+        break;
+      }
+    }
+    RL_Remove(old);
+    RL_Evict(old, to_remove_head);
+  }
 }
 
 template<Cache::EvictionPolicy policy>
@@ -394,8 +936,34 @@ Cache::Handle* CacheShard<policy>::Lookup(const Slice& key,
                                           uint32_t hash,
                                           bool caching) {
   RLHandle* e;
+  {
+    // Hits don't take the lock, so that concurrent lookups of the same shard
+    // only share the cache lines of the entries they find. The entry may be
+    // removed from the table concurrently; once it has lost its last
+    // reference, the lookup misses, and the epoch keeps it from being freed
+    // under the lookup in the meantime.
+    EpochTracker::Guard g(epochs_);
+    e = table_.Lookup(key, hash);
+    if (e != nullptr && TryRef(e)) {
+      RL_UpdateAfterLookup(e);
+    } else {
+      e = nullptr;
+    }
+  }
+
+  UpdateMetricsLookup(e != nullptr, caching);
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+template<>
+Cache::Handle* CacheShard<Cache::EvictionPolicy::TINYLFU>::Lookup(const Slice& key,
+                                                                   uint32_t hash,
+                                                                   bool caching) {
+  RLHandle* e;
   {
     std::lock_guard<decltype(mutex_)> l(mutex_);
+    sketch_.Increment(hash);
     e = table_.Lookup(key, hash);
     if (e != nullptr) {
       e->refs.fetch_add(1, std::memory_order_relaxed);
@@ -413,9 +981,22 @@ template<Cache::EvictionPolicy policy>
 void CacheShard<policy>::Release(Cache::Handle* handle) {
   RLHandle* e = reinterpret_cast<RLHandle*>(handle);
   bool last_reference = Unref(e);
-  if (last_reference) {
+  if (!last_reference) {
+    return;
+  }
+  if (!kLockFreeLookups) {
     FreeEntry(e);
+    return;
+  }
+  // Lookups which found the entry before it was removed from the hash table
+  // may still be reading it.
+  e->next = nullptr;
+  RLHandle* to_free_head;
+  {
+    std::lock_guard<decltype(mutex_)> l(mutex_);
+    to_free_head = RetireEntries(e);
   }
+  FreeEntries(to_free_head);
 }
 
 template<Cache::EvictionPolicy policy>
@@ -427,6 +1008,7 @@ Cache::Handle* CacheShard<policy>::Insert(
   handle->eviction_callback = eviction_callback;
   // Two refs for the handle: one from CacheShard, one for the returned handle.
   handle->refs.store(2, std::memory_order_relaxed);
+  handle->referenced.store(false, std::memory_order_relaxed);
   UpdateMemTracker(handle->charge);
   if (PREDICT_TRUE(metrics_)) {
     metrics_->cache_usage->IncrementBy(handle->charge);
@@ -437,7 +1019,7 @@ Cache::Handle* CacheShard<policy>::Insert(
   {
     std::lock_guard<decltype(mutex_)> l(mutex_);
 
-    RL_Append(handle);
+    RL_Append(handle, policy == Cache::EvictionPolicy::TINYLFU ? kWindowList : kMainList);
 
     RLHandle* old = table_.Insert(handle);
     if (old != nullptr) {
@@ -448,45 +1030,34 @@ Cache::Handle* CacheShard<policy>::Insert(
       }
     }
 
-    while (usage_ > capacity_ && rl_.next != &rl_) {
-      RLHandle* old = rl_.next;
-      RL_Remove(old);
-      table_.Remove(old->key(), old->hash);
-      if (Unref(old)) {
-        old->next = to_remove_head;
-        to_remove_head = old;
-      }
-    }
+    RL_EvictIfNeeded(&to_remove_head);
+    to_remove_head = RetireEntries(to_remove_head);
   }
 
   // we free the entries here outside of mutex for
   // performance reasons
-  while (to_remove_head != nullptr) {
-    RLHandle* next = to_remove_head->next;
-    FreeEntry(to_remove_head);
-    to_remove_head = next;
-  }
+  FreeEntries(to_remove_head);
 
   return reinterpret_cast<Cache::Handle*>(handle);
 }
 
 template<Cache::EvictionPolicy policy>
 void CacheShard<policy>::Erase(const Slice& key, uint32_t hash) {
-  RLHandle* e;
-  bool last_reference = false;
+  RLHandle* to_remove_head = nullptr;
   {
     std::lock_guard<decltype(mutex_)> l(mutex_);
-    e = table_.Remove(key, hash);
+    RLHandle* e = table_.Remove(key, hash);
     if (e != nullptr) {
       RL_Remove(e);
-      last_reference = Unref(e);
+      if (Unref(e)) {
+        e->next = nullptr;
+        to_remove_head = e;
+      }
     }
+    to_remove_head = RetireEntries(to_remove_head);
   }
   // mutex not held here
-  // last_reference will only be true if e != NULL
-  if (last_reference) {
-    FreeEntry(e);
-  }
+  FreeEntries(to_remove_head);
 }
 
 template<Cache::EvictionPolicy policy>
@@ -498,46 +1069,45 @@ size_t CacheShard<policy>::Invalidate(const Cache::InvalidationControl& ctl) {
   {
     std::lock_guard<decltype(mutex_)> l(mutex_);
 
-    // rl_.next is the oldest (a.k.a. least relevant) entry in the recency list.
-    RLHandle* h = rl_.next;
-    while (h != nullptr && h != &rl_ &&
-           ctl.iteration_func(valid_entry_count, invalid_entry_count)) {
-      if (ctl.validity_func(h->key(), h->value())) {
-        // Continue iterating over the list.
+    // The lists are ordered from the least to the most relevant, and rl.next
+    // is the oldest (a.k.a. least relevant) entry in each list.
+    for (auto& rl : rl_) {
+      RLHandle* h = rl.next;
+      while (h != nullptr && h != &rl &&
+             ctl.iteration_func(valid_entry_count, invalid_entry_count)) {
+        if (ctl.validity_func(h->key(), h->value())) {
+          // Continue iterating over the list.
+          h = h->next;
+          ++valid_entry_count;
+          continue;
+        }
+        // Copy the handle slated for removal.
+        RLHandle* h_to_remove = h;
+        // Prepare for next iteration of the cycle.
         h = h->next;
-        ++valid_entry_count;
-        continue;
-      }
-      // Copy the handle slated for removal.
-      RLHandle* h_to_remove = h;
-      // Prepare for next iteration of the cycle.
-      h = h->next;
-
-      RL_Remove(h_to_remove);
-      table_.Remove(h_to_remove->key(), h_to_remove->hash);
-      if (Unref(h_to_remove)) {
-        h_to_remove->next = to_remove_head;
-        to_remove_head = h_to_remove;
+
+        RL_Remove(h_to_remove);
+        RL_Evict(h_to_remove, &to_remove_head);
+        ++invalid_entry_count;
       }
-      ++invalid_entry_count;
     }
+    to_remove_head = RetireEntries(to_remove_head);
   }
   // Once removed from the lookup table and the recency list, the entries
   // with no references left must be deallocated because Cache::Release()
   // wont be called for them from elsewhere.
-  while (to_remove_head != nullptr) {
-    RLHandle* next = to_remove_head->next;
-    FreeEntry(to_remove_head);
-    to_remove_head = next;
-  }
+  FreeEntries(to_remove_head);
   return invalid_entry_count;
 }
 
 // Determine the number of bits of the hash that should be used to determine
 // the cache shard. This, in turn, determines the number of shards.
 int DetermineShardBits() {
-  int bits = PREDICT_FALSE(FLAGS_cache_force_single_shard) ?
-      0 : Bits::Log2Ceiling(base::NumCPUs());
+  int bits = 0;
+  if (PREDICT_TRUE(!FLAGS_cache_force_single_shard)) {
+    bits = Bits::Log2Ceiling(FLAGS_cache_num_shards > 0 ? FLAGS_cache_num_shards
+                                                        : base::NumCPUs());
+  }
   VLOG(1) << "Will use " << (1 << bits) << " shards for recency list cache.";
   return bits;
 }
@@ -557,7 +1127,7 @@ class ShardedCache : public Cache {
     const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
     for (int s = 0; s < num_shards; s++) {
       unique_ptr<CacheShard<policy>> shard(
-          new CacheShard<policy>(mem_tracker_.get()));
+          new CacheShard<policy>(mem_tracker_.get(), &epochs_));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
@@ -669,6 +1239,7 @@ class ShardedCache : public Cache {
 
   shared_ptr<MemTracker> mem_tracker_;
   unique_ptr<CacheMetrics> metrics_;
+  EpochTracker epochs_;
   vector<CacheShard<policy>*> shards_;
 
   // Number of bits of hash used to determine the shard.
@@ -693,6 +1264,12 @@ Cache* NewCache<Cache::EvictionPolicy::LRU,
   return new ShardedCache<Cache::EvictionPolicy::LRU>(capacity, id);
 }
 
+template<>
+Cache* NewCache<Cache::EvictionPolicy::TINYLFU,
+                Cache::MemoryType::DRAM>(size_t capacity, const std::string& id) {
+  return new ShardedCache<Cache::EvictionPolicy::TINYLFU>(capacity, id);
+}
+
 std::ostream& operator<<(std::ostream& os, Cache::MemoryType mem_type) {
   switch (mem_type) {
     case Cache::MemoryType::DRAM:
@@ -49,6 +49,13 @@ class Cache {
 
     // The least-recently-used items are evicted.
     LRU,
+
+    // W-TinyLFU: new items enter a small LRU window, and items leaving the
+    // window are admitted to a segmented LRU only if they have been looked up
+    // more often than the items they would displace. Access frequencies are
+    // estimated with a compact, periodically aged sketch. This keeps large
+    // sequential scans from flushing frequently used items out of the cache.
+    TINYLFU,
   };
 
   // Callback interface which is called when an entry is evicted from the
@@ -357,6 +364,11 @@ template<>
 Cache* NewCache<Cache::EvictionPolicy::LRU,
                 Cache::MemoryType::DRAM>(size_t capacity, const std::string& id);
 
+// Create a new W-TinyLFU cache with a fixed size capacity, stored in DRAM.
+template<>
+Cache* NewCache<Cache::EvictionPolicy::TINYLFU,
+                Cache::MemoryType::DRAM>(size_t capacity, const std::string& id);
+
 // A helper method to output cache memory type into ostream.
 std::ostream& operator<<(std::ostream& os, Cache::MemoryType mem_type);
 
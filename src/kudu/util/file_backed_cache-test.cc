@@ -0,0 +1,205 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/file_backed_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+
+class FileBackedCacheTest : public KuduTest {
+ public:
+  FileBackedCacheTest()
+      : path_(GetTestPath("cache")) {
+  }
+
+ protected:
+  // Small regions, so that the cache fills up quickly.
+  static constexpr uint64_t kRegionSize = 64 * 1024;
+  static constexpr uint64_t kCapacity = 4096 + 4 * kRegionSize;
+
+  Status OpenCache(const string& owner = "owner") {
+    cache_.reset();
+    return FileBackedCache::Open(env_, path_, kCapacity, kRegionSize, owner, &cache_);
+  }
+
+  static string Key(int i) {
+    return Substitute("key-$0", i);
+  }
+
+  static string Value(int i, size_t size = 1000) {
+    string value = Substitute("value-$0-", i);
+    value.resize(size, 'x');
+    return value;
+  }
+
+  // Look up the given key, returning whether it was found and, if so,
+  // storing its value in 'value'.
+  bool Lookup(const string& key, string* value) {
+    return cache_->Lookup(key, [&](size_t size) {
+      value->resize(size);
+      return reinterpret_cast<uint8_t*>(&(*value)[0]);
+    });
+  }
+
+  const string path_;
+  unique_ptr<FileBackedCache> cache_;
+};
+
+TEST_F(FileBackedCacheTest, TestInsertAndLookup) {
+  ASSERT_OK(OpenCache());
+  for (int i = 0; i < 10; i++) {
+    cache_->Insert(Key(i), Value(i));
+  }
+  // Replacing an entry makes the latest value visible.
+  cache_->Insert(Key(3), Value(300, 2000));
+  cache_->WaitForInsertsForTests();
+  ASSERT_EQ(10, cache_->num_entries());
+
+  string value;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(cache_->Contains(Key(i)));
+    ASSERT_TRUE(Lookup(Key(i), &value));
+    ASSERT_EQ(i == 3 ? Value(300, 2000) : Value(i), value);
+  }
+  ASSERT_FALSE(cache_->Contains(Key(10)));
+  ASSERT_FALSE(Lookup(Key(10), &value));
+
+  // Entries larger than a region aren't cached.
+  cache_->Insert(Key(11), Value(11, kRegionSize));
+  cache_->WaitForInsertsForTests();
+  ASSERT_FALSE(Lookup(Key(11), &value));
+}
+
+TEST_F(FileBackedCacheTest, TestRegionsAreReclaimed) {
+  ASSERT_OK(OpenCache());
+  // Insert enough entries to fill the cache several times over.
+  const int kNumEntries = 4 * kCapacity / 1000;
+  for (int i = 0; i < kNumEntries; i++) {
+    cache_->Insert(Key(i), Value(i));
+    cache_->WaitForInsertsForTests();
+  }
+  ASSERT_LT(cache_->num_entries(), kCapacity / 1000);
+
+  // The oldest entries are gone, and the latest ones are still there.
+  string value;
+  ASSERT_FALSE(Lookup(Key(0), &value));
+  for (int i = kNumEntries - 100; i < kNumEntries; i++) {
+    ASSERT_TRUE(Lookup(Key(i), &value));
+    ASSERT_EQ(Value(i), value);
+  }
+}
+
+TEST_F(FileBackedCacheTest, TestEntriesSurviveReopen) {
+  ASSERT_OK(OpenCache());
+  const int kNumEntries = 2 * kCapacity / 1000;
+  for (int i = 0; i < kNumEntries; i++) {
+    cache_->Insert(Key(i), Value(i));
+    cache_->WaitForInsertsForTests();
+  }
+  const size_t num_entries = cache_->num_entries();
+  ASSERT_OK(OpenCache());
+  ASSERT_EQ(num_entries, cache_->num_entries());
+
+  string value;
+  for (int i = kNumEntries - 100; i < kNumEntries; i++) {
+    ASSERT_TRUE(Lookup(Key(i), &value));
+    ASSERT_EQ(Value(i), value);
+  }
+
+  // New entries are written after the recovered ones, rather than over them.
+  cache_->Insert(Key(kNumEntries), Value(kNumEntries));
+  cache_->WaitForInsertsForTests();
+  ASSERT_TRUE(Lookup(Key(kNumEntries - 1), &value));
+  ASSERT_TRUE(Lookup(Key(kNumEntries), &value));
+
+  // A cache with a different layout starts out empty.
+  cache_.reset();
+  ASSERT_OK(FileBackedCache::Open(env_, path_, kCapacity, kRegionSize / 2, "owner", &cache_));
+  ASSERT_EQ(0, cache_->num_entries());
+}
+
+TEST_F(FileBackedCacheTest, TestEntriesOfOtherOwnersAreDiscarded) {
+  ASSERT_OK(OpenCache("owner-a"));
+  cache_->Insert(Key(0), Value(0));
+  cache_->WaitForInsertsForTests();
+
+  // Another owner starts out with an empty cache...
+  ASSERT_OK(OpenCache("owner-b"));
+  ASSERT_EQ(0, cache_->num_entries());
+  string value;
+  ASSERT_FALSE(Lookup(Key(0), &value));
+  cache_->Insert(Key(1), Value(1));
+  cache_->WaitForInsertsForTests();
+
+  // ...and, having taken over the file, so does the original owner.
+  ASSERT_OK(OpenCache("owner-a"));
+  ASSERT_EQ(0, cache_->num_entries());
+  ASSERT_FALSE(Lookup(Key(1), &value));
+
+  Status s = OpenCache(string(FileBackedCache::kMaxOwnerSize + 1, 'x'));
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+TEST_F(FileBackedCacheTest, TestCorruptEntriesAreMisses) {
+  ASSERT_OK(OpenCache());
+  cache_->Insert(Key(0), Value(0));
+  cache_->Insert(Key(1), Value(1));
+  cache_->WaitForInsertsForTests();
+  cache_.reset();
+
+  // Corrupt the value of the first entry, which follows the superblock and
+  // the entry's header and key.
+  {
+    unique_ptr<RWFile> file;
+    RWFileOptions opts;
+    opts.mode = Env::MUST_EXIST;
+    ASSERT_OK(env_->NewRWFile(opts, path_, &file));
+    ASSERT_OK(file->Write(4096 + 24 + Key(0).size() + 10, "garbage"));
+    ASSERT_OK(file->Close());
+  }
+
+  ASSERT_OK(OpenCache());
+  ASSERT_EQ(2, cache_->num_entries());
+  string value;
+  ASSERT_FALSE(Lookup(Key(0), &value));
+  ASSERT_EQ(1, cache_->num_entries());
+  ASSERT_TRUE(Lookup(Key(1), &value));
+  ASSERT_EQ(Value(1), value);
+}
+
+TEST_F(FileBackedCacheTest, TestCapacityTooSmall) {
+  Status s = FileBackedCache::Open(env_, path_, kRegionSize, kRegionSize, "owner", &cache_);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+} // namespace kudu
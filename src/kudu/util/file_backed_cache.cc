@@ -0,0 +1,406 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/file_backed_cache.h"
+
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/array_view.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/crc.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/threadpool.h"
+
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+// The file starts with a superblock describing its layout, padded to this
+// size. The regions follow it.
+//
+//   magic       u64
+//   version     u32
+//   owner_len   u32
+//   region_size u64
+//   num_regions u64
+//   owner       64 bytes  (zero-padded)
+//   crc32c      u32  (of the preceding fields)
+constexpr uint64_t kSuperblockSize = 4096;
+constexpr uint64_t kSuperblockMagic = 0x656863616366646bULL;  // "kdfcache"
+constexpr uint32_t kSuperblockVersion = 2;
+constexpr size_t kSuperblockEncodedSize = 32 + FileBackedCache::kMaxOwnerSize + 4;
+
+// Each entry is a header followed by the key and the value.
+//
+//   magic     u32
+//   crc32c    u32  (of the rest of the entry)
+//   seq       u64
+//   key_len   u32
+//   value_len u32
+constexpr size_t kEntryHeaderSize = 24;
+constexpr uint32_t kEntryMagic = 0x6b636665;
+constexpr size_t kMaxKeySize = 256;
+
+// The maximum number of inserts waiting to be written.
+constexpr int kMaxQueuedInserts = 256;
+
+void EncodeSuperblock(uint64_t region_size, uint64_t num_regions, const string& owner,
+                      uint8_t* buf) {
+  DCHECK_LE(owner.size(), FileBackedCache::kMaxOwnerSize);
+  EncodeFixed64(buf, kSuperblockMagic);
+  EncodeFixed32(buf + 8, kSuperblockVersion);
+  EncodeFixed32(buf + 12, owner.size());
+  EncodeFixed64(buf + 16, region_size);
+  EncodeFixed64(buf + 24, num_regions);
+  memset(buf + 32, 0, FileBackedCache::kMaxOwnerSize);
+  memcpy(buf + 32, owner.data(), owner.size());
+  const size_t crc_offset = kSuperblockEncodedSize - 4;
+  EncodeFixed32(buf + crc_offset, crc::Crc32c(buf, crc_offset));
+}
+
+} // anonymous namespace
+
+constexpr size_t FileBackedCache::kMaxOwnerSize;
+
+Status FileBackedCache::Open(Env* env, const string& path,
+                             uint64_t capacity, uint64_t region_size,
+                             const string& owner,
+                             unique_ptr<FileBackedCache>* cache) {
+  if (owner.size() > kMaxOwnerSize) {
+    return Status::InvalidArgument(Substitute(
+        "owner of $0 bytes is longer than $1 bytes", owner.size(), kMaxOwnerSize));
+  }
+  const uint64_t num_regions = capacity > kSuperblockSize ?
+      (capacity - kSuperblockSize) / region_size : 0;
+  if (num_regions < 2) {
+    return Status::InvalidArgument(Substitute(
+        "capacity of $0 bytes is too small for regions of $1 bytes", capacity, region_size));
+  }
+  RWFileOptions opts;
+  opts.mode = Env::CREATE_OR_OPEN;
+  unique_ptr<RWFile> file;
+  RETURN_NOT_OK_PREPEND(env->NewRWFile(opts, path, &file),
+                        "unable to open cache file");
+  unique_ptr<FileBackedCache> c(new FileBackedCache(std::move(file), region_size, num_regions));
+  RETURN_NOT_OK_PREPEND(c->Init(owner), Substitute("unable to initialize cache file $0", path));
+  *cache = std::move(c);
+  return Status::OK();
+}
+
+FileBackedCache::FileBackedCache(unique_ptr<RWFile> file,
+                                 uint64_t region_size,
+                                 uint64_t num_regions)
+    : file_(std::move(file)),
+      region_size_(region_size),
+      num_regions_(num_regions),
+      write_region_(num_regions - 1),
+      write_offset_(region_size),
+      next_seq_(1),
+      region_keys_(num_regions),
+      usage_(0) {
+}
+
+FileBackedCache::~FileBackedCache() {
+  if (write_pool_) {
+    write_pool_->Shutdown();
+  }
+}
+
+Status FileBackedCache::Init(const string& owner) {
+  RETURN_NOT_OK(ThreadPoolBuilder("file-cache-writer")
+                .set_min_threads(0)
+                .set_max_threads(1)
+                .set_max_queue_size(kMaxQueuedInserts)
+                .Build(&write_pool_));
+
+  uint64_t size;
+  RETURN_NOT_OK(file_->Size(&size));
+  if (size == kSuperblockSize + num_regions_ * region_size_) {
+    uint8_t expected[kSuperblockEncodedSize];
+    EncodeSuperblock(region_size_, num_regions_, owner, expected);
+    uint8_t actual[kSuperblockEncodedSize];
+    RETURN_NOT_OK(file_->Read(0, Slice(actual, sizeof(actual))));
+    if (memcmp(expected, actual, sizeof(expected)) == 0) {
+      return Recover();
+    }
+  }
+  LOG(INFO) << "Formatting cache file " << file_->filename();
+  return Format(owner);
+}
+
+Status FileBackedCache::Format(const string& owner) {
+  // Truncating first zeroes out the entries of any previous layout.
+  RETURN_NOT_OK(file_->Truncate(0));
+  RETURN_NOT_OK(file_->PreAllocate(0, kSuperblockSize + num_regions_ * region_size_,
+                                   RWFile::CHANGE_FILE_SIZE));
+  uint8_t superblock[kSuperblockEncodedSize];
+  EncodeSuperblock(region_size_, num_regions_, owner, superblock);
+  RETURN_NOT_OK(file_->Write(0, Slice(superblock, sizeof(superblock))));
+  return file_->Sync();
+}
+
+Status FileBackedCache::Recover() {
+  uint64_t max_seq = 0;
+  uint8_t buf[kEntryHeaderSize + kMaxKeySize];
+  for (uint64_t region = 0; region < num_regions_; region++) {
+    // Each region is scanned up to the first invalid header: the newest
+    // entry in a region is always followed by an empty header, if there is
+    // room for one.
+    uint64_t offset = 0;
+    while (offset + kEntryHeaderSize <= region_size_) {
+      const uint64_t file_offset = RegionOffset(region) + offset;
+      RETURN_NOT_OK(file_->Read(file_offset, Slice(buf, kEntryHeaderSize)));
+      const uint64_t seq = DecodeFixed64(buf + 8);
+      const uint32_t key_size = DecodeFixed32(buf + 16);
+      const uint64_t entry_size = kEntryHeaderSize + key_size + DecodeFixed32(buf + 20);
+      if (DecodeFixed32(buf) != kEntryMagic || key_size > kMaxKeySize ||
+          offset + entry_size > region_size_) {
+        break;
+      }
+      RETURN_NOT_OK(file_->Read(file_offset + kEntryHeaderSize,
+                                Slice(buf + kEntryHeaderSize, key_size)));
+      string key(reinterpret_cast<const char*>(buf + kEntryHeaderSize), key_size);
+      {
+        std::lock_guard<simple_spinlock> l(lock_);
+        const auto it = index_.find(key);
+        if (it == index_.end() || it->second.seq < seq) {
+          AddEntryUnlocked(std::move(key), { file_offset, entry_size, seq });
+        }
+      }
+      if (seq > max_seq) {
+        max_seq = seq;
+        write_region_ = region;
+      }
+      offset += entry_size;
+    }
+  }
+  // Resume writing at the region after the one written last.
+  next_seq_ = max_seq + 1;
+  write_offset_ = region_size_;
+  LOG(INFO) << Substitute("Indexed $0 entries ($1 bytes) in cache file $2",
+                          index_.size(), usage_, file_->filename());
+  return Status::OK();
+}
+
+void FileBackedCache::Insert(const Slice& key, const Slice& value) {
+  const size_t entry_size = kEntryHeaderSize + key.size() + value.size();
+  if (key.size() > kMaxKeySize || entry_size > region_size_) {
+    return;
+  }
+  std::shared_ptr<faststring> buf(new faststring(entry_size));
+  buf->resize(kEntryHeaderSize);
+  buf->append(key.data(), key.size());
+  buf->append(value.data(), value.size());
+  const size_t key_size = key.size();
+  Status s = write_pool_->SubmitFunc([this, buf, key_size]() {
+    WriteEntry(buf.get(), key_size);
+  });
+  if (PREDICT_FALSE(!s.ok())) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (metrics_) {
+      metrics_->dropped_inserts->Increment();
+    }
+  }
+}
+
+void FileBackedCache::WriteEntry(faststring* buf, size_t key_size) {
+  const uint64_t seq = next_seq_++;
+  uint8_t* header = buf->data();
+  EncodeFixed32(header, kEntryMagic);
+  EncodeFixed64(header + 8, seq);
+  EncodeFixed32(header + 16, key_size);
+  EncodeFixed32(header + 20, buf->size() - kEntryHeaderSize - key_size);
+  EncodeFixed32(header + 4, crc::Crc32c(header + 8, buf->size() - 8));
+
+  if (write_offset_ + buf->size() > region_size_) {
+    write_region_ = (write_region_ + 1) % num_regions_;
+    write_offset_ = 0;
+    std::lock_guard<simple_spinlock> l(lock_);
+    EvictRegionUnlocked(write_region_);
+  }
+  const EntryLocation loc = { RegionOffset(write_region_) + write_offset_, buf->size(), seq };
+  // Unless the region is full, the entry is followed by an empty header, so
+  // that Recover() doesn't mistake any older entries after it for new ones.
+  // The next entry overwrites it.
+  static const uint8_t kEmptyHeader[kEntryHeaderSize] = {};
+  Slice data[] = { Slice(*buf), Slice(kEmptyHeader, kEntryHeaderSize) };
+  const bool has_room = write_offset_ + buf->size() + kEntryHeaderSize <= region_size_;
+  Status s = file_->WriteV(loc.offset, ArrayView<const Slice>(data, has_room ? 2 : 1));
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << Substitute("Unable to write to cache file $0: $1",
+                                                 file_->filename(), s.ToString());
+    if (metrics_) {
+      metrics_->dropped_inserts->Increment();
+    }
+    return;
+  }
+  write_offset_ += buf->size();
+  AddEntryUnlocked(string(reinterpret_cast<const char*>(header + kEntryHeaderSize), key_size),
+                   loc);
+  if (metrics_) {
+    metrics_->inserts->Increment();
+  }
+}
+
+bool FileBackedCache::Lookup(const Slice& key, const Allocator& allocate) {
+  if (key.size() > kMaxKeySize) {
+    return false;
+  }
+  const string key_str = key.ToString();
+  EntryLocation loc;
+  FileBackedCacheMetrics* metrics;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    metrics = metrics_.get();
+    const auto it = index_.find(key_str);
+    if (it == index_.end()) {
+      if (metrics) {
+        metrics->misses->Increment();
+      }
+      return false;
+    }
+    loc = it->second;
+  }
+
+  const size_t value_size = loc.size - kEntryHeaderSize - key.size();
+  uint8_t* value = allocate(value_size);
+  if (!value) {
+    return false;
+  }
+  uint8_t header[kEntryHeaderSize + kMaxKeySize];
+  Slice results[] = { Slice(header, kEntryHeaderSize + key.size()), Slice(value, value_size) };
+  Status s = file_->ReadV(loc.offset, results);
+
+  // The entry may have been overwritten since it was looked up in the index,
+  // or torn by a crash before the cache was opened.
+  bool valid = s.ok() &&
+      DecodeFixed32(header) == kEntryMagic &&
+      DecodeFixed64(header + 8) == loc.seq &&
+      DecodeFixed32(header + 16) == key.size() &&
+      DecodeFixed32(header + 20) == value_size &&
+      memcmp(header + kEntryHeaderSize, key.data(), key.size()) == 0;
+  if (valid) {
+    uint32_t crc = crc::Crc32c(header + 8, kEntryHeaderSize - 8 + key.size());
+    crc = crc::Crc32c(value, value_size, crc);
+    valid = crc == DecodeFixed32(header + 4);
+  }
+  if (PREDICT_FALSE(!valid)) {
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << Substitute("Unable to read from cache file $0: $1",
+                                                   file_->filename(), s.ToString());
+    }
+    std::lock_guard<simple_spinlock> l(lock_);
+    RemoveEntryUnlocked(key_str, loc);
+    if (metrics) {
+      metrics->misses->Increment();
+    }
+    return false;
+  }
+  if (metrics) {
+    metrics->hits->Increment();
+  }
+  return true;
+}
+
+bool FileBackedCache::Contains(const Slice& key) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return ContainsKey(index_, key.ToString());
+}
+
+void FileBackedCache::SetMetrics(unique_ptr<FileBackedCacheMetrics> metrics) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  metrics_ = std::move(metrics);
+  metrics_->usage->set_value(usage_);
+}
+
+void FileBackedCache::WaitForInsertsForTests() {
+  write_pool_->Wait();
+}
+
+size_t FileBackedCache::num_entries() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return index_.size();
+}
+
+void FileBackedCache::AddEntryUnlocked(string key, const EntryLocation& loc) {
+  DCHECK(lock_.is_locked());
+  region_keys_[RegionOf(loc.offset)].push_back(key);
+  auto& slot = index_[std::move(key)];
+  usage_ -= slot.size;
+  usage_ += loc.size;
+  slot = loc;
+  if (metrics_) {
+    metrics_->usage->set_value(usage_);
+  }
+}
+
+void FileBackedCache::RemoveEntryUnlocked(const string& key, const EntryLocation& loc) {
+  DCHECK(lock_.is_locked());
+  const auto it = index_.find(key);
+  if (it == index_.end() || it->second.seq != loc.seq) {
+    return;
+  }
+  usage_ -= it->second.size;
+  index_.erase(it);
+  if (metrics_) {
+    metrics_->usage->set_value(usage_);
+  }
+}
+
+void FileBackedCache::EvictRegionUnlocked(uint64_t region) {
+  DCHECK(lock_.is_locked());
+  for (const auto& key : region_keys_[region]) {
+    const auto it = index_.find(key);
+    if (it == index_.end() || RegionOf(it->second.offset) != region) {
+      continue;
+    }
+    usage_ -= it->second.size;
+    index_.erase(it);
+    if (metrics_) {
+      metrics_->evictions->Increment();
+    }
+  }
+  region_keys_[region].clear();
+  if (metrics_) {
+    metrics_->usage->set_value(usage_);
+  }
+}
+
+uint64_t FileBackedCache::RegionOffset(uint64_t region) const {
+  return kSuperblockSize + region * region_size_;
+}
+
+uint64_t FileBackedCache::RegionOf(uint64_t offset) const {
+  return (offset - kSuperblockSize) / region_size_;
+}
+
+} // namespace kudu
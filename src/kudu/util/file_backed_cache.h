@@ -0,0 +1,197 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Env;
+class RWFile;
+class ThreadPool;
+class faststring;
+
+// Metrics of a FileBackedCache. Subclasses instantiate the members from the
+// metric prototypes of the cache's user.
+struct FileBackedCacheMetrics {
+  virtual ~FileBackedCacheMetrics() = default;
+
+  scoped_refptr<Counter> inserts;
+  scoped_refptr<Counter> dropped_inserts;
+  scoped_refptr<Counter> evictions;
+  scoped_refptr<Counter> hits;
+  scoped_refptr<Counter> misses;
+  scoped_refptr<AtomicGauge<uint64_t>> usage;
+};
+
+// A cache of key/value pairs kept in a preallocated file. It is meant to be
+// put on a local SSD, as a second tier behind an in-memory cache: entries
+// evicted from memory are inserted here, and looked up here when the
+// in-memory cache misses.
+//
+// The file is divided into fixed-size regions, which are filled with entries
+// one after the other, like a log. Once the last region is full, the oldest
+// one is reclaimed, evicting all of its entries. Every entry carries a
+// checksum which is verified whenever the entry is read back, so the file is
+// never synced: an entry which was torn by a crash, or overwritten while
+// being read, is simply a miss.
+//
+// The file is stamped with the identity of its owner, e.g. the instance of
+// the file system whose data is cached. Opening the cache again with the same
+// owner indexes the entries already in the file, so that they survive
+// restarts, which reads the header of every entry. This requires that a key
+// identifies the same value for as long as the owner exists. If the owner
+// differs, for example because the file was written by another server, the
+// entries are discarded.
+//
+// Inserts are written by a background thread, and are best-effort: if too
+// many are outstanding, further ones are dropped.
+//
+// This class is thread-safe.
+class FileBackedCache {
+ public:
+  // Called by Lookup() with the size of the value which was found, to get a
+  // buffer to read it into. May return null to abandon the lookup.
+  typedef std::function<uint8_t*(size_t)> Allocator;
+
+  // The maximum size of the identity of the owner of a cache file.
+  static constexpr size_t kMaxOwnerSize = 64;
+
+  // Open the cache kept in the file at 'path' on behalf of 'owner', creating
+  // the file if it doesn't exist or reinitializing it if its layout doesn't
+  // match 'capacity' and 'region_size', or if it was stamped with a different
+  // owner. The file takes up at most 'capacity' bytes, which must be enough
+  // for at least two regions. Entries larger than a region are never cached.
+  static Status Open(Env* env, const std::string& path,
+                     uint64_t capacity, uint64_t region_size,
+                     const std::string& owner,
+                     std::unique_ptr<FileBackedCache>* cache);
+
+  // Waits for the insert being written, if any. Inserts which are still
+  // queued are dropped.
+  ~FileBackedCache();
+
+  // Asynchronously insert a copy of the given entry, replacing any entry
+  // with the same key.
+  void Insert(const Slice& key, const Slice& value);
+
+  // Look up the entry with the given key, reading its value into the buffer
+  // returned by 'allocate'. Returns true if the value was read, or false if
+  // the entry wasn't found or couldn't be read.
+  bool Lookup(const Slice& key, const Allocator& allocate);
+
+  // Whether there is an entry with the given key. Unlike Lookup(), this
+  // doesn't read the file, so the entry may still turn out to be unreadable.
+  bool Contains(const Slice& key) const;
+
+  // Start recording metrics in 'metrics'.
+  void SetMetrics(std::unique_ptr<FileBackedCacheMetrics> metrics);
+
+  // Wait until all queued inserts have been written.
+  void WaitForInsertsForTests();
+
+  // The number of entries in the cache.
+  size_t num_entries() const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileBackedCache);
+
+  // Where an entry is in the file.
+  struct EntryLocation {
+    uint64_t offset;
+    // The size of the entry, including its header.
+    uint64_t size;
+    uint64_t seq;
+  };
+
+  FileBackedCache(std::unique_ptr<RWFile> file, uint64_t region_size, uint64_t num_regions);
+
+  // Index the entries in the file, or reinitialize the file if it doesn't
+  // hold a cache with this layout and owner.
+  Status Init(const std::string& owner);
+
+  // Truncate the file and write its superblock, stamped with 'owner'.
+  Status Format(const std::string& owner);
+
+  // Read the headers of all entries in the file into 'index_'.
+  Status Recover();
+
+  // Write the entry in 'buf', whose header is yet to be filled in, into the
+  // current region. Runs on 'write_pool_'.
+  void WriteEntry(faststring* buf, size_t key_size);
+
+  // Add an entry to the index, replacing any entry with the same key.
+  // Requires 'lock_' to be held.
+  void AddEntryUnlocked(std::string key, const EntryLocation& loc);
+
+  // Remove the entry with the given key if it is still at 'loc'.
+  // Requires 'lock_' to be held.
+  void RemoveEntryUnlocked(const std::string& key, const EntryLocation& loc);
+
+  // Evict all entries in the given region. Requires 'lock_' to be held.
+  void EvictRegionUnlocked(uint64_t region);
+
+  uint64_t RegionOffset(uint64_t region) const;
+  uint64_t RegionOf(uint64_t offset) const;
+
+  const std::unique_ptr<RWFile> file_;
+  const uint64_t region_size_;
+  const uint64_t num_regions_;
+
+  // Single-threaded pool on which inserts are written.
+  std::unique_ptr<ThreadPool> write_pool_;
+
+  // The region being written, and the offset in it of the next entry. Only
+  // accessed on 'write_pool_' once the cache is open.
+  uint64_t write_region_;
+  uint64_t write_offset_;
+
+  // The sequence number of the next entry to be written. Entries written
+  // later have higher sequence numbers, so that the latest entry with a key
+  // can be told apart when the file is indexed. Accessed like 'write_region_'.
+  uint64_t next_seq_;
+
+  // Protects the members below.
+  mutable simple_spinlock lock_;
+
+  std::unordered_map<std::string, EntryLocation> index_;
+
+  // The keys of the entries written to each region, in no particular order.
+  // May include keys whose latest entry is elsewhere.
+  std::vector<std::vector<std::string>> region_keys_;
+
+  // Total size of the indexed entries.
+  uint64_t usage_;
+
+  std::unique_ptr<FileBackedCacheMetrics> metrics_;
+};
+
+} // namespace kudu
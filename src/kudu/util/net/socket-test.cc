@@ -17,8 +17,11 @@
 
 #include "kudu/util/net/socket.h"
 
+#include <sys/uio.h>
+
 #include <thread>
 
+#include <cerrno>
 #include <cstdint>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -86,4 +89,79 @@ TEST_F(SocketTest, TestRecvReset) {
 TEST_F(SocketTest, TestRecvEOF) {
   DoTest(true, "recv got EOF from 127.0.0.1:[0-9]+");
 }
+
+TEST_F(SocketTest, TestResetOnClose) {
+  Sockaddr address;
+  address.ParseString("127.0.0.1", 0);
+  Socket listener;
+  ASSERT_OK(listener.Init(0));
+  ASSERT_OK(listener.BindAndListen(address, 0));
+  Sockaddr listen_address;
+  ASSERT_OK(listener.GetSocketAddress(&listen_address));
+
+  Socket client;
+  ASSERT_OK(client.Init(0));
+  ASSERT_OK(client.Connect(listen_address));
+  Socket server;
+  Sockaddr remote;
+  ASSERT_OK(listener.Accept(&server, &remote, 0));
+
+  // The peer sees the connection reset rather than shut down cleanly.
+  ASSERT_OK(client.SetResetOnClose());
+  ASSERT_OK(client.Close());
+  ASSERT_OK(server.SetRecvTimeout(MonoDelta::FromSeconds(10)));
+  int n;
+  uint8_t buf[16];
+  Status s = server.Recv(buf, sizeof(buf), &n);
+  ASSERT_TRUE(s.IsNetworkError()) << s.ToString();
+  ASSERT_EQ(ECONNRESET, s.posix_code()) << s.ToString();
+}
+
+TEST_F(SocketTest, TestZeroCopySend) {
+  Sockaddr address;
+  address.ParseString("127.0.0.1", 0);
+  Socket listener;
+  ASSERT_OK(listener.Init(0));
+  ASSERT_OK(listener.BindAndListen(address, 0));
+  Sockaddr listen_address;
+  ASSERT_OK(listener.GetSocketAddress(&listen_address));
+
+  Socket client;
+  ASSERT_OK(client.Init(0));
+  ASSERT_OK(client.Connect(listen_address));
+  Socket server;
+  Sockaddr remote;
+  ASSERT_OK(listener.Accept(&server, &remote, 0));
+
+  Status s = client.EnableZeroCopy();
+  if (!s.ok()) {
+    LOG(WARNING) << "Skipping test, zero-copy sends not supported: " << s.ToString();
+    return;
+  }
+  ASSERT_OK(client.SetNonBlocking(true));
+
+  // Send twice, and receive what was sent.
+  std::string data(64 * 1024, 'x');
+  for (int i = 0; i < 2; i++) {
+    struct iovec iov;
+    iov.iov_base = &data[0];
+    iov.iov_len = data.size();
+    int64_t nwritten;
+    ASSERT_OK(client.WritevZeroCopy(&iov, 1, &nwritten));
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[nwritten]);
+    size_t nread;
+    ASSERT_OK(server.BlockingRecv(buf.get(), nwritten, &nread,
+                                  MonoTime::Now() + MonoDelta::FromSeconds(10)));
+  }
+
+  // Both sends are reported complete.
+  uint32_t next_send = 0;
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_OK(client.ReadZeroCopyCompletions([&](uint32_t first, uint32_t last) {
+      CHECK_EQ(next_send, first);
+      next_send = last + 1;
+    }));
+    ASSERT_EQ(2, next_send);
+  });
+}
 } // namespace kudu
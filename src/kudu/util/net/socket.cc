@@ -24,6 +24,10 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#endif
+
 #include <cerrno>
 #include <cinttypes>
 #include <cstring>
@@ -244,6 +248,15 @@ Status Socket::SetReuseAddr(bool flag) {
   return Status::OK();
 }
 
+Status Socket::SetResetOnClose() {
+  struct linger l;
+  l.l_onoff = 1;
+  l.l_linger = 0;
+  RETURN_NOT_OK_PREPEND(SetSockOpt(SOL_SOCKET, SO_LINGER, l),
+                        "failed to set SO_LINGER");
+  return Status::OK();
+}
+
 Status Socket::SetReusePort(bool flag) {
   #ifdef SO_REUSEPORT
     int int_flag = flag ? 1 : 0;
@@ -454,6 +467,90 @@ Status Socket::Writev(const struct ::iovec *iov, int iov_len,
   return Status::OK();
 }
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define KUDU_HAVE_MSG_ZEROCOPY 1
+#endif
+
+Status Socket::EnableZeroCopy() {
+#if defined(KUDU_HAVE_MSG_ZEROCOPY)
+  RETURN_NOT_OK_PREPEND(SetSockOpt(SOL_SOCKET, SO_ZEROCOPY, 1),
+                        "failed to set SO_ZEROCOPY");
+  return Status::OK();
+#else
+  return Status::NotSupported("MSG_ZEROCOPY is not supported on this platform");
+#endif
+}
+
+Status Socket::WritevZeroCopy(const struct ::iovec *iov, int iov_len,
+                              int64_t *nwritten) {
+#if defined(KUDU_HAVE_MSG_ZEROCOPY)
+  if (PREDICT_FALSE(iov_len <= 0)) {
+    return Status::NetworkError(
+                StringPrintf("writev: invalid io vector length of %d",
+                             iov_len),
+                Slice(), EINVAL);
+  }
+  DCHECK_GE(fd_, 0);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(struct msghdr));
+  msg.msg_iov = const_cast<iovec *>(iov);
+  msg.msg_iovlen = iov_len;
+  ssize_t res;
+  RETRY_ON_EINTR(res, ::sendmsg(fd_, &msg, MSG_NOSIGNAL | MSG_ZEROCOPY));
+  if (PREDICT_FALSE(res < 0)) {
+    int err = errno;
+    return Status::NetworkError("sendmsg error", ErrnoToString(err), err);
+  }
+
+  *nwritten = res;
+  return Status::OK();
+#else
+  return Status::NotSupported("MSG_ZEROCOPY is not supported on this platform");
+#endif
+}
+
+Status Socket::ReadZeroCopyCompletions(const std::function<void(uint32_t, uint32_t)>& cb) {
+#if defined(KUDU_HAVE_MSG_ZEROCOPY)
+  DCHECK_GE(fd_, 0);
+  while (true) {
+    uint8_t control[CMSG_SPACE(sizeof(struct sock_extended_err) +
+                               sizeof(struct sockaddr_storage))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t res;
+    RETRY_ON_EINTR(res, ::recvmsg(fd_, &msg, MSG_ERRQUEUE));
+    if (res < 0) {
+      int err = errno;
+      if (err == EAGAIN) {
+        return Status::OK();
+      }
+      return Status::NetworkError("recvmsg error on error queue", ErrnoToString(err), err);
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      const auto* ee = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      if (ee->ee_errno != 0) {
+        return Status::NetworkError("zero-copy send failed",
+                                    ErrnoToString(ee->ee_errno), ee->ee_errno);
+      }
+      cb(ee->ee_info, ee->ee_data);
+    }
+  }
+#else
+  return Status::NotSupported("MSG_ZEROCOPY is not supported on this platform");
+#endif
+}
+
 // Mostly follows writen() from Stevens (2004) or Kerrisk (2010).
 Status Socket::BlockingWrite(const uint8_t *buf, size_t buflen, size_t *nwritten,
     const MonoTime& deadline) {
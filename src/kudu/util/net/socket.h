@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
@@ -88,6 +89,11 @@ class Socket {
   // Sets SO_REUSEPORT to 'flag'. Should be used prior to Bind().
   Status SetReusePort(bool flag);
 
+  // Sets SO_LINGER with a timeout of 0, so that Close() resets the
+  // connection and discards any data the kernel hasn't sent yet, rather than
+  // keep sending it after the socket is closed.
+  Status SetResetOnClose();
+
   // Convenience method to invoke the common sequence:
   // 1) SetReuseAddr(true)
   // 2) Bind()
@@ -136,6 +142,26 @@ class Socket {
   // bytes must be retried. See writev(2) for more information.
   virtual Status Writev(const struct ::iovec *iov, int iov_len, int64_t *nwritten);
 
+  // Allow WritevZeroCopy() to be used on the socket, by setting SO_ZEROCOPY.
+  // Returns NotSupported if the socket or platform can't send with
+  // MSG_ZEROCOPY, and an error if the kernel doesn't support it.
+  virtual Status EnableZeroCopy();
+
+  // Like Writev(), but with MSG_ZEROCOPY: rather than copying the data into
+  // the socket buffer, the kernel may pin the memory it's in and send it
+  // from there. That memory must not be modified or freed until the kernel
+  // has reported the send complete, see ReadZeroCopyCompletions(). Each call
+  // which succeeds is numbered by the kernel, consecutively from 0.
+  //
+  // Requires EnableZeroCopy() to have succeeded.
+  Status WritevZeroCopy(const struct ::iovec *iov, int iov_len, int64_t *nwritten);
+
+  // Read the notifications of completed zero-copy sends from the socket's
+  // error queue until it's empty, calling 'cb' with the numbers of the first
+  // and last sends which each of them covers. Sends are usually, but not
+  // necessarily, reported in order.
+  Status ReadZeroCopyCompletions(const std::function<void(uint32_t, uint32_t)>& cb);
+
   // Blocking Write call, returns IOError unless full buffer is sent.
   // Underlying Socket expected to be in blocking mode. Fails if any Write() sends 0 bytes.
   // Returns OK if buflen bytes were sent, otherwise IOError.
@@ -63,6 +63,7 @@ struct memkind;
 
 // Useful in tests that require accurate cache capacity accounting.
 DECLARE_bool(cache_force_single_shard);
+DECLARE_int32(cache_num_shards);
 
 DEFINE_string(nvm_cache_path, "/pmem",
               "The path at which the NVM cache will try to allocate its memory. "
@@ -560,8 +561,11 @@ size_t NvmLRUCache::Invalidate(const Cache::InvalidationControl& ctl) {
 // Determine the number of bits of the hash that should be used to determine
 // the cache shard. This, in turn, determines the number of shards.
 int DetermineShardBits() {
-  int bits = PREDICT_FALSE(FLAGS_cache_force_single_shard) ?
-      0 : Bits::Log2Ceiling(base::NumCPUs());
+  int bits = 0;
+  if (PREDICT_TRUE(!FLAGS_cache_force_single_shard)) {
+    bits = Bits::Log2Ceiling(FLAGS_cache_num_shards > 0 ? FLAGS_cache_num_shards
+                                                        : base::NumCPUs());
+  }
   VLOG(1) << "Will use " << (1 << bits) << " shards for LRU cache.";
   return bits;
 }
@@ -17,16 +17,24 @@
 
 #include "kudu/util/os-util.h"
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
+#include <glog/logging.h>
 #include <gtest/gtest.h>
 
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/test_macros.h"
 
 using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -59,4 +67,30 @@ TEST(OsUtilTest, TestSelfNameWithParens) {
   RunTest("a(b(c((d))e)", 111, 222, 333);
 }
 
+#if defined(__linux__)
+TEST(OsUtilTest, TestGetAllowedCpus) {
+  vector<int> cpus;
+  ASSERT_OK(GetAllowedCpus(&cpus));
+  ASSERT_FALSE(cpus.empty());
+  ASSERT_TRUE(std::is_sorted(cpus.begin(), cpus.end()));
+  // The thread is running on one of the CPUs it's allowed to.
+  ASSERT_TRUE(std::binary_search(cpus.begin(), cpus.end(), sched_getcpu()));
+
+  // Once pinned, the thread is only allowed to run on that CPU.
+  const int cpu = cpus.back();
+  ASSERT_OK(PinCurrentThreadToCpu(cpu));
+  SCOPED_CLEANUP({
+    cpu_set_t all;
+    CPU_ZERO(&all);
+    for (int c : cpus) {
+      CPU_SET(c, &all);
+    }
+    CHECK_EQ(0, sched_setaffinity(0, sizeof(all), &all));
+  });
+  vector<int> pinned;
+  ASSERT_OK(GetAllowedCpus(&pinned));
+  ASSERT_EQ(vector<int>({ cpu }), pinned);
+}
+#endif // defined(__linux__)
+
 } // namespace kudu
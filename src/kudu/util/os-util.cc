@@ -25,9 +25,13 @@
 #include "kudu/util/os-util.h"
 
 #include <fcntl.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstddef>
 #include <ostream>
 #include <string>
@@ -43,6 +47,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/util/env.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/status.h"
@@ -143,6 +148,43 @@ void DisableCoreDumps() {
   }
 }
 
+Status GetAllowedCpus(vector<int>* cpus) {
+#ifndef __linux__
+  return Status::NotSupported("CPU affinity is not supported on this platform");
+#else
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    int err = errno;
+    return Status::IOError("could not get the CPU affinity of the thread",
+                           ErrnoToString(err), err);
+  }
+  cpus->clear();
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus->push_back(cpu);
+    }
+  }
+  return Status::OK();
+#endif // __linux__
+}
+
+Status PinCurrentThreadToCpu(int cpu) {
+#ifndef __linux__
+  return Status::NotSupported("CPU affinity is not supported on this platform");
+#else
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    int err = errno;
+    return Status::IOError(Substitute("could not pin thread to CPU $0", cpu),
+                           ErrnoToString(err), err);
+  }
+  return Status::OK();
+#endif // __linux__
+}
+
 bool IsBeingDebugged() {
 #ifndef __linux__
   return false;
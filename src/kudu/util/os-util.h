@@ -26,6 +26,7 @@
 #include <cstdint>
 #include <string>
 #include <type_traits> // IWYU pragma: keep
+#include <vector>
 
 #include "kudu/util/status.h"
 
@@ -62,6 +63,18 @@ Status GetThreadStats(int64_t tid, ThreadStats* stats);
 // want to generate a core dump from an "expected" crash.
 void DisableCoreDumps();
 
+// Get the CPUs which the calling thread is allowed to run on, in ascending
+// order. This reflects any restriction of the process to a cpuset, or by
+// 'taskset'.
+//
+// Returns NotSupported on platforms without CPU affinity (non-Linux).
+Status GetAllowedCpus(std::vector<int>* cpus);
+
+// Restrict the calling thread to run only on CPU 'cpu'.
+//
+// Returns NotSupported on platforms without CPU affinity (non-Linux).
+Status PinCurrentThreadToCpu(int cpu);
+
 // Return true if this process appears to be running under a debugger or strace.
 //
 // This may return false on unsupported (non-Linux) platforms.
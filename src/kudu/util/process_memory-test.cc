@@ -72,4 +72,23 @@ TEST(ProcessMemory, BenchmarkConsumptionTracking) {
   LOG(INFO) << "Performed " << total_count / secs << " iters/sec";
 }
 
+#ifdef TCMALLOC_ENABLED
+TEST(ProcessMemory, TestThreadBytesAllocated) {
+  process_memory::StartCountingThreadAllocations();
+  int64_t before = process_memory::ThreadBytesAllocated();
+  char* volatile x = new char[8000];
+  delete[] x;
+  ASSERT_GE(process_memory::ThreadBytesAllocated() - before, 8000);
+
+  // Allocations made by other threads aren't counted.
+  before = process_memory::ThreadBytesAllocated();
+  thread t([]() {
+    char* volatile y = new char[8000];
+    delete[] y;
+  });
+  t.join();
+  ASSERT_LT(process_memory::ThreadBytesAllocated() - before, 8000);
+}
+#endif
+
 } // namespace kudu
@@ -23,6 +23,7 @@
 #include <glog/logging.h>
 #ifdef TCMALLOC_ENABLED
 #include <gperftools/malloc_extension.h>  // IWYU pragma: keep
+#include <gperftools/malloc_hook.h>       // IWYU pragma: keep
 #endif
 
 #include "kudu/gutil/atomicops.h"
@@ -162,6 +163,34 @@ void GcTcmalloc() {
 #endif // TCMALLOC_ENABLED
 
 
+// Per-thread allocation counting
+// ------------------------------------------------------------
+namespace {
+__thread int64_t g_thread_bytes_allocated = 0;
+GoogleOnceType g_count_thread_allocations_once = GOOGLE_ONCE_INIT;
+
+#ifdef TCMALLOC_ENABLED
+void CountThreadAllocation(const void* /*ptr*/, size_t size) {
+  g_thread_bytes_allocated += size;
+}
+#endif
+
+void DoStartCountingThreadAllocations() {
+#ifdef TCMALLOC_ENABLED
+  CHECK(MallocHook::AddNewHook(&CountThreadAllocation));
+#endif
+}
+} // anonymous namespace
+
+void StartCountingThreadAllocations() {
+  GoogleOnceInit(&g_count_thread_allocations_once, &DoStartCountingThreadAllocations);
+}
+
+int64_t ThreadBytesAllocated() {
+  return g_thread_bytes_allocated;
+}
+
+
 // Consumption and soft memory limit behavior
 // ------------------------------------------------------------
 namespace {
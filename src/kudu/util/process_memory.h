@@ -50,6 +50,16 @@ int64_t SoftLimit();
 // Return the configured memory pressure threshold for the process.
 int64_t MemoryPressureThreshold();
 
+// Start counting the bytes allocated by each thread, see
+// ThreadBytesAllocated(). This hooks every allocation, so isn't done unless
+// asked for. Does nothing unless built with tcmalloc. Thread-safe, and may be
+// called more than once.
+void StartCountingThreadAllocations();
+
+// Return the number of bytes allocated by the calling thread since
+// StartCountingThreadAllocations() was first called, or 0 if it wasn't.
+int64_t ThreadBytesAllocated();
+
 #ifdef TCMALLOC_ENABLED
 // Get the current amount of allocated memory, according to tcmalloc.
 //